@@ -4,9 +4,16 @@
 #include <hal_ext_irq.h>
 #include <hal_spi_m_sync.h>
 #include <hal_atomic.h>
+#include <hal_sleep.h>
+#include <hal_timer.h>
+#include <utils_assert.h>
 
 #include <atmel_start_pins.h>
 
+#include <hpl_eic_config.h>
+#include <hpl_tc_config.h>
+#include <peripheral_clk_config.h>
+
 //#define USE_CONFIG_PUBLIC_NETOWRK 0
 #define XTAL 1
 #define ADV_DEBUG 0
@@ -15,6 +22,9 @@
 #define SX1262 1
 #define SX1268 0
 
+// 1: DIO1 edges are time stamped by TC0 through the EVSYS, 0: by software in the IRQ handling
+#define DIO1_CAPTURE 1
+
 //volatile hal_atomic_t __atomic;
 //#define CRITICAL_SECTION_ENTER atomic_enter_critical(&__atomic)
 //#define CRITICAL_SECTION_LEAVE atomic_leave_critical(&__atomic)
@@ -38,10 +48,69 @@ int32_t SendSpi(uint8_t *data, uint8_t len);
 
 int32_t ReadSpi(uint8_t *rx_data, uint8_t len);
 
+int32_t TransferSpi(uint8_t *tx_data, uint8_t *rx_data, uint8_t len);// Full-duplex, rx_data gets what the radio clocks out
+
 void IRQ_Init(void);// Possibility to add DIO2 and DIO3 interrupts
 
 void DIO1_IRQ(void);
 
+#define IN_INTERRUPT() (__get_IPSR() != 0) // An exception handler is running
+
+#define DIO1_REQUEST 0 // Deferred request of DIO1 in the HAL, see SX126xHal_DeferFromIsr
+
+// MCU low power, values of PM SLEEPCFG.SLEEPMODE
+
+#define MCU_SLEEP_IDLE 2
+#define MCU_SLEEP_STANDBY 4
+
+// STANDBY stops the EIC clock, DIO1 can wake the MCU only with asynchronous edge detection
+#define MCU_STANDBY_WAKES_ON_DIO1 CONF_EIC_ASYNCH0
+// The timer tasks run on TC7, they are late if TC7 stops in STANDBY
+#define MCU_STANDBY_KEEPS_TIMER CONF_TC7_RUNSTDBY
+
+#define NO_TIMER_TASK 0xFFFFFFFF
+
+void mcu_sleep(const uint8_t mode);
+
+uint32_t get_time_us(void);
+
+uint32_t next_timer_task_us(void);// NO_TIMER_TASK if nothing is scheduled
+
+// One shot timer tasks on the same timer, used by the bare-metal backend of sx126x_os
+
+void timer_task_start(struct timer_task *task, uint32_t ms, void (*cb)(const struct timer_task *const));
+
+void timer_task_stop(struct timer_task *task);
+
+// Time stamps of the radio events
+
+#if DIO1_CAPTURE
+// TC0 is not an Atmel Start component, it runs from the generator of TIMER_0 (TC7)
+#ifndef CONF_GCLK_TC0_SRC
+#define CONF_GCLK_TC0_SRC CONF_GCLK_TC7_SRC
+#define CONF_GCLK_TC0_FREQUENCY CONF_GCLK_TC7_FREQUENCY
+#endif
+#define TIMESTAMP_PRESCALER 3 // TC0 CTRLA.PRESCALER, DIV8
+#define TIMESTAMP_TICKS_PER_US (CONF_GCLK_TC0_FREQUENCY / (1 << TIMESTAMP_PRESCALER) / 1000000)
+#if (CONF_GCLK_TC0_FREQUENCY % ((1 << TIMESTAMP_PRESCALER) * 1000000)) != 0
+#error "TC0 must count a whole number of ticks per us, change TIMESTAMP_PRESCALER"
+#endif
+#else
+#define TIMESTAMP_TICKS_PER_US 1
+#endif
+
+void DIO1_CaptureInit(void);
+
+uint32_t get_timestamp(void);
+
+uint32_t DIO1_GetTimestamp(void);// Time of the last DIO1 rising edge, or now if it was not captured
+
+// One shot timer in the time stamp ticks, the callback runs in the TC0 interrupt
+
+bool slot_timer_start(uint32_t timestamp, void (*callback)(void));// false without DIO1_CAPTURE
+
+void slot_timer_stop(void);
+
 // Some macro definitions
 
 #define wait_ms delay_ms
@@ -0,0 +1,162 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_ADR_H__
+#define __SX126x_ADR_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Peers tracked, the least recently used one is replaced
+ */
+#define ADR_MAX_PEERS                               8
+
+/*!
+ * \brief SNR samples averaged per peer, all needed before a faster rate
+ */
+#define ADR_HISTORY                                 8
+
+/*!
+ * \brief SNR kept above the demodulator floor of the rate, in dB, and
+ *        the extra needed to move to a faster rate
+ */
+#define ADR_MARGIN_DB                               5
+#define ADR_HYSTERESIS_DB                           3
+
+/*!
+ * \brief Packets missed in a row before falling back to the default rate
+ */
+#define ADR_MAX_MISSES                              4
+
+/*!
+ * \brief Negotiation frames: type, rate, token and, for the answer, 0 if
+ *        the rate is accepted
+ */
+#define ADR_TYPE_REQUEST                            0xD1
+#define ADR_TYPE_ANSWER                             0xD2
+#define ADR_REQUEST_SIZE                            3
+#define ADR_ANSWER_SIZE                             4
+
+/*!
+ * \brief A LoRa data rate
+ */
+typedef struct
+{
+    RadioLoRaSpreadingFactors_t  SpreadingFactor;
+    RadioLoRaBandwidths_t        Bandwidth;
+    RadioLoRaCodingRates_t       CodingRate;
+    int8_t                       RequiredSnr;       //!< Demodulator floor [0.25 dB]
+    int8_t                       NoiseOffset;       //!< Noise over the 125 kHz one [0.25 dB]
+}AdrDataRate_t;
+
+/*!
+ * \brief Number of entries of the data rate table, slowest first
+ */
+#define ADR_DATA_RATES                              9
+
+/*!
+ * \brief Clears the peers, they start at the default rate
+ *
+ * \param [in]  defaultRate   Index in the data rate table, used by new peers
+ *                            and after a lost link
+ */
+void SX126x_AdrInit( uint8_t defaultRate );
+
+/*!
+ * \brief Gets an entry of the data rate table
+ *
+ * \param [in]  rate          Its index
+ *
+ * \retval      dataRate      The entry, NULL if out of the table
+ */
+const AdrDataRate_t *SX126x_AdrGetDataRate( uint8_t rate );
+
+/*!
+ * \brief Records the SNR of a packet received from a peer
+ *
+ * \param [in]  peer          Address of the peer
+ * \param [in]  pktStatus     Status from SX126x_GetPacketStatus
+ */
+void SX126x_AdrOnPacket( uint8_t peer, PacketStatus_t *pktStatus );
+
+/*!
+ * \brief Records a packet expected from a peer and not received
+ *
+ * \param [in]  peer          Address of the peer
+ */
+void SX126x_AdrOnMiss( uint8_t peer );
+
+/*!
+ * \brief Gets the rate in use with a peer
+ *
+ * \param [in]  peer          Address of the peer
+ *
+ * \retval      rate          Index in the data rate table
+ */
+uint8_t SX126x_AdrGetRate( uint8_t peer );
+
+/*!
+ * \brief Chooses the fastest rate keeping ADR_MARGIN_DB over its floor, from
+ *        the average SNR of the peer converted to the bandwidth of each rate
+ *
+ * \param [in]  peer          Address of the peer
+ *
+ * \retval      rate          Index in the data rate table
+ */
+uint8_t SX126x_AdrSelect( uint8_t peer );
+
+/*!
+ * \brief Builds a request for the rate chosen by SX126x_AdrSelect, to be sent
+ *        to the peer at the current rate
+ *
+ * \param [in]  peer          Address of the peer
+ * \param [out] buffer        The request, ADR_REQUEST_SIZE bytes
+ *
+ * \retval      size          Its size, 0 if the rate does not change
+ */
+uint8_t SX126x_AdrBuildRequest( uint8_t peer, uint8_t *buffer );
+
+/*!
+ * \brief Handles a negotiation frame received from a peer. A request is
+ *        accepted unless the SNR seen here rules the rate out, the rate is
+ *        used once the answer is sent. An answer switches the rate at once.
+ *
+ * \param [in]  peer          Address of the peer
+ * \param [in]  payload       The frame
+ * \param [in]  size          Its size
+ * \param [out] answer        The answer to send, ADR_ANSWER_SIZE bytes
+ *
+ * \retval      size          Size of the answer, 0 if none
+ */
+uint8_t SX126x_AdrOnFrame( uint8_t peer, uint8_t *payload, uint8_t size, uint8_t *answer );
+
+/*!
+ * \brief To be called when the answer to a peer has been sent
+ *
+ * \param [in]  peer          Address of the peer
+ */
+void SX126x_AdrOnAnswerSent( uint8_t peer );
+
+/*!
+ * \brief Sets the modulation of the rate used with a peer, before sending to
+ *        it or receiving from it
+ *
+ * \param [in]  peer          Address of the peer
+ */
+void SX126x_AdrApply( uint8_t peer );
+
+#endif // __SX126x_ADR_H__
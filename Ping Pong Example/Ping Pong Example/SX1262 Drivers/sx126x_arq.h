@@ -0,0 +1,128 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_ARQ_H__
+#define __SX126x_ARQ_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Frames in flight, up to 32 (one SACK bit each), 1 for stop-and-wait
+ */
+#ifndef ARQ_WINDOW
+#define ARQ_WINDOW                                  8
+#endif
+
+/*!
+ * \brief Largest payload of a frame
+ */
+#define ARQ_MAX_PAYLOAD                             64
+
+/*!
+ * \brief Data frame header: type and flags, sequence number, oldest frame
+ *        the sender still holds
+ *        SACK frame: type, next sequence expected, 32 bit map of the frames
+ *        received after it (LSB first)
+ */
+#define ARQ_HEADER_SIZE                             3
+#define ARQ_SACK_SIZE                               6
+
+#define ARQ_TYPE_DATA                               0xA1
+#define ARQ_TYPE_SACK                               0xA2
+#define ARQ_FLAG_ACK_REQUEST                        0x08
+
+/*!
+ * \brief Frames sent between two acknowledgement requests
+ */
+#define ARQ_ACK_EVERY                               ( ( ARQ_WINDOW + 1 ) / 2 )
+
+/*!
+ * \brief Transmissions of a frame before it is dropped
+ */
+#define ARQ_MAX_RETRIES                             8
+
+/*!
+ * \brief Time for the receiver to turn a frame into a SACK on air, in us
+ */
+#define ARQ_ACK_DELAY_US                            10000
+
+/*!
+ * \brief Bounds of the retransmission timeout, in us
+ */
+#define ARQ_MIN_RTO_US                              50000
+#define ARQ_MAX_RTO_US                              30000000
+
+/*!
+ * \brief Counters of the link
+ */
+typedef struct
+{
+    uint32_t      Sent;                             //!< Frames sent, retransmissions included
+    uint32_t      Retransmitted;
+    uint32_t      Dropped;                          //!< Frames given up after ARQ_MAX_RETRIES
+    uint32_t      Delivered;                        //!< Frames received in order
+    uint32_t      Rto;                              //!< Current retransmission timeout [us]
+    uint32_t      Srtt;                             //!< Smoothed round trip time [us]
+}ArqStats_t;
+
+/*!
+ * \brief Resets both directions of the link
+ *
+ * \param [in]  modParams     Modulation of the link
+ * \param [in]  packetParams  Packet format of the link
+ */
+void SX126x_ArqInit( ModulationParams_t *modParams, PacketParams_t *packetParams );
+
+/*!
+ * \brief Queues a payload, it is staged in the window until acknowledged
+ *
+ * \param [in]  payload       The payload
+ * \param [in]  size          Its size, 1 to ARQ_MAX_PAYLOAD
+ *
+ * \retval      status        0 if queued, 1 if the window is full
+ */
+uint8_t SX126x_ArqSend( uint8_t *payload, uint8_t size );
+
+/*!
+ * \brief Gets the next payload received in order
+ *
+ * \param [out] buffer        The payload
+ * \param [in]  maxSize       Size of the buffer
+ *
+ * \retval      size          Its size, 0 if there is none
+ */
+uint8_t SX126x_ArqReceive( uint8_t *buffer, uint8_t maxSize );
+
+/*!
+ * \brief Sends the next new or timed out frame when the radio is free, or
+ *        listens. To be called from the main loop.
+ */
+void SX126x_ArqProcess( void );
+
+/*!
+ * \brief Radio events to forward
+ */
+void SX126x_ArqOnTxDone( void );
+void SX126x_ArqOnRxDone( uint8_t *payload, uint8_t size );
+void SX126x_ArqOnTimeout( void );
+
+/*!
+ * \brief Gets the counters
+ */
+void SX126x_ArqGetStats( ArqStats_t *stats );
+
+#endif // __SX126x_ARQ_H__
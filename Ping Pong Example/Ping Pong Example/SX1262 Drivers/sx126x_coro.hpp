@@ -0,0 +1,471 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_CORO_HPP__
+#define __SX126x_CORO_HPP__
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#include "sx126x.hpp"
+
+/*!
+ * \brief C++20 coroutines over the radio of sx126x.hpp, for protocols written
+ *        as straight-line code:
+ *
+ *     sx126x::coro::Task Ping( Radio &radio )
+ *     {
+ *         for( uint8_t retry = 0; retry < 3; retry++ )
+ *         {
+ *             co_await radio.Transmit( request );
+ *             auto rx = co_await radio.Receive( answer, 100 );
+ *             if( rx.Result == sx126x::coro::RxResult::Ok )
+ *             {
+ *                 co_return;
+ *             }
+ *         }
+ *     }
+ *
+ *     sx126x::coro::Spawn( Ping( radio ) );
+ *     sx126x::coro::Run< Idle >( radio );
+ *
+ * The DIO1 interrupt only calls AsyncRadio::OnDio1. The coroutines are resumed
+ * by the event loop in the main loop context, so the SPI is never used from an
+ * interrupt and nothing in here needs locking. Coroutine frames come from a
+ * static pool, there is no heap.
+ */
+
+/*!
+ * \brief Size of a coroutine frame slot and number of slots. A Task holding
+ *        a larger frame fails to start (Task::Valid is false).
+ */
+#ifndef SX126X_CORO_FRAME_SIZE
+#define SX126X_CORO_FRAME_SIZE                      256
+#endif
+#ifndef SX126X_CORO_FRAMES
+#define SX126X_CORO_FRAMES                          8
+#endif
+
+namespace sx126x::coro
+{
+
+static_assert( SX126X_CORO_FRAMES <= 32, "one bit per frame in a 32 bits mask" );
+
+/*!
+ * \brief Fixed pool of coroutine frames, used from the main loop only
+ */
+class FramePool
+{
+public:
+    static void *Allocate( std::size_t size ) noexcept
+    {
+        if( size > SX126X_CORO_FRAME_SIZE )
+        {
+            return nullptr;
+        }
+        for( uint8_t i = 0; i < SX126X_CORO_FRAMES; i++ )
+        {
+            if( ( Used & ( 1UL << i ) ) == 0 )
+            {
+                Used |= ( 1UL << i );
+                return Frames[i].Data;
+            }
+        }
+        return nullptr;
+    }
+
+    static void Free( void *frame ) noexcept
+    {
+        std::size_t i = static_cast< Block * >( frame ) - Frames;
+
+        Used &= ~( 1UL << i );
+    }
+
+    /*!
+     * \brief Number of frames in use
+     */
+    static uint8_t InUse( ) noexcept
+    {
+        return static_cast< uint8_t >( __builtin_popcount( Used ) );
+    }
+
+private:
+    struct alignas( std::max_align_t ) Block
+    {
+        unsigned char Data[SX126X_CORO_FRAME_SIZE];
+    };
+
+    static inline Block Frames[SX126X_CORO_FRAMES];
+    static inline uint32_t Used = 0;
+};
+
+/*!
+ * \brief Coroutine returning nothing. It starts when awaited, resuming the
+ *        awaiting coroutine when done, or when given to Spawn.
+ */
+class Task
+{
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle< promise_type >;
+
+    struct FinalAwaiter
+    {
+        bool await_ready( ) noexcept { return false; }
+
+        std::coroutine_handle< > await_suspend( Handle handle ) noexcept
+        {
+            std::coroutine_handle< > next = handle.promise( ).Continuation;
+
+            if( handle.promise( ).Detached )
+            {
+                // Nobody owns a spawned task, its frame goes back to the pool here
+                handle.destroy( );
+            }
+            return next;
+        }
+
+        void await_resume( ) noexcept { }
+    };
+
+    struct promise_type
+    {
+        std::coroutine_handle< > Continuation = std::noop_coroutine( );
+        bool Detached = false;
+
+        Task get_return_object( ) noexcept { return Task( Handle::from_promise( *this ) ); }
+        static Task get_return_object_on_allocation_failure( ) noexcept { return Task( ); }
+        std::suspend_always initial_suspend( ) noexcept { return { }; }
+        FinalAwaiter final_suspend( ) noexcept { return { }; }
+        void return_void( ) noexcept { }
+        void unhandled_exception( ) noexcept { std::terminate( ); }
+
+        static void *operator new( std::size_t size ) noexcept { return FramePool::Allocate( size ); }
+        static void operator delete( void *frame ) noexcept { FramePool::Free( frame ); }
+    };
+
+    Task( ) = default;
+    Task( Task &&other ) noexcept : Coroutine( other.Coroutine ) { other.Coroutine = nullptr; }
+    Task( const Task & ) = delete;
+    Task &operator=( const Task & ) = delete;
+
+    ~Task( )
+    {
+        if( Coroutine )
+        {
+            Coroutine.destroy( );
+        }
+    }
+
+    /*!
+     * \brief false if no frame was left in the pool
+     */
+    bool Valid( ) const { return static_cast< bool >( Coroutine ); }
+
+    bool await_ready( ) const noexcept { return !Coroutine; }
+
+    std::coroutine_handle< > await_suspend( std::coroutine_handle< > awaiting ) noexcept
+    {
+        Coroutine.promise( ).Continuation = awaiting;
+        return Coroutine;
+    }
+
+    void await_resume( ) noexcept { }
+
+    /*!
+     * \brief Starts a task nobody awaits, its frame is freed when it ends
+     *
+     * \retval      started       false if the task got no frame
+     */
+    friend bool Spawn( Task task )
+    {
+        Handle handle = task.Coroutine;
+
+        if( !handle )
+        {
+            return false;
+        }
+        task.Coroutine = nullptr;
+        handle.promise( ).Detached = true;
+        handle.resume( );
+        return true;
+    }
+
+private:
+    explicit Task( Handle handle ) : Coroutine( handle ) { }
+
+    Handle Coroutine = nullptr;
+};
+
+bool Spawn( Task task );
+
+struct TxResult
+{
+    enum Results : uint8_t { Ok, Timeout } Result;
+};
+
+struct RxResult
+{
+    enum Results : uint8_t { Ok, Timeout, CrcError, HeaderError } Result;
+    uint8_t Length;                                 //!< Bytes received, only the first fit the buffer
+};
+
+struct CadResult
+{
+    bool Activity;
+};
+
+/*!
+ * \brief Radio with awaitable operations, one at a time. LoRa only: the
+ *        payload length goes in the LoRa packet parameters.
+ */
+template< typename Bus, typename Pins >
+class AsyncRadio : public Radio< Bus, Pins >
+{
+public:
+    using Base = Radio< Bus, Pins >;
+
+    /*!
+     * \brief Routes the IRQs ending the operations to DIO1 and sets the packet
+     *        parameters, after the modulation is configured
+     */
+    void Begin( uint16_t preamble = 8, bool crc = true, bool invertIq = false )
+    {
+        constexpr Irq irqs = Irq::TxDone | Irq::RxDone | Irq::CrcError | Irq::HeaderError | Irq::CadDone |
+                             Irq::CadActivityDetected | Irq::RxTxTimeout;
+
+        Preamble = preamble;
+        Crc = crc;
+        InvertIq = invertIq;
+        Base::SetBufferBaseAddress( 0x00, 0x00 );
+        Base::SetDioIrqParams( irqs, irqs );
+        Base::ClearIrqStatus( Irq::All );
+    }
+
+    /*!
+     * \brief To be called from the DIO1 interrupt
+     */
+    void OnDio1( ) { Pending = true; }
+
+    bool IsPending( ) const { return Pending; }
+
+    /*!
+     * \brief Resumes the coroutine waiting on the radio if DIO1 rose, called
+     *        by the event loop
+     *
+     * \retval      progressed    true if the IRQs were served
+     */
+    bool Process( )
+    {
+        if( !Pending )
+        {
+            return false;
+        }
+        Pending = false;
+        Result = Base::GetIrqStatus( );
+        Base::ClearIrqStatus( Result );
+        if( Waiter )
+        {
+            std::coroutine_handle< > waiter = Waiter;
+
+            Waiter = nullptr;
+            waiter.resume( );
+        }
+        return true;
+    }
+
+    struct TxAwaiter
+    {
+        AsyncRadio &R;
+        Span< const uint8_t > Payload;
+        uint32_t Timeout;
+
+        bool await_ready( ) const noexcept { return false; }
+
+        void await_suspend( std::coroutine_handle< > handle )
+        {
+            R.Waiter = handle;
+            R.WriteBuffer( 0x00, Payload );
+            R.SetLoRaPacketParams( R.Preamble, false, static_cast< uint8_t >( Payload.size( ) ), R.Crc, R.InvertIq );
+            R.SetTx( Timeout );
+        }
+
+        TxResult await_resume( ) const noexcept
+        {
+            return { ( R.Result & Irq::TxDone ) ? TxResult::Ok : TxResult::Timeout };
+        }
+    };
+
+    struct RxAwaiter
+    {
+        AsyncRadio &R;
+        Span< uint8_t > Buffer;
+        uint32_t Timeout;
+
+        bool await_ready( ) const noexcept { return false; }
+
+        void await_suspend( std::coroutine_handle< > handle )
+        {
+            R.Waiter = handle;
+            R.SetLoRaPacketParams( R.Preamble, false, 0xFF, R.Crc, R.InvertIq );
+            R.SetRx( Timeout );
+        }
+
+        RxResult await_resume( )
+        {
+            uint8_t length;
+            uint8_t start;
+
+            if( R.Result & Irq::HeaderError )
+            {
+                return { RxResult::HeaderError, 0 };
+            }
+            if( R.Result & Irq::CrcError )
+            {
+                return { RxResult::CrcError, 0 };
+            }
+            if( !( R.Result & Irq::RxDone ) )
+            {
+                return { RxResult::Timeout, 0 };
+            }
+            R.GetRxBufferStatus( length, start );
+            R.ReadBuffer( start, Span< uint8_t >( Buffer.data( ), ( length < Buffer.size( ) ) ? length : Buffer.size( ) ) );
+            return { RxResult::Ok, length };
+        }
+    };
+
+    struct CadAwaiter
+    {
+        AsyncRadio &R;
+
+        bool await_ready( ) const noexcept { return false; }
+
+        void await_suspend( std::coroutine_handle< > handle )
+        {
+            R.Waiter = handle;
+            R.SetCad( );
+        }
+
+        CadResult await_resume( ) const noexcept { return { R.Result & Irq::CadActivityDetected }; }
+    };
+
+    /*!
+     * \brief Sends a packet
+     *
+     * \param [in]  payload       Up to 255 bytes
+     * \param [in]  timeoutMs     Radio side TX timeout, 0 for none
+     */
+    TxAwaiter Transmit( Span< const uint8_t > payload, uint32_t timeoutMs = 0 )
+    {
+        return { *this, payload, Ticks( timeoutMs ) };
+    }
+
+    /*!
+     * \brief Receives a packet
+     *
+     * \param [out] buffer        Gets the payload, truncated to its size
+     * \param [in]  timeoutMs     Radio side RX timeout, 0 to wait for a packet
+     */
+    RxAwaiter Receive( Span< uint8_t > buffer, uint32_t timeoutMs )
+    {
+        return { *this, buffer, Ticks( timeoutMs ) };
+    }
+
+    /*!
+     * \brief Runs a channel activity detection with the CAD parameters in use
+     */
+    CadAwaiter Cad( ) { return { *this }; }
+
+private:
+    /*!
+     * \brief Milliseconds to steps of 15.625 us, below the continuous RX value
+     */
+    static constexpr uint32_t Ticks( uint32_t ms )
+    {
+        return ( ms >= 0xFFFFFE / 64 ) ? 0xFFFFFE : ms * 64;
+    }
+
+    std::coroutine_handle< > Waiter = nullptr;
+    Irq Result = Irq::None;
+    volatile bool Pending = false;
+    uint16_t Preamble = 8;
+    bool Crc = true;
+    bool InvertIq = false;
+};
+
+/*!
+ * \brief Event loop: serves the radios and waits through the Idle policy when
+ *        none has anything to do.
+ *
+ *     struct Idle
+ *     {
+ *         // Waits for an interrupt unless pending( ) is true,
+ *         // false if nothing can happen anymore
+ *         template< typename F >
+ *         static bool Wait( F pending );
+ *     };
+ *
+ * Returns when Idle::Wait does, never on the target.
+ */
+template< typename Idle, typename... Radios >
+void Run( Radios &... radios )
+{
+    for( ;; )
+    {
+        if( ( radios.Process( ) | ... ) )
+        {
+            continue;
+        }
+        if( !Idle::Wait( [&]( ) { return ( radios.IsPending( ) || ... ); } ) )
+        {
+            return;
+        }
+    }
+}
+
+} // namespace sx126x::coro
+
+#if defined( SX126X_DEVICE_POLICIES )
+
+namespace sx126x::coro
+{
+
+/*!
+ * \brief Idle policy on the MCU sleep of the device specific implementation.
+ *        DIO1 rising between the check and the sleep still wakes the MCU,
+ *        the interrupt is only masked.
+ */
+struct DeviceIdle
+{
+    template< typename F >
+    static bool Wait( F pending )
+    {
+        CRITICAL_SECTION_ENTER()
+        if( !pending( ) )
+        {
+            mcu_sleep( MCU_SLEEP_IDLE );
+        }
+        CRITICAL_SECTION_LEAVE()
+        return true;
+    }
+};
+
+} // namespace sx126x::coro
+
+#endif // SX126X_DEVICE_POLICIES
+
+#endif // __SX126x_CORO_HPP__
@@ -0,0 +1,138 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_CRC_H__
+#define __SX126x_CRC_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief 1 for the slicing-by-8 kernel, 4 KB of tables per engine, default on
+ *        host builds. 0 for the 16 entry table of the Cortex-M4, one nibble
+ *        at a time.
+ */
+#ifndef CRC_SLICING_BY_8
+#if defined( __arm__ )
+#define CRC_SLICING_BY_8                            0
+#else
+#define CRC_SLICING_BY_8                            1
+#endif
+#endif
+
+/*!
+ * \brief Reset value of the whitening LFSR
+ */
+#define WHITENING_SEED_DEFAULT                      0x01FF
+
+/*!
+ * \brief Software copy of the GFSK CRC of the radio: MSB first, the seed
+ *        loaded in the LFSR, the data bytes then the CRC sent MSB first. The
+ *        1 byte CRCs use the low byte of the seed and of the polynomial.
+ */
+typedef struct
+{
+    uint16_t      Seed;                             //!< Aligned on bit 15
+    uint16_t      XorOut;                           //!< Aligned on bit 15
+    uint8_t       Bytes;                            //!< 0, 1 or 2
+#if ( CRC_SLICING_BY_8 == 1 )
+    uint16_t      Table[8][256];                    //!< Table[k][x]: x followed by k zero bytes
+#else
+    uint16_t      Table[16];                        //!< A nibble shifted through the LFSR
+#endif
+}CrcEngine_t;
+
+/*!
+ * \brief Sets an engine up as SetPacketParams sets the radio up
+ *
+ * \param [out] crc           The engine
+ * \param [in]  type          CRC type of the GFSK packet parameters, the IBM
+ *                            and CCIT presets override the seed and polynomial
+ * \param [in]  seed          As given to SX126x_SetCrcSeed
+ * \param [in]  polynomial    As given to SX126x_SetCrcPolynomial
+ */
+void SX126x_CrcInit( CrcEngine_t *crc, RadioCrcTypes_t type, uint16_t seed, uint16_t polynomial );
+
+/*!
+ * \brief Runs the LFSR over some data, to compute a CRC in several parts
+ *
+ * \param [in]  crc           The engine
+ * \param [in]  state         crc->Seed for the first part, then the result
+ *                            of the previous one
+ * \param [in]  data          The data
+ * \param [in]  size          Its size
+ *
+ * \retval      state         The new state
+ */
+uint16_t SX126x_CrcUpdate( CrcEngine_t *crc, uint16_t state, const uint8_t *data, uint16_t size );
+
+/*!
+ * \brief Gets the CRC sent after the data from the state of the LFSR
+ *
+ * \retval      crc           Right aligned, 0 if the packet has no CRC
+ */
+uint16_t SX126x_CrcFinal( CrcEngine_t *crc, uint16_t state );
+
+/*!
+ * \brief Computes the CRC of a whole buffer
+ *
+ * \retval      crc           Right aligned, 0 if the packet has no CRC
+ */
+uint16_t SX126x_CrcCompute( CrcEngine_t *crc, const uint8_t *data, uint16_t size );
+
+/*!
+ * \brief XORs data with the PN9 sequence of the radio, x^9 + x^5 + 1, the
+ *        low 8 bits of the LFSR with each byte. Whitening and dewhitening are
+ *        the same operation.
+ *
+ * \param [in,out] state      The LFSR, the seed of SX126x_SetWhiteningSeed for
+ *                            the first byte after the sync word
+ * \param [in,out] data       The data, changed in place
+ * \param [in]  size          Its size
+ */
+void SX126x_Whiten( uint16_t *state, uint8_t *data, uint16_t size );
+
+/*!
+ * \brief Builds a frame as the radio sends it after the sync word: the
+ *        header (length, address) and the payload, the CRC, all whitened
+ *
+ * \param [in]  crc           The engine
+ * \param [in]  whitening     1 if whitening is on
+ * \param [in]  seed          The whitening seed
+ * \param [in]  header        The header bytes, NULL if none
+ * \param [in]  headerSize    Their number
+ * \param [in]  payload       The payload
+ * \param [in]  size          Its size
+ * \param [out] frame         The frame, headerSize + size + crc->Bytes bytes
+ *
+ * \retval      size          Size of the frame
+ */
+uint16_t SX126x_GfskEncode( CrcEngine_t *crc, uint8_t whitening, uint16_t seed, const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint16_t size, uint8_t *frame );
+
+/*!
+ * \brief Dewhitens a frame captured after the sync word and checks its CRC
+ *
+ * \param [in]  crc           The engine
+ * \param [in]  whitening     1 if whitening is on
+ * \param [in]  seed          The whitening seed
+ * \param [in,out] frame      The frame, dewhitened in place
+ * \param [in]  size          Its size, CRC included
+ *
+ * \retval      status        0 if the CRC is right, 1 otherwise
+ */
+uint8_t SX126x_GfskDecode( CrcEngine_t *crc, uint8_t whitening, uint16_t seed, uint8_t *frame, uint16_t size );
+
+#endif // __SX126x_CRC_H__
@@ -0,0 +1,213 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_entropy.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+#define ENTROPY_ROTL( x, n )                        ( ( ( x ) << ( n ) ) | ( ( x ) >> ( 32 - ( n ) ) ) )
+
+#define ENTROPY_QUARTER_ROUND( a, b, c, d )                                              \
+    a += b; d ^= a; d = ENTROPY_ROTL( d, 16 );                                          \
+    c += d; b ^= c; b = ENTROPY_ROTL( b, 12 );                                          \
+    a += b; d ^= a; d = ENTROPY_ROTL( d, 8 );                                           \
+    c += d; b ^= c; b = ENTROPY_ROTL( b, 7 );
+
+/*!
+ * \brief Generator key, replaced after every block
+ */
+static uint32_t Key[8];
+
+/*!
+ * \brief Output of the last block not served yet
+ */
+static uint8_t Output[32];
+static uint8_t OutputLeft = 0;
+
+/*!
+ * \brief Radio samples waiting for the next reseed
+ */
+static uint32_t Pool[8];
+static uint8_t PoolSamples = 0;
+static uint8_t PoolSlot = 0;
+static uint32_t LastSample = 0;
+
+static uint32_t LastHarvest = 0;
+static uint32_t LastReseed = 0;
+static uint8_t Seeded = 0;
+
+
+/*!
+ * \brief ChaCha20 block of the key, counter and nonce at 0: a new key is
+ *        never used twice
+ */
+static void EntropyBlock( uint32_t *block )
+{
+    static const uint32_t constants[4] = { 0x61707865, 0x3320646E, 0x79622D32, 0x6B206574 };
+    uint32_t x[16];
+
+    memcpy( &x[0], constants, sizeof( constants ) );
+    memcpy( &x[4], Key, sizeof( Key ) );
+    memset( &x[12], 0, 4 * sizeof( uint32_t ) );
+    memcpy( block, x, sizeof( x ) );
+
+    for( uint8_t i = 0; i < 10; i++ )
+    {
+        ENTROPY_QUARTER_ROUND( x[0], x[4], x[8],  x[12] )
+        ENTROPY_QUARTER_ROUND( x[1], x[5], x[9],  x[13] )
+        ENTROPY_QUARTER_ROUND( x[2], x[6], x[10], x[14] )
+        ENTROPY_QUARTER_ROUND( x[3], x[7], x[11], x[15] )
+        ENTROPY_QUARTER_ROUND( x[0], x[5], x[10], x[15] )
+        ENTROPY_QUARTER_ROUND( x[1], x[6], x[11], x[12] )
+        ENTROPY_QUARTER_ROUND( x[2], x[7], x[8],  x[13] )
+        ENTROPY_QUARTER_ROUND( x[3], x[4], x[9],  x[14] )
+    }
+    for( uint8_t i = 0; i < 16; i++ )
+    {
+        block[i] += x[i];
+    }
+}
+
+/*!
+ * \brief Next block: the first half is the new key, the second the output
+ */
+static void EntropyRefill( void )
+{
+    uint32_t block[16];
+
+    EntropyBlock( block );
+    memcpy( Key, &block[0], sizeof( Key ) );
+    memcpy( Output, &block[8], sizeof( Output ) );
+    OutputLeft = sizeof( Output );
+    memset( block, 0, sizeof( block ) );
+}
+
+static void EntropyReseed( void )
+{
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        Key[i] ^= Pool[i];
+    }
+    // The old key and the pool both go into the new one
+    EntropyRefill( );
+    OutputLeft = 0;
+    memset( Pool, 0, sizeof( Pool ) );
+    PoolSamples = 0;
+    LastReseed = get_time_us( );
+    Seeded = 1;
+}
+
+static void EntropyMix( uint32_t sample )
+{
+    uint8_t slot = PoolSlot;
+
+    PoolSlot = ( PoolSlot + 1 ) % 8;
+    // Rotated first so that equal samples landing on the same word don't cancel out
+    Pool[slot] = ENTROPY_ROTL( Pool[slot], 7 ) ^ sample;
+    // Stops counting while the reseed waits for its period
+    if( PoolSamples < ENTROPY_RESEED_SAMPLES )
+    {
+        PoolSamples++;
+    }
+}
+
+void SX126x_EntropyInit( uint8_t bootstrap )
+{
+    memset( Key, 0, sizeof( Key ) );
+    memset( Pool, 0, sizeof( Pool ) );
+    OutputLeft = 0;
+    PoolSamples = 0;
+    PoolSlot = 0;
+    Seeded = 0;
+    LastHarvest = get_time_us( );
+
+    if( bootstrap == 1 )
+    {
+        for( uint8_t i = 0; i < ENTROPY_RESEED_SAMPLES; i++ )
+        {
+            EntropyMix( SX126x_GetRandom( ) );
+        }
+        EntropyReseed( );
+    }
+}
+
+uint8_t SX126x_EntropyHarvest( void )
+{
+    RadioOperatingModes_t mode = SX126x_GetOperatingMode( );
+    uint32_t now = get_time_us( );
+    uint8_t buf[4];
+    uint32_t sample;
+
+    if( ( ( mode != MODE_RX ) && ( mode != MODE_RX_DC ) ) || ( ( now - LastHarvest ) < ENTROPY_HARVEST_PERIOD_US ) )
+    {
+        return 0;
+    }
+    LastHarvest = now;
+
+    SX126xHal_ReadRegister( RANDOM_NUMBER_GENERATORBASEADDR, buf, 4 );
+    sample = ( ( uint32_t )buf[0] << 24 ) | ( ( uint32_t )buf[1] << 16 ) | ( ( uint32_t )buf[2] << 8 ) | buf[3];
+    // The same value twice: the radio already left RX, nothing new
+    if( sample == LastSample )
+    {
+        return 0;
+    }
+    LastSample = sample;
+    EntropyMix( sample );
+
+    if( ( PoolSamples >= ENTROPY_RESEED_SAMPLES ) &&
+        ( ( Seeded == 0 ) || ( ( now - LastReseed ) >= ENTROPY_RESEED_PERIOD_US ) ) )
+    {
+        EntropyReseed( );
+    }
+    return 1;
+}
+
+uint8_t SX126x_EntropyIsSeeded( void )
+{
+    return Seeded;
+}
+
+uint8_t SX126x_EntropyGet( uint8_t *buffer, uint16_t size )
+{
+    // The key is still all zeros: the output would be known to anyone
+    if( Seeded == 0 )
+    {
+        return 1;
+    }
+    while( size > 0 )
+    {
+        uint8_t chunk;
+
+        if( OutputLeft == 0 )
+        {
+            EntropyRefill( );
+        }
+        chunk = ( size < OutputLeft ) ? ( uint8_t )size : OutputLeft;
+        memcpy( buffer, &Output[sizeof( Output ) - OutputLeft], chunk );
+        // Served bytes are erased
+        memset( &Output[sizeof( Output ) - OutputLeft], 0, chunk );
+        OutputLeft -= chunk;
+        buffer += chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+uint8_t SX126x_EntropyGetU32( uint32_t *value )
+{
+    return SX126x_EntropyGet( ( uint8_t * )value, sizeof( *value ) );
+}
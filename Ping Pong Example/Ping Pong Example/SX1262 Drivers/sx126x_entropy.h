@@ -0,0 +1,82 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_ENTROPY_H__
+#define __SX126x_ENTROPY_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Shortest time between two reads of the radio RNG, in us
+ */
+#define ENTROPY_HARVEST_PERIOD_US                   1000
+
+/*!
+ * \brief Samples of 32 bits mixed in the pool before a reseed, and shortest
+ *        time between two reseeds, in us
+ */
+#define ENTROPY_RESEED_SAMPLES                      16
+#define ENTROPY_RESEED_PERIOD_US                    1000000
+
+/*!
+ * \brief Seeds the generator. With bootstrap set it takes
+ *        ENTROPY_RESEED_SAMPLES from SX126x_GetRandom, about 1 ms each, and
+ *        leaves the radio in STDBY_RC. Otherwise the generator is seeded by
+ *        the first reseed of SX126x_EntropyHarvest.
+ *
+ * \param [in]  bootstrap     1 to seed at once
+ */
+void SX126x_EntropyInit( uint8_t bootstrap );
+
+/*!
+ * \brief Reads the radio RNG if the radio is receiving anyway, at most every
+ *        ENTROPY_HARVEST_PERIOD_US, and reseeds the generator once enough
+ *        samples are in the pool. To be called from the main loop or the RX
+ *        path, it never changes the radio mode.
+ *
+ * \retval      status        1 if a sample was taken, 0 otherwise
+ */
+uint8_t SX126x_EntropyHarvest( void );
+
+/*!
+ * \brief Tells if the generator has been seeded with radio samples
+ */
+uint8_t SX126x_EntropyIsSeeded( void );
+
+/*!
+ * \brief Fills a buffer with random bytes from RAM: ChaCha20 with the key
+ *        replaced after every block, so the past outputs can't be recovered.
+ *        Nothing is output until the generator is seeded, see
+ *        SX126x_EntropyIsSeeded.
+ *
+ * \param [out] buffer        The random bytes
+ * \param [in]  size          Their number
+ *
+ * \retval      status        0 if filled, 1 if not seeded yet
+ */
+uint8_t SX126x_EntropyGet( uint8_t *buffer, uint16_t size );
+
+/*!
+ * \brief Gets a 32 bits random value from RAM, see SX126x_EntropyGet
+ *
+ * \param [out] value         The random value
+ *
+ * \retval      status        0 if set, 1 if not seeded yet
+ */
+uint8_t SX126x_EntropyGetU32( uint32_t *value );
+
+#endif // __SX126x_ENTROPY_H__
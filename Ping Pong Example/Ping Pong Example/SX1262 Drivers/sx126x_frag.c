@@ -0,0 +1,382 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_frag.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+/*!
+ * \brief A message being reassembled, its data is a run of pool blocks
+ */
+typedef struct
+{
+    uint8_t       InUse;
+    uint8_t       Complete;
+    uint8_t       Source;
+    uint8_t       MessageId;
+    uint8_t       Count;                            //!< Number of fragments
+    uint8_t       FirstBlock;
+    uint8_t       Blocks;
+    uint16_t      Size;
+    uint32_t      Received;                         //!< One bit per fragment
+    uint32_t      Start;                            //!< Time of the first fragment [us]
+}FragContext_t;
+
+static PacketParams_t PacketParams;
+
+static uint8_t FramePayload = 0;                    // Largest fragment payload
+
+/*!
+ * \brief Message being sent
+ */
+static uint8_t *TxMessage = NULL;
+static uint16_t TxSize = 0;
+static uint8_t TxSource = 0;
+static uint8_t TxMessageId = 0;
+static uint8_t TxCount = 0;
+static uint8_t TxNext = 0;
+static uint8_t TxFragmentSize = 0;
+
+static uint8_t Pool[FRAG_POOL_BLOCKS * FRAG_BLOCK_SIZE];
+
+static uint64_t PoolUsed = 0;                       // One bit per block
+
+static FragContext_t Contexts[FRAG_CONTEXTS];
+
+
+/*!
+ * \brief Fragments are balanced: all but the last have the same size, which
+ *        the receiver derives from the message size and the count
+ */
+static uint8_t FragFragmentSize( uint16_t size, uint8_t count )
+{
+    return ( uint8_t )( ( size + count - 1 ) / count );
+}
+
+static void FragSetLength( uint8_t size )
+{
+    // SetPacketParams converts the GFSK lengths in place, work on a copy
+    PacketParams_t params = PacketParams;
+
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        params.Params.LoRa.PayloadLength = size;
+    }
+    else
+    {
+        params.Params.Gfsk.PayloadLength = size;
+    }
+    SX126x_SetPacketParams( &params );
+}
+
+static void FragSendFragment( void )
+{
+    uint8_t header[FRAG_HEADER_SIZE];
+    uint16_t offset = ( uint16_t )TxNext * TxFragmentSize;
+    uint8_t size = ( TxSize - offset < TxFragmentSize ) ? ( uint8_t )( TxSize - offset ) : TxFragmentSize;
+    uint8_t base;
+
+    // Buffer, length and SetTx of the same fragment, no other task in between
+    SX126xHal_Lock( );
+    base = SX126x_GetTxBaseAddress( );
+
+    header[0] = TxSource;
+    header[1] = TxMessageId;
+    header[2] = TxNext;
+    header[3] = TxCount;
+    header[4] = ( uint8_t )( TxSize & 0xFF );
+    header[5] = ( uint8_t )( TxSize >> 8 );
+
+    // Header and slice of the message, no intermediate frame buffer
+    SX126xHal_WriteBuffer( base, header, FRAG_HEADER_SIZE );
+    SX126xHal_WriteBuffer( base + FRAG_HEADER_SIZE, TxMessage + offset, size );
+    FragSetLength( FRAG_HEADER_SIZE + size );
+    SX126x_SetTx( 0 );
+    SX126xHal_Unlock( );
+    TxNext++;
+}
+
+/*!
+ * \brief First fit of a run of free blocks
+ *
+ * \retval      first         First block, FRAG_POOL_BLOCKS if none
+ */
+static uint8_t FragAllocate( uint8_t blocks )
+{
+    uint8_t run = 0;
+
+    for( uint8_t i = 0; i < FRAG_POOL_BLOCKS; i++ )
+    {
+        run = ( PoolUsed & ( 1ULL << i ) ) ? 0 : run + 1;
+        if( run == blocks )
+        {
+            uint8_t first = i + 1 - blocks;
+
+            for( uint8_t j = first; j <= i; j++ )
+            {
+                PoolUsed |= ( 1ULL << j );
+            }
+            return first;
+        }
+    }
+    return FRAG_POOL_BLOCKS;
+}
+
+static void FragFree( FragContext_t *context )
+{
+    for( uint8_t j = context->FirstBlock; j < context->FirstBlock + context->Blocks; j++ )
+    {
+        PoolUsed &= ~( 1ULL << j );
+    }
+    context->InUse = 0;
+}
+
+static FragContext_t *FragFind( uint8_t source, uint8_t messageId )
+{
+    for( uint8_t i = 0; i < FRAG_CONTEXTS; i++ )
+    {
+        if( ( Contexts[i].InUse == 1 ) && ( Contexts[i].Source == source ) && ( Contexts[i].MessageId == messageId ) )
+        {
+            return &Contexts[i];
+        }
+    }
+    return NULL;
+}
+
+static FragContext_t *FragFindFree( void )
+{
+    for( uint8_t i = 0; i < FRAG_CONTEXTS; i++ )
+    {
+        if( Contexts[i].InUse == 0 )
+        {
+            return &Contexts[i];
+        }
+    }
+    return NULL;
+}
+
+static FragContext_t *FragOpen( uint8_t source, uint8_t messageId, uint8_t count, uint16_t size )
+{
+    FragContext_t *context;
+    uint8_t blocks = ( size + FRAG_BLOCK_SIZE - 1 ) / FRAG_BLOCK_SIZE;
+    uint8_t first;
+
+    context = FragFindFree( );
+    if( context == NULL )
+    {
+        // Stale messages may be holding all the contexts
+        SX126x_FragExpire( );
+        context = FragFindFree( );
+        if( context == NULL )
+        {
+            return NULL;
+        }
+    }
+    first = FragAllocate( blocks );
+    if( first == FRAG_POOL_BLOCKS )
+    {
+        // Stale messages may be holding the blocks
+        SX126x_FragExpire( );
+        first = FragAllocate( blocks );
+        if( first == FRAG_POOL_BLOCKS )
+        {
+            return NULL;
+        }
+    }
+    context->InUse = 1;
+    context->Complete = 0;
+    context->Source = source;
+    context->MessageId = messageId;
+    context->Count = count;
+    context->FirstBlock = first;
+    context->Blocks = blocks;
+    context->Size = size;
+    context->Received = 0;
+    context->Start = get_time_us( );
+    return context;
+}
+
+void SX126x_FragInit( PacketParams_t *packetParams )
+{
+    uint8_t maxPayload;
+
+    PacketParams = *packetParams;
+    maxPayload = ( PacketParams.PacketType == PACKET_TYPE_LORA ) ? PacketParams.Params.LoRa.PayloadLength : PacketParams.Params.Gfsk.PayloadLength;
+    FramePayload = ( maxPayload > FRAG_HEADER_SIZE ) ? maxPayload - FRAG_HEADER_SIZE : 0;
+    TxMessage = NULL;
+    PoolUsed = 0;
+    memset( Contexts, 0, sizeof( Contexts ) );
+}
+
+uint8_t SX126x_FragSend( uint8_t source, uint8_t *message, uint16_t size )
+{
+    uint16_t count;
+
+    if( ( TxMessage != NULL ) || ( size == 0 ) || ( size > FRAG_MAX_MESSAGE ) || ( FramePayload == 0 ) )
+    {
+        return 1;
+    }
+    count = ( size + FramePayload - 1 ) / FramePayload;
+    if( count > FRAG_MAX_FRAGMENTS )
+    {
+        return 1;
+    }
+
+    TxMessage = message;
+    TxSize = size;
+    TxSource = source;
+    TxMessageId++;
+    TxCount = ( uint8_t )count;
+    TxFragmentSize = FragFragmentSize( size, TxCount );
+    TxNext = 0;
+    FragSendFragment( );
+    return 0;
+}
+
+uint8_t SX126x_FragOnTxDone( void )
+{
+    if( TxMessage == NULL )
+    {
+        return 1;
+    }
+    if( TxNext < TxCount )
+    {
+        FragSendFragment( );
+        return 0;
+    }
+    TxMessage = NULL;
+    return 1;
+}
+
+/*!
+ * \brief SX126x_FragReceive with the bus owned
+ */
+static FragStatus_t FragReceiveLocked( FragMessage_t *message )
+{
+    uint8_t header[FRAG_HEADER_SIZE];
+    uint8_t length;
+    uint8_t start;
+    uint16_t size;
+    uint16_t offset;
+    uint8_t fragmentSize;
+    FragContext_t *context;
+
+    SX126x_GetRxBufferStatus( &length, &start );
+    if( length <= FRAG_HEADER_SIZE )
+    {
+        return FRAG_INVALID;
+    }
+    SX126xHal_ReadBuffer( start, header, FRAG_HEADER_SIZE );
+    size = header[4] | ( ( uint16_t )header[5] << 8 );
+    if( ( header[3] == 0 ) || ( header[3] > FRAG_MAX_FRAGMENTS ) || ( header[2] >= header[3] ) ||
+        ( size == 0 ) || ( size > FRAG_MAX_MESSAGE ) || ( size < header[3] ) || ( size > ( uint16_t )header[3] * 255 ) )
+    {
+        return FRAG_INVALID;
+    }
+    fragmentSize = FragFragmentSize( size, header[3] );
+    offset = ( uint16_t )header[2] * fragmentSize;
+    if( ( offset >= size ) || ( length - FRAG_HEADER_SIZE != ( ( size - offset < fragmentSize ) ? size - offset : fragmentSize ) ) )
+    {
+        return FRAG_INVALID;
+    }
+
+    context = FragFind( header[0], header[1] );
+    if( ( context != NULL ) && ( ( context->Size != size ) || ( context->Count != header[3] ) ) )
+    {
+        // Same id reused for another message, the old one is lost
+        FragFree( context );
+        context = NULL;
+    }
+    if( context == NULL )
+    {
+        context = FragOpen( header[0], header[1], header[3], size );
+        if( context == NULL )
+        {
+            return FRAG_NO_MEMORY;
+        }
+    }
+    if( ( context->Complete == 1 ) || ( context->Received & ( 1UL << header[2] ) ) )
+    {
+        return FRAG_DUPLICATE;
+    }
+
+    // Straight from the radio buffer to its place in the message
+    SX126xHal_ReadBuffer( start + FRAG_HEADER_SIZE, &Pool[context->FirstBlock * FRAG_BLOCK_SIZE + offset], length - FRAG_HEADER_SIZE );
+    context->Received |= ( 1UL << header[2] );
+
+    if( context->Received != ( ( context->Count == 32 ) ? 0xFFFFFFFFUL : ( ( 1UL << context->Count ) - 1 ) ) )
+    {
+        return FRAG_INCOMPLETE;
+    }
+    context->Complete = 1;
+    message->Source = context->Source;
+    message->MessageId = context->MessageId;
+    message->Size = context->Size;
+    message->Data = &Pool[context->FirstBlock * FRAG_BLOCK_SIZE];
+    return FRAG_COMPLETE;
+}
+
+FragStatus_t SX126x_FragReceive( FragMessage_t *message )
+{
+    FragStatus_t status;
+
+    // The buffer status and the reads of the same frame, no other task in between
+    SX126xHal_Lock( );
+    status = FragReceiveLocked( message );
+    SX126xHal_Unlock( );
+    return status;
+}
+
+void SX126x_FragRelease( FragMessage_t *message )
+{
+    FragContext_t *context = FragFind( message->Source, message->MessageId );
+
+    if( ( context != NULL ) && ( context->Complete == 1 ) )
+    {
+        FragFree( context );
+    }
+    message->Data = NULL;
+}
+
+void SX126x_FragExpire( void )
+{
+    uint32_t now = get_time_us( );
+
+    for( uint8_t i = 0; i < FRAG_CONTEXTS; i++ )
+    {
+        // Complete messages belong to the application until released
+        if( ( Contexts[i].InUse == 1 ) && ( Contexts[i].Complete == 0 ) &&
+            ( ( now - Contexts[i].Start ) > ( uint32_t )FRAG_TIMEOUT_MS * 1000 ) )
+        {
+            FragFree( &Contexts[i] );
+        }
+    }
+}
+
+uint8_t SX126x_FragGetFreeBlocks( void )
+{
+    uint8_t free = 0;
+
+    for( uint8_t i = 0; i < FRAG_POOL_BLOCKS; i++ )
+    {
+        if( ( PoolUsed & ( 1ULL << i ) ) == 0 )
+        {
+            free++;
+        }
+    }
+    return free;
+}
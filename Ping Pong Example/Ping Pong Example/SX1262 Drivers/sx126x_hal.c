@@ -17,8 +17,13 @@ __/\\\\____________/\\\\_____/\\\\\\\\\\\\_
 Modifier: Marco Giordano
 */
 
+#include <stddef.h>
+
 #include "sx126x_hal.h"
 #include "sx126x_commands.h"
+#include "sx126x_energy.h"
+#include "sx126x_sleep.h"
+#include "sx126x_os.h"
 
 /*!
  * \brief Used to block execution to give enough time to Busy to go up
@@ -27,13 +32,235 @@ Modifier: Marco Giordano
 #define WaitOnCounter( )          for( uint8_t counter = 0; counter < 15; counter++ ) \
                                   {  __NOP( ); }
 
+/*!
+ * \brief Time BUSY is polled yielding to the other tasks, before sleeping
+ *        between the polls, in us
+ */
+#define HAL_BUSY_YIELD_US                           200
+
+/*!
+ * \brief Event flag raised by SX126xHal_OnDio1Irq
+ */
+#define HAL_EVENT_DIO1                              0x01
+
+/*!
+ * \brief Owns the SPI bus, and the HAL state below, for a whole transaction or
+ *        a whole driver call, see SX126xHal_Lock
+ */
+static OsMutex_t BusMutex;
+
+/*!
+ * \brief Nesting of the bus ownership, only the owner changes it
+ */
+static uint8_t BusDepth = 0;
+
+static OsEventFlags_t IrqEvents;
+
+/*!
+ * \brief Handlers of the requests deferred from the interrupts
+ */
+static void ( *DeferredHandlers[HAL_DEFERRED_REQUESTS] )( void );
+
+/*!
+ * \brief One bit per request deferred and not served yet, set by the
+ *        interrupts with atomic operations only
+ */
+static volatile uint32_t Pending = 0;
+
+/*!
+ * \brief 1 while a context runs the deferred handlers
+ */
+static volatile uint8_t Draining = 0;
+
+/*!
+ * \brief 1 once SetSleep or SetRxDutyCycle is sent, the next transaction wakes
+ *        the radio up first
+ */
+static uint8_t Asleep = 0;
+
+/*!
+ * \brief Status byte clocked out by the radio on the last transaction
+ */
+static RadioStatus_t Status = { .Value = 0 };
+
+/*!
+ * \brief 1 if the chip mode in Status is still the current one
+ */
+static uint8_t StatusFresh = 0;
+
+/*!
+ * \brief Opcode of the last transaction, the radio reports its outcome in the
+ *        status of the next one
+ */
+static uint8_t LastOpcode = RADIO_GET_STATUS;
+
+/*!
+ * \brief Last failed command, CmdStatus 0 if none since the last read
+ */
+static uint8_t ErrorOpcode = 0;
+static uint8_t ErrorStatus = 0;
+
+/*!
+ * \brief Commands after which the chip mode may not be the one in the status
+ *        clocked out while sending them
+ */
+static uint8_t SX126xHal_ChangesMode( uint8_t opcode )
+{
+    switch( opcode )
+    {
+        case RADIO_SET_SLEEP:
+        case RADIO_SET_STANDBY:
+        case RADIO_SET_FS:
+        case RADIO_SET_TX:
+        case RADIO_SET_RX:
+        case RADIO_SET_RXDUTYCYCLE:
+        case RADIO_SET_CAD:
+        case RADIO_SET_TXCONTINUOUSWAVE:
+        case RADIO_SET_TXCONTINUOUSPREAMBLE:
+        case RADIO_CALIBRATE:
+        case RADIO_CALIBRATEIMAGE:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+/*!
+ * \brief Sends the opcode and the bytes following it (address, offset, NOP or
+ *        first parameter) in a single full-duplex transfer, keeping the status
+ *        the radio clocks out with the byte after the opcode
+ *
+ * \param [in]  header        Opcode then up to 3 bytes
+ * \param [in]  size          Size of the header
+ */
+static void SX126xHal_SendHeader( uint8_t *header, uint8_t size )
+{
+    uint8_t rx[4];
+
+    TransferSpi( header, rx, size );
+    if( size < 2 )
+    {
+        // Nothing clocked after the opcode, the byte during it is RFU
+        StatusFresh = 0;
+        LastOpcode = header[0];
+        return;
+    }
+
+    Status.Value = rx[1];
+    switch( Status.Fields.CmdStatus )
+    {
+        case CMD_STATUS_TIMEOUT:
+        case CMD_STATUS_PROCESSING_ERROR:
+        case CMD_STATUS_EXEC_FAILURE:
+            ErrorOpcode = LastOpcode;
+            ErrorStatus = Status.Fields.CmdStatus;
+            break;
+
+        default:
+            break;
+    }
+    StatusFresh = !SX126xHal_ChangesMode( header[0] );
+    LastOpcode = header[0];
+}
+
+/*!
+ * \brief Runs the deferred requests. Only one context drains at a time, the
+ *        handlers use the HAL and requests raised meanwhile are picked up by
+ *        the loop.
+ */
+static void SX126xHal_Drain( void )
+{
+    uint32_t pending;
+
+    while( ( __atomic_load_n( &Pending, __ATOMIC_ACQUIRE ) != 0 ) &&
+           ( __atomic_exchange_n( &Draining, 1, __ATOMIC_ACQUIRE ) == 0 ) )
+    {
+        while( ( pending = __atomic_exchange_n( &Pending, 0, __ATOMIC_ACQ_REL ) ) != 0 )
+        {
+            for( uint8_t i = 0; i < HAL_DEFERRED_REQUESTS; i++ )
+            {
+                if( ( ( pending & ( 1UL << i ) ) != 0 ) && ( DeferredHandlers[i] != NULL ) )
+                {
+                    DeferredHandlers[i]( );
+                }
+            }
+        }
+        // A request raised after the last exchange is seen by the outer loop
+        __atomic_store_n( &Draining, 0, __ATOMIC_RELEASE );
+    }
+}
+
+static void SX126xHal_Acquire( void )
+{
+    SX126x_OsMutexLock( &BusMutex );
+    BusDepth++;
+}
+
+/*!
+ * \brief Gives the bus back. The outermost release serves what the interrupts
+ *        deferred meanwhile, a driver call is never split by a handler.
+ */
+static void SX126xHal_Release( void )
+{
+    uint8_t outermost = ( --BusDepth == 0 ) ? 1 : 0;
+
+    SX126x_OsMutexUnlock( &BusMutex );
+    if( outermost == 1 )
+    {
+        SX126xHal_Drain( );
+    }
+}
+
+/*!
+ * \brief Wakes the radio up before a command, as the Semtech driver does, if
+ *        it was left sleeping. The bus is held, the configuration replayed
+ *        after the wake up is sent by nested transactions.
+ */
+static void SX126xHal_CheckDeviceReady( void )
+{
+    if( Asleep == 1 )
+    {
+        SX126xHal_Wakeup( );
+    }
+}
+
+/*!
+ * \brief Waits for BUSY to go low, accounting the time spent in the energy model
+ */
+static void SX126xHal_WaitOnBusy( void )
+{
+    uint32_t start;
+
+    if( read_pin( BUSY ) )
+    {
+        start = get_time_us( );
+        SX126x_EnergyBusyBegin( start );
+        // Most commands take a few us, calibrations and wake ups take ms
+        while( read_pin( BUSY ) )
+        {
+            if( ( get_time_us( ) - start ) < HAL_BUSY_YIELD_US )
+            {
+                SX126x_OsYield( );
+            }
+            else
+            {
+                SX126x_OsDelayMs( 1 );
+            }
+        }
+        SX126x_EnergyBusyEnd( get_time_us( ) );
+    }
+}
 
 void SX126xHal_SpiInit( void )
 {
+    SX126x_OsMutexInit( &BusMutex );
+    SX126x_OsEventInit( &IrqEvents );
+
     NSS_OFF
     SPI_init();
 
-    wait_ms( 100 );
+    SX126x_OsDelayMs( 100 );
 }
 
 void SX126xHal_IoIrqInit( void )
@@ -43,18 +270,22 @@ void SX126xHal_IoIrqInit( void )
 
 void SX126xHal_Reset( void )
 {
-    CRITICAL_SECTION_ENTER()
-    wait_ms( 20 );
+    // The bus lock keeps the other tasks off the radio, the interrupts keep running
+    SX126xHal_Acquire( );
+    SX126x_OsDelayMs( 20 );
     RESET_ON
-    wait_ms( 50 );
+    SX126x_OsDelayMs( 50 );
     RESET_OFF
-    wait_ms( 20 );
-    CRITICAL_SECTION_LEAVE()
+    SX126x_OsDelayMs( 20 );
+
+    StatusFresh = 0;
+    Asleep = 0;
+    SX126xHal_Release( );
 }
 
 void SX126xHal_Wakeup( void )
 {
-    CRITICAL_SECTION_ENTER()
+    SX126xHal_Acquire( );
 
     //Don't wait for BUSY here
     uint8_t wakeup_sequence[2] = {RADIO_GET_STATUS, 0x00};
@@ -63,61 +294,93 @@ void SX126xHal_Wakeup( void )
     NSS_OFF
 
     // Wait for chip to be ready.
-    WAIT_BUSY
+    SX126xHal_WaitOnBusy( );
 
-    CRITICAL_SECTION_LEAVE()
-    
-    //AntSwOn( );
+    // Clocked out while the radio was asleep
+    StatusFresh = 0;
+    LastOpcode = RADIO_GET_STATUS;
+    Asleep = 0;
+
+    // Switch is turned off when device is in sleep mode and turned on is all other modes
+    SX126xHal_AntSwOn( );
+    // Put back what the sleep mode did not retain
+    SX126x_SleepRestore( );
+
+    SX126xHal_Release( );
 }
 
 void SX126xHal_WriteCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size )
 { 
-    WAIT_BUSY
+    SX126xHal_Acquire( );
+    SX126xHal_CheckDeviceReady( );
+    SX126xHal_WaitOnBusy( );
 
     NSS_ON
 
-    SendSpi((uint8_t *)&command, 1);
-    SendSpi(buffer, size);
+    uint8_t header[2] = {command, 0x00};
+    if(size == 0){
+        SX126xHal_SendHeader(header, 1);
+    }else{
+        header[1] = buffer[0];
+        SX126xHal_SendHeader(header, 2);
+        SendSpi(buffer + 1, size - 1);
+    }
 
     NSS_OFF
+
+    if( ( command == RADIO_SET_SLEEP ) || ( command == RADIO_SET_RXDUTYCYCLE ) )
+    {
+        // Any later access wakes the radio through NSS, BUSY stays high until then
+        Asleep = 1;
+    }
+
+    SX126xHal_Release( );
     
     //WaitOnCounter( );
 }
 
 void SX126xHal_ReadCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size )
 {
-    WAIT_BUSY
+    SX126xHal_Acquire( );
+    SX126xHal_CheckDeviceReady( );
+    SX126xHal_WaitOnBusy( );
 
     NSS_ON
 
-    SendSpi((uint8_t *)&command, 1);
-    if(command != RADIO_GET_STATUS){
-        uint8_t zero = 0x00; // Throw the status for not-status commands
-        SendSpi( &zero, 1);
+    uint8_t header[2] = {command, 0x00};
+    SX126xHal_SendHeader(header, 2);
+    if(command == RADIO_GET_STATUS){
+        // The status is the only answer
+        buffer[0] = Status.Value;
+    }else{
+        ReadSpi(buffer, size);
     }
-    ReadSpi(buffer, size);
     
     NSS_OFF
+
+    SX126xHal_Release( );
     
 }
 
 void SX126xHal_WriteRegister( uint16_t address, uint8_t *buffer, uint16_t size )
 {
-    WAIT_BUSY
+    SX126xHal_Acquire( );
+    SX126xHal_CheckDeviceReady( );
+    SX126xHal_WaitOnBusy( );
 
     NSS_ON
 
     uint8_t address_high = (( address >> 8 ) & 0xFF);
     uint8_t address_low = ( address & 0xFF);
     
-    RadioCommands_t command = RADIO_WRITE_REGISTER;
-    SendSpi((uint8_t *) &command, 1);
-    SendSpi( &address_high , 1);
-    SendSpi( &address_low , 1);
+    uint8_t header[3] = {RADIO_WRITE_REGISTER, address_high, address_low};
+    SX126xHal_SendHeader(header, 3);
     SendSpi(buffer, size);
     
     NSS_OFF
 
+    SX126xHal_Release( );
+
 }
 
 void SX126xHal_WriteReg( uint16_t address, uint8_t *value )
@@ -127,23 +390,22 @@ void SX126xHal_WriteReg( uint16_t address, uint8_t *value )
 
 void SX126xHal_ReadRegister( uint16_t address, uint8_t *buffer, uint16_t size )
 {
-    WAIT_BUSY
+    SX126xHal_Acquire( );
+    SX126xHal_CheckDeviceReady( );
+    SX126xHal_WaitOnBusy( );
 
     NSS_ON
     
     uint8_t address_high = (( address >> 8 ) & 0xFF);
     uint8_t address_low = ( address & 0xFF);
 
-    uint8_t zero = 0;
-    RadioCommands_t command = RADIO_READ_REGISTER;
-    
-    SendSpi((uint8_t *) &command, 1);
-    SendSpi( &address_high , 1);
-    SendSpi( &address_low , 1);
-    SendSpi(&zero, 1);
+    uint8_t header[4] = {RADIO_READ_REGISTER, address_high, address_low, 0x00};
+    SX126xHal_SendHeader(header, 4);
     ReadSpi(buffer, size); 
    
     NSS_OFF
+
+    SX126xHal_Release( );
     
 }
 
@@ -154,36 +416,103 @@ void SX126xHal_ReadReg( uint16_t address, uint8_t *data )
 
 void SX126xHal_WriteBuffer( uint8_t offset, uint8_t *buffer, uint8_t size )
 {
-    WAIT_BUSY
+    SX126xHal_Acquire( );
+    SX126xHal_CheckDeviceReady( );
+    SX126xHal_WaitOnBusy( );
 
     NSS_ON
 
-    RadioCommands_t command = RADIO_WRITE_BUFFER;
-    SendSpi((uint8_t *) &command, 1);
-    SendSpi(&offset, 1);
+    uint8_t header[2] = {RADIO_WRITE_BUFFER, offset};
+    SX126xHal_SendHeader(header, 2);
     SendSpi(buffer, size);
     
     NSS_OFF
 
+    SX126xHal_Release( );
+
 }
 
 void SX126xHal_ReadBuffer( uint8_t offset, uint8_t *buffer, uint8_t size )
 {
-    WAIT_BUSY
+    SX126xHal_Acquire( );
+    SX126xHal_CheckDeviceReady( );
+    SX126xHal_WaitOnBusy( );
 
     NSS_ON
     
-    RadioCommands_t command = RADIO_READ_BUFFER;
-    uint8_t zero = 0;
-    SendSpi((uint8_t *) &command, 1);
-    SendSpi(&offset, 1);
-    SendSpi(&zero, 1);
+    uint8_t header[3] = {RADIO_READ_BUFFER, offset, 0x00};
+    SX126xHal_SendHeader(header, 3);
 
     ReadSpi(buffer, size);
 
     NSS_OFF
+
+    SX126xHal_Release( );
+}
+
+
+void SX126xHal_Lock( void )
+{
+    SX126xHal_Acquire( );
+}
+
+void SX126xHal_Unlock( void )
+{
+    SX126xHal_Release( );
+}
+
+void SX126xHal_SetDeferredHandler( uint8_t request, void ( *handler )( void ) )
+{
+    if( request < HAL_DEFERRED_REQUESTS )
+    {
+        DeferredHandlers[request] = handler;
+    }
+}
+
+void SX126xHal_DeferFromIsr( uint8_t request )
+{
+    // A bit index, past the handlers it is undefined or never served
+    ASSERT( request < HAL_DEFERRED_REQUESTS );
+    if( request < HAL_DEFERRED_REQUESTS )
+    {
+        __atomic_fetch_or( &Pending, 1UL << request, __ATOMIC_RELEASE );
+    }
+}
+
+uint8_t SX126xHal_HasPending( void )
+{
+    return ( __atomic_load_n( &Pending, __ATOMIC_ACQUIRE ) != 0 ) ? 1 : 0;
+}
+
+void SX126xHal_ProcessPending( void )
+{
+    SX126xHal_Drain( );
+}
+
+void SX126xHal_OnDio1Irq( void )
+{
+    SX126x_OsEventSetFromIsr( &IrqEvents, HAL_EVENT_DIO1 );
+}
+
+uint8_t SX126xHal_WaitDio1( uint32_t timeoutMs )
+{
+    return ( SX126x_OsEventWait( &IrqEvents, HAL_EVENT_DIO1, timeoutMs ) != 0 ) ? 1 : 0;
+}
+
+uint8_t SX126xHal_GetCachedStatus( uint8_t *status )
+{
+    *status = Status.Value;
+    return StatusFresh;
 }
 
+uint8_t SX126xHal_GetCommandError( uint8_t *opcode )
+{
+    uint8_t cmdStatus = ErrorStatus;
+
+    *opcode = ErrorOpcode;
+    ErrorStatus = 0;
+    return cmdStatus;
+}
 
 uint8_t SX126xHal_GetDioStatus( void )
 {
@@ -25,6 +25,11 @@ Modifier: Marco Giordano
  * \brief Abstraction layer for the sx126x commands
  */
 
+/*!
+ * \brief Number of requests the interrupts can defer, see SX126xHal_DeferFromIsr
+ */
+#define HAL_DEFERRED_REQUESTS                       8
+
 
 /*!
     * \brief Initialize the SPI communication on the selected microcontroller
@@ -42,7 +47,9 @@ void SX126xHal_IoIrqInit( void );
 void SX126xHal_Reset( void );
 
 /*!
-    * \brief Wakes up the radio
+    * \brief Wakes up the radio and replays the configuration the sleep lost.
+    *        Every transaction does it first after a SetSleep or a
+    *        SetRxDutyCycle.
     */
 void SX126xHal_Wakeup( void );
 
@@ -119,6 +126,84 @@ void SX126xHal_WriteBuffer( uint8_t offset, uint8_t *buffer, uint8_t size );
     */
 void SX126xHal_ReadBuffer( uint8_t offset, uint8_t *buffer, uint8_t size );
 
+/*!
+    * \brief Takes the bus for a sequence of transactions that must not be split,
+    *        e.g. WriteBuffer then SetTx. It nests: the bus is given back, and
+    *        the deferred requests served, by the outermost SX126xHal_Unlock.
+    */
+void SX126xHal_Lock( void );
+void SX126xHal_Unlock( void );
+
+/*!
+    * \brief Sets the handler of a request deferred from the interrupts
+    *
+    * \param [in]  request       Request number, below HAL_DEFERRED_REQUESTS
+    * \param [in]  handler       Runs in the context giving the bus back last, at
+    *                            the end of a driver call, it can use the whole
+    *                            driver
+    */
+void SX126xHal_SetDeferredHandler( uint8_t request, void ( *handler )( void ) );
+
+/*!
+    * \brief Defers a request from an interrupt. The HAL must never be called from
+    *        an interrupt: the transaction running in the main context would be
+    *        interleaved with it. The request is served when the outermost
+    *        driver call gives the bus back, or by SX126xHal_ProcessPending.
+    *        Lock-free, interrupts stay enabled.
+    *
+    * \param [in]  request       Request number, below HAL_DEFERRED_REQUESTS
+    */
+void SX126xHal_DeferFromIsr( uint8_t request );
+
+/*!
+    * \brief Tells if deferred requests wait to be served
+    *
+    * \retval      pending       1 if some requests are pending
+    */
+uint8_t SX126xHal_HasPending( void );
+
+/*!
+    * \brief Serves the deferred requests while the bus is free, to be called from
+    *        the main loop
+    */
+void SX126xHal_ProcessPending( void );
+
+/*!
+    * \brief To be called from the DIO1 interrupt, wakes up SX126xHal_WaitDio1
+    */
+void SX126xHal_OnDio1Irq( void );
+
+/*!
+    * \brief Blocks the calling task until DIO1 rises
+    *
+    * \param [in]  timeoutMs     Longest wait [ms], OS_WAIT_FOREVER or 0 to poll
+    *
+    * \retval      risen         1 if DIO1 rose since the last call, 0 on timeout
+    */
+uint8_t SX126xHal_WaitDio1( uint32_t timeoutMs );
+
+/*!
+    * \brief Gets the status the radio clocked out on the last transaction, every
+    *        command, register and buffer access captures it for free
+    *
+    * \param [out] status        The status byte, see RadioStatus_t
+    *
+    * \retval      fresh         1 if its chip mode is still current, 0 if a mode
+    *                            change was commanded since or the radio slept
+    */
+uint8_t SX126xHal_GetCachedStatus( uint8_t *status );
+
+/*!
+    * \brief Gets and clears the last failed command. The radio reports the
+    *        outcome of a command in the status of the next transaction.
+    *
+    * \param [out] opcode        Opcode of the failed command
+    *
+    * \retval      cmdStatus     CMD_STATUS_TIMEOUT, CMD_STATUS_PROCESSING_ERROR or
+    *                            CMD_STATUS_EXEC_FAILURE, 0 if no command failed
+    */
+uint8_t SX126xHal_GetCommandError( uint8_t *opcode );
+
 /*!
     * \brief Returns the status of DIOs pins
     *
@@ -0,0 +1,231 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <stddef.h>
+
+#include "sx126x_longpkt.h"
+#include "sx126x_hal.h"
+
+typedef enum
+{
+    LONGPKT_IDLE                            = 0x00,
+    LONGPKT_TX,
+    LONGPKT_RX,
+}LongPktStates_t;
+
+static LongPktStates_t State = LONGPKT_IDLE;
+
+static const uint8_t *TxData = NULL;
+static uint8_t *RxData = NULL;
+static uint32_t Size = 0;
+
+/*!
+ * \brief Bytes gone through the packet handler, from the buffer pointer
+ */
+static uint32_t Done = 0;
+
+/*!
+ * \brief Bytes written to the radio (TX) or read from it (RX)
+ */
+static uint32_t Moved = 0;
+
+static uint8_t LastPointer = 0;
+
+
+static void LongPktPosition( void )
+{
+    uint8_t pointer;
+
+    // Called at least every LONGPKT_REFILL_BYTES, the pointer can't go round
+    SX126xHal_ReadReg( REG_BUFFER_POINTER, &pointer );
+    Done += ( uint8_t )( pointer - LastPointer );
+    LastPointer = pointer;
+    if( Done > Size )
+    {
+        Done = Size;
+    }
+}
+
+/*!
+ * \brief The packet ends when the byte count of the packet handler, modulo
+ *        256, reaches the length register. It is kept one turn ahead until
+ *        the last 255 bytes.
+ */
+static void LongPktSetLength( void )
+{
+    uint8_t length = ( ( Size - Done ) > 255 ) ? ( uint8_t )( Done - 1 ) : ( uint8_t )Size;
+
+    SX126xHal_WriteReg( REG_GFSK_PAYLOADLENGTH, &length );
+}
+
+static void LongPktRefill( void )
+{
+    // 255 bytes at most ahead of the packet handler, the buffer has 256
+    while( ( Moved < Size ) && ( ( Moved - Done ) < 255 ) )
+    {
+        uint8_t offset = ( uint8_t )Moved;
+        uint32_t chunk = Size - Moved;
+
+        if( chunk > 255 - ( Moved - Done ) )
+        {
+            chunk = 255 - ( Moved - Done );
+        }
+        if( chunk > 256 - ( uint32_t )offset )
+        {
+            chunk = 256 - ( uint32_t )offset;
+        }
+        SX126xHal_WriteBuffer( offset, ( uint8_t * )TxData + Moved, ( uint8_t )chunk );
+        Moved += chunk;
+    }
+}
+
+static void LongPktDrain( void )
+{
+    while( Moved < Done )
+    {
+        uint8_t offset = ( uint8_t )Moved;
+        uint32_t chunk = Done - Moved;
+
+        if( chunk > 256 - ( uint32_t )offset )
+        {
+            chunk = 256 - ( uint32_t )offset;
+        }
+        SX126xHal_ReadBuffer( offset, RxData + Moved, ( uint8_t )chunk );
+        Moved += chunk;
+    }
+}
+
+/*!
+ * \brief Common part of TX and RX: the whole buffer as a ring from 0
+ */
+static uint8_t LongPktStart( PacketParams_t *packetParams, uint32_t size )
+{
+    PacketParams_t params;
+
+    if( ( State != LONGPKT_IDLE ) || ( size == 0 ) ||
+        ( packetParams->PacketType != PACKET_TYPE_GFSK ) ||
+        ( packetParams->Params.Gfsk.HeaderType != RADIO_PACKET_FIXED_LENGTH ) )
+    {
+        return 1;
+    }
+    SX126x_SetBufferBaseAddresses( 0x00, 0x00 );
+    // SetPacketParams converts the GFSK lengths in place, work on a copy
+    params = *packetParams;
+    params.Params.Gfsk.PayloadLength = ( size > 255 ) ? 255 : ( uint8_t )size;
+    SX126x_SetPacketParams( &params );
+
+    Size = size;
+    Done = 0;
+    Moved = 0;
+    LastPointer = 0;
+    LongPktSetLength( );
+    return 0;
+}
+
+uint8_t SX126x_LongPktSend( PacketParams_t *packetParams, const uint8_t *data, uint32_t size )
+{
+    SX126xHal_Lock( );
+    if( LongPktStart( packetParams, size ) != 0 )
+    {
+        SX126xHal_Unlock( );
+        return 1;
+    }
+    TxData = data;
+    LongPktRefill( );
+    State = LONGPKT_TX;
+    SX126x_SetTx( 0 );
+    SX126xHal_Unlock( );
+    return 0;
+}
+
+uint8_t SX126x_LongPktReceive( PacketParams_t *packetParams, uint8_t *buffer, uint32_t size, uint32_t timeout )
+{
+    SX126xHal_Lock( );
+    if( LongPktStart( packetParams, size ) != 0 )
+    {
+        SX126xHal_Unlock( );
+        return 1;
+    }
+    RxData = buffer;
+    State = LONGPKT_RX;
+    SX126x_SetRx( timeout );
+    SX126xHal_Unlock( );
+    return 0;
+}
+
+void SX126x_LongPktSetRxLength( uint32_t size )
+{
+    if( ( State != LONGPKT_RX ) || ( size >= Size ) || ( size < Done ) )
+    {
+        return;
+    }
+    Size = size;
+    LongPktSetLength( );
+}
+
+uint32_t SX126x_LongPktProcess( void )
+{
+    uint32_t progress = Done;
+
+    // The position read and the length written must not be split
+    SX126xHal_Lock( );
+    switch( State )
+    {
+        case LONGPKT_TX:
+            LongPktPosition( );
+            LongPktRefill( );
+            LongPktSetLength( );
+            progress = Done;
+            break;
+        case LONGPKT_RX:
+            LongPktPosition( );
+            LongPktDrain( );
+            LongPktSetLength( );
+            progress = Moved;
+            break;
+        default:
+            break;
+    }
+    SX126xHal_Unlock( );
+    return progress;
+}
+
+uint32_t SX126x_LongPktOnDone( void )
+{
+    LongPktStates_t state = State;
+
+    if( state == LONGPKT_IDLE )
+    {
+        return Done;
+    }
+    SX126xHal_Lock( );
+    LongPktPosition( );
+    State = LONGPKT_IDLE;
+    if( state == LONGPKT_RX )
+    {
+        LongPktDrain( );
+    }
+    SX126xHal_Unlock( );
+    return Done;
+}
+
+uint32_t SX126x_LongPktGetPeriod( uint32_t bitRate )
+{
+    if( bitRate == 0 )
+    {
+        return 0;
+    }
+    return ( uint32_t )( ( uint64_t )LONGPKT_REFILL_BYTES * 8 * 1000000 / bitRate );
+}
@@ -0,0 +1,93 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_LONGPKT_H__
+#define __SX126x_LONGPKT_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Bytes the radio may send or receive between two calls to
+ *        SX126x_LongPktProcess, half of the data buffer
+ */
+#define LONGPKT_REFILL_BYTES                        128
+
+/*!
+ * \brief Sends a GFSK packet of any size. The data buffer of the radio is
+ *        used as a ring: SX126x_LongPktProcess writes the data as it is sent
+ *        and keeps the payload length register ahead of the packet handler
+ *        until the last 255 bytes. The whole buffer is used, both base
+ *        addresses are set to 0.
+ *
+ * \param [in]  packetParams  GFSK fixed length packet format, the length is
+ *                            ignored
+ * \param [in]  data          The data, read until the end of the packet
+ * \param [in]  size          Its size
+ *
+ * \retval      status        0 if the packet is started, 1 if the packet format
+ *                            is not supported or a transfer is running
+ */
+uint8_t SX126x_LongPktSend( PacketParams_t *packetParams, const uint8_t *data, uint32_t size );
+
+/*!
+ * \brief Receives a GFSK packet of any size, SX126x_LongPktProcess reads the
+ *        data as it comes
+ *
+ * \param [in]  packetParams  GFSK fixed length packet format, the length is
+ *                            ignored
+ * \param [out] buffer        The data
+ * \param [in]  size          Size of the packet, see SX126x_LongPktSetRxLength
+ * \param [in]  timeout       As in SX126x_SetRx
+ *
+ * \retval      status        0 if the reception is started, 1 otherwise
+ */
+uint8_t SX126x_LongPktReceive( PacketParams_t *packetParams, uint8_t *buffer, uint32_t size, uint32_t timeout );
+
+/*!
+ * \brief Changes the size of the packet being received, when it is carried
+ *        in its first bytes. It can only get smaller, and not below the bytes
+ *        already received.
+ *
+ * \param [in]  size          The new size
+ */
+void SX126x_LongPktSetRxLength( uint32_t size );
+
+/*!
+ * \brief Moves the data between the radio and the user buffer. To be called
+ *        at least every SX126x_LongPktGetPeriod, from a timer.
+ *
+ * \retval      count         Bytes sent or received so far
+ */
+uint32_t SX126x_LongPktProcess( void );
+
+/*!
+ * \brief Ends the transfer, to be called on TX done, RX done or timeout
+ *
+ * \retval      count         Bytes sent or received
+ */
+uint32_t SX126x_LongPktOnDone( void );
+
+/*!
+ * \brief Longest time between two calls to SX126x_LongPktProcess
+ *
+ * \param [in]  bitRate       GFSK bit rate [b/s]
+ *
+ * \retval      period        [us]
+ */
+uint32_t SX126x_LongPktGetPeriod( uint32_t bitRate );
+
+#endif // __SX126x_LONGPKT_H__
@@ -0,0 +1,302 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_neighbor.h"
+
+#define NEIGHBOR_NONE                               0xFFFF
+#define NEIGHBOR_HASH_SIZE                          ( 1UL << NEIGHBOR_HASH_BITS )
+#define NEIGHBOR_HASH_MASK                          ( NEIGHBOR_HASH_SIZE - 1 )
+
+#if ( NEIGHBOR_HASH_SIZE < 2 * NEIGHBOR_MAX ) || ( NEIGHBOR_MAX >= NEIGHBOR_NONE )
+#error "NEIGHBOR_HASH_BITS too small for NEIGHBOR_MAX"
+#endif
+
+/*!
+ * \brief The table, one array per field so that a search only walks the
+ *        addresses. Entries 0 .. Count - 1 are in use.
+ */
+static uint16_t Address[NEIGHBOR_MAX];
+static int16_t Rssi[NEIGHBOR_MAX];
+static int16_t Snr[NEIGHBOR_MAX];
+static uint16_t Received[NEIGHBOR_MAX];
+static uint16_t Lost[NEIGHBOR_MAX];
+static uint8_t LastSequence[NEIGHBOR_MAX];
+static uint32_t LastHeard[NEIGHBOR_MAX];
+static uint32_t FreqError[NEIGHBOR_MAX];
+
+/*!
+ * \brief LRU list, from the most recently heard (Head) to the least (Tail)
+ */
+static uint16_t Prev[NEIGHBOR_MAX];
+static uint16_t Next[NEIGHBOR_MAX];
+static uint16_t Head = NEIGHBOR_NONE;
+static uint16_t Tail = NEIGHBOR_NONE;
+
+/*!
+ * \brief Open addressing index: entry + 1, 0 if the slot is empty
+ */
+static uint16_t Hash[NEIGHBOR_HASH_SIZE];
+
+static uint16_t Count = 0;
+
+
+static uint16_t NeighborHome( uint16_t address )
+{
+    // Fibonacci hashing
+    return ( uint16_t )( ( ( uint32_t )address * 40503UL ) >> ( 16 - NEIGHBOR_HASH_BITS ) ) & NEIGHBOR_HASH_MASK;
+}
+
+/*!
+ * \brief Slot of an address in the index, or the empty slot ending its probe
+ */
+static uint16_t NeighborSlot( uint16_t address )
+{
+    uint16_t slot = NeighborHome( address );
+
+    while( ( Hash[slot] != 0 ) && ( Address[Hash[slot] - 1] != address ) )
+    {
+        slot = ( slot + 1 ) & NEIGHBOR_HASH_MASK;
+    }
+    return slot;
+}
+
+static void NeighborUnlink( uint16_t entry )
+{
+    if( Prev[entry] != NEIGHBOR_NONE )
+    {
+        Next[Prev[entry]] = Next[entry];
+    }
+    else
+    {
+        Head = Next[entry];
+    }
+    if( Next[entry] != NEIGHBOR_NONE )
+    {
+        Prev[Next[entry]] = Prev[entry];
+    }
+    else
+    {
+        Tail = Prev[entry];
+    }
+}
+
+static void NeighborPushFront( uint16_t entry )
+{
+    Prev[entry] = NEIGHBOR_NONE;
+    Next[entry] = Head;
+    if( Head != NEIGHBOR_NONE )
+    {
+        Prev[Head] = entry;
+    }
+    Head = entry;
+    if( Tail == NEIGHBOR_NONE )
+    {
+        Tail = entry;
+    }
+}
+
+/*!
+ * \brief Empties a slot of the index, moving back the entries probed past it
+ */
+static void NeighborHashDelete( uint16_t slot )
+{
+    uint16_t next = slot;
+
+    Hash[slot] = 0;
+    for( ;; )
+    {
+        uint16_t home;
+
+        next = ( next + 1 ) & NEIGHBOR_HASH_MASK;
+        if( Hash[next] == 0 )
+        {
+            return;
+        }
+        home = NeighborHome( Address[Hash[next] - 1] );
+        // The entry stays if its home is cyclically in ( slot, next ]
+        if( ( ( next > slot ) && ( ( home <= slot ) || ( home > next ) ) ) ||
+            ( ( next < slot ) && ( home <= slot ) && ( home > next ) ) )
+        {
+            Hash[slot] = Hash[next];
+            Hash[next] = 0;
+            slot = next;
+        }
+    }
+}
+
+/*!
+ * \brief Removes an entry and moves the last one in its place
+ */
+static void NeighborDelete( uint16_t entry )
+{
+    uint16_t last = Count - 1;
+
+    NeighborHashDelete( NeighborSlot( Address[entry] ) );
+    NeighborUnlink( entry );
+
+    if( entry != last )
+    {
+        Hash[NeighborSlot( Address[last] )] = entry + 1;
+        Address[entry] = Address[last];
+        Rssi[entry] = Rssi[last];
+        Snr[entry] = Snr[last];
+        Received[entry] = Received[last];
+        Lost[entry] = Lost[last];
+        LastSequence[entry] = LastSequence[last];
+        LastHeard[entry] = LastHeard[last];
+        FreqError[entry] = FreqError[last];
+        Prev[entry] = Prev[last];
+        Next[entry] = Next[last];
+        if( Prev[entry] != NEIGHBOR_NONE )
+        {
+            Next[Prev[entry]] = entry;
+        }
+        else
+        {
+            Head = entry;
+        }
+        if( Next[entry] != NEIGHBOR_NONE )
+        {
+            Prev[Next[entry]] = entry;
+        }
+        else
+        {
+            Tail = entry;
+        }
+    }
+    Count--;
+}
+
+static void NeighborFill( uint16_t entry, NeighborInfo_t *info )
+{
+    uint32_t total = ( uint32_t )Received[entry] + Lost[entry];
+
+    info->Address = Address[entry];
+    info->Rssi = Rssi[entry];
+    info->Snr = Snr[entry];
+    info->Per = ( total == 0 ) ? 0 : ( uint16_t )( ( uint32_t )Lost[entry] * 1000 / total );
+    info->LastSequence = LastSequence[entry];
+    info->LastHeard = LastHeard[entry];
+    info->FreqError = FreqError[entry];
+}
+
+void SX126x_NeighborInit( void )
+{
+    memset( Hash, 0, sizeof( Hash ) );
+    Head = NEIGHBOR_NONE;
+    Tail = NEIGHBOR_NONE;
+    Count = 0;
+}
+
+void SX126x_NeighborUpdate( uint16_t address, uint8_t sequence, PacketStatus_t *pktStatus )
+{
+    uint16_t slot = NeighborSlot( address );
+    uint16_t entry;
+    int16_t rssi;
+    int16_t snr = 0;
+
+    if( pktStatus->packetType == PACKET_TYPE_LORA )
+    {
+        rssi = 16 * pktStatus->Params.LoRa.RssiPkt;
+        snr = 16 * pktStatus->Params.LoRa.SnrPkt;
+    }
+    else
+    {
+        rssi = 16 * pktStatus->Params.Gfsk.RssiSync;
+    }
+
+    if( Hash[slot] == 0 )
+    {
+        if( Count == NEIGHBOR_MAX )
+        {
+            NeighborDelete( Tail );
+            slot = NeighborSlot( address );
+        }
+        entry = Count++;
+        Hash[slot] = entry + 1;
+        Address[entry] = address;
+        Rssi[entry] = rssi;
+        Snr[entry] = snr;
+        Received[entry] = 1;
+        Lost[entry] = 0;
+        NeighborPushFront( entry );
+    }
+    else
+    {
+        uint8_t gap = sequence - LastSequence[Hash[slot] - 1];
+
+        entry = Hash[slot] - 1;
+        Rssi[entry] += ( rssi - Rssi[entry] ) / ( 1 << NEIGHBOR_EWMA_SHIFT );
+        Snr[entry] += ( snr - Snr[entry] ) / ( 1 << NEIGHBOR_EWMA_SHIFT );
+        // Duplicates and late packets (gap of 0 or backwards) lose nothing
+        if( ( gap > 1 ) && ( gap < 128 ) )
+        {
+            Lost[entry] += gap - 1;
+        }
+        Received[entry]++;
+        if( ( Received[entry] + Lost[entry] ) > NEIGHBOR_PER_WINDOW )
+        {
+            Received[entry] /= 2;
+            Lost[entry] /= 2;
+        }
+        if( entry != Head )
+        {
+            NeighborUnlink( entry );
+            NeighborPushFront( entry );
+        }
+    }
+    LastSequence[entry] = sequence;
+    LastHeard[entry] = pktStatus->Timestamp;
+    FreqError[entry] = ( pktStatus->packetType == PACKET_TYPE_LORA ) ? pktStatus->Params.LoRa.FreqError : pktStatus->Params.Gfsk.FreqError;
+}
+
+uint8_t SX126x_NeighborGet( uint16_t address, NeighborInfo_t *info )
+{
+    uint16_t slot = NeighborSlot( address );
+
+    if( Hash[slot] == 0 )
+    {
+        return 1;
+    }
+    NeighborFill( Hash[slot] - 1, info );
+    return 0;
+}
+
+uint8_t SX126x_NeighborGetAt( uint16_t index, NeighborInfo_t *info )
+{
+    if( index >= Count )
+    {
+        return 1;
+    }
+    NeighborFill( index, info );
+    return 0;
+}
+
+void SX126x_NeighborRemove( uint16_t address )
+{
+    uint16_t slot = NeighborSlot( address );
+
+    if( Hash[slot] != 0 )
+    {
+        NeighborDelete( Hash[slot] - 1 );
+    }
+}
+
+uint16_t SX126x_NeighborCount( void )
+{
+    return Count;
+}
@@ -0,0 +1,110 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_NEIGHBOR_H__
+#define __SX126x_NEIGHBOR_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Entries of the table, the least recently heard one is replaced
+ */
+#ifndef NEIGHBOR_MAX
+#define NEIGHBOR_MAX                                32
+#endif
+
+/*!
+ * \brief log2 of the hash index size, at least twice NEIGHBOR_MAX
+ */
+#ifndef NEIGHBOR_HASH_BITS
+#define NEIGHBOR_HASH_BITS                          6
+#endif
+
+/*!
+ * \brief Weight of a new sample in the RSSI and SNR averages: 1 / 2^shift
+ */
+#define NEIGHBOR_EWMA_SHIFT                         3
+
+/*!
+ * \brief Received and lost counts are halved over this, the PER follows the
+ *        last few hundred packets
+ */
+#define NEIGHBOR_PER_WINDOW                         256
+
+/*!
+ * \brief Link quality of a neighbor
+ */
+typedef struct
+{
+    uint16_t      Address;
+    int16_t       Rssi;                             //!< Average RSSI [1/16 dBm]
+    int16_t       Snr;                              //!< Average SNR, LoRa only [1/16 dB]
+    uint16_t      Per;                              //!< Packet error rate from the sequence gaps [1/1000]
+    uint8_t       LastSequence;
+    uint32_t      LastHeard;                        //!< Time stamp of the last packet [us]
+    uint32_t      FreqError;                        //!< Of the last packet, as in PacketStatus_t
+}NeighborInfo_t;
+
+/*!
+ * \brief Empties the table
+ */
+void SX126x_NeighborInit( void );
+
+/*!
+ * \brief Updates a neighbor from a received packet, adding it if needed.
+ *        Constant time, to be called from the RX path.
+ *
+ * \param [in]  address       Address of the sender
+ * \param [in]  sequence      Sequence number of the packet, the gaps count
+ *                            as lost packets
+ * \param [in]  pktStatus     Status from SX126x_GetPacketStatus
+ */
+void SX126x_NeighborUpdate( uint16_t address, uint8_t sequence, PacketStatus_t *pktStatus );
+
+/*!
+ * \brief Gets the link quality of a neighbor
+ *
+ * \param [in]  address       Address of the neighbor
+ * \param [out] info          Its link quality
+ *
+ * \retval      status        0 if found, 1 otherwise
+ */
+uint8_t SX126x_NeighborGet( uint16_t address, NeighborInfo_t *info );
+
+/*!
+ * \brief Gets a neighbor by position, to walk the table
+ *
+ * \param [in]  index         0 to SX126x_NeighborCount( ) - 1
+ * \param [out] info          Its link quality
+ *
+ * \retval      status        0 if found, 1 otherwise
+ */
+uint8_t SX126x_NeighborGetAt( uint16_t index, NeighborInfo_t *info );
+
+/*!
+ * \brief Removes a neighbor
+ *
+ * \param [in]  address       Address of the neighbor
+ */
+void SX126x_NeighborRemove( uint16_t address );
+
+/*!
+ * \brief Number of neighbors in the table
+ */
+uint16_t SX126x_NeighborCount( void );
+
+#endif // __SX126x_NEIGHBOR_H__
@@ -0,0 +1,494 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_os.h"
+
+#if( SX126X_OS == SX126X_OS_FREERTOS )
+
+/*!
+ * \brief Milliseconds to ticks, rounded up so that a wait is never shorter
+ */
+static TickType_t OsTicks( uint32_t ms )
+{
+    if( ms == OS_WAIT_FOREVER )
+    {
+        return portMAX_DELAY;
+    }
+    return ( TickType_t )( ( ( uint64_t )ms * configTICK_RATE_HZ + 999 ) / 1000 );
+}
+
+static void OsTimerExpired( TimerHandle_t handle )
+{
+    OsTimer_t *timer = ( OsTimer_t * )pvTimerGetTimerID( handle );
+
+    timer->Callback( timer->Context );
+}
+
+void SX126x_OsMutexInit( OsMutex_t *mutex )
+{
+    mutex->Handle = xSemaphoreCreateRecursiveMutexStatic( &mutex->Buffer );
+}
+
+void SX126x_OsMutexLock( OsMutex_t *mutex )
+{
+    xSemaphoreTakeRecursive( mutex->Handle, portMAX_DELAY );
+}
+
+void SX126x_OsMutexUnlock( OsMutex_t *mutex )
+{
+    xSemaphoreGiveRecursive( mutex->Handle );
+}
+
+void SX126x_OsSemaphoreInit( OsSemaphore_t *semaphore )
+{
+    semaphore->Handle = xSemaphoreCreateCountingStatic( 0xFFFF, 0, &semaphore->Buffer );
+}
+
+void SX126x_OsSemaphoreGive( OsSemaphore_t *semaphore )
+{
+    xSemaphoreGive( semaphore->Handle );
+}
+
+void SX126x_OsSemaphoreGiveFromIsr( OsSemaphore_t *semaphore )
+{
+    BaseType_t woken = pdFALSE;
+
+    xSemaphoreGiveFromISR( semaphore->Handle, &woken );
+    portYIELD_FROM_ISR( woken );
+}
+
+bool SX126x_OsSemaphoreTake( OsSemaphore_t *semaphore, uint32_t timeoutMs )
+{
+    return xSemaphoreTake( semaphore->Handle, OsTicks( timeoutMs ) ) == pdTRUE;
+}
+
+void SX126x_OsEventInit( OsEventFlags_t *events )
+{
+    events->Handle = xEventGroupCreateStatic( &events->Buffer );
+}
+
+void SX126x_OsEventSet( OsEventFlags_t *events, uint32_t flags )
+{
+    xEventGroupSetBits( events->Handle, flags );
+}
+
+void SX126x_OsEventSetFromIsr( OsEventFlags_t *events, uint32_t flags )
+{
+    BaseType_t woken = pdFALSE;
+
+    // Deferred to the timer service task by FreeRTOS
+    xEventGroupSetBitsFromISR( events->Handle, flags, &woken );
+    portYIELD_FROM_ISR( woken );
+}
+
+uint32_t SX126x_OsEventWait( OsEventFlags_t *events, uint32_t flags, uint32_t timeoutMs )
+{
+    return xEventGroupWaitBits( events->Handle, flags, pdTRUE, pdFALSE, OsTicks( timeoutMs ) ) & flags;
+}
+
+void SX126x_OsDelayMs( uint32_t ms )
+{
+    vTaskDelay( OsTicks( ms ) );
+}
+
+void SX126x_OsYield( void )
+{
+    taskYIELD( );
+}
+
+void SX126x_OsTimerInit( OsTimer_t *timer, OsTimerCallback_t callback, void *context )
+{
+    timer->Callback = callback;
+    timer->Context = context;
+    timer->Handle = xTimerCreateStatic( "sx126x", 1, pdFALSE, timer, OsTimerExpired, &timer->Buffer );
+}
+
+void SX126x_OsTimerStart( OsTimer_t *timer, uint32_t ms )
+{
+    TickType_t ticks = OsTicks( ms );
+
+    // Changing the period also starts the timer
+    xTimerChangePeriod( timer->Handle, ( ticks == 0 ) ? 1 : ticks, portMAX_DELAY );
+}
+
+void SX126x_OsTimerStop( OsTimer_t *timer )
+{
+    xTimerStop( timer->Handle, portMAX_DELAY );
+}
+
+#elif( SX126X_OS == SX126X_OS_POSIX )
+
+#include <sched.h>
+#include <signal.h>
+
+/*!
+ * \brief Inits a condition variable on the monotonic clock
+ */
+static void OsCondInit( pthread_cond_t *cond )
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( cond, &attr );
+    pthread_condattr_destroy( &attr );
+}
+
+/*!
+ * \brief Waits on the condition up to the deadline, the mutex being held
+ *
+ * \retval      expired       true if the deadline passed
+ */
+static bool OsCondWait( pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline )
+{
+    if( deadline == NULL )
+    {
+        pthread_cond_wait( cond, mutex );
+        return false;
+    }
+    return pthread_cond_timedwait( cond, mutex, deadline ) != 0;
+}
+
+static const struct timespec *OsDeadline( struct timespec *deadline, uint32_t timeoutMs )
+{
+    if( timeoutMs == OS_WAIT_FOREVER )
+    {
+        return NULL;
+    }
+    clock_gettime( CLOCK_MONOTONIC, deadline );
+    deadline->tv_sec += timeoutMs / 1000;
+    deadline->tv_nsec += ( long )( timeoutMs % 1000 ) * 1000000;
+    if( deadline->tv_nsec >= 1000000000 )
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+static void OsTimerExpired( union sigval value )
+{
+    OsTimer_t *timer = ( OsTimer_t * )value.sival_ptr;
+
+    timer->Callback( timer->Context );
+}
+
+void SX126x_OsMutexInit( OsMutex_t *mutex )
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &mutex->Mutex, &attr );
+    pthread_mutexattr_destroy( &attr );
+}
+
+void SX126x_OsMutexLock( OsMutex_t *mutex )
+{
+    pthread_mutex_lock( &mutex->Mutex );
+}
+
+void SX126x_OsMutexUnlock( OsMutex_t *mutex )
+{
+    pthread_mutex_unlock( &mutex->Mutex );
+}
+
+void SX126x_OsSemaphoreInit( OsSemaphore_t *semaphore )
+{
+    pthread_mutex_init( &semaphore->Mutex, NULL );
+    OsCondInit( &semaphore->Cond );
+    semaphore->Count = 0;
+}
+
+void SX126x_OsSemaphoreGive( OsSemaphore_t *semaphore )
+{
+    pthread_mutex_lock( &semaphore->Mutex );
+    semaphore->Count++;
+    pthread_cond_signal( &semaphore->Cond );
+    pthread_mutex_unlock( &semaphore->Mutex );
+}
+
+void SX126x_OsSemaphoreGiveFromIsr( OsSemaphore_t *semaphore )
+{
+    // The interrupts of a host simulation are threads
+    SX126x_OsSemaphoreGive( semaphore );
+}
+
+bool SX126x_OsSemaphoreTake( OsSemaphore_t *semaphore, uint32_t timeoutMs )
+{
+    struct timespec buffer;
+    const struct timespec *deadline = OsDeadline( &buffer, timeoutMs );
+    bool taken = false;
+
+    pthread_mutex_lock( &semaphore->Mutex );
+    while( ( semaphore->Count == 0 ) && ( timeoutMs != 0 ) )
+    {
+        if( OsCondWait( &semaphore->Cond, &semaphore->Mutex, deadline ) )
+        {
+            break;
+        }
+    }
+    if( semaphore->Count > 0 )
+    {
+        semaphore->Count--;
+        taken = true;
+    }
+    pthread_mutex_unlock( &semaphore->Mutex );
+
+    return taken;
+}
+
+void SX126x_OsEventInit( OsEventFlags_t *events )
+{
+    pthread_mutex_init( &events->Mutex, NULL );
+    OsCondInit( &events->Cond );
+    events->Flags = 0;
+}
+
+void SX126x_OsEventSet( OsEventFlags_t *events, uint32_t flags )
+{
+    pthread_mutex_lock( &events->Mutex );
+    events->Flags |= flags;
+    pthread_cond_broadcast( &events->Cond );
+    pthread_mutex_unlock( &events->Mutex );
+}
+
+void SX126x_OsEventSetFromIsr( OsEventFlags_t *events, uint32_t flags )
+{
+    SX126x_OsEventSet( events, flags );
+}
+
+uint32_t SX126x_OsEventWait( OsEventFlags_t *events, uint32_t flags, uint32_t timeoutMs )
+{
+    struct timespec buffer;
+    const struct timespec *deadline = OsDeadline( &buffer, timeoutMs );
+    uint32_t set;
+
+    pthread_mutex_lock( &events->Mutex );
+    while( ( ( events->Flags & flags ) == 0 ) && ( timeoutMs != 0 ) )
+    {
+        if( OsCondWait( &events->Cond, &events->Mutex, deadline ) )
+        {
+            break;
+        }
+    }
+    set = events->Flags & flags;
+    events->Flags &= ~set;
+    pthread_mutex_unlock( &events->Mutex );
+
+    return set;
+}
+
+void SX126x_OsDelayMs( uint32_t ms )
+{
+    struct timespec delay = { ms / 1000, ( long )( ms % 1000 ) * 1000000 };
+
+    while( nanosleep( &delay, &delay ) != 0 )
+    {
+    }
+}
+
+void SX126x_OsYield( void )
+{
+    sched_yield( );
+}
+
+void SX126x_OsTimerInit( OsTimer_t *timer, OsTimerCallback_t callback, void *context )
+{
+    struct sigevent event;
+
+    memset( &event, 0, sizeof( event ) );
+    timer->Callback = callback;
+    timer->Context = context;
+    event.sigev_notify = SIGEV_THREAD;
+    event.sigev_value.sival_ptr = timer;
+    event.sigev_notify_function = OsTimerExpired;
+    timer_create( CLOCK_MONOTONIC, &event, &timer->Handle );
+}
+
+void SX126x_OsTimerStart( OsTimer_t *timer, uint32_t ms )
+{
+    struct itimerspec spec;
+
+    memset( &spec, 0, sizeof( spec ) );
+    spec.it_value.tv_sec = ms / 1000;
+    // A zero value would disarm the timer
+    spec.it_value.tv_nsec = ( ms == 0 ) ? 1 : ( long )( ms % 1000 ) * 1000000;
+    timer_settime( timer->Handle, 0, &spec, NULL );
+}
+
+void SX126x_OsTimerStop( OsTimer_t *timer )
+{
+    struct itimerspec spec;
+
+    memset( &spec, 0, sizeof( spec ) );
+    timer_settime( timer->Handle, 0, &spec, NULL );
+}
+
+#else
+
+/*!
+ * \brief true once timeoutMs passed since start
+ */
+static bool OsExpired( uint32_t start, uint32_t timeoutMs )
+{
+    return ( timeoutMs != OS_WAIT_FOREVER ) && ( ( get_time_us( ) - start ) / 1000 >= timeoutMs );
+}
+
+static void OsTimerExpired( const struct timer_task *const task )
+{
+    OsTimer_t *timer = ( OsTimer_t * )task;
+
+    timer->Callback( timer->Context );
+}
+
+void SX126x_OsMutexInit( OsMutex_t *mutex )
+{
+    mutex->Depth = 0;
+}
+
+void SX126x_OsMutexLock( OsMutex_t *mutex )
+{
+    // Nobody to wait for, the owner would be the context being interrupted
+    ASSERT( IN_INTERRUPT( ) == 0 );
+    mutex->Depth++;
+}
+
+void SX126x_OsMutexUnlock( OsMutex_t *mutex )
+{
+    ASSERT( mutex->Depth > 0 );
+    mutex->Depth--;
+}
+
+void SX126x_OsSemaphoreInit( OsSemaphore_t *semaphore )
+{
+    semaphore->Count = 0;
+}
+
+void SX126x_OsSemaphoreGive( OsSemaphore_t *semaphore )
+{
+    CRITICAL_SECTION_ENTER()
+    semaphore->Count++;
+    CRITICAL_SECTION_LEAVE()
+}
+
+void SX126x_OsSemaphoreGiveFromIsr( OsSemaphore_t *semaphore )
+{
+    SX126x_OsSemaphoreGive( semaphore );
+}
+
+bool SX126x_OsSemaphoreTake( OsSemaphore_t *semaphore, uint32_t timeoutMs )
+{
+    uint32_t start = get_time_us( );
+    bool taken = false;
+
+    for( ;; )
+    {
+        // The timer tick wakes the MCU up, the timeout is checked at least once per tick
+        CRITICAL_SECTION_ENTER()
+        if( semaphore->Count > 0 )
+        {
+            semaphore->Count--;
+            taken = true;
+        }
+        else if( timeoutMs != 0 )
+        {
+            mcu_sleep( MCU_SLEEP_IDLE );
+        }
+        CRITICAL_SECTION_LEAVE()
+
+        if( taken || OsExpired( start, timeoutMs ) )
+        {
+            return taken;
+        }
+    }
+}
+
+void SX126x_OsEventInit( OsEventFlags_t *events )
+{
+    events->Flags = 0;
+}
+
+void SX126x_OsEventSet( OsEventFlags_t *events, uint32_t flags )
+{
+    CRITICAL_SECTION_ENTER()
+    events->Flags |= flags;
+    CRITICAL_SECTION_LEAVE()
+}
+
+void SX126x_OsEventSetFromIsr( OsEventFlags_t *events, uint32_t flags )
+{
+    SX126x_OsEventSet( events, flags );
+}
+
+uint32_t SX126x_OsEventWait( OsEventFlags_t *events, uint32_t flags, uint32_t timeoutMs )
+{
+    uint32_t start = get_time_us( );
+    uint32_t set = 0;
+
+    for( ;; )
+    {
+        CRITICAL_SECTION_ENTER()
+        set = events->Flags & flags;
+        events->Flags &= ~set;
+        if( ( set == 0 ) && ( timeoutMs != 0 ) )
+        {
+            mcu_sleep( MCU_SLEEP_IDLE );
+        }
+        CRITICAL_SECTION_LEAVE()
+
+        if( ( set != 0 ) || OsExpired( start, timeoutMs ) )
+        {
+            return set;
+        }
+    }
+}
+
+void SX126x_OsDelayMs( uint32_t ms )
+{
+    // wait_ms takes 16 bits
+    while( ms > 0 )
+    {
+        uint16_t chunk = ( ms > 0xFFFF ) ? 0xFFFF : ( uint16_t )ms;
+
+        wait_ms( chunk );
+        ms -= chunk;
+    }
+}
+
+void SX126x_OsYield( void )
+{
+}
+
+void SX126x_OsTimerInit( OsTimer_t *timer, OsTimerCallback_t callback, void *context )
+{
+    memset( &timer->Task, 0, sizeof( timer->Task ) );
+    timer->Callback = callback;
+    timer->Context = context;
+}
+
+void SX126x_OsTimerStart( OsTimer_t *timer, uint32_t ms )
+{
+    timer_task_start( &timer->Task, ms, OsTimerExpired );
+}
+
+void SX126x_OsTimerStop( OsTimer_t *timer )
+{
+    timer_task_stop( &timer->Task );
+}
+
+#endif
@@ -0,0 +1,216 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_OS_H__
+#define __SX126x_OS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * \brief Backends of the OS abstraction
+ */
+#define SX126X_OS_BAREMETAL                         0
+#define SX126X_OS_FREERTOS                          1
+#define SX126X_OS_POSIX                             2
+
+/*!
+ * \brief Backend in use, set it from the compiler command line
+ */
+#ifndef SX126X_OS
+#define SX126X_OS                                   SX126X_OS_BAREMETAL
+#endif
+
+/*!
+ * \brief Timeout waiting forever
+ */
+#define OS_WAIT_FOREVER                             0xFFFFFFFF
+
+/*!
+ * \brief Callback of a timer. It runs in the timer interrupt (bare-metal), in
+ *        the timer service task (FreeRTOS) or in a thread (POSIX).
+ */
+typedef void ( *OsTimerCallback_t )( void *context );
+
+#if( SX126X_OS == SX126X_OS_FREERTOS )
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "event_groups.h"
+#include "timers.h"
+
+typedef struct
+{
+    SemaphoreHandle_t     Handle;
+    StaticSemaphore_t     Buffer;
+}OsMutex_t;
+
+typedef struct
+{
+    SemaphoreHandle_t     Handle;
+    StaticSemaphore_t     Buffer;
+}OsSemaphore_t;
+
+typedef struct
+{
+    EventGroupHandle_t    Handle;
+    StaticEventGroup_t    Buffer;
+}OsEventFlags_t;
+
+typedef struct
+{
+    TimerHandle_t         Handle;
+    StaticTimer_t         Buffer;
+    OsTimerCallback_t     Callback;
+    void                  *Context;
+}OsTimer_t;
+
+#elif( SX126X_OS == SX126X_OS_POSIX )
+
+#include <pthread.h>
+#include <time.h>
+
+typedef struct
+{
+    pthread_mutex_t       Mutex;
+}OsMutex_t;
+
+typedef struct
+{
+    pthread_mutex_t       Mutex;
+    pthread_cond_t        Cond;
+    uint32_t              Count;
+}OsSemaphore_t;
+
+typedef struct
+{
+    pthread_mutex_t       Mutex;
+    pthread_cond_t        Cond;
+    uint32_t              Flags;
+}OsEventFlags_t;
+
+typedef struct
+{
+    timer_t               Handle;
+    OsTimerCallback_t     Callback;
+    void                  *Context;
+}OsTimer_t;
+
+#else
+
+#include "device_specific_implementation.h"
+
+/*!
+ * \brief A single context, the mutex only counts the nesting. It asserts (DEBUG
+ *        builds) it is never taken from an interrupt, nor unlocked more than
+ *        locked.
+ */
+typedef struct
+{
+    volatile uint8_t      Depth;
+}OsMutex_t;
+
+typedef struct
+{
+    volatile uint32_t     Count;
+}OsSemaphore_t;
+
+typedef struct
+{
+    volatile uint32_t     Flags;
+}OsEventFlags_t;
+
+typedef struct
+{
+    struct timer_task     Task;                     //!< First, the callback gets its address
+    OsTimerCallback_t     Callback;
+    void                  *Context;
+}OsTimer_t;
+
+#endif
+
+/*!
+ * \brief Recursive mutex, not to be used from an interrupt. The owner may take
+ *        it again and gives it back with as many unlocks. The FreeRTOS
+ *        backend needs configUSE_RECURSIVE_MUTEXES.
+ */
+void SX126x_OsMutexInit( OsMutex_t *mutex );
+void SX126x_OsMutexLock( OsMutex_t *mutex );
+void SX126x_OsMutexUnlock( OsMutex_t *mutex );
+
+/*!
+ * \brief Counting semaphore, it can be given from an interrupt
+ */
+void SX126x_OsSemaphoreInit( OsSemaphore_t *semaphore );
+void SX126x_OsSemaphoreGive( OsSemaphore_t *semaphore );
+void SX126x_OsSemaphoreGiveFromIsr( OsSemaphore_t *semaphore );
+
+/*!
+ * \brief Takes the semaphore, blocking the calling task up to the timeout
+ *
+ * \param [in]  semaphore     The semaphore
+ * \param [in]  timeoutMs     Longest wait [ms], OS_WAIT_FOREVER or 0 to poll
+ *
+ * \retval      taken         true if taken, false on timeout
+ */
+bool SX126x_OsSemaphoreTake( OsSemaphore_t *semaphore, uint32_t timeoutMs );
+
+/*!
+ * \brief Event flags, 24 bits for FreeRTOS compatibility. They can be set
+ *        from an interrupt.
+ */
+void SX126x_OsEventInit( OsEventFlags_t *events );
+void SX126x_OsEventSet( OsEventFlags_t *events, uint32_t flags );
+void SX126x_OsEventSetFromIsr( OsEventFlags_t *events, uint32_t flags );
+
+/*!
+ * \brief Waits for any of the flags, blocking the calling task up to the
+ *        timeout, and clears the ones returned
+ *
+ * \param [in]  events        The event flags
+ * \param [in]  flags         Flags to wait for
+ * \param [in]  timeoutMs     Longest wait [ms], OS_WAIT_FOREVER or 0 to poll
+ *
+ * \retval      set           Flags among the ones waited for that were set,
+ *                            0 on timeout
+ */
+uint32_t SX126x_OsEventWait( OsEventFlags_t *events, uint32_t flags, uint32_t timeoutMs );
+
+/*!
+ * \brief Blocks the calling task, the other tasks and the interrupts keep
+ *        running
+ *
+ * \param [in]  ms            Delay [ms]
+ */
+void SX126x_OsDelayMs( uint32_t ms );
+
+/*!
+ * \brief Lets the other ready tasks run, e.g. while polling BUSY. Nothing on
+ *        bare-metal.
+ */
+void SX126x_OsYield( void );
+
+/*!
+ * \brief One shot timer
+ *
+ * \param [in]  timer         The timer
+ * \param [in]  callback      Called when it expires
+ * \param [in]  context       Given to the callback
+ */
+void SX126x_OsTimerInit( OsTimer_t *timer, OsTimerCallback_t callback, void *context );
+void SX126x_OsTimerStart( OsTimer_t *timer, uint32_t ms );
+void SX126x_OsTimerStop( OsTimer_t *timer );
+
+#endif // __SX126x_OS_H__
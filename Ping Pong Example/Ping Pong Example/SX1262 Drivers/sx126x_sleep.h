@@ -0,0 +1,114 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#ifndef __SX126x_SLEEP_H__
+#define __SX126x_SLEEP_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Largest configuration block kept in the shadow (SetPacketParams, GFSK)
+ */
+#define SHADOW_MAX_SIZE                             9
+
+/*!
+ * \brief Configuration blocks kept in the driver shadow state
+ *
+ * \remark The order of the entries is the order in which they are replayed
+ *         after a wake up: packet type must go before the modulation and
+ *         packet parameters, the PA configuration before the TX parameters
+ */
+typedef enum
+{
+    SHADOW_REGULATOR_MODE                   = 0x00,
+    SHADOW_TCXO_MODE,
+    SHADOW_RF_SWITCH_MODE,
+    SHADOW_PACKET_TYPE,
+    SHADOW_CALIBRATE_IMAGE,
+    SHADOW_RF_FREQUENCY,
+    SHADOW_PA_CONFIG,
+    SHADOW_TX_PARAMS,
+    SHADOW_MODULATION_PARAMS,
+    SHADOW_PACKET_PARAMS,
+    SHADOW_BUFFER_BASE_ADDRESS,
+    SHADOW_DIO_IRQ_PARAMS,
+    SHADOW_FALLBACK_MODE,
+    SHADOW_CAD_PARAMS,
+    SHADOW_STOP_RX_TIMER_ON_PREAMBLE,
+    SHADOW_LORA_SYMB_TIMEOUT,
+    SHADOW_REG_LORA_SYNCWORD,
+    SHADOW_REG_GFSK_SYNCWORD,
+    SHADOW_REG_CRC_SEED,
+    SHADOW_REG_CRC_POLYNOMIAL,
+    SHADOW_REG_WHITENING_SEED,
+    SHADOW_REG_OCP,
+    SHADOW_REG_RX_GAIN,
+    SHADOW_ENTRIES,
+}RadioShadowEntries_t;
+
+/*!
+ * \brief Shadow entries lost in a warm start sleep
+ *
+ * The configuration is retained in warm start, but the RX gain register is
+ * not part of the default retention list and comes back as power saving gain
+ */
+#define SHADOW_WARM_START_LOST                      ( 1UL << SHADOW_REG_RX_GAIN )
+
+/*!
+ * \brief Shadow entries lost in a cold start sleep: everything
+ */
+#define SHADOW_COLD_START_LOST                      ( ( 1UL << SHADOW_ENTRIES ) - 1 )
+
+/*!
+ * \brief Stores the last value written to the radio for a configuration block
+ *
+ * \param [in]  entry         The configuration block being written
+ * \param [in]  buffer        The bytes sent to the radio for the block
+ * \param [in]  size          The number of bytes, at most SHADOW_MAX_SIZE
+ */
+void SX126x_ShadowStore( RadioShadowEntries_t entry, uint8_t *buffer, uint8_t size );
+
+/*!
+ * \brief Forgets the whole shadow state, e.g. after a hardware reset
+ */
+void SX126x_ShadowClear( void );
+
+/*!
+ * \brief Records the kind of sleep the radio is entering
+ *
+ * \param [in]  sleepConfig   The configuration given to SetSleep
+ */
+void SX126x_SleepEnter( SleepParams_t sleepConfig );
+
+/*!
+ * \brief Returns the shadow entries that must be written again at next wake up
+ *
+ * \retval      lostMask      One bit per RadioShadowEntries_t
+ */
+uint32_t SX126x_SleepGetLostMask( void );
+
+/*!
+ * \brief Replays the lost configuration after the radio left sleep mode
+ *
+ * Only the entries lost by the last sleep and previously configured are sent,
+ * back to back, in replay order, with a full calibration after the TCXO
+ * mode. Called by SX126xHal_Wakeup, the radio is left in STDBY_RC.
+ *
+ * \retval      count         The number of commands sent to the radio
+ */
+uint8_t SX126x_SleepRestore( void );
+
+#endif // __SX126x_SLEEP_H__
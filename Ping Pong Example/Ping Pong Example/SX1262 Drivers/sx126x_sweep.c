@@ -0,0 +1,103 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include "sx126x_sweep.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+uint8_t SX126x_SweepPrepare( const uint32_t *frequencies, uint32_t *words, uint16_t count )
+{
+    uint8_t band[2] = { 0, 0 };
+    uint8_t calFreq[2];
+
+    if( count == 0 )
+    {
+        return 0;
+    }
+    SX126x_GetImageCalibration( frequencies[0], band );
+    for( uint16_t i = 0; i < count; i++ )
+    {
+        calFreq[0] = 0;
+        calFreq[1] = 0;
+        SX126x_GetImageCalibration( frequencies[i], calFreq );
+        if( ( calFreq[0] != band[0] ) || ( calFreq[1] != band[1] ) )
+        {
+            return 1;
+        }
+        words[i] = SX126x_GetFrequencyWord( frequencies[i] );
+    }
+    // Valid for the whole sweep
+    SX126xHal_Lock( );
+    SX126x_SetStandby( STDBY_RC );
+    SX126x_CheckImageCalibration( frequencies[0] );
+    SX126xHal_Unlock( );
+    return 0;
+}
+
+uint32_t SX126x_SweepRun( const uint32_t *words, uint16_t count, uint8_t samples, SweepResult_t *results )
+{
+    uint32_t start = get_time_us( );
+    uint32_t elapsed;
+
+    if( samples == 0 )
+    {
+        samples = 1;
+    }
+    for( uint16_t i = 0; i < count; i++ )
+    {
+        int16_t sum = 0;
+        int8_t min = INT8_MAX;
+        int8_t max = INT8_MIN;
+        uint32_t settle;
+
+        // The frequency can only be changed in standby, XOSC keeps the
+        // crystal running between the channels. The bus is given back, and
+        // the deferred requests served, between two channels only.
+        SX126xHal_Lock( );
+        SX126x_SetStandby( STDBY_XOSC );
+        SX126x_SetRfFrequencyWord( words[i] );
+        SX126x_SetRx( 0xFFFFFF );
+        settle = get_time_us( );
+        while( ( get_time_us( ) - settle ) < SWEEP_SETTLE_US )
+        {
+        }
+        for( uint8_t n = 0; n < samples; n++ )
+        {
+            int8_t rssi = SX126x_GetRssiInst( );
+
+            sum += rssi;
+            if( rssi < min )
+            {
+                min = rssi;
+            }
+            if( rssi > max )
+            {
+                max = rssi;
+            }
+        }
+        SX126xHal_Unlock( );
+        results[i].Min = min;
+        results[i].Avg = ( int8_t )( sum / samples );
+        results[i].Max = max;
+    }
+    SX126x_SetStandby( STDBY_RC );
+
+    elapsed = get_time_us( ) - start;
+    if( elapsed == 0 )
+    {
+        return 0;
+    }
+    return ( uint32_t )( ( uint64_t )count * 1000000 / elapsed );
+}
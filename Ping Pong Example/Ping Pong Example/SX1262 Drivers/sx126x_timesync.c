@@ -0,0 +1,282 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_timesync.h"
+#include "device_specific_implementation.h"
+
+#define TIMESYNC_PPB                                1000000000LL
+
+/*!
+ * \brief A beacon as seen by the node: when it started on air, in local time,
+ *        and the network time it carried
+ */
+typedef struct
+{
+    uint64_t      Local;
+    int64_t       Offset;                           //!< Network minus local time
+}TimeSyncSample_t;
+
+static TimeSyncRoles_t Role = TIMESYNC_NODE;
+
+static uint32_t BeaconTimeOnAir = 0;                // [ticks]
+
+static TimeSyncSample_t Samples[TIMESYNC_WINDOW];
+
+static uint8_t SampleCount = 0;
+
+static uint8_t SampleNext = 0;
+
+/*!
+ * \brief Result of the regression: network = local + Offset + Drift * ( local - Reference )
+ */
+static uint64_t FitReference = 0;
+static int64_t FitOffset = 0;
+static int32_t FitDrift = 0;                        // [ppb]
+
+/*!
+ * \brief Extension of get_timestamp to 64 bit
+ */
+static uint64_t LocalTime = 0;
+static uint32_t LastTimestamp = 0;
+
+/*!
+ * \brief Coordinator: current TX latency and start of the last beacon
+ */
+static uint32_t TxLatency = 0;                      // [ticks]
+static uint64_t BeaconStart = 0;
+static uint8_t BeaconSequence = 0;
+static uint8_t BeaconPending = 0;
+
+
+/*!
+ * \brief Extends a 32 bit time stamp, which may be slightly in the past
+ */
+static uint64_t TimeSyncExtend( uint32_t timestamp )
+{
+    int32_t elapsed;
+    uint64_t time;
+
+    CRITICAL_SECTION_ENTER()
+    elapsed = ( int32_t )( timestamp - LastTimestamp );
+    time = LocalTime + elapsed;
+    if( elapsed > 0 )
+    {
+        LocalTime = time;
+        LastTimestamp = timestamp;
+    }
+    CRITICAL_SECTION_LEAVE()
+
+    return time;
+}
+
+/*!
+ * \brief Least squares fit of the offset against the local time
+ *
+ * \remark Runs once per beacon, double precision is needed for the sums
+ */
+static void TimeSyncFit( void )
+{
+    uint8_t newest = ( SampleNext + TIMESYNC_WINDOW - 1 ) % TIMESYNC_WINDOW;
+    uint64_t reference = Samples[newest].Local;
+    int64_t offset = Samples[newest].Offset;
+    double meanX = 0, meanY = 0, sxx = 0, sxy = 0;
+    double slope = 0;
+
+    // Relative to the newest sample, the values stay small
+    for( uint8_t i = 0; i < SampleCount; i++ )
+    {
+        meanX += ( double )( int64_t )( Samples[i].Local - reference );
+        meanY += ( double )( Samples[i].Offset - offset );
+    }
+    meanX /= SampleCount;
+    meanY /= SampleCount;
+    for( uint8_t i = 0; i < SampleCount; i++ )
+    {
+        double x = ( double )( int64_t )( Samples[i].Local - reference ) - meanX;
+        double y = ( double )( Samples[i].Offset - offset ) - meanY;
+
+        sxx += x * x;
+        sxy += x * y;
+    }
+    if( sxx > 0 )
+    {
+        slope = sxy / sxx;
+    }
+
+    CRITICAL_SECTION_ENTER()
+    FitReference = reference;
+    FitOffset = offset + ( int64_t )( meanY - slope * meanX );
+    FitDrift = ( int32_t )( slope * TIMESYNC_PPB );
+    CRITICAL_SECTION_LEAVE()
+}
+
+void SX126x_TimeSyncInit( TimeSyncRoles_t role, uint32_t beaconTimeOnAir )
+{
+    Role = role;
+    BeaconTimeOnAir = beaconTimeOnAir * TIMESTAMP_TICKS_PER_US;
+    SampleCount = 0;
+    SampleNext = 0;
+    FitReference = 0;
+    FitOffset = 0;
+    FitDrift = 0;
+    LastTimestamp = get_timestamp( );
+    TxLatency = TIMESYNC_TX_LATENCY_US * TIMESTAMP_TICKS_PER_US;
+    BeaconPending = 0;
+}
+
+void SX126x_TimeSyncSendBeacon( void )
+{
+    uint8_t beacon[TIMESYNC_BEACON_SIZE];
+    uint64_t network;
+
+    BeaconStart = TimeSyncExtend( get_timestamp( ) ) + TxLatency;
+    network = BeaconStart / TIMESTAMP_TICKS_PER_US;
+
+    beacon[0] = TIMESYNC_BEACON_TYPE;
+    beacon[1] = BeaconSequence++;
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        beacon[2 + i] = ( uint8_t )( network >> ( 8 * i ) );
+    }
+    BeaconPending = 1;
+    SX126x_SendPayload( beacon, TIMESYNC_BEACON_SIZE, 0 );
+}
+
+void SX126x_TimeSyncOnTxDone( uint32_t timestamp )
+{
+    int64_t error;
+
+    if( BeaconPending == 0 )
+    {
+        return;
+    }
+    BeaconPending = 0;
+
+    error = ( int64_t )( TimeSyncExtend( timestamp ) - BeaconTimeOnAir - BeaconStart );
+    if( ( error > ( int64_t )TIMESYNC_MAX_ERROR_US * TIMESTAMP_TICKS_PER_US ) ||
+        ( error < -( int64_t )TIMESYNC_MAX_ERROR_US * TIMESTAMP_TICKS_PER_US ) )
+    {
+        // Not our beacon, or the time on air does not match the packet
+        return;
+    }
+    // Smooth the SPI and PLL lock jitter
+    TxLatency = ( uint32_t )( ( int64_t )TxLatency + error / 4 );
+}
+
+uint8_t SX126x_TimeSyncOnBeacon( uint8_t *payload, uint8_t size, uint32_t timestamp )
+{
+    uint64_t start;
+    uint64_t network = 0;
+    int64_t error;
+
+    if( ( size != TIMESYNC_BEACON_SIZE ) || ( payload[0] != TIMESYNC_BEACON_TYPE ) )
+    {
+        return 0;
+    }
+    if( Role != TIMESYNC_NODE )
+    {
+        return 1;
+    }
+
+    // The packet started one time on air before the RX done, counted by the
+    // local clock: 144 ms (SF9, 10 bytes) at 50 ppm are 7 us
+    start = TimeSyncExtend( timestamp ) - BeaconTimeOnAir + ( ( int64_t )BeaconTimeOnAir * FitDrift ) / TIMESYNC_PPB -
+            TIMESYNC_RX_LATENCY_US * TIMESTAMP_TICKS_PER_US;
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        network |= ( uint64_t )payload[2 + i] << ( 8 * i );
+    }
+    network *= TIMESTAMP_TICKS_PER_US;
+
+    if( SampleCount > 0 )
+    {
+        error = ( int64_t )( network - SX126x_TimeSyncLocalToNetwork( start ) );
+        if( ( error > ( int64_t )TIMESYNC_MAX_ERROR_US * TIMESTAMP_TICKS_PER_US ) ||
+            ( error < -( int64_t )TIMESYNC_MAX_ERROR_US * TIMESTAMP_TICKS_PER_US ) )
+        {
+            SampleCount = 0;
+            SampleNext = 0;
+        }
+    }
+
+    Samples[SampleNext].Local = start;
+    Samples[SampleNext].Offset = ( int64_t )( network - start );
+    SampleNext = ( SampleNext + 1 ) % TIMESYNC_WINDOW;
+    if( SampleCount < TIMESYNC_WINDOW )
+    {
+        SampleCount++;
+    }
+    TimeSyncFit( );
+
+    return 1;
+}
+
+TimeSyncStates_t SX126x_TimeSyncGetState( void )
+{
+    if( ( Role == TIMESYNC_COORDINATOR ) || ( SampleCount > 1 ) )
+    {
+        return TIMESYNC_SYNCED;
+    }
+    return ( SampleCount == 1 ) ? TIMESYNC_OFFSET_ONLY : TIMESYNC_UNSYNCED;
+}
+
+uint64_t SX126x_TimeSyncGetLocalTime( void )
+{
+    return TimeSyncExtend( get_timestamp( ) );
+}
+
+uint64_t SX126x_TimeSyncGetNetworkTime( void )
+{
+    return SX126x_TimeSyncLocalToNetwork( SX126x_TimeSyncGetLocalTime( ) );
+}
+
+uint64_t SX126x_TimeSyncLocalToNetwork( uint64_t local )
+{
+    uint64_t network;
+
+    if( Role == TIMESYNC_COORDINATOR )
+    {
+        return local;
+    }
+    CRITICAL_SECTION_ENTER()
+    network = local + FitOffset + ( ( int64_t )( local - FitReference ) * FitDrift ) / TIMESYNC_PPB;
+    CRITICAL_SECTION_LEAVE()
+
+    return network;
+}
+
+uint64_t SX126x_TimeSyncNetworkToLocal( uint64_t network )
+{
+    uint64_t local;
+
+    if( Role == TIMESYNC_COORDINATOR )
+    {
+        return network;
+    }
+    CRITICAL_SECTION_ENTER()
+    // The drift term is evaluated at the first guess, the error is drift squared
+    local = network - FitOffset;
+    local -= ( ( int64_t )( local - FitReference ) * FitDrift ) / TIMESYNC_PPB;
+    CRITICAL_SECTION_LEAVE()
+
+    return local;
+}
+
+int32_t SX126x_TimeSyncGetDriftPpb( void )
+{
+    return ( Role == TIMESYNC_COORDINATOR ) ? 0 : FitDrift;
+}
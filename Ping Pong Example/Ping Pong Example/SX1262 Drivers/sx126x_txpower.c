@@ -0,0 +1,137 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_txpower.h"
+
+/*!
+ * \brief Power control state of a peer
+ */
+typedef struct
+{
+    uint8_t       Used;
+    uint8_t       Address;
+    int8_t        Power;                            //!< [dBm]
+    uint32_t      LastUse;
+}TxPowerPeer_t;
+
+static TxPowerPeer_t Peers[TXPOWER_MAX_PEERS];
+
+static int8_t MinPower = -3;
+static int8_t MaxPower = 22;
+
+/*!
+ * \brief Power given to the last SetTxParams, INT8_MIN if none
+ */
+static int8_t AppliedPower = INT8_MIN;
+static RadioRampTimes_t AppliedRamp = RADIO_RAMP_10_US;
+
+static uint32_t UseCount = 0;
+
+
+static TxPowerPeer_t *TxPowerGetPeer( uint8_t address )
+{
+    TxPowerPeer_t *oldest = &Peers[0];
+
+    for( uint8_t i = 0; i < TXPOWER_MAX_PEERS; i++ )
+    {
+        if( ( Peers[i].Used == 1 ) && ( Peers[i].Address == address ) )
+        {
+            Peers[i].LastUse = ++UseCount;
+            return &Peers[i];
+        }
+        if( Peers[i].Used == 0 )
+        {
+            oldest = &Peers[i];
+        }
+        else if( ( oldest->Used == 1 ) && ( Peers[i].LastUse < oldest->LastUse ) )
+        {
+            oldest = &Peers[i];
+        }
+    }
+
+    // A new peer starts at the maximum, the acknowledgements bring it down
+    oldest->Used = 1;
+    oldest->Address = address;
+    oldest->Power = MaxPower;
+    oldest->LastUse = ++UseCount;
+    return oldest;
+}
+
+static void TxPowerSet( TxPowerPeer_t *peer, int16_t power )
+{
+    if( power > MaxPower )
+    {
+        power = MaxPower;
+    }
+    else if( power < MinPower )
+    {
+        power = MinPower;
+    }
+    peer->Power = ( int8_t )power;
+}
+
+void SX126x_TxPowerInit( int8_t minPower, int8_t maxPower )
+{
+    memset( Peers, 0, sizeof( Peers ) );
+    MinPower = minPower;
+    MaxPower = ( maxPower > minPower ) ? maxPower : minPower;
+    AppliedPower = INT8_MIN;
+    UseCount = 0;
+}
+
+void SX126x_TxPowerOnAck( uint8_t peer, int8_t snr, RadioLoRaSpreadingFactors_t sf )
+{
+    TxPowerPeer_t *p = TxPowerGetPeer( peer );
+    // Demodulator floor of the datasheet: -2.5 dB per SF step from -5 dB at SF6 [0.25 dB]
+    int16_t required = -10 * ( ( int16_t )sf - 4 );
+    int16_t error = ( 4 * ( int16_t )snr - required ) / 4 - TXPOWER_TARGET_MARGIN_DB;
+
+    if( error > TXPOWER_HYSTERESIS_DB )
+    {
+        TxPowerSet( p, p->Power - ( ( error > TXPOWER_MAX_STEP_DOWN_DB ) ? TXPOWER_MAX_STEP_DOWN_DB : error ) );
+    }
+    else if( error < -TXPOWER_HYSTERESIS_DB )
+    {
+        // Too close to the floor, all the way back up at once
+        TxPowerSet( p, p->Power - error );
+    }
+}
+
+void SX126x_TxPowerOnMiss( uint8_t peer )
+{
+    TxPowerPeer_t *p = TxPowerGetPeer( peer );
+
+    TxPowerSet( p, p->Power + TXPOWER_MISS_STEP_DB );
+}
+
+int8_t SX126x_TxPowerGet( uint8_t peer )
+{
+    return TxPowerGetPeer( peer )->Power;
+}
+
+void SX126x_TxPowerApply( uint8_t peer, RadioRampTimes_t rampTime )
+{
+    int8_t power = TxPowerGetPeer( peer )->Power;
+
+    if( ( power == AppliedPower ) && ( rampTime == AppliedRamp ) )
+    {
+        return;
+    }
+    SX126x_SetTxParams( power, rampTime );
+    AppliedPower = power;
+    AppliedRamp = rampTime;
+}
@@ -0,0 +1,85 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_TXPOWER_H__
+#define __SX126x_TXPOWER_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Peers tracked, the least recently used one is replaced
+ */
+#define TXPOWER_MAX_PEERS                           8
+
+/*!
+ * \brief SNR margin over the demodulator floor the peer should see, in dB,
+ *        and the error tolerated around it
+ */
+#define TXPOWER_TARGET_MARGIN_DB                    6
+#define TXPOWER_HYSTERESIS_DB                       2
+
+/*!
+ * \brief Largest decrease per acknowledgement and increase per missed
+ *        acknowledgement, in dB
+ */
+#define TXPOWER_MAX_STEP_DOWN_DB                    3
+#define TXPOWER_MISS_STEP_DB                        3
+
+/*!
+ * \brief Clears the peers, they start at the maximum power
+ *
+ * \param [in]  minPower      Lowest power used [dBm]
+ * \param [in]  maxPower      Highest power used [dBm]
+ */
+void SX126x_TxPowerInit( int8_t minPower, int8_t maxPower );
+
+/*!
+ * \brief Adjusts the power of a peer from the SNR it measured on our frame
+ *        and sent back in its acknowledgement
+ *
+ * \param [in]  peer          Address of the peer
+ * \param [in]  snr           SNR reported by the peer [dB]
+ * \param [in]  sf            Spreading factor of the frame
+ */
+void SX126x_TxPowerOnAck( uint8_t peer, int8_t snr, RadioLoRaSpreadingFactors_t sf );
+
+/*!
+ * \brief Raises the power of a peer after a missed acknowledgement
+ *
+ * \param [in]  peer          Address of the peer
+ */
+void SX126x_TxPowerOnMiss( uint8_t peer );
+
+/*!
+ * \brief Gets the power used with a peer
+ *
+ * \param [in]  peer          Address of the peer
+ *
+ * \retval      power         [dBm]
+ */
+int8_t SX126x_TxPowerGet( uint8_t peer );
+
+/*!
+ * \brief Sets the power of a peer before sending to it, SetTxParams is only
+ *        issued when the power differs from the previous call
+ *
+ * \param [in]  peer          Address of the peer
+ * \param [in]  rampTime      Ramp up time
+ */
+void SX126x_TxPowerApply( uint8_t peer, RadioRampTimes_t rampTime );
+
+#endif // __SX126x_TXPOWER_H__
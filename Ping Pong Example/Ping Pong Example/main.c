@@ -2,6 +2,7 @@
 
 #include "./SX1262 Drivers/sx126x_commands.h"
 #include "./SX1262 Drivers/sx126x_hal.h"
+#include "./SX1262 Drivers/sx126x_power.h"
 
 extern struct usart_sync_descriptor USART_0;
 struct io_descriptor *usart;
@@ -28,6 +29,7 @@ int main(void)
 	io_write(usart, welcome_USART, 13);
 
 	SX126x_Init();
+	SX126x_PowerInit();
 
 	// SET THIS FOR THE RX
 	set_rx(868000000, LORA_BW_500, LORA_SF7, LORA_CR_4_5, LORA_PACKET_VARIABLE_LENGTH, 0x20);
@@ -48,6 +50,11 @@ int main(void)
 	
 	//delay_ms(500);
 	
+	// Radio work deferred by the interrupts while the bus was free
+	SX126xHal_ProcessPending();
+
+	// Sleep until DIO1 or the next timer task
+	SX126x_PowerIdle();
 	}
 }
 
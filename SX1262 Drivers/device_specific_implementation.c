@@ -17,6 +17,10 @@ Author: Marco Giordano
 
 #include "device_specific_implementation.h"
 #include "sx126x_commands.h"
+#include "sx126x_hal.h"
+
+#include <hal_timer.h>
+#include <peripheral_clk_config.h>
 
 // Device-specific implementations
 // Sobstitute here the functions related to your specific microcontroller
@@ -24,6 +28,12 @@ Author: Marco Giordano
 extern struct spi_m_sync_descriptor SPI_0;
 struct io_descriptor *spi;
 extern struct io_descriptor *usart;
+extern struct timer_descriptor TIMER_0;
+
+#define TIMER_0_TICK_US CONF_TC7_TIMER_TICK
+#define TIMER_0_COUNTS_PER_US ( CONF_GCLK_TC7_FREQUENCY / CONF_TC7_PRESCALE / 1000000 )
+
+static void DIO1_Deferred(void);
 
 uint8_t read_pin(const uint8_t pin){
     return gpio_get_pin_level(pin);
@@ -63,18 +73,29 @@ int32_t ReadSpi(uint8_t *rx_data, uint8_t len){
     return spi_m_sync_transfer(&SPI_0, &temp);
 }
 
+int32_t TransferSpi(uint8_t *tx_data, uint8_t *rx_data, uint8_t len){
+    struct spi_xfer temp;
+
+    temp.txbuf = tx_data;
+    temp.rxbuf = rx_data;
+    temp.size  = len;
+    // Return number of bytes transferred or ERR_BUSY
+    return spi_m_sync_transfer(&SPI_0, &temp);
+}
+
 void IRQ_Init(void)
 {
+    SX126xHal_SetDeferredHandler(DIO1_REQUEST, DIO1_Deferred);
 	ext_irq_register(PIN_PC00, DIO1_IRQ);
     // Possibility to add DIO2 and DIO3 interrupts
+#if DIO1_CAPTURE
+    DIO1_CaptureInit();
+#endif
 }
 
-void DIO1_IRQ(void)
+// Radio work of DIO1, run from the main context by the HAL
+static void DIO1_Deferred(void)
 {
-	gpio_toggle_pin_level(LED);
-    // Clear the interrupt in the radio
-    //SX126x_ClearIrqStatus( IRQ_RADIO_ALL );
-    // Do something in the ISR
 	uint8_t tx_done_see[10] = "Received!\n";
 	io_write(usart, tx_done_see, 10);
 	
@@ -84,9 +105,185 @@ void DIO1_IRQ(void)
 	
 	io_write(usart, buffer_g, 4);
 	SX126x_ClearIrqStatus(2);
-	//delay_ms(10);
 	//SX126x_SendPayload((uint8_t *) "PONG", 4, 0); // Be careful timeout
-	//delay_ms(5);
 	SX126x_SetRx(0);
+}
+
+void DIO1_IRQ(void)
+{
+	gpio_toggle_pin_level(LED);
+    // Wakes up the tasks blocked in SX126xHal_WaitDio1
+    SX126xHal_OnDio1Irq();
+    // No SPI here, the main context may be in the middle of a transaction
+    SX126xHal_DeferFromIsr(DIO1_REQUEST);
+}
+
+void mcu_sleep(const uint8_t mode)
+{
+    sleep(mode);
+}
+
+static uint32_t tc7_read_count(void)
+{
+    hri_tc_write_CTRLB_CMD_bf(TC7, TC_CTRLBSET_CMD_READSYNC_Val);
+    while(hri_tc_read_CTRLB_CMD_bf(TC7)){}
+    return hri_tccount32_read_COUNT_reg(TC7);
+}
+
+uint32_t get_time_us(void)
+{
+    volatile uint32_t *time = &TIMER_0.time;
+    uint32_t base;
+    uint32_t ticks;
+    uint32_t count;
+
+    // Retry if the timer ticked while the counter was being read
+    do{
+        base = *time;
+        ticks = base;
+        count = tc7_read_count();
+        // A tick not served yet, in a critical section the counter restarts
+        // but the time base does not move: the tick is added here. Read again,
+        // the first count may be from before the overflow.
+        if(hri_tc_get_INTFLAG_OVF_bit(TC7)){
+            ticks++;
+            count = tc7_read_count();
+        }
+    }while(base != *time);
+
+    return ticks * TIMER_0_TICK_US + count / TIMER_0_COUNTS_PER_US;
+}
+
+uint32_t next_timer_task_us(void)
+{
+    // Tasks are sorted, the head of the list is the next one to expire
+    struct timer_task *next = (struct timer_task *)list_get_head(&TIMER_0.tasks);
+    if(next == NULL){
+        return NO_TIMER_TASK;
+    }
+    uint32_t elapsed = TIMER_0.time - next->time_label;
+    if(elapsed >= next->interval){
+        return 0;
+    }
+    return (next->interval - elapsed) * TIMER_0_TICK_US;
+}
 
-}
\ No newline at end of file
+void timer_task_start(struct timer_task *task, uint32_t ms, void (*cb)(const struct timer_task *const))
+{
+    uint32_t ticks = ms * 1000 / TIMER_0_TICK_US;
+
+    // Restarting a task still in the list, hal_timer asserts on a task not listed
+    timer_task_stop(task);
+    task->interval = (ticks == 0) ? 1 : ticks;
+    task->cb = cb;
+    task->mode = TIMER_TASK_ONE_SHOT;
+    timer_add_task(&TIMER_0, task);
+}
+
+void timer_task_stop(struct timer_task *task)
+{
+    // A one shot task leaves the list when it expires, the interrupt must not
+    // remove it in between
+    CRITICAL_SECTION_ENTER()
+    if(is_list_element(&TIMER_0.tasks, task)){
+        timer_remove_task(&TIMER_0, task);
+    }
+    CRITICAL_SECTION_LEAVE()
+}
+
+void DIO1_CaptureInit(void)
+{
+    // TC0 free running in 32 bits (TC1 as slave), TIMESTAMP_TICKS_PER_US
+    hri_mclk_set_APBAMASK_TC0_bit(MCLK);
+    hri_mclk_set_APBAMASK_TC1_bit(MCLK);
+    hri_gclk_write_PCHCTRL_reg(GCLK, TC0_GCLK_ID, CONF_GCLK_TC0_SRC | (1 << GCLK_PCHCTRL_CHEN_Pos));
+
+    hri_tc_write_CTRLA_reg(TC0, TC_CTRLA_SWRST);
+    hri_tc_wait_for_sync(TC0, TC_SYNCBUSY_SWRST);
+    // The event copies COUNT into CC0 and raises MC0
+    hri_tc_write_CTRLA_reg(TC0, TC_CTRLA_MODE_COUNT32 | TC_CTRLA_PRESCALER(TIMESTAMP_PRESCALER) | TC_CTRLA_CAPTEN0);
+    hri_tc_write_EVCTRL_reg(TC0, TC_EVCTRL_TCEI | TC_EVCTRL_EVACT_STAMP);
+    hri_tc_set_CTRLA_ENABLE_bit(TC0);
+    hri_tc_wait_for_sync(TC0, TC_SYNCBUSY_ENABLE);
+    // CC1 stays a compare channel, used by the slot timer
+    NVIC_ClearPendingIRQ(TC0_IRQn);
+    NVIC_EnableIRQ(TC0_IRQn);
+
+    // EXTINT0 (DIO1) -> EVSYS channel 0 -> TC0, no CPU involved
+    hri_mclk_set_APBBMASK_EVSYS_bit(MCLK);
+    hri_evsys_write_CHANNEL_reg(EVSYS, 0, EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_EIC_EXTINT_0) | EVSYS_CHANNEL_PATH_ASYNCHRONOUS);
+    hri_evsys_write_USER_reg(EVSYS, EVSYS_ID_USER_TC0_EVU, 0 + 1); // Channel number + 1
+
+    // EVCTRL is enable protected
+    hri_eic_clear_CTRLA_ENABLE_bit(EIC);
+    hri_eic_wait_for_sync(EIC, EIC_SYNCBUSY_ENABLE);
+    hri_eic_set_EVCTRL_EXTINTEO_bf(EIC, 1 << 0);
+    hri_eic_set_CTRLA_ENABLE_bit(EIC);
+    hri_eic_wait_for_sync(EIC, EIC_SYNCBUSY_ENABLE);
+}
+
+uint32_t get_timestamp(void)
+{
+#if DIO1_CAPTURE
+    hri_tc_write_CTRLB_CMD_bf(TC0, TC_CTRLBSET_CMD_READSYNC_Val);
+    while(hri_tc_read_CTRLB_CMD_bf(TC0)){}
+    return hri_tccount32_read_COUNT_reg(TC0);
+#else
+    return get_time_us();
+#endif
+}
+
+uint32_t DIO1_GetTimestamp(void)
+{
+#if DIO1_CAPTURE
+    // Reading CC0 clears MC0, a timestamp is given only once
+    if(hri_tc_get_INTFLAG_MC0_bit(TC0)){
+        return hri_tccount32_read_CC_reg(TC0, 0);
+    }
+#endif
+    return get_timestamp();
+}
+
+static void (*slot_timer_callback)(void) = NULL;
+
+static volatile bool slot_timer_late = false;
+
+bool slot_timer_start(uint32_t timestamp, void (*callback)(void))
+{
+#if DIO1_CAPTURE
+    slot_timer_callback = callback;
+    hri_tccount32_write_CC_reg(TC0, 1, timestamp);
+    hri_tc_clear_INTFLAG_MC1_bit(TC0);
+    hri_tc_set_INTEN_MC1_bit(TC0);
+    // The compare only matches on equality, a time already passed fires now
+    if((int32_t)(timestamp - get_timestamp()) <= 0){
+        slot_timer_late = true;
+        NVIC_SetPendingIRQ(TC0_IRQn);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void slot_timer_stop(void)
+{
+#if DIO1_CAPTURE
+    hri_tc_clear_INTEN_MC1_bit(TC0);
+    slot_timer_late = false;
+#endif
+}
+
+void TC0_Handler(void)
+{
+#if DIO1_CAPTURE
+    if(hri_tc_get_INTFLAG_MC1_bit(TC0) || slot_timer_late){
+        hri_tc_clear_INTEN_MC1_bit(TC0);
+        hri_tc_clear_INTFLAG_MC1_bit(TC0);
+        slot_timer_late = false;
+        if(slot_timer_callback != NULL){
+            slot_timer_callback();
+        }
+    }
+#endif
+}
@@ -0,0 +1,555 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_HPP__
+#define __SX126x_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * \brief Header-only C++17 layer over the radio commands.
+ *
+ * The radio is a template on two policies with static member functions, so
+ * every radio instance compiles to code specialized on its own pins with no
+ * function pointer or virtual call:
+ *
+ *     struct Bus                                // SPI, NSS included
+ *     {
+ *         static void Select( );
+ *         static void Deselect( );
+ *         // Full-duplex, tx nullptr clocks out zeros, rx nullptr drops the answer
+ *         static void Transfer( const uint8_t *tx, uint8_t *rx, std::size_t size );
+ *     };
+ *
+ *     struct Pins
+ *     {
+ *         static bool Busy( );
+ *         static void SetReset( bool level );
+ *         static void DelayMs( uint32_t ms );
+ *     };
+ *
+ * Defining SX126X_DEVICE_POLICIES before the include adds DeviceBus and
+ * DevicePins, built on the functions of device_specific_implementation.h.
+ */
+namespace sx126x
+{
+
+/*!
+ * \brief Radio constants, the same as the C driver
+ */
+constexpr uint32_t XtalFreq = 32000000;
+constexpr uint32_t FreqDiv = 33554432;
+
+/*!
+ * \brief Opcodes understood by the radio
+ */
+enum class Opcode : uint8_t
+{
+    GetStatus                       = 0xC0,
+    WriteRegister                   = 0x0D,
+    ReadRegister                    = 0x1D,
+    WriteBuffer                     = 0x0E,
+    ReadBuffer                      = 0x1E,
+    SetSleep                        = 0x84,
+    SetStandby                      = 0x80,
+    SetFs                           = 0xC1,
+    SetTx                           = 0x83,
+    SetRx                           = 0x82,
+    SetCad                          = 0xC5,
+    SetPacketType                   = 0x8A,
+    SetRfFrequency                  = 0x86,
+    SetTxParams                     = 0x8E,
+    SetBufferBaseAddress            = 0x8F,
+    SetPacketParams                 = 0x8C,
+    GetRxBufferStatus               = 0x13,
+    GetPacketStatus                 = 0x14,
+    SetDioIrqParams                 = 0x08,
+    GetIrqStatus                    = 0x12,
+    ClearIrqStatus                  = 0x02,
+    GetDeviceErrors                 = 0x17,
+};
+
+enum class StandbyMode : uint8_t
+{
+    Rc                              = 0x00,
+    Xosc                            = 0x01,
+};
+
+enum class PacketType : uint8_t
+{
+    Gfsk                            = 0x00,
+    LoRa                            = 0x01,
+};
+
+enum class RampTime : uint8_t
+{
+    Ramp10Us                        = 0x00,
+    Ramp20Us,
+    Ramp40Us,
+    Ramp80Us,
+    Ramp200Us,
+    Ramp800Us,
+    Ramp1700Us,
+    Ramp3400Us,
+};
+
+/*!
+ * \brief Chip modes reported in the status byte
+ */
+enum class ChipMode : uint8_t
+{
+    StandbyRc                       = 0x02,
+    StandbyXosc                     = 0x03,
+    Fs                              = 0x04,
+    Rx                              = 0x05,
+    Tx                              = 0x06,
+};
+
+/*!
+ * \brief Command outcomes reported in the status byte
+ */
+enum class CmdStatus : uint8_t
+{
+    DataAvailable                   = 0x02,
+    Timeout                         = 0x03,
+    ProcessingError                 = 0x04,
+    ExecFailure                     = 0x05,
+    TxDone                          = 0x06,
+};
+
+/*!
+ * \brief IRQ flags, combined with | and tested with &
+ */
+enum class Irq : uint16_t
+{
+    None                            = 0x0000,
+    TxDone                          = 0x0001,
+    RxDone                          = 0x0002,
+    PreambleDetected                = 0x0004,
+    SyncWordValid                   = 0x0008,
+    HeaderValid                     = 0x0010,
+    HeaderError                     = 0x0020,
+    CrcError                        = 0x0040,
+    CadDone                         = 0x0080,
+    CadActivityDetected             = 0x0100,
+    RxTxTimeout                     = 0x0200,
+    All                             = 0xFFFF,
+};
+
+constexpr Irq operator|( Irq a, Irq b )
+{
+    return static_cast< Irq >( static_cast< uint16_t >( a ) | static_cast< uint16_t >( b ) );
+}
+
+constexpr bool operator&( Irq a, Irq b )
+{
+    return ( static_cast< uint16_t >( a ) & static_cast< uint16_t >( b ) ) != 0;
+}
+
+/*!
+ * \brief Status byte, see RadioStatus_t
+ */
+struct Status
+{
+    uint8_t Value;
+
+    constexpr ChipMode Mode( ) const { return static_cast< ChipMode >( ( Value >> 4 ) & 0x07 ); }
+    constexpr CmdStatus Command( ) const { return static_cast< CmdStatus >( ( Value >> 1 ) & 0x07 ); }
+    constexpr bool Failed( ) const
+    {
+        return ( Command( ) == CmdStatus::Timeout ) || ( Command( ) == CmdStatus::ProcessingError ) ||
+               ( Command( ) == CmdStatus::ExecFailure );
+    }
+};
+
+/*!
+ * \brief View over contiguous bytes, the part of C++20 std::span used here
+ */
+template< typename T >
+class Span
+{
+public:
+    constexpr Span( ) : Ptr( nullptr ), Count( 0 ) { }
+    constexpr Span( T *data, std::size_t size ) : Ptr( data ), Count( size ) { }
+
+    template< std::size_t N >
+    constexpr Span( T ( &array )[N] ) : Ptr( array ), Count( N ) { }
+
+    template< typename U, std::size_t N >
+    constexpr Span( std::array< U, N > &array ) : Ptr( array.data( ) ), Count( N ) { }
+
+    template< typename U, std::size_t N >
+    constexpr Span( const std::array< U, N > &array ) : Ptr( array.data( ) ), Count( N ) { }
+
+    constexpr T *data( ) const { return Ptr; }
+    constexpr std::size_t size( ) const { return Count; }
+    constexpr T &operator[]( std::size_t i ) const { return Ptr[i]; }
+
+private:
+    T *Ptr;
+    std::size_t Count;
+};
+
+/*!
+ * \brief Frequency in Hz to the PLL step word, with the same integer rounding as
+ *        SX126x_GetFrequencyWord
+ */
+constexpr uint32_t FrequencyWord( uint32_t frequency )
+{
+    return static_cast< uint32_t >( static_cast< uint64_t >( frequency ) * FreqDiv / XtalFreq );
+}
+
+static_assert( FrequencyWord( 868000000 ) == 0x36400000, "frequency word" );
+
+/*!
+ * \brief Encodes a command frame, opcode then parameters, at compile time when
+ *        the parameters are constants
+ */
+template< typename... Args >
+constexpr std::array< uint8_t, sizeof...( Args ) + 1 > Encode( Opcode opcode, Args... args )
+{
+    return { { static_cast< uint8_t >( opcode ), static_cast< uint8_t >( args )... } };
+}
+
+/*!
+ * \brief Timeouts in steps of 15.625 us, 0 single mode, 0xFFFFFF continuous RX
+ */
+constexpr std::array< uint8_t, 4 > EncodeTimeout( Opcode opcode, uint32_t timeout )
+{
+    return Encode( opcode, timeout >> 16, timeout >> 8, timeout );
+}
+
+constexpr std::array< uint8_t, 5 > EncodeFrequency( uint32_t frequency )
+{
+    return Encode( Opcode::SetRfFrequency, FrequencyWord( frequency ) >> 24, FrequencyWord( frequency ) >> 16,
+                   FrequencyWord( frequency ) >> 8, FrequencyWord( frequency ) );
+}
+
+static_assert( EncodeFrequency( 868000000 )[1] == 0x36, "frequency frame" );
+
+/*!
+ * \brief One radio on its bus and pins
+ */
+template< typename Bus, typename Pins >
+class Radio
+{
+public:
+    /*!
+     * \brief Hard resets the radio, see SX126xHal_Reset
+     */
+    void Reset( )
+    {
+        Pins::DelayMs( 20 );
+        Pins::SetReset( false );
+        Pins::DelayMs( 50 );
+        Pins::SetReset( true );
+        Pins::DelayMs( 20 );
+        Fresh = false;
+    }
+
+    /*!
+     * \brief Wakes the radio from sleep with a GetStatus, without waiting for
+     *        BUSY before it
+     */
+    void Wakeup( )
+    {
+        static constexpr auto frame = Encode( Opcode::GetStatus, 0x00 );
+
+        Bus::Select( );
+        Bus::Transfer( frame.data( ), nullptr, frame.size( ) );
+        Bus::Deselect( );
+        WaitOnBusy( );
+        Fresh = false;
+    }
+
+    void WaitOnBusy( ) const
+    {
+        while( Pins::Busy( ) )
+        {
+        }
+    }
+
+    /*!
+     * \brief Sends an encoded command frame, keeping the status of its first
+     *        parameter byte
+     *
+     * \param [in]  frame         Opcode then parameters, from Encode
+     */
+    template< std::size_t N >
+    void WriteCommand( const std::array< uint8_t, N > &frame )
+    {
+        uint8_t rx[N];
+
+        WaitOnBusy( );
+        Bus::Select( );
+        Bus::Transfer( frame.data( ), rx, N );
+        Bus::Deselect( );
+        if constexpr( N > 1 )
+        {
+            Capture( rx[1], ChangesMode( static_cast< Opcode >( frame[0] ) ) );
+        }
+        else
+        {
+            // Nothing clocked after the opcode, the byte during it is RFU
+            Fresh = false;
+        }
+    }
+
+    /*!
+     * \brief Sends a read command and gets its answer
+     *
+     * \param [in]  opcode        Opcode of the command
+     * \param [out] answer        Bytes following the status
+     */
+    void ReadCommand( Opcode opcode, Span< uint8_t > answer )
+    {
+        const uint8_t header[2] = { static_cast< uint8_t >( opcode ), 0x00 };
+
+        Transaction( header, answer );
+    }
+
+    void WriteRegister( uint16_t address, Span< const uint8_t > data )
+    {
+        const uint8_t header[3] = { static_cast< uint8_t >( Opcode::WriteRegister ),
+                                    static_cast< uint8_t >( address >> 8 ), static_cast< uint8_t >( address ) };
+
+        Transaction( header, data );
+    }
+
+    void ReadRegister( uint16_t address, Span< uint8_t > data )
+    {
+        const uint8_t header[4] = { static_cast< uint8_t >( Opcode::ReadRegister ),
+                                    static_cast< uint8_t >( address >> 8 ), static_cast< uint8_t >( address ), 0x00 };
+
+        Transaction( header, data );
+    }
+
+    void WriteBuffer( uint8_t offset, Span< const uint8_t > data )
+    {
+        const uint8_t header[2] = { static_cast< uint8_t >( Opcode::WriteBuffer ), offset };
+
+        Transaction( header, data );
+    }
+
+    void ReadBuffer( uint8_t offset, Span< uint8_t > data )
+    {
+        const uint8_t header[3] = { static_cast< uint8_t >( Opcode::ReadBuffer ), offset, 0x00 };
+
+        Transaction( header, data );
+    }
+
+    void SetStandby( StandbyMode mode ) { WriteCommand( Encode( Opcode::SetStandby, mode ) ); }
+    void SetPacketType( PacketType type ) { WriteCommand( Encode( Opcode::SetPacketType, type ) ); }
+    void SetFs( ) { WriteCommand( Encode( Opcode::SetFs ) ); }
+    void SetCad( ) { WriteCommand( Encode( Opcode::SetCad ) ); }
+    void SetTx( uint32_t timeout ) { WriteCommand( EncodeTimeout( Opcode::SetTx, timeout ) ); }
+    void SetRx( uint32_t timeout ) { WriteCommand( EncodeTimeout( Opcode::SetRx, timeout ) ); }
+
+    /*!
+     * \brief Sets the RF frequency without image calibration, the word is
+     *        computed at compile time
+     */
+    template< uint32_t Frequency >
+    void SetRfFrequency( )
+    {
+        static constexpr auto frame = EncodeFrequency( Frequency );
+
+        WriteCommand( frame );
+    }
+
+    void SetRfFrequency( uint32_t frequency ) { WriteCommand( EncodeFrequency( frequency ) ); }
+
+    void SetTxParams( int8_t power, RampTime ramp ) { WriteCommand( Encode( Opcode::SetTxParams, power, ramp ) ); }
+
+    void SetBufferBaseAddress( uint8_t txBase, uint8_t rxBase )
+    {
+        WriteCommand( Encode( Opcode::SetBufferBaseAddress, txBase, rxBase ) );
+    }
+
+    /*!
+     * \brief Sets the LoRa packet parameters
+     *
+     * \param [in]  preamble      Preamble length in symbols
+     * \param [in]  implicitHeader true for a fixed length packet without header
+     * \param [in]  length        Payload length, the largest accepted in RX
+     * \param [in]  crc           true to add and check the payload CRC
+     * \param [in]  invertIq      true to invert the IQ signals
+     */
+    void SetLoRaPacketParams( uint16_t preamble, bool implicitHeader, uint8_t length, bool crc, bool invertIq )
+    {
+        WriteCommand( Encode( Opcode::SetPacketParams, preamble >> 8, preamble, implicitHeader, length, crc, invertIq ) );
+    }
+
+    void SetDioIrqParams( Irq irqMask, Irq dio1Mask, Irq dio2Mask = Irq::None, Irq dio3Mask = Irq::None )
+    {
+        WriteCommand( Encode( Opcode::SetDioIrqParams, U16( irqMask ) >> 8, U16( irqMask ),
+                              U16( dio1Mask ) >> 8, U16( dio1Mask ), U16( dio2Mask ) >> 8, U16( dio2Mask ),
+                              U16( dio3Mask ) >> 8, U16( dio3Mask ) ) );
+    }
+
+    Irq GetIrqStatus( )
+    {
+        uint8_t irq[2];
+
+        ReadCommand( Opcode::GetIrqStatus, irq );
+        return static_cast< Irq >( ( irq[0] << 8 ) | irq[1] );
+    }
+
+    void ClearIrqStatus( Irq irq ) { WriteCommand( Encode( Opcode::ClearIrqStatus, U16( irq ) >> 8, U16( irq ) ) ); }
+
+    /*!
+     * \brief Gets the payload length and start of the last packet received
+     */
+    void GetRxBufferStatus( uint8_t &length, uint8_t &start )
+    {
+        uint8_t answer[2];
+
+        ReadCommand( Opcode::GetRxBufferStatus, answer );
+        length = answer[0];
+        start = answer[1];
+    }
+
+    /*!
+     * \brief Gets the radio status, from the last transaction when its chip mode
+     *        is still current
+     */
+    Status GetStatus( )
+    {
+        if( !Fresh )
+        {
+            ReadCommand( Opcode::GetStatus, Span< uint8_t >( ) );
+        }
+        return Last;
+    }
+
+    /*!
+     * \brief Status captured by the last transaction, no SPI traffic
+     */
+    Status LastStatus( ) const { return Last; }
+
+private:
+    static constexpr uint16_t U16( Irq irq ) { return static_cast< uint16_t >( irq ); }
+
+    static constexpr bool ChangesMode( Opcode opcode )
+    {
+        return ( opcode == Opcode::SetSleep ) || ( opcode == Opcode::SetStandby ) || ( opcode == Opcode::SetFs ) ||
+               ( opcode == Opcode::SetTx ) || ( opcode == Opcode::SetRx ) || ( opcode == Opcode::SetCad );
+    }
+
+    void Capture( uint8_t status, bool changesMode )
+    {
+        Last.Value = status;
+        Fresh = !changesMode;
+    }
+
+    /*!
+     * \brief Header in full-duplex for the status, then the data in or out
+     */
+    template< std::size_t N >
+    void Transaction( const uint8_t ( &header )[N], Span< uint8_t > in )
+    {
+        uint8_t rx[N];
+
+        WaitOnBusy( );
+        Bus::Select( );
+        Bus::Transfer( header, rx, N );
+        Bus::Transfer( nullptr, in.data( ), in.size( ) );
+        Bus::Deselect( );
+        Capture( rx[1], false );
+    }
+
+    template< std::size_t N >
+    void Transaction( const uint8_t ( &header )[N], Span< const uint8_t > out )
+    {
+        uint8_t rx[N];
+
+        WaitOnBusy( );
+        Bus::Select( );
+        Bus::Transfer( header, rx, N );
+        Bus::Transfer( out.data( ), nullptr, out.size( ) );
+        Bus::Deselect( );
+        Capture( rx[1], false );
+    }
+
+    Status Last = { 0 };
+    bool Fresh = false;
+};
+
+} // namespace sx126x
+
+#if defined( SX126X_DEVICE_POLICIES )
+
+extern "C"
+{
+#include "device_specific_implementation.h"
+}
+
+namespace sx126x
+{
+
+/*!
+ * \brief Bus policy on the SPI functions of the device specific implementation,
+ *        NSS on the given pin
+ */
+template< uint8_t Nss >
+struct DeviceBus
+{
+    static void Select( ) { write_pin( Nss, false ); }
+    static void Deselect( ) { write_pin( Nss, true ); }
+
+    static void Transfer( const uint8_t *tx, uint8_t *rx, std::size_t size )
+    {
+        // The device functions move at most 255 bytes at a time
+        while( size > 0 )
+        {
+            uint8_t chunk = ( size > 255 ) ? 255 : static_cast< uint8_t >( size );
+
+            if( tx == nullptr )
+            {
+                ReadSpi( rx, chunk );
+            }
+            else if( rx == nullptr )
+            {
+                SendSpi( const_cast< uint8_t * >( tx ), chunk );
+            }
+            else
+            {
+                TransferSpi( const_cast< uint8_t * >( tx ), rx, chunk );
+            }
+            tx = ( tx == nullptr ) ? nullptr : tx + chunk;
+            rx = ( rx == nullptr ) ? nullptr : rx + chunk;
+            size -= chunk;
+        }
+    }
+};
+
+/*!
+ * \brief Pin policy on the GPIO functions of the device specific implementation
+ */
+template< uint8_t BusyPin, uint8_t ResetPin >
+struct DevicePins
+{
+    static bool Busy( ) { return read_pin( BusyPin ) != 0; }
+    static void SetReset( bool level ) { write_pin( ResetPin, level ); }
+    static void DelayMs( uint32_t ms ) { wait_ms( ms ); }
+};
+
+} // namespace sx126x
+
+#endif // SX126X_DEVICE_POLICIES
+
+#endif // __SX126x_HPP__
@@ -0,0 +1,272 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_adr.h"
+
+#define ADR_NONE                                    0xFF
+
+/*!
+ * \brief Data rates, slowest first. RequiredSnr is the demodulator floor of
+ *        the datasheet, about 1 dB lower with the 4/8 coding rate.
+ */
+static const AdrDataRate_t DataRates[ADR_DATA_RATES] =
+{
+    { LORA_SF12, LORA_BW_125, LORA_CR_4_8, -84, 0 },
+    { LORA_SF12, LORA_BW_125, LORA_CR_4_5, -80, 0 },
+    { LORA_SF11, LORA_BW_125, LORA_CR_4_5, -70, 0 },
+    { LORA_SF10, LORA_BW_125, LORA_CR_4_5, -60, 0 },
+    { LORA_SF9,  LORA_BW_125, LORA_CR_4_5, -50, 0 },
+    { LORA_SF8,  LORA_BW_125, LORA_CR_4_5, -40, 0 },
+    { LORA_SF7,  LORA_BW_125, LORA_CR_4_5, -30, 0 },
+    { LORA_SF7,  LORA_BW_250, LORA_CR_4_5, -30, 12 },
+    { LORA_SF7,  LORA_BW_500, LORA_CR_4_5, -30, 24 },
+};
+
+/*!
+ * \brief Link state with a peer
+ */
+typedef struct
+{
+    uint8_t       Used;
+    uint8_t       Address;
+    uint8_t       Rate;                             //!< Index in DataRates
+    uint8_t       Requested;                        //!< Rate asked to the peer, ADR_NONE if none
+    uint8_t       Token;                            //!< Of the last request
+    uint8_t       Switch;                           //!< Rate to use once the answer is sent
+    uint8_t       Misses;
+    uint8_t       Samples;
+    uint8_t       Head;
+    int8_t        Snr[ADR_HISTORY];                 //!< [0.25 dB]
+    uint32_t      LastUse;
+}AdrPeer_t;
+
+static AdrPeer_t Peers[ADR_MAX_PEERS];
+
+static uint8_t DefaultRate = 0;
+
+static uint32_t UseCount = 0;
+
+
+static AdrPeer_t *AdrGetPeer( uint8_t address )
+{
+    AdrPeer_t *oldest = &Peers[0];
+
+    for( uint8_t i = 0; i < ADR_MAX_PEERS; i++ )
+    {
+        if( ( Peers[i].Used == 1 ) && ( Peers[i].Address == address ) )
+        {
+            Peers[i].LastUse = ++UseCount;
+            return &Peers[i];
+        }
+        if( Peers[i].Used == 0 )
+        {
+            oldest = &Peers[i];
+        }
+        else if( ( oldest->Used == 1 ) && ( Peers[i].LastUse < oldest->LastUse ) )
+        {
+            oldest = &Peers[i];
+        }
+    }
+
+    memset( oldest, 0, sizeof( AdrPeer_t ) );
+    oldest->Used = 1;
+    oldest->Address = address;
+    oldest->Rate = DefaultRate;
+    oldest->Requested = ADR_NONE;
+    oldest->Switch = ADR_NONE;
+    oldest->LastUse = ++UseCount;
+    return oldest;
+}
+
+static void AdrSetRate( AdrPeer_t *peer, uint8_t rate )
+{
+    // The history was measured with another spreading factor, start over
+    peer->Rate = rate;
+    peer->Samples = 0;
+    peer->Head = 0;
+    peer->Misses = 0;
+}
+
+/*!
+ * \brief Checks the SNR margin of a rate against the history of a peer
+ *
+ * \param [in]  extra         Margin over ADR_MARGIN_DB [0.25 dB]
+ */
+static uint8_t AdrRateFits( AdrPeer_t *peer, uint8_t rate, int16_t extra )
+{
+    int16_t sum = 0;
+    int16_t snr;
+
+    for( uint8_t i = 0; i < peer->Samples; i++ )
+    {
+        sum += peer->Snr[i];
+    }
+    // A wider bandwidth lets in more noise
+    snr = sum / peer->Samples - ( DataRates[rate].NoiseOffset - DataRates[peer->Rate].NoiseOffset );
+
+    return snr >= ( DataRates[rate].RequiredSnr + 4 * ADR_MARGIN_DB + extra );
+}
+
+void SX126x_AdrInit( uint8_t defaultRate )
+{
+    memset( Peers, 0, sizeof( Peers ) );
+    DefaultRate = ( defaultRate < ADR_DATA_RATES ) ? defaultRate : 0;
+    UseCount = 0;
+}
+
+const AdrDataRate_t *SX126x_AdrGetDataRate( uint8_t rate )
+{
+    return ( rate < ADR_DATA_RATES ) ? &DataRates[rate] : NULL;
+}
+
+void SX126x_AdrOnPacket( uint8_t peer, PacketStatus_t *pktStatus )
+{
+    AdrPeer_t *p = AdrGetPeer( peer );
+
+    p->Misses = 0;
+    if( pktStatus->packetType != PACKET_TYPE_LORA )
+    {
+        return;
+    }
+    p->Snr[p->Head] = 4 * pktStatus->Params.LoRa.SnrPkt;
+    p->Head = ( p->Head + 1 ) % ADR_HISTORY;
+    if( p->Samples < ADR_HISTORY )
+    {
+        p->Samples++;
+    }
+}
+
+void SX126x_AdrOnMiss( uint8_t peer )
+{
+    AdrPeer_t *p = AdrGetPeer( peer );
+
+    if( ++p->Misses >= ADR_MAX_MISSES )
+    {
+        // The link is lost at this rate, both ends meet again at the default
+        AdrSetRate( p, DefaultRate );
+        p->Requested = ADR_NONE;
+        p->Switch = ADR_NONE;
+    }
+}
+
+uint8_t SX126x_AdrGetRate( uint8_t peer )
+{
+    return AdrGetPeer( peer )->Rate;
+}
+
+uint8_t SX126x_AdrSelect( uint8_t peer )
+{
+    AdrPeer_t *p = AdrGetPeer( peer );
+
+    if( p->Samples == 0 )
+    {
+        return p->Rate;
+    }
+    for( uint8_t rate = ADR_DATA_RATES - 1; rate > 0; rate-- )
+    {
+        if( rate > p->Rate )
+        {
+            // Faster only on a full history and with some hysteresis
+            if( ( p->Samples == ADR_HISTORY ) && AdrRateFits( p, rate, 4 * ADR_HYSTERESIS_DB ) )
+            {
+                return rate;
+            }
+        }
+        else if( AdrRateFits( p, rate, 0 ) )
+        {
+            return rate;
+        }
+    }
+    return 0;
+}
+
+uint8_t SX126x_AdrBuildRequest( uint8_t peer, uint8_t *buffer )
+{
+    AdrPeer_t *p = AdrGetPeer( peer );
+    uint8_t rate = SX126x_AdrSelect( peer );
+
+    if( rate == p->Rate )
+    {
+        p->Requested = ADR_NONE;
+        return 0;
+    }
+    p->Requested = rate;
+    p->Token++;
+
+    buffer[0] = ADR_TYPE_REQUEST;
+    buffer[1] = rate;
+    buffer[2] = p->Token;
+    return ADR_REQUEST_SIZE;
+}
+
+uint8_t SX126x_AdrOnFrame( uint8_t peer, uint8_t *payload, uint8_t size, uint8_t *answer )
+{
+    AdrPeer_t *p = AdrGetPeer( peer );
+
+    if( ( size >= ADR_REQUEST_SIZE ) && ( payload[0] == ADR_TYPE_REQUEST ) )
+    {
+        uint8_t rate = payload[1];
+        uint8_t refused = ( rate >= ADR_DATA_RATES );
+
+        // Faster only if the packets of the peer allow it here too
+        if( ( refused == 0 ) && ( rate > p->Rate ) && ( p->Samples > 0 ) && !AdrRateFits( p, rate, 0 ) )
+        {
+            refused = 1;
+        }
+        p->Switch = refused ? ADR_NONE : rate;
+
+        answer[0] = ADR_TYPE_ANSWER;
+        answer[1] = rate;
+        answer[2] = payload[2];
+        answer[3] = refused;
+        return ADR_ANSWER_SIZE;
+    }
+    if( ( size >= ADR_ANSWER_SIZE ) && ( payload[0] == ADR_TYPE_ANSWER ) )
+    {
+        if( ( p->Requested != ADR_NONE ) && ( payload[1] == p->Requested ) && ( payload[2] == p->Token ) && ( payload[3] == 0 ) )
+        {
+            AdrSetRate( p, p->Requested );
+        }
+        p->Requested = ADR_NONE;
+    }
+    return 0;
+}
+
+void SX126x_AdrOnAnswerSent( uint8_t peer )
+{
+    AdrPeer_t *p = AdrGetPeer( peer );
+
+    if( p->Switch != ADR_NONE )
+    {
+        AdrSetRate( p, p->Switch );
+        p->Switch = ADR_NONE;
+    }
+}
+
+void SX126x_AdrApply( uint8_t peer )
+{
+    const AdrDataRate_t *rate = &DataRates[AdrGetPeer( peer )->Rate];
+    ModulationParams_t modParams;
+
+    memset( &modParams, 0, sizeof( modParams ) );
+    modParams.PacketType = PACKET_TYPE_LORA;
+    modParams.Params.LoRa.SpreadingFactor = rate->SpreadingFactor;
+    modParams.Params.LoRa.Bandwidth = rate->Bandwidth;
+    modParams.Params.LoRa.CodingRate = rate->CodingRate;
+    // LowDatarateOptimize is set by SX126x_SetModulationParams
+    SX126x_SetModulationParams( &modParams );
+}
@@ -0,0 +1,490 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_arq.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+typedef enum
+{
+    ARQ_FRAME_FREE                          = 0x00,
+    ARQ_FRAME_PENDING,                              //!< To be sent, new or lost
+    ARQ_FRAME_SENT,                                 //!< Waiting for its acknowledgement
+    ARQ_FRAME_ACKED,
+}ArqFrameStates_t;
+
+typedef enum
+{
+    ARQ_IDLE                                = 0x00,
+    ARQ_LISTEN,                                     //!< Continuous RX, can be interrupted to send
+    ARQ_TX_DATA,
+    ARQ_TX_SACK,
+    ARQ_WAIT_SACK,
+}ArqStates_t;
+
+/*!
+ * \brief A frame of the window, staged with its header
+ */
+typedef struct
+{
+    ArqFrameStates_t  State;
+    uint8_t           Size;                         //!< Header included
+    uint8_t           Retries;
+    uint8_t           Covered;                      //!< An acknowledgement request was sent since
+    uint32_t          SentAt;                       //!< Time of that request [us]
+    uint8_t           Data[ARQ_HEADER_SIZE + ARQ_MAX_PAYLOAD];
+}ArqFrame_t;
+
+static PacketParams_t PacketParams;
+
+static ArqStates_t State = ARQ_IDLE;
+
+static ArqStats_t Stats;
+
+/*!
+ * \brief Sender: frames TxBase .. TxNext - 1 are in the window
+ */
+static ArqFrame_t TxWindow[ARQ_WINDOW];
+static uint8_t TxBase = 0;
+static uint8_t TxNext = 0;
+static uint8_t TxCurrent = 0;                       // Frame on air
+static uint8_t SinceAckRequest = 0;
+
+/*!
+ * \brief Round trip measure on the frame asking for the acknowledgement
+ */
+static uint8_t RttPending = 0;
+static uint32_t RttStart = 0;
+static uint32_t Rttvar = 0;
+static uint32_t BackoffStamp = 0;
+
+static uint32_t DataTimeOnAir = 0;                  // Largest data frame [us]
+static uint32_t SackTimeOnAir = 0;                  // [us]
+
+/*!
+ * \brief Receiver: RxRead is the next frame for the application, RxBase the
+ *        next one missing
+ */
+static ArqFrame_t RxWindow[ARQ_WINDOW];
+static uint8_t RxRead = 0;
+static uint8_t RxBase = 0;
+static uint8_t SackPending = 0;
+
+
+static void ArqSetLength( uint8_t size )
+{
+    // SetPacketParams converts the GFSK lengths in place, work on a copy
+    PacketParams_t params = PacketParams;
+
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        params.Params.LoRa.PayloadLength = size;
+    }
+    else
+    {
+        params.Params.Gfsk.PayloadLength = size;
+    }
+    SX126x_SetPacketParams( &params );
+}
+
+static uint8_t ArqInWindow( uint8_t sequence, uint8_t base )
+{
+    return ( uint8_t )( sequence - base ) < ARQ_WINDOW;
+}
+
+/*!
+ * \brief Next frame to send: lost or timed out first, then the new ones
+ *
+ * \retval      sequence      TxNext if there is none
+ */
+static uint8_t ArqNextFrame( uint32_t now, uint8_t after )
+{
+    for( uint8_t seq = after; seq != TxNext; seq++ )
+    {
+        ArqFrame_t *frame = &TxWindow[seq % ARQ_WINDOW];
+
+        if( ( frame->State == ARQ_FRAME_PENDING ) ||
+            ( ( frame->State == ARQ_FRAME_SENT ) && ( frame->Covered == 1 ) && ( ( now - frame->SentAt ) > Stats.Rto ) ) )
+        {
+            return seq;
+        }
+    }
+    return TxNext;
+}
+
+static void ArqUpdateRto( uint32_t sample )
+{
+    // RFC 6298, plus the time on air of the frame the timer starts with
+    if( Stats.Srtt == 0 )
+    {
+        Stats.Srtt = sample;
+        Rttvar = sample / 2;
+    }
+    else
+    {
+        uint32_t delta = ( sample > Stats.Srtt ) ? sample - Stats.Srtt : Stats.Srtt - sample;
+
+        Rttvar = ( 3 * Rttvar + delta ) / 4;
+        Stats.Srtt = ( 7 * Stats.Srtt + sample ) / 8;
+    }
+    Stats.Rto = Stats.Srtt + 4 * Rttvar + DataTimeOnAir;
+    if( Stats.Rto < ARQ_MIN_RTO_US )
+    {
+        Stats.Rto = ARQ_MIN_RTO_US;
+    }
+    if( Stats.Rto > ARQ_MAX_RTO_US )
+    {
+        Stats.Rto = ARQ_MAX_RTO_US;
+    }
+}
+
+/*!
+ * \brief Frees the acknowledged frames at the start of the window
+ */
+static void ArqSlide( void )
+{
+    while( ( TxBase != TxNext ) && ( TxWindow[TxBase % ARQ_WINDOW].State == ARQ_FRAME_ACKED ) )
+    {
+        TxWindow[TxBase % ARQ_WINDOW].State = ARQ_FRAME_FREE;
+        TxBase++;
+    }
+}
+
+static void ArqSendSack( void )
+{
+    uint8_t sack[ARQ_SACK_SIZE];
+    uint32_t map = 0;
+
+    for( uint8_t i = 0; i < 32; i++ )
+    {
+        uint8_t seq = RxBase + 1 + i;
+
+        if( ArqInWindow( seq, RxRead ) && ( RxWindow[seq % ARQ_WINDOW].State == ARQ_FRAME_ACKED ) )
+        {
+            map |= ( 1UL << i );
+        }
+    }
+    sack[0] = ARQ_TYPE_SACK;
+    sack[1] = RxBase;
+    sack[2] = ( uint8_t )map;
+    sack[3] = ( uint8_t )( map >> 8 );
+    sack[4] = ( uint8_t )( map >> 16 );
+    sack[5] = ( uint8_t )( map >> 24 );
+
+    SackPending = 0;
+    State = ARQ_TX_SACK;
+    // The length and the frame it belongs to, no other task in between
+    SX126xHal_Lock( );
+    ArqSetLength( ARQ_SACK_SIZE );
+    SX126x_SendPayload( sack, ARQ_SACK_SIZE, 0 );
+    SX126xHal_Unlock( );
+}
+
+static void ArqOnSack( uint8_t *payload )
+{
+    uint8_t next = payload[1];
+    uint32_t map = payload[2] | ( ( uint32_t )payload[3] << 8 ) | ( ( uint32_t )payload[4] << 16 ) | ( ( uint32_t )payload[5] << 24 );
+    uint8_t highest = next;
+
+    if( ( uint8_t )( next - TxBase ) > ( uint8_t )( TxNext - TxBase ) )
+    {
+        // Older than the last one
+        return;
+    }
+    if( RttPending == 1 )
+    {
+        // SACKs only answer requests, this one answers the last request
+        ArqUpdateRto( get_time_us( ) - RttStart );
+        RttPending = 0;
+    }
+
+    for( uint8_t seq = TxBase; seq != TxNext; seq++ )
+    {
+        ArqFrame_t *frame = &TxWindow[seq % ARQ_WINDOW];
+        uint8_t ahead = seq - next - 1;
+
+        if( ( uint8_t )( seq - TxBase ) < ( uint8_t )( next - TxBase ) )
+        {
+            frame->State = ARQ_FRAME_ACKED;
+        }
+        else if( ( seq != next ) && ( ahead < 32 ) && ( map & ( 1UL << ahead ) ) )
+        {
+            frame->State = ARQ_FRAME_ACKED;
+            highest = seq;
+        }
+    }
+    // Sent before a frame the receiver has got and not acknowledged: lost
+    for( uint8_t seq = next; seq != highest; seq++ )
+    {
+        ArqFrame_t *frame = &TxWindow[seq % ARQ_WINDOW];
+
+        if( frame->State == ARQ_FRAME_SENT )
+        {
+            frame->State = ARQ_FRAME_PENDING;
+        }
+    }
+    ArqSlide( );
+}
+
+static void ArqOnData( uint8_t *payload, uint8_t size )
+{
+    uint8_t seq = payload[1];
+    uint8_t base = payload[2];
+    ArqFrame_t *frame = &RxWindow[seq % ARQ_WINDOW];
+
+    if( ( payload[0] & ARQ_FLAG_ACK_REQUEST ) != 0 )
+    {
+        SackPending = 1;
+    }
+    // The sender gave up the frames before its base, stop waiting for them
+    while( ( RxBase != base ) && ( ( uint8_t )( base - RxBase ) < 128 ) && ( RxBase != ( uint8_t )( RxRead + ARQ_WINDOW ) ) )
+    {
+        if( RxWindow[RxBase % ARQ_WINDOW].State != ARQ_FRAME_ACKED )
+        {
+            RxWindow[RxBase % ARQ_WINDOW].State = ARQ_FRAME_ACKED;
+            RxWindow[RxBase % ARQ_WINDOW].Size = 0;
+        }
+        RxBase++;
+    }
+    // Outside the window: already delivered, or too far ahead
+    if( ( ArqInWindow( seq, RxRead ) == 0 ) || ( ( uint8_t )( seq - RxRead ) < ( uint8_t )( RxBase - RxRead ) ) )
+    {
+        return;
+    }
+    if( frame->State != ARQ_FRAME_ACKED )
+    {
+        frame->State = ARQ_FRAME_ACKED;
+        frame->Size = size - ARQ_HEADER_SIZE;
+        memcpy( frame->Data, payload + ARQ_HEADER_SIZE, frame->Size );
+    }
+    while( ( RxBase != ( uint8_t )( RxRead + ARQ_WINDOW ) ) && ( RxWindow[RxBase % ARQ_WINDOW].State == ARQ_FRAME_ACKED ) )
+    {
+        RxBase++;
+    }
+}
+
+void SX126x_ArqInit( ModulationParams_t *modParams, PacketParams_t *packetParams )
+{
+    PacketParams_t params = *packetParams;
+
+    PacketParams = *packetParams;
+    memset( &Stats, 0, sizeof( Stats ) );
+    memset( TxWindow, 0, sizeof( TxWindow ) );
+    memset( RxWindow, 0, sizeof( RxWindow ) );
+    TxBase = TxNext = 0;
+    RxRead = RxBase = 0;
+    SinceAckRequest = 0;
+    SackPending = 0;
+    RttPending = 0;
+    Rttvar = 0;
+    State = ARQ_IDLE;
+
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        params.Params.LoRa.PayloadLength = ARQ_HEADER_SIZE + ARQ_MAX_PAYLOAD;
+        DataTimeOnAir = SX126x_GetTimeOnAir( modParams, &params );
+        params.Params.LoRa.PayloadLength = ARQ_SACK_SIZE;
+    }
+    else
+    {
+        params.Params.Gfsk.PayloadLength = ARQ_HEADER_SIZE + ARQ_MAX_PAYLOAD;
+        DataTimeOnAir = SX126x_GetTimeOnAir( modParams, &params );
+        params.Params.Gfsk.PayloadLength = ARQ_SACK_SIZE;
+    }
+    SackTimeOnAir = SX126x_GetTimeOnAir( modParams, &params );
+    // No sample yet: a frame, its SACK and the receiver turnaround, twice
+    Stats.Rto = 2 * ( DataTimeOnAir + SackTimeOnAir + ARQ_ACK_DELAY_US );
+}
+
+uint8_t SX126x_ArqSend( uint8_t *payload, uint8_t size )
+{
+    ArqFrame_t *frame = &TxWindow[TxNext % ARQ_WINDOW];
+
+    if( ( ( uint8_t )( TxNext - TxBase ) >= ARQ_WINDOW ) || ( size == 0 ) || ( size > ARQ_MAX_PAYLOAD ) )
+    {
+        return 1;
+    }
+    frame->Data[0] = ARQ_TYPE_DATA;
+    frame->Data[1] = TxNext;
+    frame->Data[2] = TxBase;
+    memcpy( &frame->Data[ARQ_HEADER_SIZE], payload, size );
+    frame->Size = ARQ_HEADER_SIZE + size;
+    frame->Retries = 0;
+    frame->State = ARQ_FRAME_PENDING;
+    TxNext++;
+    return 0;
+}
+
+uint8_t SX126x_ArqReceive( uint8_t *buffer, uint8_t maxSize )
+{
+    ArqFrame_t *frame = &RxWindow[RxRead % ARQ_WINDOW];
+    uint8_t size;
+
+    // Skip the frames given up by the sender
+    while( ( RxRead != RxBase ) && ( frame->Size == 0 ) )
+    {
+        frame->State = ARQ_FRAME_FREE;
+        RxRead++;
+        frame = &RxWindow[RxRead % ARQ_WINDOW];
+    }
+    if( ( RxRead == RxBase ) || ( frame->Size > maxSize ) )
+    {
+        return 0;
+    }
+    size = frame->Size;
+    memcpy( buffer, frame->Data, size );
+    frame->State = ARQ_FRAME_FREE;
+    RxRead++;
+    Stats.Delivered++;
+    return size;
+}
+
+void SX126x_ArqProcess( void )
+{
+    uint32_t now = get_time_us( );
+    uint8_t seq;
+    ArqFrame_t *frame;
+
+    if( ( State != ARQ_IDLE ) && ( State != ARQ_LISTEN ) )
+    {
+        return;
+    }
+    if( SackPending == 1 )
+    {
+        ArqSendSack( );
+        return;
+    }
+
+    seq = ArqNextFrame( now, TxBase );
+    if( seq == TxNext )
+    {
+        if( State == ARQ_IDLE )
+        {
+            State = ARQ_LISTEN;
+            SX126x_SetRx( 0xFFFFFF );
+        }
+        return;
+    }
+
+    frame = &TxWindow[seq % ARQ_WINDOW];
+    if( frame->Retries >= ARQ_MAX_RETRIES )
+    {
+        // Given up, the next frames carry the new base to the receiver
+        frame->State = ARQ_FRAME_ACKED;
+        Stats.Dropped++;
+        ArqSlide( );
+        return;
+    }
+    if( frame->Retries > 0 )
+    {
+        Stats.Retransmitted++;
+    }
+    if( ( frame->State == ARQ_FRAME_SENT ) && ( frame->SentAt != BackoffStamp ) )
+    {
+        // Timed out, not reported lost by a SACK: back off once for all the
+        // frames of the same request
+        BackoffStamp = frame->SentAt;
+        Stats.Rto = ( Stats.Rto > ARQ_MAX_RTO_US / 2 ) ? ARQ_MAX_RTO_US : 2 * Stats.Rto;
+    }
+
+    // Ask for a SACK at the end of a burst, or every ARQ_ACK_EVERY frames
+    frame->Data[0] = ARQ_TYPE_DATA;
+    SinceAckRequest++;
+    if( ( SinceAckRequest >= ARQ_ACK_EVERY ) || ( ArqNextFrame( now, seq + 1 ) == TxNext ) )
+    {
+        frame->Data[0] |= ARQ_FLAG_ACK_REQUEST;
+        SinceAckRequest = 0;
+        // The frames in flight are acknowledged by the SACK of this one,
+        // their timers start with it
+        for( uint8_t i = TxBase; i != TxNext; i++ )
+        {
+            if( TxWindow[i % ARQ_WINDOW].State == ARQ_FRAME_SENT )
+            {
+                TxWindow[i % ARQ_WINDOW].Covered = 1;
+                TxWindow[i % ARQ_WINDOW].SentAt = now;
+            }
+        }
+        frame->Covered = 1;
+        frame->SentAt = now;
+        // Karn: a retransmitted frame gives no sample
+        RttPending = ( frame->Retries == 0 ) ? 1 : 0;
+        RttStart = now;
+    }
+    else
+    {
+        frame->Covered = 0;
+    }
+
+    // Straight from the staged frame, only the base is updated
+    frame->Data[2] = TxBase;
+    TxCurrent = seq;
+    frame->State = ARQ_FRAME_SENT;
+    frame->Retries++;
+    Stats.Sent++;
+    State = ARQ_TX_DATA;
+    // The length and the frame it belongs to, no other task in between
+    SX126xHal_Lock( );
+    ArqSetLength( frame->Size );
+    SX126x_SendPayload( frame->Data, frame->Size, 0 );
+    SX126xHal_Unlock( );
+}
+
+void SX126x_ArqOnTxDone( void )
+{
+    if( ( State == ARQ_TX_DATA ) && ( TxWindow[TxCurrent % ARQ_WINDOW].Data[0] & ARQ_FLAG_ACK_REQUEST ) )
+    {
+        // Listen for the SACK: the receiver turnaround and the SACK on air
+        State = ARQ_WAIT_SACK;
+        SX126x_SetRx( ( ( SackTimeOnAir + 2 * ARQ_ACK_DELAY_US ) * 64 ) / 1000 );
+        return;
+    }
+    State = ARQ_IDLE;
+}
+
+void SX126x_ArqOnRxDone( uint8_t *payload, uint8_t size )
+{
+    if( ( size == ARQ_SACK_SIZE ) && ( payload[0] == ARQ_TYPE_SACK ) )
+    {
+        ArqOnSack( payload );
+    }
+    // An empty data frame would read as given up, a longer one overruns the window
+    else if( ( size > ARQ_HEADER_SIZE ) && ( size <= ARQ_HEADER_SIZE + ARQ_MAX_PAYLOAD ) &&
+             ( ( payload[0] & ~ARQ_FLAG_ACK_REQUEST ) == ARQ_TYPE_DATA ) )
+    {
+        ArqOnData( payload, size );
+    }
+    // A continuous reception goes on
+    if( State != ARQ_LISTEN )
+    {
+        State = ARQ_IDLE;
+    }
+}
+
+void SX126x_ArqOnTimeout( void )
+{
+    if( State == ARQ_WAIT_SACK )
+    {
+        // The request or its SACK is lost, the round trip is unknown
+        RttPending = 0;
+    }
+    State = ARQ_IDLE;
+}
+
+void SX126x_ArqGetStats( ArqStats_t *stats )
+{
+    memcpy( stats, &Stats, sizeof( Stats ) );
+}
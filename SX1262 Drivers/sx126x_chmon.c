@@ -0,0 +1,201 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_chmon.h"
+#include "sx126x_sweep.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+static uint32_t Words[CHMON_MAX_CHANNELS];
+static uint8_t Count = 0;
+static uint8_t Next = 0;
+
+/*!
+ * \brief Ring of the visit averages of every channel [dBm]
+ */
+static int8_t Rssi[CHMON_MAX_CHANNELS][CHMON_HISTORY];
+static uint8_t Head[CHMON_MAX_CHANNELS];
+static uint8_t Samples[CHMON_MAX_CHANNELS];
+
+
+/*!
+ * \brief Score of a channel, the lower the quieter [0.25 dB]
+ */
+static int16_t ChMonScore( uint8_t channel )
+{
+    ChMonChannel_t stats;
+
+    SX126x_ChMonGetChannel( channel, &stats );
+    if( stats.Samples == 0 )
+    {
+        return INT16_MAX;
+    }
+    return 4 * stats.NoiseFloor + ( 4 * CHMON_OCCUPANCY_DB * stats.Occupancy ) / 100;
+}
+
+uint8_t SX126x_ChMonInit( const uint32_t *frequencies, uint8_t count )
+{
+    if( ( count == 0 ) || ( count > CHMON_MAX_CHANNELS ) )
+    {
+        return 1;
+    }
+    if( SX126x_SweepPrepare( frequencies, Words, count ) != 0 )
+    {
+        return 1;
+    }
+    memset( Head, 0, sizeof( Head ) );
+    memset( Samples, 0, sizeof( Samples ) );
+    Count = count;
+    Next = 0;
+    return 0;
+}
+
+uint8_t SX126x_ChMonProcess( void )
+{
+    RadioOperatingModes_t mode;
+    uint32_t word;
+    int16_t sum = 0;
+    uint32_t settle;
+
+    // From the mode check to the restore, no other task sees the radio away
+    SX126xHal_Lock( );
+    mode = SX126x_GetOperatingMode( );
+    word = SX126x_GetRfFrequencyWord( );
+    if( ( Count == 0 ) || ( ( mode != MODE_STDBY_RC ) && ( mode != MODE_STDBY_XOSC ) ) ||
+        ( next_timer_task_us( ) < CHMON_VISIT_US ) )
+    {
+        SX126xHal_Unlock( );
+        return 1;
+    }
+
+    SX126x_SetStandby( STDBY_XOSC );
+    SX126x_SetRfFrequencyWord( Words[Next] );
+    SX126x_SetRx( 0xFFFFFF );
+    settle = get_time_us( );
+    while( ( get_time_us( ) - settle ) < SWEEP_SETTLE_US )
+    {
+    }
+    for( uint8_t n = 0; n < CHMON_SAMPLES; n++ )
+    {
+        sum += SX126x_GetRssiInst( );
+    }
+    SX126x_SetStandby( ( mode == MODE_STDBY_XOSC ) ? STDBY_XOSC : STDBY_RC );
+    if( word != 0 )
+    {
+        SX126x_SetRfFrequencyWord( word );
+    }
+    SX126xHal_Unlock( );
+
+    Rssi[Next][Head[Next]] = ( int8_t )( sum / CHMON_SAMPLES );
+    Head[Next] = ( Head[Next] + 1 ) % CHMON_HISTORY;
+    if( Samples[Next] < CHMON_HISTORY )
+    {
+        Samples[Next]++;
+    }
+    Next = ( Next + 1 ) % Count;
+    return 0;
+}
+
+void SX126x_ChMonGetChannel( uint8_t channel, ChMonChannel_t *stats )
+{
+    int16_t freeSum = 0;
+    int16_t allSum = 0;
+    uint8_t busy = 0;
+
+    memset( stats, 0, sizeof( ChMonChannel_t ) );
+    if( ( channel >= Count ) || ( Samples[channel] == 0 ) )
+    {
+        return;
+    }
+    for( uint8_t i = 0; i < Samples[channel]; i++ )
+    {
+        int8_t rssi = Rssi[channel][i];
+
+        allSum += rssi;
+        if( rssi > CHMON_BUSY_DBM )
+        {
+            busy++;
+        }
+        else
+        {
+            freeSum += rssi;
+        }
+    }
+    stats->Samples = Samples[channel];
+    stats->Occupancy = ( uint8_t )( ( 100 * busy ) / Samples[channel] );
+    // A channel never free has no floor of its own, the average is the best guess
+    stats->NoiseFloor = ( busy < Samples[channel] ) ? ( int8_t )( freeSum / ( Samples[channel] - busy ) )
+                                                   : ( int8_t )( allSum / Samples[channel] );
+}
+
+uint8_t SX126x_ChMonRank( uint16_t allowed, uint8_t *order, uint8_t count )
+{
+    int16_t scores[CHMON_MAX_CHANNELS];
+    uint8_t n = 0;
+
+    if( count == 0 )
+    {
+        return 0;
+    }
+    for( uint8_t channel = 0; channel < Count; channel++ )
+    {
+        int16_t score;
+        uint8_t i;
+
+        if( ( allowed & ( 1U << channel ) ) == 0 )
+        {
+            continue;
+        }
+        // Insertion in the sorted part, at most CHMON_MAX_CHANNELS entries
+        score = ChMonScore( channel );
+        i = ( n < count ) ? n : count - 1;
+
+        if( ( n == count ) && ( score >= scores[count - 1] ) )
+        {
+            continue;
+        }
+        while( ( i > 0 ) && ( scores[i - 1] > score ) )
+        {
+            scores[i] = scores[i - 1];
+            order[i] = order[i - 1];
+            i--;
+        }
+        scores[i] = score;
+        order[i] = channel;
+        if( n < count )
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+uint8_t SX126x_ChMonSelect( uint16_t allowed, uint8_t current )
+{
+    uint8_t best;
+
+    if( SX126x_ChMonRank( allowed, &best, 1 ) == 0 )
+    {
+        return current;
+    }
+    if( ( current < Count ) && ( allowed & ( 1U << current ) ) &&
+        ( ChMonScore( best ) + 4 * CHMON_HYSTERESIS_DB > ChMonScore( current ) ) )
+    {
+        return current;
+    }
+    return best;
+}
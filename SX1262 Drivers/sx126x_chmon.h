@@ -0,0 +1,112 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_CHMON_H__
+#define __SX126x_CHMON_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Channels monitored and RSSI samples kept per channel
+ */
+#define CHMON_MAX_CHANNELS                          16
+#define CHMON_HISTORY                               16
+
+/*!
+ * \brief RSSI samples averaged in one visit of a channel
+ */
+#define CHMON_SAMPLES                               4
+
+/*!
+ * \brief Time a visit needs, no visit when a timer task is closer, in us
+ */
+#define CHMON_VISIT_US                              1000
+
+/*!
+ * \brief A sample over this is counted as the channel being busy, in dBm
+ */
+#define CHMON_BUSY_DBM                              -100
+
+/*!
+ * \brief Score of a channel always busy over a free one with the same noise
+ *        floor, and gain needed to leave the current channel, in dB
+ */
+#define CHMON_OCCUPANCY_DB                          20
+#define CHMON_HYSTERESIS_DB                         3
+
+/*!
+ * \brief Noise and occupancy of a channel over its last samples
+ */
+typedef struct
+{
+    int8_t        NoiseFloor;                       //!< Average of the free samples [dBm]
+    uint8_t       Occupancy;                        //!< Busy samples [%]
+    uint8_t       Samples;
+}ChMonChannel_t;
+
+/*!
+ * \brief Sets the channels up, see SX126x_SweepPrepare
+ *
+ * \param [in]  frequencies   The channels [Hz], in one image calibration band
+ * \param [in]  count         Up to CHMON_MAX_CHANNELS
+ *
+ * \retval      status        0 if done, 1 otherwise
+ */
+uint8_t SX126x_ChMonInit( const uint32_t *frequencies, uint8_t count );
+
+/*!
+ * \brief Visits the next channel if the radio is in standby and no timer task
+ *        is due within CHMON_VISIT_US. The standby mode and the frequency are
+ *        restored. To be called from the main loop in the idle gaps.
+ *
+ * \retval      status        0 if a channel was sampled, 1 otherwise
+ */
+uint8_t SX126x_ChMonProcess( void );
+
+/*!
+ * \brief Gets the statistics of a channel
+ *
+ * \param [in]  channel       Its index
+ * \param [out] stats         The statistics
+ */
+void SX126x_ChMonGetChannel( uint8_t channel, ChMonChannel_t *stats );
+
+/*!
+ * \brief Orders the allowed channels from the quietest: noise floor plus
+ *        CHMON_OCCUPANCY_DB times the busy ratio. The channels never sampled
+ *        come last.
+ *
+ * \param [in]  allowed       One bit per channel
+ * \param [out] order         The channel indexes
+ * \param [in]  count         Size of order
+ *
+ * \retval      count         Channels written to order
+ */
+uint8_t SX126x_ChMonRank( uint16_t allowed, uint8_t *order, uint8_t count );
+
+/*!
+ * \brief Chooses the channel for the next transmission
+ *
+ * \param [in]  allowed       One bit per channel
+ * \param [in]  current       The channel in use, kept unless another one
+ *                            scores CHMON_HYSTERESIS_DB better
+ *
+ * \retval      channel       Its index, current if none is allowed
+ */
+uint8_t SX126x_ChMonSelect( uint16_t allowed, uint8_t current );
+
+#endif // __SX126x_CHMON_H__
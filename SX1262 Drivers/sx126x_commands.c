@@ -21,6 +21,10 @@ Modifier: Marco Giordano
 
 #include "sx126x_commands.h"
 #include "sx126x_hal.h"
+#include "sx126x_sleep.h"
+#include "sx126x_energy.h"
+#include "sx126x_stats.h"
+#include "sx126x_os.h"
 
 /*!
  * \brief Radio registers definition
@@ -37,9 +41,96 @@ typedef struct
 volatile uint32_t FrequencyError = 0;
 
 /*!
- * \brief Hold the status of the Image calibration
+ * \brief An image calibration band of the datasheet, in CalibrateImage units
+ *        of 4 MHz
  */
-static bool ImageCalibrated = false;
+typedef struct
+{
+    uint32_t      Min;                              //!< [Hz]
+    uint32_t      Max;                              //!< [Hz]
+    uint8_t       CalFreq[2];
+}RadioImageBand_t;
+
+#define RADIO_IMAGE_BANDS                           5
+
+static const RadioImageBand_t ImageBands[RADIO_IMAGE_BANDS] =
+{
+    { 430000000, 440000000, { 0x6B, 0x6F } },
+    { 470000000, 510000000, { 0x75, 0x81 } },
+    { 779000000, 787000000, { 0xC1, 0xC5 } },
+    { 863000000, 870000000, { 0xD7, 0xDB } },
+    { 902000000, 928000000, { 0xE1, 0xE9 } },
+};
+
+/*!
+ * \brief Outside of the datasheet bands the image is calibrated over a grid
+ *        of 8 MHz bands, within the 150 - 960 MHz range of the radios
+ */
+#define IMAGE_GRID_STEP                             8000000
+#define IMAGE_FREQ_MIN                              150000000
+#define IMAGE_FREQ_MAX                              960000000
+
+/*!
+ * \brief Band the image is calibrated for, CalFreq[0] << 8 | CalFreq[1], 0
+ *        if none since SX126x_Init. A cold start loses the calibration, the
+ *        wake up replays it from the shadow and the band stays valid.
+ */
+static uint16_t CalibratedBand = 0;
+
+/*!
+ * \brief Mode the radio goes into after TX or RX done, see SetRxTxFallbackMode
+ */
+static RadioOperatingModes_t FallbackMode = MODE_STDBY_RC;
+
+/*!
+ * \brief Hold if the last reception was started in continuous mode
+ */
+static bool RxContinuous = false;
+
+/*!
+ * \brief Time of the DIO1 edge handled by the last ProcessIrqs
+ */
+static uint32_t IrqTimestamp = 0;
+
+/*!
+ * \brief Where the radio takes the payload to send, see SetBufferBaseAddresses
+ */
+static uint8_t TxBaseAddress = 0x00;
+
+/*!
+ * \brief Last word given to SetRfFrequencyWord
+ */
+static uint32_t FrequencyWord = 0;
+
+/*!
+ * \brief Optimal PA settings of the SX1262/8 for a maximum power, the power
+ *        is reached with +22 dBm in SetTxParams
+ */
+typedef struct
+{
+    int8_t        Power;                            //!< [dBm]
+    uint8_t       PaDutyCycle;
+    uint8_t       HpMax;
+}RadioPaLevel_t;
+
+#define RADIO_PA_LEVELS                             4
+
+static const RadioPaLevel_t PaLevels[RADIO_PA_LEVELS] =
+{
+    { 14, 0x02, 0x02 },
+    { 17, 0x02, 0x03 },
+    { 20, 0x03, 0x05 },
+    { 22, 0x04, 0x07 },
+};
+
+/*!
+ * \brief Last PA configuration and OCP written, SetTxParams skips them when
+ *        unchanged
+ */
+static uint8_t PaConfig[4];
+static bool PaConfigValid = false;
+static uint8_t Ocp = 0;
+static bool OcpValid = false;
 
 
 void SX126x_Init( void ){
@@ -48,6 +139,12 @@ void SX126x_Init( void ){
         SX126xHal_SpiInit();
 
         SX126xHal_Reset( );
+        SX126x_ShadowClear( );
+        SX126x_EnergyInit( get_time_us( ) );
+        FallbackMode = MODE_STDBY_RC;
+        CalibratedBand = 0;
+        PaConfigValid = false;
+        OcpValid = false;
 
         SX126xHal_IoIrqInit();
 
@@ -64,24 +161,20 @@ void SX126x_Init( void ){
         SX126xHal_AntSwOn( );
         SX126x_SetDio2AsRfSwitchCtrl( true );
         
-        OperatingMode = MODE_STDBY_RC;
+        SX126x_SetOperatingMode( MODE_STDBY_RC );
         
         SX126x_SetPacketType( PACKET_TYPE_LORA );
 
 
         #ifdef USE_CONFIG_PUBLIC_NETOWRK
-                uint8_t pub_sync_h = (( LORA_MAC_PUBLIC_SYNCWORD >> 8 ) & 0xFF);
-                uint8_t pub_sync_l = ( LORA_MAC_PUBLIC_SYNCWORD & 0xFF);
+                uint8_t sync[2] = { ( LORA_MAC_PUBLIC_SYNCWORD >> 8 ) & 0xFF, LORA_MAC_PUBLIC_SYNCWORD & 0xFF };
                 // Change LoRa modem Sync Word for Public Networks
-                SX126xHal_WriteReg( REG_LR_SYNCWORD, &pub_sync_h  );
-                SX126xHal_WriteReg( REG_LR_SYNCWORD + 1, &pub_sync_l );
         #else
-                uint8_t priv_sync_h = (( LORA_MAC_PRIVATE_SYNCWORD >> 8 ) & 0xFF);
-                uint8_t priv_sync_l = ( LORA_MAC_PRIVATE_SYNCWORD & 0xFF);
+                uint8_t sync[2] = { ( LORA_MAC_PRIVATE_SYNCWORD >> 8 ) & 0xFF, LORA_MAC_PRIVATE_SYNCWORD & 0xFF };
                 // Change LoRa modem SyncWord for Private Networks
-                SX126xHal_WriteReg( REG_LR_SYNCWORD, &priv_sync_h );
-                SX126xHal_WriteReg( REG_LR_SYNCWORD + 1, &priv_sync_l );
         #endif
+                SX126xHal_WriteRegister( REG_LR_SYNCWORD, sync, 2 );
+                SX126x_ShadowStore( SHADOW_REG_LORA_SYNCWORD, sync, 2 );
 }
 
 void SX126x_SetStandby( RadioStandbyModes_t standbyConfig )
@@ -90,11 +183,11 @@ void SX126x_SetStandby( RadioStandbyModes_t standbyConfig )
     SX126xHal_WriteCommand( RADIO_SET_STANDBY, ( uint8_t* )&standbyConfig, 1 );
     if( standbyConfig == STDBY_RC )
     {
-        OperatingMode = MODE_STDBY_RC;
+        SX126x_SetOperatingMode( MODE_STDBY_RC );
     }
     else
     {
-        OperatingMode = MODE_STDBY_XOSC;
+        SX126x_SetOperatingMode( MODE_STDBY_XOSC );
     }
 }
 
@@ -108,6 +201,7 @@ void SX126x_SetDio3AsTcxoCtrl( RadioTcxoCtrlVoltage_t tcxoVoltage, uint32_t time
     buf[3] = ( uint8_t )( timeout & 0xFF );
 
     SX126xHal_WriteCommand( RADIO_SET_TCXOMODE, buf, 4 );
+    SX126x_ShadowStore( SHADOW_TCXO_MODE, buf, 4 );
 }
 
 void SX126x_Calibrate( CalibrationParams_t calibParam )
@@ -119,6 +213,7 @@ void SX126x_SetDio2AsRfSwitchCtrl( uint8_t enable )
 {
 
     SX126xHal_WriteCommand( RADIO_SET_RFSWITCHMODE, &enable, 1 );
+    SX126x_ShadowStore( SHADOW_RF_SWITCH_MODE, &enable, 1 );
 }
 
 void SX126x_SetPacketType( RadioPacketTypes_t packetType )
@@ -128,6 +223,7 @@ void SX126x_SetPacketType( RadioPacketTypes_t packetType )
     // Save packet type internally to avoid questioning the radio
     PacketType = packetType;
     SX126xHal_WriteCommand( RADIO_SET_PACKETTYPE, ( uint8_t* )&packetType, 1 );
+    SX126x_ShadowStore( SHADOW_PACKET_TYPE, ( uint8_t* )&packetType, 1 );
 }
 
 RadioOperatingModes_t SX126x_GetOperatingMode( void )
@@ -135,45 +231,59 @@ RadioOperatingModes_t SX126x_GetOperatingMode( void )
     return OperatingMode;
 }
 
+void SX126x_SetOperatingMode( RadioOperatingModes_t mode )
+{
+    OperatingMode = mode;
+    SX126x_EnergyTransition( mode, get_time_us( ) );
+}
+
 void SX126x_CheckDeviceReady( void )
 {
     if( ( SX126x_GetOperatingMode( ) == MODE_SLEEP ) || ( SX126x_GetOperatingMode( ) == MODE_RX_DC ) )
     {
+        // Also turns the switch on and restores the configuration
         SX126xHal_Wakeup( );
-        // Switch is turned off when device is in sleep mode and turned on is all other modes
-        SX126xHal_AntSwOn( );
     }
 }
 
 void SX126x_SetPayload( uint8_t *payload, uint8_t size )
 {
-    uint8_t dummy;
-    uint8_t start_buffer = 0x00;
-    SX126x_GetRxBufferStatus( &dummy, &start_buffer );
-    SX126xHal_WriteBuffer( start_buffer, payload, size );
+    // The packet is sent from the TX base address, not from the last RX one
+    SX126xHal_WriteBuffer( TxBaseAddress, payload, size );
 }
 
 uint8_t SX126x_GetPayload( uint8_t *buffer, uint8_t size,  uint8_t maxSize )
 {
     uint8_t start_buffer = 0x00;
+    uint8_t status = 0;
+
+    SX126xHal_Lock( );
     SX126x_GetRxBufferStatus( &size, &start_buffer );
     if( size > maxSize )
     {
-        return 1;
+        status = 1;
     }
-    SX126xHal_ReadBuffer( start_buffer, buffer, size );
-    return 0;
+    else
+    {
+        SX126xHal_ReadBuffer( start_buffer, buffer, size );
+    }
+    SX126xHal_Unlock( );
+    return status;
 }
 
 void SX126x_SendPayload( uint8_t *payload, uint8_t size, uint32_t timeout )
 {
+    // No deferred handler between the payload and the TX command
+    SX126xHal_Lock( );
     SX126x_SetPayload( payload, size );
     SX126x_SetTx( timeout );
+    SX126xHal_Unlock( );
 }
 
 uint8_t SX126x_SetSyncWord( uint8_t *syncWord )
 {
     SX126xHal_WriteRegister( REG_LR_SYNCWORDBASEADDRESS, syncWord, 8 );
+    SX126x_ShadowStore( SHADOW_REG_GFSK_SYNCWORD, syncWord, 8 );
     return 0;
 }
 
@@ -188,6 +298,7 @@ void SX126x_SetCrcSeed( uint16_t seed )
     {
         case PACKET_TYPE_GFSK:
             SX126xHal_WriteRegister( REG_LR_CRCSEEDBASEADDR, buf, 2 );
+            SX126x_ShadowStore( SHADOW_REG_CRC_SEED, buf, 2 );
             break;
 
         default:
@@ -206,6 +317,7 @@ void SX126x_SetCrcPolynomial( uint16_t polynomial )
     {
         case PACKET_TYPE_GFSK:
             SX126xHal_WriteRegister( REG_LR_CRCPOLYBASEADDR, buf, 2 );
+            SX126x_ShadowStore( SHADOW_REG_CRC_POLYNOMIAL, buf, 2 );
             break;
 
         default:
@@ -215,16 +327,20 @@ void SX126x_SetCrcPolynomial( uint16_t polynomial )
 
 void SX126x_SetWhiteningSeed( uint16_t seed )
 {
-    uint8_t regValue = 0;
+    uint8_t regValue[2] = { 0, 0 };
 
     switch( SX126x_GetPacketType( ) )
     {
         case PACKET_TYPE_GFSK:
-            SX126xHal_ReadReg( REG_LR_WHITSEEDBASEADDR_MSB, &regValue );
-			regValue = regValue & 0xFE;
-            regValue = ( ( seed >> 8 ) & 0x01 ) | regValue;
-            SX126xHal_WriteReg( REG_LR_WHITSEEDBASEADDR_MSB, &regValue ); // only 1 bit.
-            SX126xHal_WriteReg( REG_LR_WHITSEEDBASEADDR_LSB, (uint8_t *) &seed );
+            SX126xHal_Lock( );
+            SX126xHal_ReadReg( REG_LR_WHITSEEDBASEADDR_MSB, &regValue[0] );
+			regValue[0] = regValue[0] & 0xFE;
+            regValue[0] = ( ( seed >> 8 ) & 0x01 ) | regValue[0];
+            regValue[1] = ( uint8_t )( seed & 0xFF );
+            SX126xHal_WriteReg( REG_LR_WHITSEEDBASEADDR_MSB, &regValue[0] ); // only 1 bit.
+            SX126xHal_WriteReg( REG_LR_WHITSEEDBASEADDR_LSB, &regValue[1] );
+            SX126x_ShadowStore( SHADOW_REG_WHITENING_SEED, regValue, 2 );
+            SX126xHal_Unlock( );
             break;
 
         default:
@@ -236,14 +352,16 @@ uint32_t SX126x_GetRandom( void )
 {
     uint8_t buf[] = { 0, 0, 0, 0 };
 
+    SX126xHal_Lock( );
     // Set radio in continuous reception
     SX126x_SetRx( 0 );
 
-    wait_ms( 1 );
+    SX126x_OsDelayMs( 1 );
 
     SX126xHal_ReadRegister( RANDOM_NUMBER_GENERATORBASEADDR, buf, 4 );
 
     SX126x_SetStandby( STDBY_RC );
+    SX126xHal_Unlock( );
 
     return ( buf[0] << 24 ) | ( buf[1] << 16 ) | ( buf[2] << 8 ) | buf[3];
 }
@@ -253,23 +371,27 @@ void SX126x_SetSleep( SleepParams_t sleepConfig )
 
 
     SX126xHal_AntSwOff( );
+    // The RX counters do not survive the sleep
+    SX126x_StatsCollect( );
 
     SX126xHal_WriteCommand( RADIO_SET_SLEEP, &sleepConfig.Value, 1 );
-    OperatingMode = MODE_SLEEP;
+    SX126x_SleepEnter( sleepConfig );
+    SX126x_EnergySetWarmStart( sleepConfig.Fields.WarmStart );
+    SX126x_SetOperatingMode( MODE_SLEEP );
 }
 
 void SX126x_SetFs( void )
 {
 
     SX126xHal_WriteCommand( RADIO_SET_FS, 0, 0 );
-    OperatingMode = MODE_FS;
+    SX126x_SetOperatingMode( MODE_FS );
 }
 
 void SX126x_SetTx( uint32_t timeout )
 {
     uint8_t buf[3];
 
-    OperatingMode = MODE_TX;
+    SX126x_SetOperatingMode( MODE_TX );
  
 
 
@@ -283,22 +405,28 @@ void SX126x_SetRxBoosted( uint32_t timeout )
 {
     uint8_t buf[3];
 
-    OperatingMode = MODE_RX;
+    SX126xHal_Lock( );
+    SX126x_SetOperatingMode( MODE_RX );
+    RxContinuous = ( timeout == 0xFFFFFF );
 
 
-    SX126xHal_WriteReg( REG_RX_GAIN, (uint8_t *)0x96 ); // max LNA gain, increase current by ~2mA for around ~3dB in sensivity
+    uint8_t rxGain = 0x96;
+    SX126xHal_WriteReg( REG_RX_GAIN, &rxGain ); // max LNA gain, increase current by ~2mA for around ~3dB in sensivity
+    SX126x_ShadowStore( SHADOW_REG_RX_GAIN, &rxGain, 1 );
 
     buf[0] = ( uint8_t )( ( timeout >> 16 ) & 0xFF );
     buf[1] = ( uint8_t )( ( timeout >> 8 ) & 0xFF );
     buf[2] = ( uint8_t )( timeout & 0xFF );
     SX126xHal_WriteCommand( RADIO_SET_RX, buf, 3 );
+    SX126xHal_Unlock( );
 }
 
 void SX126x_SetRx( uint32_t timeout )
 {
     uint8_t buf[3];
 
-    OperatingMode = MODE_RX;
+    SX126x_SetOperatingMode( MODE_RX );
+    RxContinuous = ( timeout == 0xFFFFFF );
 
 
     buf[0] = ( uint8_t )( ( timeout >> 16 ) & 0xFF );
@@ -318,13 +446,13 @@ void SX126x_SetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime )
     buf[4] = ( uint8_t )( ( sleepTime >> 8 ) & 0xFF );
     buf[5] = ( uint8_t )( sleepTime & 0xFF );
     SX126xHal_WriteCommand( RADIO_SET_RXDUTYCYCLE, buf, 6 );
-    OperatingMode = MODE_RX_DC;
+    SX126x_SetOperatingMode( MODE_RX_DC );
 }
 
 void SX126x_SetCad( void )
 {
     SX126xHal_WriteCommand( RADIO_SET_CAD, 0, 0 );
-    OperatingMode = MODE_CAD;
+    SX126x_SetOperatingMode( MODE_CAD );
 }
 
 void SX126x_SetTxContinuousWave( void )
@@ -340,49 +468,70 @@ void SX126x_SetTxInfinitePreamble( void )
 void SX126x_SetStopRxTimerOnPreambleDetect( uint8_t enable )
 {
     SX126xHal_WriteCommand( RADIO_SET_STOPRXTIMERONPREAMBLE, ( uint8_t* )&enable, 1 );
+    SX126x_ShadowStore( SHADOW_STOP_RX_TIMER_ON_PREAMBLE, ( uint8_t* )&enable, 1 );
 }
 
 void SX126x_SetLoRaSymbNumTimeout( uint8_t SymbNum )
 {
     SX126xHal_WriteCommand( RADIO_SET_LORASYMBTIMEOUT, &SymbNum, 1 );
+    SX126x_ShadowStore( SHADOW_LORA_SYMB_TIMEOUT, &SymbNum, 1 );
 }
 
 void SX126x_SetRegulatorMode( RadioRegulatorMode_t mode )
 {
     SX126xHal_WriteCommand( RADIO_SET_REGULATORMODE, ( uint8_t* )&mode, 1 );
+    SX126x_ShadowStore( SHADOW_REGULATOR_MODE, ( uint8_t* )&mode, 1 );
+    SX126x_EnergySetRegulator( mode );
 }
 
 
-void SX126x_CalibrateImage( uint32_t freq )
+void SX126x_GetImageCalibration( uint32_t freq, uint8_t *calFreq )
 {
-    uint8_t calFreq[2];
+    uint32_t step;
 
-    if( freq > 900000000 )
+    for( uint8_t i = 0; i < RADIO_IMAGE_BANDS; i++ )
     {
-        calFreq[0] = 0xE1;
-        calFreq[1] = 0xE9;
-    }
-    else if( freq > 850000000 )
-    {
-        calFreq[0] = 0xD7;
-        calFreq[1] = 0xD8;
+        if( ( freq >= ImageBands[i].Min ) && ( freq <= ImageBands[i].Max ) )
+        {
+            calFreq[0] = ImageBands[i].CalFreq[0];
+            calFreq[1] = ImageBands[i].CalFreq[1];
+            return;
+        }
     }
-    else if( freq > 770000000 )
+    if( freq < IMAGE_FREQ_MIN )
     {
-        calFreq[0] = 0xC1;
-        calFreq[1] = 0xC5;
+        freq = IMAGE_FREQ_MIN;
     }
-    else if( freq > 460000000 )
+    else if( freq > IMAGE_FREQ_MAX )
     {
-        calFreq[0] = 0x75;
-        calFreq[1] = 0x81;
+        freq = IMAGE_FREQ_MAX;
     }
-    else if( freq > 425000000 )
+    step = freq / IMAGE_GRID_STEP;
+    calFreq[0] = ( uint8_t )( 2 * step );
+    calFreq[1] = ( uint8_t )( 2 * step + 2 );
+}
+
+void SX126x_CalibrateImage( uint32_t freq )
+{
+    uint8_t calFreq[2];
+
+    SX126x_GetImageCalibration( freq, calFreq );
+    SX126xHal_WriteCommand( RADIO_CALIBRATEIMAGE, calFreq, 2 );
+    SX126x_ShadowStore( SHADOW_CALIBRATE_IMAGE, calFreq, 2 );
+    CalibratedBand = ( calFreq[0] << 8 ) | calFreq[1];
+}
+
+uint8_t SX126x_CheckImageCalibration( uint32_t freq )
+{
+    uint8_t calFreq[2];
+
+    SX126x_GetImageCalibration( freq, calFreq );
+    if( ( ( calFreq[0] << 8 ) | calFreq[1] ) == CalibratedBand )
     {
-        calFreq[0] = 0x6B;
-        calFreq[1] = 0x6F;
+        return 0;
     }
-    SX126xHal_WriteCommand( RADIO_CALIBRATEIMAGE, calFreq, 2 );
+    SX126x_CalibrateImage( freq );
+    return 1;
 }
 
 void SX126x_SetPaConfig( uint8_t paDutyCycle, uint8_t HpMax, uint8_t deviceSel, uint8_t paLUT )
@@ -394,12 +543,34 @@ void SX126x_SetPaConfig( uint8_t paDutyCycle, uint8_t HpMax, uint8_t deviceSel,
     buf[1] = HpMax;
     buf[2] = deviceSel;
     buf[3] = paLUT;
+    if( PaConfigValid && ( memcmp( PaConfig, buf, 4 ) == 0 ) )
+    {
+        return;
+    }
     SX126xHal_WriteCommand( RADIO_SET_PACONFIG, buf, 4 );
+    SX126x_ShadowStore( SHADOW_PA_CONFIG, buf, 4 );
+    memcpy( PaConfig, buf, 4 );
+    PaConfigValid = true;
+    // SetPaConfig puts the OCP back to its default
+    OcpValid = false;
 }
 
 void SX126x_SetRxTxFallbackMode( uint8_t fallbackMode )
 {
     SX126xHal_WriteCommand( RADIO_SET_TXFALLBACKMODE, &fallbackMode, 1 );
+    SX126x_ShadowStore( SHADOW_FALLBACK_MODE, &fallbackMode, 1 );
+    switch( fallbackMode )
+    {
+        case 0x40:
+            FallbackMode = MODE_FS;
+            break;
+        case 0x30:
+            FallbackMode = MODE_STDBY_XOSC;
+            break;
+        default:
+            FallbackMode = MODE_STDBY_RC;
+            break;
+    }
 }
 
 void SX126x_SetDioIrqParams( uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Mask, uint16_t dio3Mask )
@@ -416,6 +587,7 @@ void SX126x_SetDioIrqParams( uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2M
     buf[6] = ( uint8_t )( ( dio3Mask >> 8 ) & 0x00FF );
     buf[7] = ( uint8_t )( dio3Mask & 0x00FF );
     SX126xHal_WriteCommand( RADIO_CFG_DIOIRQ, buf, 8 );
+    SX126x_ShadowStore( SHADOW_DIO_IRQ_PARAMS, buf, 8 );
 }
 
 uint16_t SX126x_GetIrqStatus( void )
@@ -430,22 +602,36 @@ uint16_t SX126x_GetIrqStatus( void )
 
 void SX126x_SetRfFrequency( uint32_t frequency )
 {
-    uint8_t buf[4];
-    uint32_t freq = 0;
+    SX126xHal_Lock( );
+    // Only when the band changes, retuning within a band stays cheap
+    SX126x_CheckImageCalibration( frequency );
 
+    SX126x_SetRfFrequencyWord( SX126x_GetFrequencyWord( frequency ) );
+    SX126xHal_Unlock( );
+}
 
-    if( ImageCalibrated == false )
-    {
-        SX126x_CalibrateImage( frequency );
-        ImageCalibrated = true;
-    }
+uint32_t SX126x_GetFrequencyWord( uint32_t frequency )
+{
+    // frequency / FREQ_STEP without the double division
+    return ( uint32_t )( ( ( uint64_t )frequency * FREQ_DIV ) / XTAL_FREQ );
+}
+
+void SX126x_SetRfFrequencyWord( uint32_t freq )
+{
+    uint8_t buf[4];
 
-    freq = ( uint32_t )( ( double )frequency / ( double )FREQ_STEP );
     buf[0] = ( uint8_t )( ( freq >> 24 ) & 0xFF );
     buf[1] = ( uint8_t )( ( freq >> 16 ) & 0xFF );
     buf[2] = ( uint8_t )( ( freq >> 8 ) & 0xFF );
     buf[3] = ( uint8_t )( freq & 0xFF );
     SX126xHal_WriteCommand( RADIO_SET_RFFREQUENCY, buf, 4 );
+    SX126x_ShadowStore( SHADOW_RF_FREQUENCY, buf, 4 );
+    FrequencyWord = freq;
+}
+
+uint32_t SX126x_GetRfFrequencyWord( void )
+{
+    return FrequencyWord;
 }
 
 
@@ -457,8 +643,10 @@ RadioPacketTypes_t SX126x_GetPacketType( void )
 void SX126x_SetTxParams( int8_t power, RadioRampTimes_t rampTime )
 {
     uint8_t buf[2];
+    uint8_t ocp;
 
-
+    // PA configuration, OCP and TX parameters go together
+    SX126xHal_Lock( );
     if( SX1261 )
     {
         if( power == 15 )
@@ -477,11 +665,13 @@ void SX126x_SetTxParams( int8_t power, RadioRampTimes_t rampTime )
         {
             power = -3;
         }
-        SX126xHal_WriteReg( REG_OCP, (uint8_t *) 0x18 ); // current max is 80 mA for the whole device
+        SX126x_EnergySetTxPower( power );
+        ocp = 0x18; // current max is 80 mA for the whole device
     }
     else // sx1262 or sx1268
     {
-        SX126x_SetPaConfig( 0x04, 0x07, 0x00, 0x01 );
+        uint8_t level = 0;
+
         if( power > 22 )
         {
             power = 22;
@@ -490,7 +680,22 @@ void SX126x_SetTxParams( int8_t power, RadioRampTimes_t rampTime )
         {
             power = -3;
         }
-        SX126xHal_WriteReg( REG_OCP, (uint8_t *) 0x38 ); // current max 160mA for the whole device
+        // Smallest PA able to reach the power, it draws the least current
+        while( PaLevels[level].Power < power )
+        {
+            level++;
+        }
+        SX126x_SetPaConfig( PaLevels[level].PaDutyCycle, PaLevels[level].HpMax, 0x00, 0x01 );
+        SX126x_EnergySetTxPower( power );
+        power += 22 - PaLevels[level].Power;
+        ocp = 0x38; // current max 160mA for the whole device
+    }
+    if( ( OcpValid == false ) || ( ocp != Ocp ) )
+    {
+        SX126xHal_WriteReg( REG_OCP, &ocp );
+        SX126x_ShadowStore( SHADOW_REG_OCP, &ocp, 1 );
+        Ocp = ocp;
+        OcpValid = true;
     }
     buf[0] = power;
     if( XTAL == 0 )
@@ -509,6 +714,8 @@ void SX126x_SetTxParams( int8_t power, RadioRampTimes_t rampTime )
         buf[1] = ( uint8_t )rampTime;
     }
     SX126xHal_WriteCommand( RADIO_SET_TXPARAMS, buf, 2 );
+    SX126x_ShadowStore( SHADOW_TX_PARAMS, buf, 2 );
+    SX126xHal_Unlock( );
 }
 
 void SX126x_SetModulationParams( ModulationParams_t *modulationParams )
@@ -607,6 +814,7 @@ void SX126x_SetModulationParams( ModulationParams_t *modulationParams )
         return;
     }
     SX126xHal_WriteCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
+    SX126x_ShadowStore( SHADOW_MODULATION_PARAMS, buf, n );
 }
 
 void SX126x_SetPacketParams( PacketParams_t *packetParams )
@@ -670,6 +878,7 @@ void SX126x_SetPacketParams( PacketParams_t *packetParams )
         return;
     }
     SX126xHal_WriteCommand( RADIO_SET_PACKETPARAMS, buf, n );
+    SX126x_ShadowStore( SHADOW_PACKET_PARAMS, buf, n );
 }
 
 void SX126x_SetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, RadioCadExitModes_t cadExitMode, uint32_t cadTimeout )
@@ -684,7 +893,7 @@ void SX126x_SetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak
     buf[5] = ( uint8_t )( ( cadTimeout >> 8 ) & 0xFF );
     buf[6] = ( uint8_t )( cadTimeout & 0xFF );
     SX126xHal_WriteCommand( RADIO_SET_CADPARAMS, buf, 7 );
-    OperatingMode = MODE_CAD;
+    SX126x_ShadowStore( SHADOW_CAD_PARAMS, buf, 7 );
 }
 
 void SX126x_SetBufferBaseAddresses( uint8_t txBaseAddress, uint8_t rxBaseAddress )
@@ -695,6 +904,13 @@ void SX126x_SetBufferBaseAddresses( uint8_t txBaseAddress, uint8_t rxBaseAddress
     buf[0] = txBaseAddress;
     buf[1] = rxBaseAddress;
     SX126xHal_WriteCommand( RADIO_SET_BUFFERBASEADDRESS, buf, 2 );
+    TxBaseAddress = txBaseAddress;
+    SX126x_ShadowStore( SHADOW_BUFFER_BASE_ADDRESS, buf, 2 );
+}
+
+uint8_t SX126x_GetTxBaseAddress( void )
+{
+    return TxBaseAddress;
 }
 
 RadioStatus_t SX126x_GetStatus( void )
@@ -702,11 +918,37 @@ RadioStatus_t SX126x_GetStatus( void )
     uint8_t stat = 0;
     RadioStatus_t status;
 
+    switch( OperatingMode )
+    {
+        case MODE_TX:
+        case MODE_RX:
+        case MODE_RX_DC:
+        case MODE_CAD:
+            // The radio leaves these modes by itself, the cached status may be old
+            break;
+
+        default:
+            if( SX126xHal_GetCachedStatus( &stat ) == 1 )
+            {
+                status.Value = stat;
+                return status;
+            }
+            break;
+    }
     SX126xHal_ReadCommand( RADIO_GET_STATUS, ( uint8_t * )&stat, 1 );
     status.Value = stat;
     return status;
 }
 
+uint8_t SX126x_GetCommandError( RadioCommands_t *opcode )
+{
+    uint8_t op;
+    uint8_t cmdStatus = SX126xHal_GetCommandError( &op );
+
+    *opcode = ( RadioCommands_t )op;
+    return cmdStatus;
+}
+
 int8_t SX126x_GetRssiInst( void )
 {
     uint8_t rssi;
@@ -719,6 +961,7 @@ void SX126x_GetRxBufferStatus( uint8_t *payloadLength, uint8_t *rxStartBufferPoi
 {
     uint8_t status[2];
 
+    SX126xHal_Lock( );
     SX126xHal_ReadCommand( RADIO_GET_RXBUFFERSTATUS, status, 2 );
 	
     /* The registers in this part of code are not in the datasheet*/
@@ -738,6 +981,7 @@ void SX126x_GetRxBufferStatus( uint8_t *payloadLength, uint8_t *rxStartBufferPoi
 
     //*payloadLength = status[0];
     *rxStartBufferPointer = status[1];
+    SX126xHal_Unlock( );
 }
 
 void SX126x_GetPacketStatus( PacketStatus_t *pktStatus )
@@ -747,6 +991,7 @@ void SX126x_GetPacketStatus( PacketStatus_t *pktStatus )
     SX126xHal_ReadCommand( RADIO_GET_PACKETSTATUS, status, 3 );
 
     pktStatus->packetType = SX126x_GetPacketType( );
+    pktStatus->Timestamp = IrqTimestamp;
     switch( pktStatus->packetType )
     {
         case PACKET_TYPE_GFSK:
@@ -773,6 +1018,24 @@ void SX126x_GetPacketStatus( PacketStatus_t *pktStatus )
     }
 }
 
+void SX126x_GetStats( RxCounter_t *rxCounter )
+{
+    uint8_t buf[6];
+
+    SX126xHal_ReadCommand( RADIO_GET_STATS, buf, 6 );
+    rxCounter->packetType = SX126x_GetPacketType( );
+    rxCounter->PacketReceived = ( buf[0] << 8 ) | buf[1];
+    rxCounter->CrcError = ( buf[2] << 8 ) | buf[3];
+    rxCounter->LengthError = ( buf[4] << 8 ) | buf[5];
+}
+
+void SX126x_ResetStats( void )
+{
+    uint8_t buf[6] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+    SX126xHal_WriteCommand( RADIO_RESET_STATS, buf, 6 );
+}
+
 RadioError_t SX126x_GetDeviceErrors( void )
 {
     RadioError_t error;
@@ -791,8 +1054,15 @@ void SX126x_ClearIrqStatus( uint16_t irq )
 
 void SX126x_ProcessIrqs( void )
 {
+    // DIO1 stays high until the IRQs are cleared, the capture can't be overwritten before
+    IrqTimestamp = DIO1_GetTimestamp( );
+
+    // The operating mode follows the IRQs read, a handler must not run in between
+    SX126xHal_Lock( );
+
     uint16_t irqRegs = SX126x_GetIrqStatus( );
     SX126x_ClearIrqStatus( IRQ_RADIO_ALL );
+    SX126x_StatsOnIrq( irqRegs, OperatingMode );
 
 
     if( ( irqRegs & IRQ_HEADER_VALID ) == IRQ_HEADER_VALID )
@@ -809,23 +1079,32 @@ void SX126x_ProcessIrqs( void )
 
     if( ( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
     {
+        SX126x_SetOperatingMode( FallbackMode );
+        SX126x_EnergyPacketDone( get_time_us( ) );
        // Do something: Tx done
     }
 
     if( ( irqRegs & IRQ_RX_DONE ) == IRQ_RX_DONE )
     {
+        if( RxContinuous == false )
+        {
+            SX126x_SetOperatingMode( FallbackMode );
+        }
         if( ( irqRegs & IRQ_CRC_ERROR ) == IRQ_CRC_ERROR )
         {
             // Do something: Rx error
         }
         else
         {
+            SX126x_EnergyPacketDone( get_time_us( ) );
            // Do something: Rx succesful
         }
     }
 
     if( ( irqRegs & IRQ_CAD_DONE ) == IRQ_CAD_DONE )
     {
+        // LORA_CAD_ONLY exit mode, the other ones go on in RX
+        SX126x_SetOperatingMode( MODE_STDBY_RC );
         // Do something: cad done
     }
 
@@ -844,7 +1123,9 @@ void SX126x_ProcessIrqs( void )
         {
             //Fail
         }
+        SX126x_SetOperatingMode( FallbackMode );
     }
+    SX126xHal_Unlock( );
     
 /*
     //IRQ_PREAMBLE_DETECTED                   = 0x0004,
@@ -887,6 +1168,106 @@ void SX126x_ProcessIrqs( void )
 
 }
 
+uint32_t SX126x_GetIrqTimestamp( void )
+{
+    return IrqTimestamp;
+}
+
+static uint32_t SX126x_GetLoRaBandwidthInHz( RadioLoRaBandwidths_t bw )
+{
+    switch( bw )
+    {
+        case LORA_BW_007:
+            return 7810;
+        case LORA_BW_010:
+            return 10420;
+        case LORA_BW_015:
+            return 15630;
+        case LORA_BW_020:
+            return 20830;
+        case LORA_BW_031:
+            return 31250;
+        case LORA_BW_041:
+            return 41670;
+        case LORA_BW_062:
+            return 62500;
+        case LORA_BW_125:
+            return 125000;
+        case LORA_BW_250:
+            return 250000;
+        case LORA_BW_500:
+        default:
+            return 500000;
+    }
+}
+
+uint32_t SX126x_GetTimeOnAir( ModulationParams_t *modParams, PacketParams_t *packetParams )
+{
+    if( modParams->PacketType == PACKET_TYPE_LORA )
+    {
+        uint8_t sf = modParams->Params.LoRa.SpreadingFactor;
+        uint8_t de = modParams->Params.LoRa.LowDatarateOptimize ? 1 : 0;
+        uint8_t header = ( packetParams->Params.LoRa.HeaderType == LORA_PACKET_EXPLICIT ) ? 1 : 0;
+        uint8_t crc = ( packetParams->Params.LoRa.CrcMode == LORA_CRC_ON ) ? 1 : 0;
+        int32_t bits;
+        int32_t divider;
+        uint32_t quarterSymbols; // in 1/4 symbol, the preamble has 4.25 or 6.25 extra symbols
+
+        // SX1261/2 datasheet, 6.1.4 LoRa Transmission Time on Air
+        if( sf <= 6 )
+        {
+            bits = 8 * packetParams->Params.LoRa.PayloadLength + 16 * crc - 4 * sf + 20 * header;
+            divider = 4 * sf;
+            quarterSymbols = ( packetParams->Params.LoRa.PreambleLength * 4 ) + 25;
+        }
+        else
+        {
+            bits = 8 * packetParams->Params.LoRa.PayloadLength + 16 * crc - 4 * sf + 8 + 20 * header;
+            divider = 4 * ( sf - 2 * de );
+            quarterSymbols = ( packetParams->Params.LoRa.PreambleLength * 4 ) + 17;
+        }
+        if( bits < 0 )
+        {
+            bits = 0;
+        }
+        quarterSymbols += 4 * ( 8 + ( ( bits + divider - 1 ) / divider ) * ( modParams->Params.LoRa.CodingRate + 4 ) );
+
+        // Tsym = 2^SF / BW
+        return ( uint32_t )( ( ( ( uint64_t )quarterSymbols << sf ) * 1000000 ) / ( 4 * ( uint64_t )SX126x_GetLoRaBandwidthInHz( modParams->Params.LoRa.Bandwidth ) ) );
+    }
+    else if( modParams->PacketType == PACKET_TYPE_GFSK )
+    {
+        uint32_t bytes = packetParams->Params.Gfsk.PreambleLength + packetParams->Params.Gfsk.SyncWordLength + packetParams->Params.Gfsk.PayloadLength;
+
+        if( packetParams->Params.Gfsk.HeaderType == RADIO_PACKET_VARIABLE_LENGTH )
+        {
+            bytes += 1;
+        }
+        if( packetParams->Params.Gfsk.AddrComp != RADIO_ADDRESSCOMP_FILT_OFF )
+        {
+            bytes += 1;
+        }
+        switch( packetParams->Params.Gfsk.CrcLength )
+        {
+            case RADIO_CRC_OFF:
+                break;
+            case RADIO_CRC_1_BYTES:
+            case RADIO_CRC_1_BYTES_INV:
+                bytes += 1;
+                break;
+            default:
+                bytes += 2;
+                break;
+        }
+        if( modParams->Params.Gfsk.BitRate == 0 )
+        {
+            return 0;
+        }
+        return ( uint32_t )( ( ( uint64_t )bytes * 8 * 1000000 + modParams->Params.Gfsk.BitRate - 1 ) / modParams->Params.Gfsk.BitRate );
+    }
+    return 0;
+}
+
 // HELPER FUNCTIONS TO START TX AND RX
 
 void set_rx( uint32_t freq, RadioLoRaBandwidths_t bw, RadioLoRaSpreadingFactors_t sf, RadioLoRaCodingRates_t cd, RadioLoRaPacketLengthsMode_t ht, uint8_t pck_len ){
@@ -935,7 +1316,6 @@ void set_rx( uint32_t freq, RadioLoRaBandwidths_t bw, RadioLoRaSpreadingFactors_
 void set_tx( uint32_t freq, RadioLoRaBandwidths_t bw, RadioLoRaSpreadingFactors_t sf, RadioLoRaCodingRates_t cd, RadioLoRaPacketLengthsMode_t ht, uint8_t pck_len, int8_t power, RadioRampTimes_t rt ){
     // Same considerations as RX
     set_rx( freq, bw, sf, cd, ht, pck_len );
-    // Plus some specific TX
-    SX126x_SetPaConfig( 0x04, 0x07, 0x00, 0x01 );
+    // Plus some specific TX, the PA is configured for the power
     SX126x_SetTxParams(power, rt);
 }
@@ -17,6 +17,9 @@ __/\\\\____________/\\\\_____/\\\\\\\\\\\\_
 Modifier: Marco Giordano
 */
 
+#ifndef __SX126x_COMMANDS_H__
+#define __SX126x_COMMANDS_H__
+
 #include <stdint.h>
 
 // ************************** //
@@ -85,6 +88,18 @@ Modifier: Marco Giordano
 */
 #define REG_LR_PAYLOADLENGTH                        0x0702
 
+/*!
+* \brief The address of the register holding the GFSK payload size, the packet
+*        handler compares its byte count with it during the packet
+*/
+#define REG_GFSK_PAYLOADLENGTH                      0x06BB
+
+/*!
+* \brief The address of the register holding the position of the packet handler
+*        in the data buffer, during TX and RX
+*/
+#define REG_BUFFER_POINTER                          0x0803
+
 /*!
 * \brief The addresses of the registers holding SyncWords values
 */
@@ -441,6 +456,7 @@ IRQ_RADIO_ALL                           = 0xFFFF,
 typedef struct
 {
 RadioPacketTypes_t                    packetType;      //!< Packet to which the packet status are referring to.
+uint32_t                              Timestamp;       //!< Time of the DIO1 edge of the packet, see SX126x_GetIrqTimestamp
 struct
 {
 struct
@@ -466,9 +482,9 @@ struct
 typedef struct
 {
 RadioPacketTypes_t                    packetType;       //!< Packet to which the packet status are referring to.
-uint16_t PacketReceived;
-uint16_t CrcOk;
-uint16_t LengthError;
+uint16_t PacketReceived;                               //!< Packets received, the wrong ones included
+uint16_t CrcError;                                     //!< Packets received with a wrong CRC
+uint16_t LengthError;                                  //!< GFSK: length errors, LoRa: header errors
 }RxCounter_t;
 
 
@@ -650,6 +666,15 @@ typedef union RadioStatus_u
     }Fields;
 }RadioStatus_t;
 
+/*!
+ * \brief Values of RadioStatus_t.Fields.CmdStatus
+ */
+#define CMD_STATUS_DATA_AVAILABLE                   0x02
+#define CMD_STATUS_TIMEOUT                          0x03
+#define CMD_STATUS_PROCESSING_ERROR                 0x04
+#define CMD_STATUS_EXEC_FAILURE                     0x05
+#define CMD_STATUS_TX_DONE                          0x06
+
 
 
 /*!
@@ -717,6 +742,13 @@ void SX126x_SetPacketType( RadioPacketTypes_t packetType );
 */
 RadioOperatingModes_t SX126x_GetOperatingMode( void );
 
+/*!
+* \brief Sets the Operation Mode the driver just put the Radio into
+*
+* \param [in]  mode          The new operating mode
+*/
+void SX126x_SetOperatingMode( RadioOperatingModes_t mode );
+
 /*!
 * \brief Wakeup the radio if it is in Sleep mode and check that Busy is low
 */
@@ -876,6 +908,26 @@ void SX126x_SetRegulatorMode( RadioRegulatorMode_t mode );
 */
 void SX126x_CalibrateImage( uint32_t freq );
 
+/*!
+* \brief Calibrates the image rejection if the band of a frequency is not the
+*        one calibrated since the last cold start
+*
+* \param [in]  freq          The operating frequency
+*
+* \retval      status        1 if a calibration was run, 0 otherwise
+*/
+uint8_t SX126x_CheckImageCalibration( uint32_t freq );
+
+/*!
+* \brief Gets the image calibration band CalibrateImage uses for a frequency:
+*        the datasheet bands (430-440, 470-510, 779-787, 863-870, 902-928 MHz),
+*        8 MHz bands elsewhere
+*
+* \param [in]  freq          The operating frequency
+* \param [out] calFreq       The two CalibrateImage bytes
+*/
+void SX126x_GetImageCalibration( uint32_t freq, uint8_t *calFreq );
+
 /*!
 * \brief Sets the transmission parameters
 *
@@ -917,6 +969,30 @@ uint16_t SX126x_GetIrqStatus( void );
 */
 void SX126x_SetRfFrequency( uint32_t frequency );
 
+/*!
+* \brief Converts a frequency into the word of SetRfFrequency, in integers
+*
+* \param [in]  frequency     RF frequency [Hz]
+*
+* \retval      freq          The frequency in FREQ_STEP units
+*/
+uint32_t SX126x_GetFrequencyWord( uint32_t frequency );
+
+/*!
+* \brief Sets the RF frequency from a word of SX126x_GetFrequencyWord, without
+*        the image calibration check
+*
+* \param [in]  freq          The frequency in FREQ_STEP units
+*/
+void SX126x_SetRfFrequencyWord( uint32_t freq );
+
+/*!
+* \brief Gets the frequency word in use
+*
+* \retval      freq          The frequency in FREQ_STEP units
+*/
+uint32_t SX126x_GetRfFrequencyWord( void );
+
 /*!
 * \brief Gets the current radio protocol
 *
@@ -925,9 +1001,11 @@ void SX126x_SetRfFrequency( uint32_t frequency );
 RadioPacketTypes_t SX126x_GetPacketType( void );
 
 /*!
-* \brief Sets the transmission parameters
+* \brief Sets the transmission parameters. On the SX1262/8 the smallest PA
+*        reaching the power is configured, SetPaConfig and the OCP are only
+*        written when they change.
 *
-* \param [in]  power         RF output power [-18..13] dBm
+* \param [in]  power         RF output power [-3..22] dBm, [-3..14] dBm on the SX1261
 * \param [in]  rampTime      Transmission ramp up time
 */
 void SX126x_SetTxParams( int8_t power, RadioRampTimes_t rampTime );
@@ -970,12 +1048,32 @@ void SX126x_SetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak
 void SX126x_SetBufferBaseAddresses( uint8_t txBaseAddress, uint8_t rxBaseAddress );
 
 /*!
-* \brief Gets the current radio status
+* \brief Gets the buffer address the radio transmits from
+*
+* \retval      txBaseAddress Transmission base address
+*/
+uint8_t SX126x_GetTxBaseAddress( void );
+
+/*!
+* \brief Gets the current radio status. The status captured by the last
+*        transaction is returned without any SPI traffic while the radio is in a
+*        mode it only leaves on command and no mode change was sent since.
 *
 * \retval      status        Radio status
 */
 RadioStatus_t SX126x_GetStatus( void );
 
+/*!
+* \brief Gets and clears the last command the radio reported as failed, seen
+*        in the status of the transaction following it
+*
+* \param [out] opcode        Opcode of the failed command
+*
+* \retval      cmdStatus     CMD_STATUS_TIMEOUT, CMD_STATUS_PROCESSING_ERROR or
+*                            CMD_STATUS_EXEC_FAILURE, 0 if no command failed
+*/
+uint8_t SX126x_GetCommandError( RadioCommands_t *opcode );
+
 /*!
 * \brief Returns the instantaneous RSSI value for the last packet received
 *
@@ -998,6 +1096,19 @@ void SX126x_GetRxBufferStatus( uint8_t *payloadLength, uint8_t *rxStartBuffer );
 */
 void SX126x_GetPacketStatus( PacketStatus_t *pktStatus );
 
+/*!
+* \brief Gets the RX counters of the radio. They are 16 bits wide, they wrap
+*        around and they are lost in sleep.
+*
+* \param [out] rxCounter     The counters, for the current packet type
+*/
+void SX126x_GetStats( RxCounter_t *rxCounter );
+
+/*!
+* \brief Resets the RX counters of the radio
+*/
+void SX126x_ResetStats( void );
+
 /*!
 * \brief Returns the possible system erros
 *
@@ -1018,6 +1129,29 @@ void SX126x_ClearIrqStatus( uint16_t irq );
 */
 void SX126x_ProcessIrqs( void );
 
+/*!
+* \brief Returns the time of the DIO1 edge handled by the last ProcessIrqs
+*
+* \remark Hardware captured when DIO1_CAPTURE is enabled, in TIMESTAMP_TICKS_PER_US units
+*
+* \retval      timestamp     Time of the TX done, RX done, CAD done or timeout event
+*/
+uint32_t SX126x_GetIrqTimestamp( void );
+
+/*!
+* \brief Computes the time on air of a packet, from the first preamble symbol
+*        to the end of the CRC
+*
+* \remark The GFSK preamble and sync word lengths are in bytes, as given to
+*         SX126x_SetPacketParams
+*
+* \param [in]  modParams     Modulation parameters of the packet
+* \param [in]  packetParams  Packet parameters, with the payload length
+*
+* \retval      timeOnAir     Time on air [us]
+*/
+uint32_t SX126x_GetTimeOnAir( ModulationParams_t *modParams, PacketParams_t *packetParams );
+
 
 /*!
 * \brief Helper structs to easily set up tx and rx
@@ -1114,3 +1248,5 @@ struct LoRa_pckt
 void set_rx( uint32_t freq, RadioLoRaBandwidths_t bw, RadioLoRaSpreadingFactors_t sf, RadioLoRaCodingRates_t cd, RadioLoRaPacketLengthsMode_t ht, uint8_t pck_len );
 
 void set_tx( uint32_t freq, RadioLoRaBandwidths_t bw, RadioLoRaSpreadingFactors_t sf, RadioLoRaCodingRates_t cd, RadioLoRaPacketLengthsMode_t ht, uint8_t pck_len, int8_t power, RadioRampTimes_t rt );
+
+#endif // __SX126x_COMMANDS_H__
@@ -0,0 +1,274 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_compress.h"
+#include "sx126x_hal.h"
+
+/*!
+ * \brief Stream format, after the header byte:
+ *        0LLLLLLL                    L + 1 literal bytes follow
+ *        1LLLLLDD DDDDDDDD           copy L + 3 bytes from D + 1 bytes back
+ *        The history starts with the dictionary.
+ */
+#define COMPRESS_LITERALS_MAX                       128
+#define COMPRESS_MATCH_MIN                          3
+#define COMPRESS_MATCH_MAX                          ( 31 + COMPRESS_MATCH_MIN )
+#define COMPRESS_DISTANCE_MAX                       1024
+
+#define COMPRESS_HASH_SIZE                          256
+
+/*!
+ * \brief Default dictionary: keys and values common in JSON-like telemetry,
+ *        and runs of zeros of packed structures. Train your own on your traffic.
+ */
+static const uint8_t DefaultDictionary[] =
+    "\0\0\0\0\0\0\0\0\xFF\xFF\xFF\xFF"
+    "{\"id\":\"\",\"type\":\"\",\"ts\":,\"seq\":,\"status\":\"ok\",\"error\":\"\","
+    "\"temp\":,\"temperature\":,\"hum\":,\"humidity\":,\"pressure\":,\"co2\":,"
+    "\"bat\":,\"battery\":,\"voltage\":,\"current\":,\"power\":,\"energy\":,"
+    "\"rssi\":-,\"snr\":,\"lat\":,\"lon\":,\"alt\":,\"speed\":,\"value\":,"
+    "\"values\":[,\"data\":{\"count\":,\"min\":,\"max\":,\"avg\":,"
+    "\"true\",\"false\",null,0.00,0.0,100,1000,\"}]}";
+
+static const uint8_t *Dictionary = DefaultDictionary;
+
+static uint16_t DictionarySize = sizeof( DefaultDictionary ) - 1;
+
+/*!
+ * \brief Last history position + 1 of every hash, 0 if none
+ */
+static uint16_t HashTable[COMPRESS_HASH_SIZE];
+
+static uint8_t CompressBuffer[COMPRESS_MAX_INPUT + 1];
+
+
+static uint8_t CompressHistory( const uint8_t *input, uint16_t position )
+{
+    return ( position < DictionarySize ) ? Dictionary[position] : input[position - DictionarySize];
+}
+
+static uint8_t CompressHash( const uint8_t *input, uint16_t position )
+{
+    uint32_t value = ( ( uint32_t )CompressHistory( input, position ) << 16 ) |
+                     ( ( uint32_t )CompressHistory( input, position + 1 ) << 8 ) |
+                     CompressHistory( input, position + 2 );
+
+    return ( uint8_t )( ( value * 2654435761UL ) >> 24 );
+}
+
+static uint8_t CompressRaw( const uint8_t *input, uint8_t size, uint8_t *output, uint8_t maxSize )
+{
+    if( size + 1 > maxSize )
+    {
+        return 0;
+    }
+    output[0] = 0x00;
+    memcpy( output + 1, input, size );
+    return size + 1;
+}
+
+void SX126x_CompressSetDictionary( const uint8_t *dictionary, uint16_t size )
+{
+    Dictionary = dictionary;
+    DictionarySize = ( size > COMPRESS_MAX_DICTIONARY ) ? COMPRESS_MAX_DICTIONARY : size;
+}
+
+uint8_t SX126x_Compress( const uint8_t *input, uint8_t size, uint8_t *output, uint8_t maxSize )
+{
+    uint16_t end = DictionarySize + size;
+    uint16_t position = DictionarySize;
+    uint16_t literals = DictionarySize;             // First pending literal
+    // Only worth it if smaller than the raw fallback
+    uint16_t limit = ( maxSize < size ) ? maxSize : size;
+    uint16_t out = 1;
+
+    if( size > COMPRESS_MAX_INPUT )
+    {
+        return 0;
+    }
+
+    memset( HashTable, 0, sizeof( HashTable ) );
+    for( uint16_t i = 0; i + COMPRESS_MATCH_MIN <= DictionarySize; i++ )
+    {
+        HashTable[CompressHash( input, i )] = i + 1;
+    }
+
+    while( position < end )
+    {
+        uint16_t length = 0;
+        uint16_t candidate = 0;
+
+        if( position + COMPRESS_MATCH_MIN <= end )
+        {
+            uint8_t hash = CompressHash( input, position );
+
+            candidate = HashTable[hash];
+            HashTable[hash] = position + 1;
+            if( ( candidate != 0 ) && ( position - ( candidate - 1 ) <= COMPRESS_DISTANCE_MAX ) )
+            {
+                candidate--;
+                while( ( length < COMPRESS_MATCH_MAX ) && ( position + length < end ) &&
+                       ( CompressHistory( input, candidate + length ) == CompressHistory( input, position + length ) ) )
+                {
+                    length++;
+                }
+            }
+        }
+        if( length < COMPRESS_MATCH_MIN )
+        {
+            position++;
+            if( ( position - literals == COMPRESS_LITERALS_MAX ) || ( position == end ) )
+            {
+                // Flush the literal run
+                uint16_t run = position - literals;
+
+                if( out + 1 + run > limit )
+                {
+                    return CompressRaw( input, size, output, maxSize );
+                }
+                output[out++] = ( uint8_t )( run - 1 );
+                memcpy( &output[out], &input[literals - DictionarySize], run );
+                out += run;
+                literals = position;
+            }
+            continue;
+        }
+
+        if( position > literals )
+        {
+            uint16_t run = position - literals;
+
+            if( out + 1 + run > limit )
+            {
+                return CompressRaw( input, size, output, maxSize );
+            }
+            output[out++] = ( uint8_t )( run - 1 );
+            memcpy( &output[out], &input[literals - DictionarySize], run );
+            out += run;
+        }
+        if( out + 2 > limit )
+        {
+            return CompressRaw( input, size, output, maxSize );
+        }
+        uint16_t distance = position - candidate - 1;
+        output[out++] = 0x80 | ( ( length - COMPRESS_MATCH_MIN ) << 2 ) | ( distance >> 8 );
+        output[out++] = ( uint8_t )( distance & 0xFF );
+
+        // Index the positions covered by the match too
+        for( uint16_t i = position + 1; ( i < position + length ) && ( i + COMPRESS_MATCH_MIN <= end ); i++ )
+        {
+            HashTable[CompressHash( input, i )] = i + 1;
+        }
+        position += length;
+        literals = position;
+    }
+
+    if( out >= size + 1 )
+    {
+        return CompressRaw( input, size, output, maxSize );
+    }
+    output[0] = COMPRESS_HEADER_COMPRESSED;
+    return ( uint8_t )out;
+}
+
+uint8_t SX126x_Decompress( const uint8_t *input, uint8_t size, uint8_t *output, uint8_t maxSize )
+{
+    uint16_t in = 1;
+    uint16_t out = 0;
+
+    if( size == 0 )
+    {
+        return 0;
+    }
+    if( ( input[0] & COMPRESS_HEADER_COMPRESSED ) == 0 )
+    {
+        if( size - 1 > maxSize )
+        {
+            return 0;
+        }
+        memcpy( output, input + 1, size - 1 );
+        return size - 1;
+    }
+
+    while( in < size )
+    {
+        uint8_t token = input[in++];
+
+        if( ( token & 0x80 ) == 0 )
+        {
+            uint16_t run = ( token & 0x7F ) + 1;
+
+            if( ( in + run > size ) || ( out + run > maxSize ) )
+            {
+                return 0;
+            }
+            memcpy( &output[out], &input[in], run );
+            in += run;
+            out += run;
+        }
+        else
+        {
+            uint16_t length = ( ( token >> 2 ) & 0x1F ) + COMPRESS_MATCH_MIN;
+            uint16_t distance;
+            uint16_t source;
+
+            if( in >= size )
+            {
+                return 0;
+            }
+            distance = ( ( ( uint16_t )( token & 0x03 ) << 8 ) | input[in++] ) + 1;
+            if( ( distance > DictionarySize + out ) || ( out + length > maxSize ) )
+            {
+                return 0;
+            }
+            // Byte by byte, the match may overlap what it produces
+            source = DictionarySize + out - distance;
+            for( uint16_t i = 0; i < length; i++, source++ )
+            {
+                output[out++] = ( source < DictionarySize ) ? Dictionary[source] : output[source - DictionarySize];
+            }
+        }
+    }
+    return ( uint8_t )out;
+}
+
+uint8_t SX126x_SendCompressed( PacketParams_t *packetParams, uint8_t *payload, uint8_t size, uint32_t timeout )
+{
+    uint8_t length = SX126x_Compress( payload, size, CompressBuffer, sizeof( CompressBuffer ) );
+    // SetPacketParams converts the GFSK lengths in place, work on a copy
+    PacketParams_t params = *packetParams;
+
+    if( length == 0 )
+    {
+        return 1;
+    }
+    // The radio sends PayloadLength bytes, not the size written to its buffer
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        params.Params.LoRa.PayloadLength = length;
+    }
+    else
+    {
+        params.Params.Gfsk.PayloadLength = length;
+    }
+    // The length and the payload it belongs to, no other task in between
+    SX126xHal_Lock( );
+    SX126x_SetPacketParams( &params );
+    SX126x_SendPayload( CompressBuffer, length, timeout );
+    SX126xHal_Unlock( );
+    return 0;
+}
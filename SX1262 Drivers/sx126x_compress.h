@@ -0,0 +1,85 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_COMPRESS_H__
+#define __SX126x_COMPRESS_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief First byte of a payload: set if the rest is compressed, clear if it
+ *        is the raw data
+ */
+#define COMPRESS_HEADER_COMPRESSED                  0x80
+
+/*!
+ * \brief Largest input, the raw fallback adds the header byte
+ */
+#define COMPRESS_MAX_INPUT                          254
+
+/*!
+ * \brief Largest dictionary, matches reach 1024 bytes back
+ */
+#define COMPRESS_MAX_DICTIONARY                     768
+
+/*!
+ * \brief Sets the dictionary, the same on both sides, e.g. a sample of the
+ *        traffic. A default one for JSON-like telemetry is used otherwise.
+ *
+ * \param [in]  dictionary    The dictionary, must stay valid
+ * \param [in]  size          Its size, up to COMPRESS_MAX_DICTIONARY
+ */
+void SX126x_CompressSetDictionary( const uint8_t *dictionary, uint16_t size );
+
+/*!
+ * \brief Compresses a payload, or copies it raw if it does not get smaller
+ *
+ * \param [in]  input         The payload
+ * \param [in]  size          Its size, up to COMPRESS_MAX_INPUT
+ * \param [out] output        The header byte and the data
+ * \param [in]  maxSize       Size of output
+ *
+ * \retval      size          Size written to output, 0 if it does not fit
+ */
+uint8_t SX126x_Compress( const uint8_t *input, uint8_t size, uint8_t *output, uint8_t maxSize );
+
+/*!
+ * \brief Restores a payload made by SX126x_Compress
+ *
+ * \param [in]  input         The received payload
+ * \param [in]  size          Its size
+ * \param [out] output        The original payload
+ * \param [in]  maxSize       Size of output
+ *
+ * \retval      size          Size of the original payload, 0 if malformed
+ */
+uint8_t SX126x_Decompress( const uint8_t *input, uint8_t size, uint8_t *output, uint8_t maxSize );
+
+/*!
+ * \brief Compresses and sends a payload, see SX126x_SendPayload. The payload
+ *        length of the packet is set to the compressed size.
+ *
+ * \param [in]  packetParams  Packet format, the length is ignored
+ * \param [in]  payload       The payload
+ * \param [in]  size          Its size, up to COMPRESS_MAX_INPUT
+ * \param [in]  timeout       TX timeout, see SX126x_SetTx
+ *
+ * \retval      status        0 if sent, 1 if the payload is too large
+ */
+uint8_t SX126x_SendCompressed( PacketParams_t *packetParams, uint8_t *payload, uint8_t size, uint32_t timeout );
+
+#endif // __SX126x_COMPRESS_H__
@@ -0,0 +1,216 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_crc.h"
+
+/*!
+ * \brief Shifts one byte through the LFSR, no data: the table entry of x
+ */
+static uint16_t CrcShift( uint16_t value, uint16_t polynomial, uint8_t bits )
+{
+    for( uint8_t i = 0; i < bits; i++ )
+    {
+        value = ( value & 0x8000 ) ? ( uint16_t )( ( value << 1 ) ^ polynomial ) : ( uint16_t )( value << 1 );
+    }
+    return value;
+}
+
+void SX126x_CrcInit( CrcEngine_t *crc, RadioCrcTypes_t type, uint16_t seed, uint16_t polynomial )
+{
+    uint8_t invert = 0;
+
+    switch( type )
+    {
+        case RADIO_CRC_2_BYTES_IBM:
+            seed = CRC_IBM_SEED;
+            polynomial = CRC_POLYNOMIAL_IBM;
+            crc->Bytes = 2;
+            break;
+        case RADIO_CRC_2_BYTES_CCIT:
+            seed = CRC_CCITT_SEED;
+            polynomial = CRC_POLYNOMIAL_CCITT;
+            crc->Bytes = 2;
+            invert = 1;
+            break;
+        case RADIO_CRC_1_BYTES:
+        case RADIO_CRC_1_BYTES_INV:
+            crc->Bytes = 1;
+            invert = ( type == RADIO_CRC_1_BYTES_INV );
+            break;
+        case RADIO_CRC_2_BYTES:
+        case RADIO_CRC_2_BYTES_INV:
+            crc->Bytes = 2;
+            invert = ( type == RADIO_CRC_2_BYTES_INV );
+            break;
+        case RADIO_CRC_OFF:
+        default:
+            crc->Bytes = 0;
+            break;
+    }
+    if( crc->Bytes == 1 )
+    {
+        // Computed in the high byte of the 16 bit LFSR, the low byte stays 0
+        seed <<= 8;
+        polynomial <<= 8;
+    }
+    crc->Seed = seed;
+    crc->XorOut = invert ? ( ( crc->Bytes == 1 ) ? 0xFF00 : 0xFFFF ) : 0x0000;
+
+#if ( CRC_SLICING_BY_8 == 1 )
+    for( uint16_t x = 0; x < 256; x++ )
+    {
+        crc->Table[0][x] = CrcShift( x << 8, polynomial, 8 );
+    }
+    for( uint8_t k = 1; k < 8; k++ )
+    {
+        for( uint16_t x = 0; x < 256; x++ )
+        {
+            uint16_t previous = crc->Table[k - 1][x];
+
+            crc->Table[k][x] = ( uint16_t )( previous << 8 ) ^ crc->Table[0][previous >> 8];
+        }
+    }
+#else
+    for( uint8_t x = 0; x < 16; x++ )
+    {
+        crc->Table[x] = CrcShift( ( uint16_t )x << 12, polynomial, 4 );
+    }
+#endif
+}
+
+uint16_t SX126x_CrcUpdate( CrcEngine_t *crc, uint16_t state, const uint8_t *data, uint16_t size )
+{
+#if ( CRC_SLICING_BY_8 == 1 )
+    uint16_t ( *t )[256] = crc->Table;
+
+    while( size >= 8 )
+    {
+        state ^= ( uint16_t )( ( data[0] << 8 ) | data[1] );
+        state = t[7][state >> 8] ^ t[6][state & 0xFF] ^ t[5][data[2]] ^ t[4][data[3]] ^
+                t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while( size-- > 0 )
+    {
+        state = ( uint16_t )( state << 8 ) ^ t[0][( state >> 8 ) ^ *data++];
+    }
+#else
+    while( size-- > 0 )
+    {
+        uint8_t byte = *data++;
+
+        state = ( uint16_t )( state << 4 ) ^ crc->Table[( state >> 12 ) ^ ( byte >> 4 )];
+        state = ( uint16_t )( state << 4 ) ^ crc->Table[( state >> 12 ) ^ ( byte & 0x0F )];
+    }
+#endif
+    return state;
+}
+
+uint16_t SX126x_CrcFinal( CrcEngine_t *crc, uint16_t state )
+{
+    state ^= crc->XorOut;
+    switch( crc->Bytes )
+    {
+        case 1:
+            return state >> 8;
+        case 2:
+            return state;
+        default:
+            return 0;
+    }
+}
+
+uint16_t SX126x_CrcCompute( CrcEngine_t *crc, const uint8_t *data, uint16_t size )
+{
+    return SX126x_CrcFinal( crc, SX126x_CrcUpdate( crc, crc->Seed, data, size ) );
+}
+
+/*!
+ * \brief Advances the PN9 LFSR by 8 bits at once. Bit i of the state is the
+ *        i-th next bit of the sequence, b[t + 9] = b[t] ^ b[t + 5].
+ */
+static uint16_t WhitenStep( uint16_t state )
+{
+    // b[t + 9] .. b[t + 12] only need the current state
+    uint16_t low = ( state ^ ( state >> 5 ) ) & 0x0F;
+    uint16_t extended = state | ( low << 9 );
+    // b[t + 13] .. b[t + 16] need the four bits just computed
+    uint16_t high = ( ( extended >> 4 ) ^ ( extended >> 9 ) ) & 0x0F;
+
+    return ( ( state >> 8 ) & 0x01 ) | ( low << 1 ) | ( high << 5 );
+}
+
+void SX126x_Whiten( uint16_t *state, uint8_t *data, uint16_t size )
+{
+    uint16_t lfsr = *state & 0x01FF;
+
+    while( size-- > 0 )
+    {
+        *data++ ^= ( uint8_t )lfsr;
+        lfsr = WhitenStep( lfsr );
+    }
+    *state = lfsr;
+}
+
+uint16_t SX126x_GfskEncode( CrcEngine_t *crc, uint8_t whitening, uint16_t seed, const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint16_t size, uint8_t *frame )
+{
+    uint16_t length = headerSize + size;
+    uint16_t value;
+
+    if( headerSize > 0 )
+    {
+        memcpy( frame, header, headerSize );
+    }
+    memcpy( frame + headerSize, payload, size );
+
+    value = SX126x_CrcCompute( crc, frame, length );
+    if( crc->Bytes == 2 )
+    {
+        frame[length++] = ( uint8_t )( value >> 8 );
+    }
+    if( crc->Bytes > 0 )
+    {
+        frame[length++] = ( uint8_t )value;
+    }
+
+    if( whitening == 1 )
+    {
+        SX126x_Whiten( &seed, frame, length );
+    }
+    return length;
+}
+
+uint8_t SX126x_GfskDecode( CrcEngine_t *crc, uint8_t whitening, uint16_t seed, uint8_t *frame, uint16_t size )
+{
+    uint16_t value;
+    uint16_t received;
+
+    if( size < crc->Bytes )
+    {
+        return 1;
+    }
+    if( whitening == 1 )
+    {
+        SX126x_Whiten( &seed, frame, size );
+    }
+    size -= crc->Bytes;
+    value = SX126x_CrcCompute( crc, frame, size );
+    received = ( crc->Bytes == 2 ) ? ( uint16_t )( ( frame[size] << 8 ) | frame[size + 1] ) : ( crc->Bytes == 1 ) ? frame[size] : 0;
+
+    return ( value == received ) ? 0 : 1;
+}
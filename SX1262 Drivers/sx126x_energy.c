@@ -0,0 +1,245 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#include <string.h>
+
+#include "sx126x_energy.h"
+#include "device_specific_implementation.h"
+
+/*!
+ * \brief A point of the TX current curve
+ */
+typedef struct
+{
+    int8_t        Power;                            //!< Output power [dBm]
+    uint32_t      Current;                          //!< Current [nA]
+}EnergyTxPoint_t;
+
+#define ENERGY_TX_POINTS                            7
+
+/*!
+ * \brief Typical TX current at 3.3 V with DC-DC, from the datasheets. Below
+ *        14 dBm the SX1262/8 back the 14 dBm PA configuration off, the points
+ *        there are read from the current versus power curves. Measure and
+ *        adjust them for your matching network.
+ */
+static const EnergyTxPoint_t TxCurrent[3][ENERGY_TX_POINTS] =
+{
+    [ENERGY_CHIP_SX1261] = { { 0, 10000000 }, { 10, 15000000 }, { 14, 25500000 }, { 15, 32000000 } },
+    [ENERGY_CHIP_SX1262] = { { -9, 26000000 }, { 0, 36000000 }, { 10, 62000000 }, { 14, 90000000 },
+                             { 17, 95000000 }, { 20, 102000000 }, { 22, 118000000 } },
+    [ENERGY_CHIP_SX1268] = { { -9, 24000000 }, { 0, 33000000 }, { 10, 56000000 }, { 14, 80000000 },
+                             { 17, 90000000 }, { 20, 97000000 }, { 22, 107000000 } },
+};
+
+/*!
+ * \brief Points used in each curve
+ */
+static const uint8_t TxPoints[3] =
+{
+    [ENERGY_CHIP_SX1261] = 4,
+    [ENERGY_CHIP_SX1262] = 7,
+    [ENERGY_CHIP_SX1268] = 7,
+};
+
+/*!
+ * \brief Typical current of the other states with DC-DC [nA], common to all the
+ *        variants. The RX current is the one of the LoRa 125 kHz bandwidth.
+ *        In nA, the sleep currents dominate a battery life estimate.
+ */
+#define ENERGY_SLEEP_COLD_NA                        160
+#define ENERGY_SLEEP_WARM_NA                        600
+#define ENERGY_STDBY_RC_NA                          600000
+#define ENERGY_STDBY_XOSC_NA                        800000
+#define ENERGY_FS_NA                                2100000
+#define ENERGY_RX_NA                                4600000
+#define ENERGY_BUSY_NA                              600000
+
+static EnergyModel_t Model;
+
+static EnergyReport_t Report;
+
+/*!
+ * \brief State being accounted since LastStamp
+ */
+static uint8_t State = MODE_STDBY_RC;
+
+/*!
+ * \brief Operating mode to go back to when BUSY goes low
+ */
+static RadioOperatingModes_t Mode = MODE_STDBY_RC;
+
+static uint32_t LastStamp = 0;
+
+/*!
+ * \brief Total charge when the previous packet was closed
+ */
+static uint64_t LastPacketCharge = 0;
+
+
+static uint32_t EnergyTxCurrent( void )
+{
+    const EnergyTxPoint_t *curve = TxCurrent[Model.Chip];
+    uint8_t points = TxPoints[Model.Chip];
+
+    if( Model.TxPower <= curve[0].Power )
+    {
+        return curve[0].Current;
+    }
+    for( uint8_t i = 1; i < points; i++ )
+    {
+        if( Model.TxPower <= curve[i].Power )
+        {
+            // Linear interpolation between the two points around the power
+            return curve[i - 1].Current + ( curve[i].Current - curve[i - 1].Current ) *
+                   ( uint32_t )( Model.TxPower - curve[i - 1].Power ) / ( uint32_t )( curve[i].Power - curve[i - 1].Power );
+        }
+    }
+    return curve[points - 1].Current;
+}
+
+static void EnergyAccount( uint32_t now )
+{
+    uint32_t elapsed = now - LastStamp;
+
+    LastStamp = now;
+    Report.Time[State] += elapsed;
+    Report.Charge[State] += ( uint64_t )elapsed * SX126x_EnergyGetCurrent( State );
+}
+
+static uint64_t EnergyTotalCharge( void )
+{
+    uint64_t charge = 0;
+
+    for( uint8_t i = 0; i < ENERGY_STATES; i++ )
+    {
+        charge += Report.Charge[i];
+    }
+    return charge;
+}
+
+void SX126x_EnergyInit( uint32_t now )
+{
+    memset( &Report, 0, sizeof( Report ) );
+    Model.Chip = SX1261 ? ENERGY_CHIP_SX1261 : ( SX1268 ? ENERGY_CHIP_SX1268 : ENERGY_CHIP_SX1262 );
+    Model.TxPower = 14;
+    Model.Regulator = USE_LDO;
+    Model.WarmStart = 0;
+    Mode = SX126x_GetOperatingMode( );
+    State = Mode;
+    LastStamp = now;
+    LastPacketCharge = 0;
+}
+
+void SX126x_EnergySetModel( EnergyModel_t *model )
+{
+    memcpy( &Model, model, sizeof( Model ) );
+}
+
+void SX126x_EnergyGetModel( EnergyModel_t *model )
+{
+    memcpy( model, &Model, sizeof( Model ) );
+}
+
+uint32_t SX126x_EnergyGetCurrent( uint8_t state )
+{
+    uint32_t current;
+    // Using only LDO implies that the Rx or Tx current is doubled
+    uint8_t ldo = ( Model.Regulator == USE_LDO ) ? 2 : 1;
+
+    switch( state )
+    {
+        case MODE_SLEEP:
+            return Model.WarmStart ? ENERGY_SLEEP_WARM_NA : ENERGY_SLEEP_COLD_NA;
+        case MODE_STDBY_RC:
+            return ENERGY_STDBY_RC_NA;
+        case MODE_STDBY_XOSC:
+            return ENERGY_STDBY_XOSC_NA * ldo;
+        case MODE_FS:
+            return ENERGY_FS_NA * ldo;
+        case MODE_TX:
+            current = EnergyTxCurrent( );
+            // The high power PA of the SX1262/8 is supplied from VBAT, only
+            // the low power PA of the SX1261 goes through the regulator
+            return ( Model.Chip == ENERGY_CHIP_SX1261 ) ? current * ldo : current;
+        case MODE_RX:
+        case MODE_RX_DC:
+        case MODE_CAD:
+            return ENERGY_RX_NA * ldo;
+        case ENERGY_BUSY:
+            return ENERGY_BUSY_NA;
+        default:
+            return 0;
+    }
+}
+
+void SX126x_EnergyTransition( RadioOperatingModes_t mode, uint32_t now )
+{
+    EnergyAccount( now );
+    Mode = mode;
+    if( State != ENERGY_BUSY )
+    {
+        State = mode;
+    }
+}
+
+void SX126x_EnergyBusyBegin( uint32_t now )
+{
+    EnergyAccount( now );
+    State = ENERGY_BUSY;
+}
+
+void SX126x_EnergyBusyEnd( uint32_t now )
+{
+    EnergyAccount( now );
+    State = Mode;
+}
+
+void SX126x_EnergySetTxPower( int8_t power )
+{
+    Model.TxPower = power;
+}
+
+void SX126x_EnergySetRegulator( RadioRegulatorMode_t mode )
+{
+    Model.Regulator = mode;
+}
+
+void SX126x_EnergySetWarmStart( uint8_t warmStart )
+{
+    Model.WarmStart = warmStart;
+}
+
+void SX126x_EnergyPacketDone( uint32_t now )
+{
+    uint64_t charge;
+
+    EnergyAccount( now );
+    charge = EnergyTotalCharge( );
+    Report.LastPacketEnergy = ( uint32_t )SX126x_EnergyToMicroJoule( charge - LastPacketCharge );
+    LastPacketCharge = charge;
+    Report.Packets++;
+}
+
+void SX126x_EnergyGetReport( EnergyReport_t *report, uint32_t now )
+{
+    EnergyAccount( now );
+    memcpy( report, &Report, sizeof( Report ) );
+}
+
+uint64_t SX126x_EnergyToMicroJoule( uint64_t charge )
+{
+    // nC * mV = pJ. 32 bits of uJ are only 4294 J, a few days of TX.
+    return charge / 1000000 * ENERGY_SUPPLY_MV / 1000000;
+}
@@ -0,0 +1,147 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#ifndef __SX126x_ENERGY_H__
+#define __SX126x_ENERGY_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Accounting state for the BUSY periods, after the operating modes
+ */
+#define ENERGY_BUSY                                 ( MODE_CAD + 1 )
+
+/*!
+ * \brief Number of accounting states: every RadioOperatingModes_t plus BUSY
+ */
+#define ENERGY_STATES                               ( MODE_CAD + 2 )
+
+/*!
+ * \brief Supply voltage used to turn charge into energy, in mV
+ */
+#define ENERGY_SUPPLY_MV                            3300
+
+/*!
+ * \brief Radio chip variants, each one has its own current table
+ */
+typedef enum
+{
+    ENERGY_CHIP_SX1261                      = 0x00,
+    ENERGY_CHIP_SX1262,
+    ENERGY_CHIP_SX1268,
+}EnergyChips_t;
+
+/*!
+ * \brief What the current drawn by the radio depends on
+ */
+typedef struct
+{
+    EnergyChips_t         Chip;
+    int8_t                TxPower;                  //!< Last power given to SetTxParams [dBm]
+    RadioRegulatorMode_t  Regulator;                //!< Last mode given to SetRegulatorMode
+    uint8_t               WarmStart;                //!< 1 if the last sleep retains the configuration
+}EnergyModel_t;
+
+/*!
+ * \brief Accumulated time and charge per state
+ */
+typedef struct
+{
+    uint64_t Time[ENERGY_STATES];                   //!< Time spent in each state [us]
+    uint64_t Charge[ENERGY_STATES];                 //!< Charge drawn in each state [nA * us = fC]
+    uint32_t Packets;                               //!< Packets sent or received
+    uint32_t LastPacketEnergy;                      //!< Energy drawn since the previous packet [uJ]
+}EnergyReport_t;
+
+/*!
+ * \brief Resets the counters and sets the model from the build configuration
+ *
+ * \param [in]  now           Current time [us]
+ */
+void SX126x_EnergyInit( uint32_t now );
+
+/*!
+ * \brief Sets the current model, e.g. to compare variants in a simulation
+ *
+ * \param [in]  model         The chip, TX power and regulator to account with
+ */
+void SX126x_EnergySetModel( EnergyModel_t *model );
+
+/*!
+ * \brief Gets the current model
+ *
+ * \param [out] model         The model in use
+ */
+void SX126x_EnergyGetModel( EnergyModel_t *model );
+
+/*!
+ * \brief Typical current drawn in a state with the current model
+ *
+ * \param [in]  state         A RadioOperatingModes_t or ENERGY_BUSY
+ *
+ * \retval      current       Current [nA]
+ */
+uint32_t SX126x_EnergyGetCurrent( uint8_t state );
+
+/*!
+ * \brief Closes the running period and starts a new operating mode
+ *
+ * \param [in]  mode          The new operating mode
+ * \param [in]  now           Current time [us]
+ */
+void SX126x_EnergyTransition( RadioOperatingModes_t mode, uint32_t now );
+
+/*!
+ * \brief Marks the beginning and the end of a BUSY period
+ *
+ * \param [in]  now           Current time [us]
+ */
+void SX126x_EnergyBusyBegin( uint32_t now );
+void SX126x_EnergyBusyEnd( uint32_t now );
+
+/*!
+ * \brief Model updates, called by the driver when it configures the radio
+ */
+void SX126x_EnergySetTxPower( int8_t power );
+void SX126x_EnergySetRegulator( RadioRegulatorMode_t mode );
+void SX126x_EnergySetWarmStart( uint8_t warmStart );
+
+/*!
+ * \brief Closes a packet: the energy drawn since the previous one is its cost
+ *
+ * \param [in]  now           Current time [us]
+ */
+void SX126x_EnergyPacketDone( uint32_t now );
+
+/*!
+ * \brief Gets the counters, updated up to now
+ *
+ * \param [out] report        The counters
+ * \param [in]  now           Current time [us]
+ */
+void SX126x_EnergyGetReport( EnergyReport_t *report, uint32_t now );
+
+/*!
+ * \brief Converts a charge into energy at ENERGY_SUPPLY_MV
+ *
+ * \param [in]  charge        Charge [nA * us = fC]
+ *
+ * \retval      energy        Energy [uJ], 64 bits: the totals of a few days
+ *                            are past 32 bits
+ */
+uint64_t SX126x_EnergyToMicroJoule( uint64_t charge );
+
+#endif // __SX126x_ENERGY_H__
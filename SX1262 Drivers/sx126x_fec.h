@@ -0,0 +1,60 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_FEC_H__
+#define __SX126x_FEC_H__
+
+#include <stdint.h>
+
+/*!
+ * \brief Largest group: data fragments and parity fragments
+ */
+#define FEC_MAX_DATA                                32
+#define FEC_MAX_PARITY                              8
+
+/*!
+ * \brief Multiplication and inverse in GF(2^8), polynomial 0x11D
+ */
+uint8_t SX126x_GfMul( uint8_t a, uint8_t b );
+uint8_t SX126x_GfInv( uint8_t a );
+
+/*!
+ * \brief Computes the parity fragments of a group, systematic Cauchy
+ *        Reed-Solomon: any k of the k + m fragments rebuild the data
+ *
+ * \param [in]  data          The k data fragments
+ * \param [in]  k             Number of data fragments, up to FEC_MAX_DATA
+ * \param [out] parity        The m parity fragments
+ * \param [in]  m             Number of parity fragments, up to FEC_MAX_PARITY
+ * \param [in]  length        Length of every fragment, the last data fragment
+ *                            padded with zeros
+ */
+void SX126x_FecEncode( uint8_t **data, uint8_t k, uint8_t **parity, uint8_t m, uint16_t length );
+
+/*!
+ * \brief Rebuilds the lost data fragments of a group
+ *
+ * \param [in,out] fragments  The k data then the m parity fragments, the lost
+ *                            data fragments are written to their buffers
+ * \param [in]  received      1 for every fragment received, updated
+ * \param [in]  k             Number of data fragments
+ * \param [in]  m             Number of parity fragments
+ * \param [in]  length        Length of every fragment
+ *
+ * \retval      status        0 if the data is complete, 1 if more than m lost
+ */
+uint8_t SX126x_FecDecode( uint8_t **fragments, uint8_t *received, uint8_t k, uint8_t m, uint16_t length );
+
+#endif // __SX126x_FEC_H__
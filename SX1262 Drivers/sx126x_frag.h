@@ -0,0 +1,127 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_FRAG_H__
+#define __SX126x_FRAG_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Fragment header: source, message id, fragment index, fragment count,
+ *        message size (LSB first)
+ */
+#define FRAG_HEADER_SIZE                            6
+
+/*!
+ * \brief Largest message and largest number of fragments of a message
+ */
+#define FRAG_MAX_MESSAGE                            4096
+#define FRAG_MAX_FRAGMENTS                          32
+
+/*!
+ * \brief Reassembly memory: a pool of blocks shared by all the messages
+ */
+#define FRAG_BLOCK_SIZE                             64
+#define FRAG_POOL_BLOCKS                            64  // 4 KB, at most 64
+
+/*!
+ * \brief Messages reassembled at the same time
+ */
+#define FRAG_CONTEXTS                               4
+
+/*!
+ * \brief A message not completed in this time is dropped, in ms
+ */
+#define FRAG_TIMEOUT_MS                             30000
+
+/*!
+ * \brief Result of a received fragment
+ */
+typedef enum
+{
+    FRAG_INCOMPLETE                         = 0x00, //!< Stored, fragments are missing
+    FRAG_COMPLETE,                                  //!< The message is ready, release it once used
+    FRAG_DUPLICATE,                                 //!< Already received, dropped
+    FRAG_NO_MEMORY,                                 //!< No context or not enough blocks, dropped
+    FRAG_INVALID,                                   //!< Not a fragment of this format, dropped
+}FragStatus_t;
+
+/*!
+ * \brief A reassembled message
+ */
+typedef struct
+{
+    uint8_t       Source;
+    uint8_t       MessageId;
+    uint16_t      Size;
+    uint8_t      *Data;                             //!< In the reassembly pool, valid until SX126x_FragRelease
+}FragMessage_t;
+
+/*!
+ * \brief Resets the transmitter and the reassembly pool
+ *
+ * \param [in]  packetParams  Packet format, PayloadLength is the largest frame
+ */
+void SX126x_FragInit( PacketParams_t *packetParams );
+
+/*!
+ * \brief Starts sending a message, the first fragment goes out now
+ *
+ * \remark Fragments are written from the message straight into the radio
+ *         buffer: it must not change until the last TX done
+ *
+ * \param [in]  source        Address of this device
+ * \param [in]  message       The message
+ * \param [in]  size          Its size, up to FRAG_MAX_MESSAGE
+ *
+ * \retval      status        0 if started, 1 if too large or a message is being sent
+ */
+uint8_t SX126x_FragSend( uint8_t source, uint8_t *message, uint16_t size );
+
+/*!
+ * \brief Sends the next fragment, to be called on TX done
+ *
+ * \retval      done          1 once the last fragment has been sent
+ */
+uint8_t SX126x_FragOnTxDone( void );
+
+/*!
+ * \brief Reads a received fragment from the radio buffer straight into its
+ *        place in the message, to be called on RX done
+ *
+ * \param [out] message       The message when FRAG_COMPLETE is returned
+ *
+ * \retval      status        See FragStatus_t
+ */
+FragStatus_t SX126x_FragReceive( FragMessage_t *message );
+
+/*!
+ * \brief Gives the blocks of a complete message back to the pool
+ */
+void SX126x_FragRelease( FragMessage_t *message );
+
+/*!
+ * \brief Drops the messages not completed within FRAG_TIMEOUT_MS
+ */
+void SX126x_FragExpire( void );
+
+/*!
+ * \brief Gets the number of free blocks of the pool
+ */
+uint8_t SX126x_FragGetFreeBlocks( void );
+
+#endif // __SX126x_FRAG_H__
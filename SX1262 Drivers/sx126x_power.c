@@ -0,0 +1,163 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#include <string.h>
+
+#include "sx126x_power.h"
+#include "sx126x_energy.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+static const uint32_t McuCurrent[MCU_STATES] =
+{
+    [MCU_ACTIVE]      = MCU_ACTIVE_CURRENT_NA,
+    [MCU_IDLE]        = MCU_IDLE_CURRENT_NA,
+    [MCU_STANDBY]     = MCU_STANDBY_CURRENT_NA,
+};
+
+static PowerResidency_t Residency;
+
+/*!
+ * \brief State the MCU is in since LastStamp
+ */
+static McuPowerStates_t McuState = MCU_ACTIVE;
+
+static uint32_t LastStamp = 0;
+
+/*!
+ * \brief Adds the time since the last call to the current MCU state
+ */
+static void PowerAccount( void )
+{
+    uint32_t now = get_time_us( );
+    uint32_t elapsed = now - LastStamp;
+
+    LastStamp = now;
+    Residency.Mcu[McuState] += elapsed;
+}
+
+void SX126x_PowerInit( void )
+{
+    memset( &Residency, 0, sizeof( Residency ) );
+    McuState = MCU_ACTIVE;
+    LastStamp = get_time_us( );
+}
+
+McuPowerStates_t SX126x_PowerSelectState( void )
+{
+    uint32_t nextTask = next_timer_task_us( );
+    bool waitingDio1;
+
+    if( read_pin( BUSY ) )
+    {
+        // The radio is processing a command, BUSY is not an interrupt source
+        return MCU_ACTIVE;
+    }
+    if( SX126xHal_HasPending( ) )
+    {
+        // An interrupt deferred a request after the main loop served them
+        return MCU_ACTIVE;
+    }
+
+    switch( SX126x_GetOperatingMode( ) )
+    {
+        case MODE_TX:
+        case MODE_RX:
+        case MODE_RX_DC:
+        case MODE_CAD:
+            waitingDio1 = true;
+            break;
+
+        default:
+            waitingDio1 = false;
+            break;
+    }
+
+    if( nextTask == 0 )
+    {
+        return MCU_ACTIVE;
+    }
+    if( ( waitingDio1 == false ) && ( nextTask == NO_TIMER_TASK ) )
+    {
+        // Nothing would wake us up
+        return MCU_ACTIVE;
+    }
+    if( ( waitingDio1 == true ) && ( MCU_STANDBY_WAKES_ON_DIO1 == 0 ) )
+    {
+        return MCU_IDLE;
+    }
+    if( nextTask == NO_TIMER_TASK )
+    {
+        return MCU_STANDBY;
+    }
+    if( ( nextTask < POWER_STANDBY_MIN_US ) || ( MCU_STANDBY_KEEPS_TIMER == 0 ) )
+    {
+        return MCU_IDLE;
+    }
+    return MCU_STANDBY;
+}
+
+McuPowerStates_t SX126x_PowerIdle( void )
+{
+    McuPowerStates_t state;
+
+    // An interrupt raised after the decision still wakes the MCU from WFI,
+    // it is served when leaving the critical section
+    CRITICAL_SECTION_ENTER()
+    state = SX126x_PowerSelectState( );
+    if( state != MCU_ACTIVE )
+    {
+        PowerAccount( );
+        McuState = state;
+        mcu_sleep( ( state == MCU_STANDBY ) ? MCU_SLEEP_STANDBY : MCU_SLEEP_IDLE );
+    }
+    CRITICAL_SECTION_LEAVE()
+
+    if( state != MCU_ACTIVE )
+    {
+        // The timer tick is served above, the time base is up to date again
+        PowerAccount( );
+        McuState = MCU_ACTIVE;
+    }
+
+    return state;
+}
+
+void SX126x_PowerGetResidency( PowerResidency_t *residency )
+{
+    PowerAccount( );
+    memcpy( residency, &Residency, sizeof( Residency ) );
+}
+
+uint32_t SX126x_PowerGetEnergyPerPacket( void )
+{
+    uint64_t charge = 0; // nA * us = fC
+    EnergyReport_t radio;
+
+    PowerAccount( );
+    SX126x_EnergyGetReport( &radio, get_time_us( ) );
+    if( radio.Packets == 0 )
+    {
+        return 0;
+    }
+    for( uint8_t i = 0; i < MCU_STATES; i++ )
+    {
+        charge += Residency.Mcu[i] * McuCurrent[i];
+    }
+    for( uint8_t i = 0; i < ENERGY_STATES; i++ )
+    {
+        charge += radio.Charge[i];
+    }
+    return ( uint32_t )( SX126x_EnergyToMicroJoule( charge ) / radio.Packets );
+}
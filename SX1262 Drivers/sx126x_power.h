@@ -0,0 +1,96 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#ifndef __SX126x_POWER_H__
+#define __SX126x_POWER_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Shortest time to the next timer task worth a STANDBY, in us.
+ *        Below this the wake up latency is not paid back
+ */
+#define POWER_STANDBY_MIN_US                        2000
+
+/*!
+ * \brief Typical MCU currents, in nA as the radio ones (SAMD51 at 120 MHz from
+ *        the DFLL)
+ */
+#define MCU_ACTIVE_CURRENT_NA                       8000000
+#define MCU_IDLE_CURRENT_NA                         3000000
+#define MCU_STANDBY_CURRENT_NA                      30000
+
+/*!
+ * \brief Power states of the MCU
+ */
+typedef enum
+{
+    MCU_ACTIVE                              = 0x00,
+    MCU_IDLE,
+    MCU_STANDBY,
+    MCU_STATES,
+}McuPowerStates_t;
+
+/*!
+ * \brief Time spent in every MCU state since SX126x_PowerInit, in us
+ */
+typedef struct
+{
+    uint64_t Mcu[MCU_STATES];                       //!< Indexed by McuPowerStates_t
+}PowerResidency_t;
+
+/*!
+ * \brief Starts the residency accounting
+ */
+void SX126x_PowerInit( void );
+
+/*!
+ * \brief Chooses the MCU state for the current radio operation
+ *
+ * The MCU may sleep only when the radio will raise DIO1 (TX, RX, CAD or RX
+ * duty cycle) or when a timer task is pending, and never while BUSY is high
+ * or requests deferred from the interrupts wait.
+ * STANDBY is used if DIO1 can wake the MCU from it and the next timer task is
+ * far enough, IDLE otherwise.
+ *
+ * \retval      state         The state SX126x_PowerIdle would enter
+ */
+McuPowerStates_t SX126x_PowerSelectState( void );
+
+/*!
+ * \brief Puts the MCU to sleep until the next interrupt, to be called from
+ *        the main loop when there is nothing left to do
+ *
+ * \retval      state         The state the MCU has been in
+ */
+McuPowerStates_t SX126x_PowerIdle( void );
+
+/*!
+ * \brief Gets the residency times, updated up to now
+ *
+ * \param [out] residency     The residency times
+ */
+void SX126x_PowerGetResidency( PowerResidency_t *residency );
+
+/*!
+ * \brief Estimates the MCU and radio energy per packet from the MCU residency
+ *        and the radio energy accounting
+ *
+ * \retval      energy        Energy per packet [uJ], 0 if no packet yet
+ */
+uint32_t SX126x_PowerGetEnergyPerPacket( void );
+
+#endif // __SX126x_POWER_H__
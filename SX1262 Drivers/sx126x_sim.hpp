@@ -0,0 +1,393 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_SIM_HPP__
+#define __SX126x_SIM_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "sx126x.hpp"
+
+/*!
+ * \brief Host simulation of radios sharing the air, to run the code of
+ *        sx126x.hpp and sx126x_coro.hpp on a PC.
+ *
+ * sim::Bus< Id > and sim::Pins< Id > are the policies of the radio Id. The
+ * simulated chip decodes the commands used by the C++ layer: standby, packet
+ * type, frequency, buffer base, DIO IRQ and LoRa packet parameters, buffer
+ * and register access, TX, RX with timeout and CAD. Time only moves in
+ * Air::Advance, which jumps to the next TX end, RX timeout or CAD end. A
+ * packet reaches the radios in RX on the same frequency at the end of its
+ * transmission, with a CRC error if another transmission overlapped it.
+ */
+namespace sx126x::sim
+{
+
+constexpr uint8_t MaxRadios = 8;
+
+/*!
+ * \brief One simulated chip
+ */
+struct Node
+{
+    enum States : uint8_t { Standby, Tx, Rx, Cad };
+
+    uint8_t Buffer[256];
+    uint8_t Frame[264];                             //!< Bytes of the running transaction
+    uint16_t FrameSize;
+    States State;
+    uint32_t Frequency;                             //!< PLL word
+    uint8_t TxBase;
+    uint8_t RxBase;
+    uint8_t Length;                                 //!< LoRa payload length
+    uint8_t RxLength;
+    uint16_t IrqMask;
+    uint16_t Dio1Mask;
+    uint16_t IrqStatus;
+    uint64_t TxStart;
+    uint64_t TxEnd;                                 //!< End of the last transmission, 0 if none
+    uint64_t Deadline;                              //!< End of the TX, RX timeout or CAD, 0 if none
+    void ( *Dio1 )( void *context );
+    void *Context;
+
+    uint8_t StatusByte( ) const
+    {
+        static const uint8_t modes[] = { 0x02, 0x06, 0x05, 0x05 };
+
+        return static_cast< uint8_t >( modes[State] << 4 );
+    }
+
+    /*!
+     * \brief Sets IRQs and raises DIO1 on its rising edge
+     */
+    void Raise( uint16_t irq )
+    {
+        bool before = ( IrqStatus & Dio1Mask ) != 0;
+
+        IrqStatus |= irq & IrqMask;
+        if( !before && ( ( IrqStatus & Dio1Mask ) != 0 ) && ( Dio1 != nullptr ) )
+        {
+            Dio1( Context );
+        }
+    }
+
+    /*!
+     * \brief Answer to a byte of the running transaction
+     */
+    uint8_t Exchange( uint8_t byte )
+    {
+        uint16_t pos = FrameSize;
+        uint8_t answer = StatusByte( );
+
+        if( FrameSize < sizeof( Frame ) )
+        {
+            Frame[FrameSize++] = byte;
+        }
+        if( pos == 0 )
+        {
+            return 0x00;
+        }
+        switch( static_cast< Opcode >( Frame[0] ) )
+        {
+            case Opcode::GetIrqStatus:
+                answer = ( pos == 2 ) ? ( IrqStatus >> 8 ) : ( pos == 3 ) ? IrqStatus : answer;
+                break;
+
+            case Opcode::GetRxBufferStatus:
+                answer = ( pos == 2 ) ? RxLength : ( pos == 3 ) ? RxBase : answer;
+                break;
+
+            case Opcode::ReadBuffer:
+                answer = ( pos >= 3 ) ? Buffer[( Frame[1] + pos - 3 ) & 0xFF] : answer;
+                break;
+
+            case Opcode::ReadRegister:
+                answer = ( pos >= 4 ) ? 0x00 : answer;
+                break;
+
+            default:
+                break;
+        }
+        return answer;
+    }
+
+    /*!
+     * \brief Runs the command of the transaction when NSS goes up
+     */
+    void Execute( uint64_t now, uint64_t airtime )
+    {
+        const uint8_t *p = &Frame[1];
+        uint16_t n = FrameSize;
+
+        FrameSize = 0;
+        if( n == 0 )
+        {
+            return;
+        }
+        switch( static_cast< Opcode >( Frame[0] ) )
+        {
+            case Opcode::SetStandby:
+                State = Standby;
+                Deadline = 0;
+                break;
+
+            case Opcode::SetRfFrequency:
+                Frequency = ( uint32_t )p[0] << 24 | ( uint32_t )p[1] << 16 | ( uint32_t )p[2] << 8 | p[3];
+                break;
+
+            case Opcode::SetBufferBaseAddress:
+                TxBase = p[0];
+                RxBase = p[1];
+                break;
+
+            case Opcode::SetDioIrqParams:
+                IrqMask = ( p[0] << 8 ) | p[1];
+                Dio1Mask = ( p[2] << 8 ) | p[3];
+                break;
+
+            case Opcode::SetPacketParams:
+                Length = p[3];
+                break;
+
+            case Opcode::ClearIrqStatus:
+                IrqStatus &= ~( ( p[0] << 8 ) | p[1] );
+                break;
+
+            case Opcode::WriteBuffer:
+                for( uint16_t i = 2; i < n; i++ )
+                {
+                    Buffer[( Frame[1] + i - 2 ) & 0xFF] = Frame[i];
+                }
+                break;
+
+            case Opcode::SetTx:
+                State = Tx;
+                TxStart = now;
+                Deadline = now + airtime;
+                break;
+
+            case Opcode::SetRx:
+            {
+                uint32_t timeout = ( uint32_t )p[0] << 16 | ( uint32_t )p[1] << 8 | p[2];
+
+                State = Rx;
+                Deadline = ( ( timeout == 0 ) || ( timeout == 0xFFFFFF ) ) ? 0 : now + ( uint64_t )timeout * 1000 / 64;
+                break;
+            }
+
+            case Opcode::SetCad:
+                State = Cad;
+                Deadline = now + 2048;                      // Two symbols at SF7 125 kHz
+                break;
+
+            default:
+                break;
+        }
+    }
+};
+
+/*!
+ * \brief The shared medium and the simulation clock
+ */
+class Air
+{
+public:
+    static inline Node Nodes[MaxRadios];
+    static inline uint64_t Now = 0;                 //!< [us]
+
+    /*!
+     * \brief Crude LoRa time on air, SF7 125 kHz by default
+     */
+    static inline uint32_t PreambleUs = 12544;
+    static inline uint32_t ByteUs = 1024;
+
+    /*!
+     * \brief Connects DIO1 of a radio, e.g. to AsyncRadio::OnDio1
+     */
+    static void Attach( uint8_t id, void ( *dio1 )( void *context ), void *context )
+    {
+        Nodes[id].Dio1 = dio1;
+        Nodes[id].Context = context;
+    }
+
+    static uint64_t Airtime( uint8_t length ) { return PreambleUs + ( uint64_t )length * ByteUs; }
+
+    /*!
+     * \brief Jumps to the next event and runs it
+     *
+     * \retval      progressed    false if no radio is waiting for anything
+     */
+    static bool Advance( )
+    {
+        Node *next = nullptr;
+
+        for( Node &node : Nodes )
+        {
+            if( ( node.Deadline != 0 ) && ( ( next == nullptr ) || ( node.Deadline < next->Deadline ) ) )
+            {
+                next = &node;
+            }
+        }
+        if( next == nullptr )
+        {
+            return false;
+        }
+        Now = next->Deadline;
+        next->Deadline = 0;
+        switch( next->State )
+        {
+            case Node::Tx:
+                next->TxEnd = Now;
+                Deliver( *next );
+                next->State = Node::Standby;
+                next->Raise( static_cast< uint16_t >( Irq::TxDone ) );
+                break;
+
+            case Node::Rx:
+                next->State = Node::Standby;
+                next->Raise( static_cast< uint16_t >( Irq::RxTxTimeout ) );
+                break;
+
+            case Node::Cad:
+                next->State = Node::Standby;
+                next->Raise( static_cast< uint16_t >( Irq::CadDone ) |
+                             ( Busy( *next ) ? static_cast< uint16_t >( Irq::CadActivityDetected ) : 0 ) );
+                break;
+
+            default:
+                break;
+        }
+        return true;
+    }
+
+private:
+    /*!
+     * \brief Another radio transmitting on the frequency of node right now
+     */
+    static bool Busy( const Node &node )
+    {
+        for( const Node &other : Nodes )
+        {
+            if( ( &other != &node ) && ( other.State == Node::Tx ) && ( other.Frequency == node.Frequency ) )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void Deliver( const Node &tx )
+    {
+        bool collision = false;
+
+        for( const Node &other : Nodes )
+        {
+            // Started before this one ended and still on air, or ended after this one started
+            if( ( &other != &tx ) && ( other.Frequency == tx.Frequency ) &&
+                ( ( ( other.State == Node::Tx ) && ( other.TxStart < Now ) ) || ( other.TxEnd > tx.TxStart ) ) )
+            {
+                collision = true;
+            }
+        }
+        for( Node &rx : Nodes )
+        {
+            if( ( rx.State != Node::Rx ) || ( rx.Frequency != tx.Frequency ) )
+            {
+                continue;
+            }
+            rx.State = Node::Standby;
+            rx.Deadline = 0;
+            if( collision )
+            {
+                rx.Raise( static_cast< uint16_t >( Irq::RxDone ) | static_cast< uint16_t >( Irq::CrcError ) );
+                continue;
+            }
+            for( uint16_t i = 0; i < tx.Length; i++ )
+            {
+                rx.Buffer[( rx.RxBase + i ) & 0xFF] = tx.Buffer[( tx.TxBase + i ) & 0xFF];
+            }
+            rx.RxLength = tx.Length;
+            rx.Raise( static_cast< uint16_t >( Irq::RxDone ) );
+        }
+    }
+};
+
+/*!
+ * \brief Bus policy of the simulated radio Id
+ */
+template< uint8_t Id >
+struct Bus
+{
+    static_assert( Id < MaxRadios, "radio id" );
+
+    static void Select( ) { Air::Nodes[Id].FrameSize = 0; }
+    static void Deselect( ) { Air::Nodes[Id].Execute( Air::Now, Air::Airtime( Air::Nodes[Id].Length ) ); }
+
+    static void Transfer( const uint8_t *tx, uint8_t *rx, std::size_t size )
+    {
+        for( std::size_t i = 0; i < size; i++ )
+        {
+            uint8_t answer = Air::Nodes[Id].Exchange( ( tx != nullptr ) ? tx[i] : 0x00 );
+
+            if( rx != nullptr )
+            {
+                rx[i] = answer;
+            }
+        }
+    }
+};
+
+/*!
+ * \brief Pin policy of the simulated radio Id, BUSY is never high
+ */
+template< uint8_t Id >
+struct Pins
+{
+    static bool Busy( ) { return false; }
+
+    static void SetReset( bool level )
+    {
+        if( !level )
+        {
+            Node &node = Air::Nodes[Id];
+
+            node.State = Node::Standby;
+            node.Deadline = 0;
+            node.IrqStatus = 0;
+            node.IrqMask = 0;
+            node.Dio1Mask = 0;
+        }
+    }
+
+    static void DelayMs( uint32_t ms ) { Air::Now += ( uint64_t )ms * 1000; }
+};
+
+/*!
+ * \brief Idle policy for sx126x::coro::Run, moves the simulated time
+ */
+struct Idle
+{
+    template< typename F >
+    static bool Wait( F pending )
+    {
+        return pending( ) || Air::Advance( );
+    }
+};
+
+} // namespace sx126x::sim
+
+#endif // __SX126x_SIM_HPP__
@@ -0,0 +1,158 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#include <string.h>
+
+#include "sx126x_sleep.h"
+#include "sx126x_hal.h"
+
+/*!
+ * \brief Where a shadow entry goes: a command opcode or a register address
+ */
+typedef struct
+{
+    uint8_t       IsRegister;                       //!< 1 if Target is a register address
+    uint16_t      Target;                           //!< Opcode or register address
+}RadioShadowTarget_t;
+
+/*!
+ * \brief Last value written for a configuration block
+ */
+typedef struct
+{
+    uint8_t       Size;
+    uint8_t       Data[SHADOW_MAX_SIZE];
+}RadioShadow_t;
+
+static const RadioShadowTarget_t ShadowTargets[SHADOW_ENTRIES] =
+{
+    [SHADOW_REGULATOR_MODE]            = { 0, RADIO_SET_REGULATORMODE },
+    [SHADOW_TCXO_MODE]                 = { 0, RADIO_SET_TCXOMODE },
+    [SHADOW_RF_SWITCH_MODE]            = { 0, RADIO_SET_RFSWITCHMODE },
+    [SHADOW_PACKET_TYPE]               = { 0, RADIO_SET_PACKETTYPE },
+    [SHADOW_CALIBRATE_IMAGE]           = { 0, RADIO_CALIBRATEIMAGE },
+    [SHADOW_RF_FREQUENCY]              = { 0, RADIO_SET_RFFREQUENCY },
+    [SHADOW_PA_CONFIG]                 = { 0, RADIO_SET_PACONFIG },
+    [SHADOW_TX_PARAMS]                 = { 0, RADIO_SET_TXPARAMS },
+    [SHADOW_MODULATION_PARAMS]         = { 0, RADIO_SET_MODULATIONPARAMS },
+    [SHADOW_PACKET_PARAMS]             = { 0, RADIO_SET_PACKETPARAMS },
+    [SHADOW_BUFFER_BASE_ADDRESS]       = { 0, RADIO_SET_BUFFERBASEADDRESS },
+    [SHADOW_DIO_IRQ_PARAMS]            = { 0, RADIO_CFG_DIOIRQ },
+    [SHADOW_FALLBACK_MODE]             = { 0, RADIO_SET_TXFALLBACKMODE },
+    [SHADOW_CAD_PARAMS]                = { 0, RADIO_SET_CADPARAMS },
+    [SHADOW_STOP_RX_TIMER_ON_PREAMBLE] = { 0, RADIO_SET_STOPRXTIMERONPREAMBLE },
+    [SHADOW_LORA_SYMB_TIMEOUT]         = { 0, RADIO_SET_LORASYMBTIMEOUT },
+    [SHADOW_REG_LORA_SYNCWORD]         = { 1, REG_LR_SYNCWORD },
+    [SHADOW_REG_GFSK_SYNCWORD]         = { 1, REG_LR_SYNCWORDBASEADDRESS },
+    [SHADOW_REG_CRC_SEED]              = { 1, REG_LR_CRCSEEDBASEADDR },
+    [SHADOW_REG_CRC_POLYNOMIAL]        = { 1, REG_LR_CRCPOLYBASEADDR },
+    [SHADOW_REG_WHITENING_SEED]        = { 1, REG_LR_WHITSEEDBASEADDR_MSB },
+    [SHADOW_REG_OCP]                   = { 1, REG_OCP },
+    [SHADOW_REG_RX_GAIN]               = { 1, REG_RX_GAIN },
+};
+
+/*!
+ * \brief Shadow copy of the radio configuration
+ */
+static RadioShadow_t Shadow[SHADOW_ENTRIES];
+
+/*!
+ * \brief One bit per entry holding a value
+ */
+static uint32_t ShadowValid = 0;
+
+/*!
+ * \brief One bit per entry lost by the last sleep
+ */
+static uint32_t ShadowLost = 0;
+
+
+void SX126x_ShadowStore( RadioShadowEntries_t entry, uint8_t *buffer, uint8_t size )
+{
+    if( ( entry >= SHADOW_ENTRIES ) || ( size > SHADOW_MAX_SIZE ) )
+    {
+        return;
+    }
+    Shadow[entry].Size = size;
+    memcpy( Shadow[entry].Data, buffer, size );
+    ShadowValid |= ( 1UL << entry );
+    // Written after the wake up, no need to replay it anymore
+    ShadowLost &= ~( 1UL << entry );
+}
+
+void SX126x_ShadowClear( void )
+{
+    ShadowValid = 0;
+    ShadowLost = 0;
+}
+
+void SX126x_SleepEnter( SleepParams_t sleepConfig )
+{
+    if( sleepConfig.Fields.WarmStart == 1 )
+    {
+        ShadowLost |= SHADOW_WARM_START_LOST;
+    }
+    else
+    {
+        ShadowLost |= SHADOW_COLD_START_LOST;
+    }
+}
+
+uint32_t SX126x_SleepGetLostMask( void )
+{
+    return ShadowLost & ShadowValid;
+}
+
+uint8_t SX126x_SleepRestore( void )
+{
+    uint32_t pending = SX126x_SleepGetLostMask( );
+    uint8_t count = 0;
+    uint8_t calibParam = 0x7F;
+    RadioOperatingModes_t mode = SX126x_GetOperatingMode( );
+
+    // After a wake up the radio is in STDBY_RC, unless the command waking it
+    // up already set the mode it goes to
+    if( ( mode == MODE_SLEEP ) || ( mode == MODE_RX_DC ) )
+    {
+        SX126x_SetOperatingMode( MODE_STDBY_RC );
+    }
+
+    for( uint8_t entry = 0; entry < SHADOW_ENTRIES; entry++ )
+    {
+        if( ( pending & ( 1UL << entry ) ) == 0 )
+        {
+            continue;
+        }
+        if( ShadowTargets[entry].IsRegister == 1 )
+        {
+            SX126xHal_WriteRegister( ShadowTargets[entry].Target, Shadow[entry].Data, Shadow[entry].Size );
+        }
+        else
+        {
+            SX126xHal_WriteCommand( ( uint8_t )ShadowTargets[entry].Target, Shadow[entry].Data, Shadow[entry].Size );
+        }
+        count++;
+        if( entry == SHADOW_TCXO_MODE )
+        {
+            // The calibrations of the cold start ran without the TCXO, redo
+            // them as SX126x_Init does. The image calibration replayed later
+            // goes back to the configured band.
+            SX126xHal_WriteCommand( RADIO_CALIBRATE, &calibParam, 1 );
+            count++;
+        }
+    }
+    ShadowLost = 0;
+
+    return count;
+}
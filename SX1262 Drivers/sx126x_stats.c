@@ -0,0 +1,151 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_stats.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+static RadioStats_t Stats;
+
+static uint32_t LastCollect = 0;
+
+
+void SX126x_StatsInit( void )
+{
+    RadioOperatingModes_t mode;
+
+    SX126xHal_Lock( );
+    memset( &Stats, 0, sizeof( Stats ) );
+    mode = SX126x_GetOperatingMode( );
+    if( ( mode != MODE_SLEEP ) && ( mode != MODE_RX_DC ) )
+    {
+        SX126x_ResetStats( );
+    }
+    LastCollect = get_time_us( );
+    SX126xHal_Unlock( );
+}
+
+void SX126x_StatsProcess( void )
+{
+    if( ( get_time_us( ) - LastCollect ) >= STATS_COLLECT_PERIOD_US )
+    {
+        SX126x_StatsCollect( );
+    }
+}
+
+void SX126x_StatsCollect( void )
+{
+    RxCounter_t counters;
+    RadioOperatingModes_t mode;
+
+    // Read, reset and folded in the totals with no other command in between:
+    // a packet counted by the radio is counted once
+    SX126xHal_Lock( );
+    mode = SX126x_GetOperatingMode( );
+    if( ( mode == MODE_SLEEP ) || ( mode == MODE_RX_DC ) )
+    {
+        // The counters are lost anyway, SetSleep collects them before. In
+        // RX_DC a command would wake the radio out of its duty cycle.
+        SX126xHal_Unlock( );
+        return;
+    }
+    // Reset after each read: the totals never have to guess a wrap around
+    SX126x_GetStats( &counters );
+    SX126x_ResetStats( );
+    LastCollect = get_time_us( );
+
+    Stats.PacketReceived += counters.PacketReceived;
+    Stats.CrcError += counters.CrcError;
+    Stats.LengthError += counters.LengthError;
+    SX126xHal_Unlock( );
+}
+
+void SX126x_StatsOnIrq( uint16_t irqRegs, RadioOperatingModes_t mode )
+{
+    if( irqRegs & IRQ_TX_DONE )
+    {
+        Stats.TxDone++;
+    }
+    if( irqRegs & IRQ_RX_DONE )
+    {
+        if( irqRegs & IRQ_CRC_ERROR )
+        {
+            Stats.RxCrcError++;
+        }
+        else
+        {
+            Stats.RxDone++;
+        }
+    }
+    if( irqRegs & IRQ_HEADER_ERROR )
+    {
+        Stats.HeaderError++;
+    }
+    if( irqRegs & IRQ_PREAMBLE_DETECTED )
+    {
+        Stats.PreambleDetected++;
+    }
+    if( irqRegs & IRQ_SYNCWORD_VALID )
+    {
+        Stats.SyncWordValid++;
+    }
+    if( irqRegs & IRQ_CAD_DONE )
+    {
+        Stats.CadDone++;
+    }
+    if( irqRegs & IRQ_CAD_ACTIVITY_DETECTED )
+    {
+        Stats.CadDetected++;
+    }
+    if( irqRegs & IRQ_RX_TX_TIMEOUT )
+    {
+        if( mode == MODE_TX )
+        {
+            Stats.TxTimeout++;
+        }
+        else
+        {
+            Stats.RxTimeout++;
+        }
+    }
+}
+
+void SX126x_StatsOnDrop( void )
+{
+    Stats.Dropped++;
+}
+
+void SX126x_StatsGet( RadioStats_t *stats )
+{
+    // The IRQ counters are updated by SX126x_ProcessIrqs, which owns the bus
+    SX126xHal_Lock( );
+    SX126x_StatsCollect( );
+    memcpy( stats, &Stats, sizeof( Stats ) );
+    SX126xHal_Unlock( );
+}
+
+uint16_t SX126x_StatsGetPer( void )
+{
+    RadioStats_t stats;
+
+    SX126x_StatsGet( &stats );
+    if( stats.PacketReceived == 0 )
+    {
+        return 0;
+    }
+    return ( uint16_t )( ( ( uint64_t )stats.CrcError + stats.LengthError ) * 1000 / stats.PacketReceived );
+}
@@ -0,0 +1,99 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_STATS_H__
+#define __SX126x_STATS_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Time between two collections of the radio counters, in us. The
+ *        16 bit counters must not wrap in between: 65535 of the shortest
+ *        packets take longer than this.
+ */
+#define STATS_COLLECT_PERIOD_US                     10000000
+
+/*!
+ * \brief Radio and driver counters since SX126x_StatsInit
+ */
+typedef struct
+{
+    // Radio counters, GetStats
+    uint32_t      PacketReceived;                   //!< Packets received, the wrong ones included
+    uint32_t      CrcError;
+    uint32_t      LengthError;                      //!< GFSK: length errors, LoRa: header errors
+    // Driver counters, from the IRQs
+    uint32_t      TxDone;
+    uint32_t      RxDone;                           //!< With a good CRC
+    uint32_t      RxCrcError;
+    uint32_t      HeaderError;
+    uint32_t      PreambleDetected;
+    uint32_t      SyncWordValid;
+    uint32_t      CadDone;
+    uint32_t      CadDetected;
+    uint32_t      TxTimeout;
+    uint32_t      RxTimeout;
+    uint32_t      Dropped;                          //!< Packets dropped by the upper layers
+}RadioStats_t;
+
+/*!
+ * \brief Clears the counters of the radio and of the driver
+ */
+void SX126x_StatsInit( void );
+
+/*!
+ * \brief Collects the radio counters every STATS_COLLECT_PERIOD_US, to be
+ *        called from the main loop
+ */
+void SX126x_StatsProcess( void );
+
+/*!
+ * \brief Adds the radio counters to the totals and resets them, owning the
+ *        bus. Nothing is done while the radio sleeps or is in RX_DC.
+ */
+void SX126x_StatsCollect( void );
+
+/*!
+ * \brief Counts the IRQs, called by SX126x_ProcessIrqs
+ *
+ * \param [in]  irqRegs       The IRQs raised
+ * \param [in]  mode          The operating mode they were raised in
+ */
+void SX126x_StatsOnIrq( uint16_t irqRegs, RadioOperatingModes_t mode );
+
+/*!
+ * \brief Counts a packet dropped by an upper layer (full queue, duplicate,
+ *        wrong address...)
+ */
+void SX126x_StatsOnDrop( void );
+
+/*!
+ * \brief Gets a snapshot of the counters, the radio ones collected first
+ *
+ * \param [out] stats         The counters
+ */
+void SX126x_StatsGet( RadioStats_t *stats );
+
+/*!
+ * \brief Packet error rate seen by the radio: CRC and header or length
+ *        errors over the packets received
+ *
+ * \retval      per           [1/1000]
+ */
+uint16_t SX126x_StatsGetPer( void );
+
+#endif // __SX126x_STATS_H__
@@ -0,0 +1,66 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_SWEEP_H__
+#define __SX126x_SWEEP_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Time for the PLL to lock and the RSSI to settle after entering RX on
+ *        a new channel, in us
+ */
+#define SWEEP_SETTLE_US                             200
+
+/*!
+ * \brief RSSI of a channel over the samples of a sweep, in dBm
+ */
+typedef struct
+{
+    int8_t        Min;
+    int8_t        Avg;
+    int8_t        Max;
+}SweepResult_t;
+
+/*!
+ * \brief Converts a channel plan into frequency words and calibrates the
+ *        image rejection for it, once
+ *
+ * \param [in]  frequencies   The channels [Hz]
+ * \param [out] words         Their frequency words, for SX126x_SweepRun
+ * \param [in]  count         Number of channels
+ *
+ * \retval      status        0 if done, 1 if the channels are not all in the
+ *                            same image calibration band
+ */
+uint8_t SX126x_SweepPrepare( const uint32_t *frequencies, uint32_t *words, uint16_t count );
+
+/*!
+ * \brief Measures the RSSI of every channel: standby on XOSC, frequency word,
+ *        continuous RX, SWEEP_SETTLE_US then back to back GetRssiInst. The
+ *        radio is left in STDBY_RC.
+ *
+ * \param [in]  words         Frequency words from SX126x_SweepPrepare
+ * \param [in]  count         Number of channels
+ * \param [in]  samples       RSSI samples per channel, at least 1
+ * \param [out] results       One per channel
+ *
+ * \retval      rate          Channels swept per second
+ */
+uint32_t SX126x_SweepRun( const uint32_t *words, uint16_t count, uint8_t samples, SweepResult_t *results );
+
+#endif // __SX126x_SWEEP_H__
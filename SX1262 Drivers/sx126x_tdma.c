@@ -0,0 +1,459 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#include <string.h>
+
+#include "sx126x_tdma.h"
+#include "sx126x_hal.h"
+#include "device_specific_implementation.h"
+
+/*!
+ * \brief The slot timer either wakes the radio up ahead of a slot or starts it
+ */
+typedef enum
+{
+    TDMA_PHASE_WAKEUP                       = 0x00,
+    TDMA_PHASE_SLOT,
+}TdmaPhases_t;
+
+static TimeSyncRoles_t Role = TIMESYNC_NODE;
+
+/*!
+ * \brief Packet format, PayloadLength is the largest payload of a slot
+ */
+static ModulationParams_t ModParams;
+static PacketParams_t PacketParams;
+
+static uint8_t Slots = 1;                           // In a superframe
+static uint8_t ContentionSlots = 0;
+static uint32_t SlotLength = 0;                     // [ticks]
+static uint32_t Guard = 0;                          // [ticks]
+
+/*!
+ * \brief How long a receiver waits for the preamble
+ */
+static uint8_t RxSymbols = 0;                       // LoRa [symbols]
+static uint32_t RxTimeout = 0;                      // GFSK [15.625 us]
+
+static TdmaOperations_t Schedule[TDMA_MAX_SLOTS];
+
+/*!
+ * \brief The queued packet, written to the radio buffer once TxStaged
+ */
+static uint8_t TxBuffer[TDMA_MAX_PAYLOAD];
+static uint8_t TxSize = 0;
+static uint8_t TxSlot = 0;
+static volatile uint8_t TxQueued = 0;
+static uint8_t TxStaged = 0;
+
+/*!
+ * \brief Contention slot used in the current superframe
+ */
+static uint8_t ContentionChoice = 1;
+
+static uint32_t Random = 1;
+
+/*!
+ * \brief Scheduler state, owned by the deferred slot handler once started
+ */
+static volatile uint8_t Running = 0;
+static uint8_t Listening = 0;                       // Node waiting for the first beacon
+static uint64_t NextSlot = 0;                       // Slot number since the network time origin
+static TdmaPhases_t Phase = TDMA_PHASE_SLOT;
+static TdmaOperations_t CurrentOp = TDMA_OP_RX;
+static uint8_t BeaconSent = 0;
+static uint8_t ProgrammedLength = 0;
+
+
+static uint32_t TdmaRandom( void )
+{
+    // xorshift32
+    Random ^= Random << 13;
+    Random ^= Random >> 17;
+    Random ^= Random << 5;
+    return Random;
+}
+
+static uint8_t TdmaMaxPayload( void )
+{
+    return ( PacketParams.PacketType == PACKET_TYPE_LORA ) ? PacketParams.Params.LoRa.PayloadLength : PacketParams.Params.Gfsk.PayloadLength;
+}
+
+/*!
+ * \brief Programs the payload length, only when it changes
+ */
+static void TdmaSetLength( uint8_t size )
+{
+    // SetPacketParams converts the GFSK lengths in place, work on a copy
+    PacketParams_t params = PacketParams;
+
+    if( size == ProgrammedLength )
+    {
+        return;
+    }
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        params.Params.LoRa.PayloadLength = size;
+    }
+    else
+    {
+        params.Params.Gfsk.PayloadLength = size;
+    }
+    SX126x_SetPacketParams( &params );
+    ProgrammedLength = size;
+}
+
+static void TdmaStage( void )
+{
+    SX126xHal_WriteBuffer( TDMA_TX_BASE_ADDRESS, TxBuffer, TxSize );
+    TxStaged = 1;
+}
+
+static TdmaOperations_t TdmaSlotOperation( uint8_t slot )
+{
+    TdmaOperations_t op;
+
+    switch( SX126x_TdmaGetSlotType( slot ) )
+    {
+        case TDMA_SLOT_BEACON:
+            return ( Role == TIMESYNC_COORDINATOR ) ? TDMA_OP_TX : TDMA_OP_RX;
+
+        case TDMA_SLOT_CONTENTION:
+            if( ( TxQueued == 1 ) && ( TxSlot == TDMA_CONTENTION ) && ( slot == ContentionChoice ) )
+            {
+                return TDMA_OP_TX;
+            }
+            return ( Role == TIMESYNC_COORDINATOR ) ? TDMA_OP_RX : TDMA_OP_SLEEP;
+
+        default:
+            op = Schedule[slot];
+            if( ( op == TDMA_OP_TX ) && ( ( TxQueued == 0 ) || ( TxSlot != slot ) ) )
+            {
+                return TDMA_OP_SLEEP;
+            }
+            return op;
+    }
+}
+
+static void TdmaOnTimer( void );
+
+/*!
+ * \brief Arms the slot timer for NextSlot
+ */
+static void TdmaArm( void )
+{
+    uint8_t slot = NextSlot % Slots;
+    TdmaOperations_t op = TdmaSlotOperation( slot );
+    uint64_t start = SX126x_TimeSyncNetworkToLocal( NextSlot * SlotLength );
+
+    if( op == TDMA_OP_TX )
+    {
+        // The receivers open their window at the slot boundary
+        start += Guard;
+    }
+    if( ( CurrentOp == TDMA_OP_SLEEP ) && ( op != TDMA_OP_SLEEP ) )
+    {
+        Phase = TDMA_PHASE_WAKEUP;
+        start -= TDMA_WAKEUP_US * TIMESTAMP_TICKS_PER_US;
+    }
+    else
+    {
+        Phase = TDMA_PHASE_SLOT;
+        // The radio is listening, writing the TX buffer now keeps the SPI
+        // transfer out of the slot start
+        if( ( op == TDMA_OP_TX ) && ( CurrentOp == TDMA_OP_RX ) && ( slot != 0 ) && ( TxStaged == 0 ) )
+        {
+            TdmaStage( );
+        }
+    }
+    slot_timer_start( ( uint32_t )start, TdmaOnTimer );
+}
+
+/*!
+ * \brief Slot timer interrupt, no SPI here: the main context may be in the
+ *        middle of a transaction
+ */
+static void TdmaOnTimer( void )
+{
+    SX126xHal_DeferFromIsr( TDMA_REQUEST );
+}
+
+/*!
+ * \brief Deferred slot timer work: one radio command at the slot boundary
+ */
+static void TdmaOnSlot( void )
+{
+    uint8_t slot = NextSlot % Slots;
+    TdmaOperations_t op;
+    SleepParams_t sleep;
+
+    if( Running == 0 )
+    {
+        return;
+    }
+    // The handlers run with the bus released: the commands of the slot go
+    // together
+    SX126xHal_Lock( );
+    if( Phase == TDMA_PHASE_WAKEUP )
+    {
+        // Wakes up and restores the configuration lost by the sleep
+        SX126x_CheckDeviceReady( );
+        CurrentOp = TDMA_OP_RX;
+        op = TdmaSlotOperation( slot );
+        if( ( op == TDMA_OP_TX ) && ( slot != 0 ) && ( TxStaged == 0 ) )
+        {
+            TdmaStage( );
+        }
+        CurrentOp = TDMA_OP_SLEEP;
+        Phase = TDMA_PHASE_SLOT;
+        slot_timer_start( ( uint32_t )( SX126x_TimeSyncNetworkToLocal( NextSlot * SlotLength ) + ( ( op == TDMA_OP_TX ) ? Guard : 0 ) ), TdmaOnTimer );
+        SX126xHal_Unlock( );
+        return;
+    }
+
+    if( ( slot == 0 ) && ( ContentionSlots > 0 ) )
+    {
+        ContentionChoice = 1 + TdmaRandom( ) % ContentionSlots;
+    }
+    op = TdmaSlotOperation( slot );
+    BeaconSent = 0;
+
+    switch( op )
+    {
+        case TDMA_OP_TX:
+            if( slot == 0 )
+            {
+                TdmaSetLength( TIMESYNC_BEACON_SIZE );
+                // Written at the TX base, a staged packet has to be written again
+                TxStaged = 0;
+                BeaconSent = 1;
+                SX126x_TimeSyncSendBeacon( );
+            }
+            else
+            {
+                if( TxStaged == 0 )
+                {
+                    TdmaStage( );
+                }
+                TdmaSetLength( TxSize );
+                SX126x_SetTx( 0 );
+            }
+            break;
+
+        case TDMA_OP_RX:
+            TdmaSetLength( TdmaMaxPayload( ) );
+            SX126x_SetRx( RxTimeout );
+            break;
+
+        default:
+            if( SX126x_GetOperatingMode( ) != MODE_SLEEP )
+            {
+                sleep.Value = 0;
+                sleep.Fields.WarmStart = 1;
+                SX126x_SetSleep( sleep );
+            }
+            break;
+    }
+    CurrentOp = op;
+    NextSlot++;
+    TdmaArm( );
+    SX126xHal_Unlock( );
+}
+
+/*!
+ * \brief Starts the slots from the next boundary
+ */
+static void TdmaBegin( void )
+{
+    uint64_t now = SX126x_TimeSyncGetNetworkTime( );
+
+    Listening = 0;
+    if( PacketParams.PacketType == PACKET_TYPE_LORA )
+    {
+        SX126x_SetLoRaSymbNumTimeout( RxSymbols );
+    }
+    CurrentOp = TDMA_OP_RX;
+    NextSlot = now / SlotLength + 1;
+    // Not enough time to set the first slot up
+    if( ( NextSlot * SlotLength - now ) < Guard )
+    {
+        NextSlot++;
+    }
+    TdmaArm( );
+}
+
+void SX126x_TdmaInit( TimeSyncRoles_t role, ModulationParams_t *modParams, PacketParams_t *packetParams, uint8_t contentionSlots, uint8_t dedicatedSlots )
+{
+    PacketParams_t params;
+    uint32_t timeOnAir;
+    uint32_t symbol;
+
+    Role = role;
+    ModParams = *modParams;
+    PacketParams = *packetParams;
+    if( TdmaMaxPayload( ) > TDMA_MAX_PAYLOAD )
+    {
+        if( PacketParams.PacketType == PACKET_TYPE_LORA )
+        {
+            PacketParams.Params.LoRa.PayloadLength = TDMA_MAX_PAYLOAD;
+        }
+        else
+        {
+            PacketParams.Params.Gfsk.PayloadLength = TDMA_MAX_PAYLOAD;
+        }
+    }
+    if( ( 1 + contentionSlots + dedicatedSlots ) > TDMA_MAX_SLOTS )
+    {
+        dedicatedSlots = TDMA_MAX_SLOTS - 1 - contentionSlots;
+    }
+    ContentionSlots = contentionSlots;
+    Slots = 1 + contentionSlots + dedicatedSlots;
+    memset( Schedule, TDMA_OP_SLEEP, sizeof( Schedule ) );
+
+    // The slot fits the largest packet with a guard on both sides
+    timeOnAir = SX126x_GetTimeOnAir( &ModParams, &PacketParams );
+    Guard = TDMA_GUARD_US * TIMESTAMP_TICKS_PER_US;
+    SlotLength = ( timeOnAir + 2 * TDMA_GUARD_US ) * TIMESTAMP_TICKS_PER_US;
+
+    // The receiver waits the two guards plus the preamble
+    RxTimeout = ( ( timeOnAir + 2 * TDMA_GUARD_US ) * 64 ) / 1000;
+    params = PacketParams;
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        // One more preamble symbol lasts one symbol more
+        params.Params.LoRa.PreambleLength++;
+        symbol = SX126x_GetTimeOnAir( &ModParams, &params ) - timeOnAir;
+        symbol = ( symbol == 0 ) ? 1 : symbol;
+        symbol = PacketParams.Params.LoRa.PreambleLength + ( 2 * TDMA_GUARD_US + symbol - 1 ) / symbol;
+        RxSymbols = ( symbol > 255 ) ? 255 : ( uint8_t )symbol;
+        // The symbol timeout ends the reception
+        RxTimeout = 0;
+    }
+
+    // Beacons are sent in the same modulation
+    params = PacketParams;
+    if( params.PacketType == PACKET_TYPE_LORA )
+    {
+        params.Params.LoRa.PayloadLength = TIMESYNC_BEACON_SIZE;
+    }
+    else
+    {
+        params.Params.Gfsk.PayloadLength = TIMESYNC_BEACON_SIZE;
+    }
+    SX126x_TimeSyncInit( role, SX126x_GetTimeOnAir( &ModParams, &params ) );
+
+    Random = get_timestamp( ) | 1;
+    TxQueued = 0;
+    TxStaged = 0;
+    Running = 0;
+    SX126xHal_SetDeferredHandler( TDMA_REQUEST, TdmaOnSlot );
+}
+
+uint32_t SX126x_TdmaGetSlotLength( void )
+{
+    return SlotLength;
+}
+
+TdmaSlotTypes_t SX126x_TdmaGetSlotType( uint8_t slot )
+{
+    if( slot == 0 )
+    {
+        return TDMA_SLOT_BEACON;
+    }
+    if( slot <= ContentionSlots )
+    {
+        return TDMA_SLOT_CONTENTION;
+    }
+    return TDMA_SLOT_DEDICATED;
+}
+
+void SX126x_TdmaSetSlot( uint8_t slot, TdmaOperations_t operation )
+{
+    if( ( slot < Slots ) && ( SX126x_TdmaGetSlotType( slot ) == TDMA_SLOT_DEDICATED ) )
+    {
+        Schedule[slot] = operation;
+    }
+}
+
+uint8_t SX126x_TdmaQueue( uint8_t slot, uint8_t *payload, uint8_t size )
+{
+    if( ( TxQueued == 1 ) || ( size > TDMA_MAX_PAYLOAD ) )
+    {
+        return 1;
+    }
+    memcpy( TxBuffer, payload, size );
+    CRITICAL_SECTION_ENTER()
+    TxSize = size;
+    TxSlot = slot;
+    TxStaged = 0;
+    TxQueued = 1;
+    CRITICAL_SECTION_LEAVE()
+    return 0;
+}
+
+void SX126x_TdmaStart( void )
+{
+    SX126xHal_Lock( );
+    SX126x_SetBufferBaseAddresses( TDMA_TX_BASE_ADDRESS, TDMA_RX_BASE_ADDRESS );
+    ProgrammedLength = 0;
+    Running = 1;
+    if( SX126x_TimeSyncGetState( ) != TIMESYNC_UNSYNCED )
+    {
+        TdmaBegin( );
+        SX126xHal_Unlock( );
+        return;
+    }
+    // Listen until the first beacon, see SX126x_TdmaOnRxDone
+    Listening = 1;
+    if( PacketParams.PacketType == PACKET_TYPE_LORA )
+    {
+        SX126x_SetLoRaSymbNumTimeout( 0 );
+    }
+    TdmaSetLength( TdmaMaxPayload( ) );
+    SX126x_SetRx( 0xFFFFFF );
+    SX126xHal_Unlock( );
+}
+
+void SX126x_TdmaStop( void )
+{
+    Running = 0;
+    slot_timer_stop( );
+    SX126x_CheckDeviceReady( );
+    SX126x_SetStandby( STDBY_RC );
+}
+
+void SX126x_TdmaOnTxDone( uint32_t timestamp )
+{
+    if( BeaconSent == 1 )
+    {
+        SX126x_TimeSyncOnTxDone( timestamp );
+        return;
+    }
+    TxStaged = 0;
+    TxQueued = 0;
+}
+
+uint8_t SX126x_TdmaOnRxDone( uint8_t *payload, uint8_t size, uint32_t timestamp )
+{
+    if( SX126x_TimeSyncOnBeacon( payload, size, timestamp ) == 0 )
+    {
+        return 0;
+    }
+    if( ( Running == 1 ) && ( Listening == 1 ) )
+    {
+        TdmaBegin( );
+    }
+    return 1;
+}
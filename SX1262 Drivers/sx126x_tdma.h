@@ -0,0 +1,156 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_TDMA_H__
+#define __SX126x_TDMA_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+#include "sx126x_hal.h"
+#include "sx126x_timesync.h"
+
+/*!
+ * \brief Largest superframe: beacon, contention and dedicated slots
+ */
+#define TDMA_MAX_SLOTS                              64
+
+/*!
+ * \brief Time before and after the packet in every slot, for the time sync
+ *        error, the drift between two beacons and the radio turnaround, in us
+ */
+#define TDMA_GUARD_US                               500
+
+/*!
+ * \brief Time to wake the radio up and restore its configuration before a
+ *        slot following a sleeping one, in us
+ */
+#define TDMA_WAKEUP_US                              1000
+
+/*!
+ * \brief The radio buffer is split: a staged packet is not overwritten by
+ *        the receptions of the slots before its own
+ */
+#define TDMA_TX_BASE_ADDRESS                        0x00
+#define TDMA_RX_BASE_ADDRESS                        0x80
+#define TDMA_MAX_PAYLOAD                            128
+
+/*!
+ * \brief Deferred request of the slot timer, see SX126xHal_DeferFromIsr. Not
+ *        to be used by the application while the scheduler is initialized.
+ */
+#define TDMA_REQUEST                                ( HAL_DEFERRED_REQUESTS - 1 )
+
+/*!
+ * \brief Slot argument of SX126x_TdmaQueue for the contention slots
+ */
+#define TDMA_CONTENTION                             0xFF
+
+/*!
+ * \brief Kind of slot, in superframe order
+ */
+typedef enum
+{
+    TDMA_SLOT_BEACON                        = 0x00, //!< First slot, the coordinator sends the beacon
+    TDMA_SLOT_CONTENTION,                           //!< Random access, e.g. to join or to ask for a slot
+    TDMA_SLOT_DEDICATED,                            //!< Owned by one node
+}TdmaSlotTypes_t;
+
+/*!
+ * \brief What the radio does in a dedicated slot
+ */
+typedef enum
+{
+    TDMA_OP_SLEEP                           = 0x00,
+    TDMA_OP_RX,
+    TDMA_OP_TX,                                     //!< Sends the queued packet, sleeps if there is none
+}TdmaOperations_t;
+
+/*!
+ * \brief Sets up the superframe and the time sync
+ *
+ * \remark While the scheduler runs the slot timer interrupt defers the radio
+ *         operations to the HAL (TDMA_REQUEST): they run when a driver call
+ *         ends or in SX126xHal_ProcessPending, which the main loop must reach
+ *         well within TDMA_GUARD_US of every slot boundary. The application
+ *         must only handle the TX done, RX done and timeout events and keep
+ *         off the radio otherwise.
+ *
+ * \param [in]  role              Coordinator or node
+ * \param [in]  modParams         Modulation of all the slots
+ * \param [in]  packetParams      Packet format, with the largest payload of a slot
+ * \param [in]  contentionSlots   Number of contention slots
+ * \param [in]  dedicatedSlots    Number of dedicated slots
+ */
+void SX126x_TdmaInit( TimeSyncRoles_t role, ModulationParams_t *modParams, PacketParams_t *packetParams, uint8_t contentionSlots, uint8_t dedicatedSlots );
+
+/*!
+ * \brief Gets the slot length: time on air of the largest packet plus two guards
+ *
+ * \retval      length        Slot length [timestamp ticks]
+ */
+uint32_t SX126x_TdmaGetSlotLength( void );
+
+/*!
+ * \brief Gets the kind of a slot
+ *
+ * \param [in]  slot          Slot index in the superframe
+ */
+TdmaSlotTypes_t SX126x_TdmaGetSlotType( uint8_t slot );
+
+/*!
+ * \brief Assigns a dedicated slot
+ *
+ * \param [in]  slot          Slot index in the superframe
+ * \param [in]  operation     What the radio does in the slot
+ */
+void SX126x_TdmaSetSlot( uint8_t slot, TdmaOperations_t operation );
+
+/*!
+ * \brief Queues a packet, it is written to the radio before its slot
+ *
+ * \param [in]  slot          A dedicated TX slot or TDMA_CONTENTION
+ * \param [in]  payload       The packet
+ * \param [in]  size          Its size, up to TDMA_MAX_PAYLOAD
+ *
+ * \retval      status        0 if queued, 1 if a packet is already waiting
+ */
+uint8_t SX126x_TdmaQueue( uint8_t slot, uint8_t *payload, uint8_t size );
+
+/*!
+ * \brief Starts the scheduler. A node listens until the first beacon.
+ */
+void SX126x_TdmaStart( void );
+
+/*!
+ * \brief Stops the scheduler, the radio is left in STDBY_RC
+ */
+void SX126x_TdmaStop( void );
+
+/*!
+ * \brief Events to forward from the radio interrupt handling
+ *
+ * \param [in]  timestamp     Time of the event, see SX126x_GetIrqTimestamp
+ */
+void SX126x_TdmaOnTxDone( uint32_t timestamp );
+
+/*!
+ * \brief Forwards a received packet
+ *
+ * \retval      consumed      1 if it was the beacon, 0 if it is for the application
+ */
+uint8_t SX126x_TdmaOnRxDone( uint8_t *payload, uint8_t size, uint32_t timestamp );
+
+#endif // __SX126x_TDMA_H__
@@ -0,0 +1,147 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __SX126x_TIMESYNC_H__
+#define __SX126x_TIMESYNC_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief First byte of a beacon payload
+ */
+#define TIMESYNC_BEACON_TYPE                        0xB5
+
+/*!
+ * \brief Beacon payload: type, sequence number, network time [us] LSB first
+ */
+#define TIMESYNC_BEACON_SIZE                        10
+
+/*!
+ * \brief Number of beacons in the offset and drift regression
+ */
+#define TIMESYNC_WINDOW                             8
+
+/*!
+ * \brief Initial time from SX126x_TimeSyncSendBeacon to the first preamble
+ *        symbol on air, in us. The coordinator refines it on every TX done.
+ */
+#define TIMESYNC_TX_LATENCY_US                      150
+
+/*!
+ * \brief Extra delay of the RX done edge on the node compared to the TX done
+ *        edge on the coordinator, in us. Measure it for your boards.
+ */
+#define TIMESYNC_RX_LATENCY_US                      0
+
+/*!
+ * \brief A beacon this far from the estimated network time restarts the
+ *        regression (coordinator reset, wrong beacon), in us
+ */
+#define TIMESYNC_MAX_ERROR_US                       2000
+
+/*!
+ * \brief Role of the device in the network
+ */
+typedef enum
+{
+    TIMESYNC_COORDINATOR                    = 0x00, //!< Owns the network time and sends the beacons
+    TIMESYNC_NODE,                                  //!< Follows the beacons
+}TimeSyncRoles_t;
+
+/*!
+ * \brief Quality of the network time estimation
+ */
+typedef enum
+{
+    TIMESYNC_UNSYNCED                       = 0x00, //!< No beacon received yet
+    TIMESYNC_OFFSET_ONLY,                           //!< One beacon, drift unknown
+    TIMESYNC_SYNCED,                                //!< Offset and drift estimated
+}TimeSyncStates_t;
+
+/*!
+ * \brief Resets the estimation
+ *
+ * \remark All the times are 64 bit counts of TIMESTAMP_TICKS_PER_US ticks. The
+ *         local time is extended from get_timestamp, it must be read at least
+ *         once every 2^31 ticks (358 s with DIO1_CAPTURE).
+ *
+ * \param [in]  role              Coordinator or node
+ * \param [in]  beaconTimeOnAir   Time on air of a beacon, see SX126x_GetTimeOnAir
+ */
+void SX126x_TimeSyncInit( TimeSyncRoles_t role, uint32_t beaconTimeOnAir );
+
+/*!
+ * \brief Sends a beacon carrying the network time of its first preamble symbol.
+ *        The packet parameters must have a TIMESYNC_BEACON_SIZE payload.
+ */
+void SX126x_TimeSyncSendBeacon( void );
+
+/*!
+ * \brief Coordinator side: measures the actual start of the last beacon to
+ *        refine the TX latency, to be called on TX done
+ *
+ * \param [in]  timestamp     Time of the TX done, see SX126x_GetIrqTimestamp
+ */
+void SX126x_TimeSyncOnTxDone( uint32_t timestamp );
+
+/*!
+ * \brief Node side: adds a received beacon to the estimation
+ *
+ * \param [in]  payload       Received payload
+ * \param [in]  size          Size of the payload
+ * \param [in]  timestamp     Time of the RX done, see SX126x_GetIrqTimestamp
+ *
+ * \retval      accepted      1 if the payload was a beacon, 0 otherwise
+ */
+uint8_t SX126x_TimeSyncOnBeacon( uint8_t *payload, uint8_t size, uint32_t timestamp );
+
+/*!
+ * \brief Gets the quality of the estimation
+ *
+ * \retval      state         The coordinator is always TIMESYNC_SYNCED
+ */
+TimeSyncStates_t SX126x_TimeSyncGetState( void );
+
+/*!
+ * \brief Gets the local time
+ *
+ * \retval      time          Local time [ticks]
+ */
+uint64_t SX126x_TimeSyncGetLocalTime( void );
+
+/*!
+ * \brief Gets the synchronized clock
+ *
+ * \retval      time          Network time [ticks]
+ */
+uint64_t SX126x_TimeSyncGetNetworkTime( void );
+
+/*!
+ * \brief Converts between the local and the network time, e.g. to arm a
+ *        local timer at a network instant
+ */
+uint64_t SX126x_TimeSyncLocalToNetwork( uint64_t local );
+uint64_t SX126x_TimeSyncNetworkToLocal( uint64_t network );
+
+/*!
+ * \brief Gets the estimated drift of the local clock
+ *
+ * \retval      drift         Network minus local rate [ppb]
+ */
+int32_t SX126x_TimeSyncGetDriftPpb( void );
+
+#endif // __SX126x_TIMESYNC_H__
@@ -0,0 +1,485 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "mock_radio.h"
+#include "device_specific_implementation.h"
+
+/*!
+ * \brief Largest transaction: opcode, offset and a whole buffer
+ */
+#define MOCK_FRAME_SIZE                             260
+
+MockRadio_t MockRadios[MOCK_RADIOS];
+
+MockRadio_t *MockRadio = &MockRadios[0];
+
+uint32_t MockTimeUs = 0;
+uint32_t MockTicks = 0;
+uint32_t MockTimeStepUs = 0;
+uint32_t MockNextTimerTaskUs = NO_TIMER_TASK;
+uint32_t MockNssViolations = 0;
+uint32_t MockSpiBytes = 0;
+uint32_t MockIsrSpiAccesses = 0;
+uint32_t MockBusyUs = 0;
+
+void ( *MockOnAccess )( void ) = NULL;
+void ( *MockOnTx )( uint8_t *payload, uint8_t size ) = NULL;
+uint8_t ( *MockOnReadRegister )( uint16_t address ) = NULL;
+void ( *MockOnWriteRegister )( uint16_t address, uint8_t value ) = NULL;
+int16_t ( *MockOnRssi )( void ) = NULL;
+void ( *MockSlotCallback )( void ) = NULL;
+uint32_t MockSlotTimestamp = 0;
+
+/*!
+ * \brief Transaction in progress: bytes sent since NSS went low, bytes read
+ */
+static uint8_t Frame[MOCK_FRAME_SIZE];
+static uint16_t FrameSize = 0;
+static uint16_t ReadIndex = 0;
+static uint8_t NssLow = 0;
+
+/*!
+ * \brief TC0 CC0 and its MC0 flag
+ */
+static uint32_t Capture = 0;
+static uint8_t Captured = 0;
+
+static uint8_t InIsr = 0;
+
+/*!
+ * \brief End of the BUSY period of the last transaction, monotonic clock [ns]
+ */
+static uint64_t BusyUntilNs = 0;
+
+
+static uint64_t MockNowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( uint64_t )now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void MockAccess( void )
+{
+    if( MockOnAccess != NULL )
+    {
+        MockOnAccess( );
+    }
+}
+
+static void MockSpiAccess( void )
+{
+    MockAccess( );
+    if( NssLow != 1 )
+    {
+        MockNssViolations++;
+    }
+    if( InIsr == 1 )
+    {
+        MockIsrSpiAccesses++;
+    }
+}
+
+/*!
+ * \brief Status byte clocked out by the radio: chip mode, no command status
+ */
+static uint8_t MockStatus( void )
+{
+    switch( MockRadio->Mode )
+    {
+        case MODE_STDBY_XOSC:
+            return 0x30;
+        case MODE_FS:
+            return 0x40;
+        case MODE_RX:
+            return 0x50;
+        case MODE_TX:
+            return 0x60;
+        default:
+            return 0x20;
+    }
+}
+
+static void MockAppend( const uint8_t *data, uint8_t size )
+{
+    for( uint8_t i = 0; ( i < size ) && ( FrameSize < MOCK_FRAME_SIZE ); i++ )
+    {
+        Frame[FrameSize++] = data[i];
+    }
+}
+
+static uint8_t MockAnswer( void )
+{
+    uint16_t index = ReadIndex++;
+
+    switch( Frame[0] )
+    {
+        case RADIO_READ_BUFFER:
+            return MockRadio->Buffer[( uint8_t )( Frame[1] + index )];
+        case RADIO_GET_IRQSTATUS:
+            return ( index == 0 ) ? ( uint8_t )( MockRadio->Irq >> 8 ) : ( uint8_t )MockRadio->Irq;
+        case RADIO_GET_RXBUFFERSTATUS:
+            return ( index == 0 ) ? MockRadio->RxLength : MockRadio->RxStart;
+        case RADIO_GET_PACKETSTATUS:
+            return ( index < 3 ) ? MockRadio->PacketStatus[index] : 0;
+        case RADIO_GET_RSSIINST:
+            return ( MockOnRssi != NULL ) ? ( uint8_t )( -2 * MockOnRssi( ) ) : 0;
+        case RADIO_READ_REGISTER:
+            return ( MockOnReadRegister != NULL ) ? MockOnReadRegister( ( ( Frame[1] << 8 ) | Frame[2] ) + index ) : 0;
+        default:
+            return 0;
+    }
+}
+
+/*!
+ * \brief Runs a command once NSS goes high
+ */
+static void MockExecute( void )
+{
+    MockRadio_t *radio = MockRadio;
+
+    if( FrameSize == 0 )
+    {
+        return;
+    }
+    if( radio->LogSize < MOCK_LOG_SIZE )
+    {
+        radio->Log[radio->LogSize++] = Frame[0];
+    }
+
+    switch( Frame[0] )
+    {
+        case RADIO_WRITE_BUFFER:
+            for( uint16_t i = 2; i < FrameSize; i++ )
+            {
+                radio->Buffer[( uint8_t )( Frame[1] + i - 2 )] = Frame[i];
+            }
+            break;
+
+        case RADIO_WRITE_REGISTER:
+            for( uint16_t i = 3; ( i < FrameSize ) && ( MockOnWriteRegister != NULL ); i++ )
+            {
+                MockOnWriteRegister( ( ( Frame[1] << 8 ) | Frame[2] ) + i - 3, Frame[i] );
+            }
+            break;
+
+        case RADIO_SET_PACKETTYPE:
+            radio->PacketType = Frame[1];
+            break;
+
+        case RADIO_SET_PACKETPARAMS:
+            // Preamble, header type, length for LoRa. Preamble, detector, sync
+            // word length, address filtering, header type, length for GFSK.
+            radio->PayloadLength = ( radio->PacketType == PACKET_TYPE_LORA ) ? Frame[4] : Frame[7];
+            break;
+
+        case RADIO_SET_RFFREQUENCY:
+            radio->Frequency = ( ( uint32_t )Frame[1] << 24 ) | ( ( uint32_t )Frame[2] << 16 ) | ( ( uint32_t )Frame[3] << 8 ) | Frame[4];
+            break;
+
+        case RADIO_SET_BUFFERBASEADDRESS:
+            radio->TxBase = Frame[1];
+            radio->RxBase = Frame[2];
+            break;
+
+        case RADIO_CLR_IRQSTATUS:
+            radio->Irq &= ~( ( uint16_t )( Frame[1] << 8 ) | Frame[2] );
+            break;
+
+        case RADIO_SET_STANDBY:
+            radio->Mode = ( Frame[1] == 0 ) ? MODE_STDBY_RC : MODE_STDBY_XOSC;
+            break;
+
+        case RADIO_SET_FS:
+            radio->Mode = MODE_FS;
+            break;
+
+        case RADIO_SET_SLEEP:
+            radio->Mode = MODE_SLEEP;
+            radio->Asleep = 1;
+            break;
+
+        case RADIO_SET_RX:
+            radio->Mode = MODE_RX;
+            radio->RxTimeout = ( ( uint32_t )Frame[1] << 16 ) | ( ( uint32_t )Frame[2] << 8 ) | Frame[3];
+            radio->RxCount++;
+            break;
+
+        case RADIO_SET_TX:
+        {
+            uint8_t payload[256];
+
+            radio->Mode = MODE_TX;
+            radio->TxCount++;
+            for( uint16_t i = 0; i < radio->PayloadLength; i++ )
+            {
+                payload[i] = radio->Buffer[( uint8_t )( radio->TxBase + i )];
+            }
+            if( MockOnTx != NULL )
+            {
+                MockOnTx( payload, radio->PayloadLength );
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void MockReset( void )
+{
+    memset( MockRadios, 0, sizeof( MockRadios ) );
+    for( uint8_t i = 0; i < MOCK_RADIOS; i++ )
+    {
+        MockRadios[i].Mode = MODE_STDBY_RC;
+        MockRadios[i].RxBase = 0x80;
+    }
+    MockRadio = &MockRadios[0];
+    MockTimeUs = 0;
+    MockTicks = 0;
+    MockTimeStepUs = 0;
+    MockNextTimerTaskUs = NO_TIMER_TASK;
+    MockNssViolations = 0;
+    MockSpiBytes = 0;
+    MockIsrSpiAccesses = 0;
+    MockBusyUs = 0;
+    BusyUntilNs = 0;
+    MockOnAccess = NULL;
+    MockOnTx = NULL;
+    MockOnReadRegister = NULL;
+    MockOnWriteRegister = NULL;
+    MockOnRssi = NULL;
+    MockSlotCallback = NULL;
+    FrameSize = 0;
+    NssLow = 0;
+    Captured = 0;
+}
+
+void MockSelect( uint8_t radio )
+{
+    MockRadio = &MockRadios[radio];
+}
+
+void MockReceive( const uint8_t *payload, uint8_t size )
+{
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        MockRadio->Buffer[( uint8_t )( MockRadio->RxBase + i )] = payload[i];
+    }
+    MockRadio->RxLength = size;
+    MockRadio->RxStart = MockRadio->RxBase;
+    MockRadio->Irq |= IRQ_RX_DONE;
+}
+
+void MockCaptureDio1( uint32_t ticks )
+{
+    Capture = ticks;
+    Captured = 1;
+}
+
+void MockRunIsr( void ( *isr )( void ) )
+{
+    uint8_t nested = InIsr;
+
+    InIsr = 1;
+    isr( );
+    InIsr = nested;
+}
+
+void MockLoRaProfile( ModulationParams_t *modParams, PacketParams_t *packetParams, RadioLoRaSpreadingFactors_t sf, uint8_t payload )
+{
+    memset( modParams, 0, sizeof( ModulationParams_t ) );
+    modParams->PacketType = PACKET_TYPE_LORA;
+    modParams->Params.LoRa.SpreadingFactor = sf;
+    modParams->Params.LoRa.Bandwidth = LORA_BW_125;
+    modParams->Params.LoRa.CodingRate = LORA_CR_4_5;
+    modParams->Params.LoRa.LowDatarateOptimize = ( sf >= LORA_SF11 ) ? 1 : 0;
+
+    memset( packetParams, 0, sizeof( PacketParams_t ) );
+    packetParams->PacketType = PACKET_TYPE_LORA;
+    packetParams->Params.LoRa.PreambleLength = 8;
+    packetParams->Params.LoRa.HeaderType = LORA_PACKET_EXPLICIT;
+    packetParams->Params.LoRa.PayloadLength = payload;
+    packetParams->Params.LoRa.CrcMode = LORA_CRC_ON;
+    packetParams->Params.LoRa.InvertIQ = LORA_IQ_NORMAL;
+}
+
+uint32_t __get_IPSR( void )
+{
+    // Any exception number, the driver only tests for 0
+    return InIsr;
+}
+
+uint8_t read_pin( const uint8_t pin )
+{
+    MockAccess( );
+    if( pin == BUSY )
+    {
+        return ( MockRadio->Asleep == 1 ) || ( ( MockBusyUs != 0 ) && ( MockNowNs( ) < BusyUntilNs ) );
+    }
+    if( pin == DIO1 )
+    {
+        return ( MockRadio->Irq != 0 ) ? 1 : 0;
+    }
+    return 0;
+}
+
+void write_pin( const uint8_t pin, const uint8_t status )
+{
+    MockAccess( );
+    if( pin != NSS )
+    {
+        return;
+    }
+    if( status == false )
+    {
+        if( ( NssLow++ != 0 ) || ( InIsr == 1 ) )
+        {
+            MockNssViolations++;
+        }
+        // The falling edge of NSS wakes the radio up
+        if( MockRadio->Asleep == 1 )
+        {
+            MockRadio->Asleep = 0;
+            MockRadio->Mode = MODE_STDBY_RC;
+        }
+        FrameSize = 0;
+        ReadIndex = 0;
+    }
+    else if( NssLow > 0 )
+    {
+        if( --NssLow == 0 )
+        {
+            MockExecute( );
+            if( MockBusyUs != 0 )
+            {
+                BusyUntilNs = MockNowNs( ) + MockBusyUs * 1000ULL;
+            }
+        }
+    }
+    MockAccess( );
+}
+
+int32_t SPI_init( void )
+{
+    return ERR_NONE;
+}
+
+int32_t SendSpi( uint8_t *data, uint8_t len )
+{
+    MockSpiAccess( );
+    MockAppend( data, len );
+    MockSpiBytes += len;
+    return len;
+}
+
+int32_t ReadSpi( uint8_t *rx_data, uint8_t len )
+{
+    MockSpiAccess( );
+    MockSpiBytes += len;
+    for( uint8_t i = 0; i < len; i++ )
+    {
+        rx_data[i] = MockAnswer( );
+    }
+    return len;
+}
+
+int32_t TransferSpi( uint8_t *tx_data, uint8_t *rx_data, uint8_t len )
+{
+    MockSpiAccess( );
+    MockAppend( tx_data, len );
+    MockSpiBytes += len;
+    for( uint8_t i = 0; i < len; i++ )
+    {
+        rx_data[i] = MockStatus( );
+    }
+    return len;
+}
+
+void IRQ_Init( void )
+{
+}
+
+void delay_ms( const uint16_t ms )
+{
+    MockTimeUs += ( uint32_t )ms * 1000;
+}
+
+void delay_us( const uint16_t us )
+{
+    MockTimeUs += us;
+}
+
+void mcu_sleep( const uint8_t mode )
+{
+}
+
+uint32_t get_time_us( void )
+{
+    uint32_t now = MockTimeUs;
+
+    MockTimeUs += MockTimeStepUs;
+    return now;
+}
+
+uint32_t next_timer_task_us( void )
+{
+    return MockNextTimerTaskUs;
+}
+
+void timer_task_start( struct timer_task *task, uint32_t ms, void ( *cb )( const struct timer_task *const ) )
+{
+}
+
+void timer_task_stop( struct timer_task *task )
+{
+}
+
+void DIO1_CaptureInit( void )
+{
+    Captured = 0;
+}
+
+uint32_t get_timestamp( void )
+{
+    return MockTicks;
+}
+
+uint32_t DIO1_GetTimestamp( void )
+{
+    // Reading CC0 clears MC0, as on TC0
+    if( Captured == 1 )
+    {
+        Captured = 0;
+        return Capture;
+    }
+    return get_timestamp( );
+}
+
+bool slot_timer_start( uint32_t timestamp, void ( *callback )( void ) )
+{
+    MockSlotTimestamp = timestamp;
+    MockSlotCallback = callback;
+    return true;
+}
+
+void slot_timer_stop( void )
+{
+    MockSlotCallback = NULL;
+}
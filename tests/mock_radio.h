@@ -0,0 +1,169 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __MOCK_RADIO_H__
+#define __MOCK_RADIO_H__
+
+#include <stdint.h>
+
+#include "sx126x_commands.h"
+
+/*!
+ * \brief Radios of the simulations, the driver talks to MockRadio
+ */
+#define MOCK_RADIOS                                 4
+
+/*!
+ * \brief Opcodes kept in the log of a radio
+ */
+#define MOCK_LOG_SIZE                               256
+
+/*!
+ * \brief A radio on the other side of the SPI bus: the data buffer and the
+ *        state the commands of the driver change
+ */
+typedef struct
+{
+    uint8_t       Buffer[256];
+    uint8_t       TxBase;
+    uint8_t       RxBase;
+    uint8_t       PacketType;
+    uint8_t       PayloadLength;                    //!< Of the last SetPacketParams
+    RadioOperatingModes_t Mode;
+    uint8_t       Asleep;                           //!< BUSY stays high until NSS goes low
+    uint32_t      RxTimeout;                        //!< Of the last SetRx
+    uint32_t      Frequency;                        //!< Word of the last SetRfFrequency
+    uint16_t      Irq;
+    uint8_t       RxLength;
+    uint8_t       RxStart;
+    uint8_t       PacketStatus[3];
+    uint32_t      TxCount;
+    uint32_t      RxCount;
+    uint8_t       Log[MOCK_LOG_SIZE];               //!< Opcode of every transaction
+    uint16_t      LogSize;
+}MockRadio_t;
+
+extern MockRadio_t MockRadios[MOCK_RADIOS];
+
+extern MockRadio_t *MockRadio;
+
+/*!
+ * \brief Time of get_time_us and counter of get_timestamp, set by the tests
+ */
+extern uint32_t MockTimeUs;
+extern uint32_t MockTicks;
+
+/*!
+ * \brief Added to MockTimeUs at every get_time_us, for the busy waits
+ */
+extern uint32_t MockTimeStepUs;
+
+/*!
+ * \brief Returned by next_timer_task_us, NO_TIMER_TASK after MockReset
+ */
+extern uint32_t MockNextTimerTaskUs;
+
+/*!
+ * \brief Transactions with a wrong NSS framing: nested, or SPI bytes with
+ *        NSS high
+ */
+extern uint32_t MockNssViolations;
+
+/*!
+ * \brief BUSY stays high this long after every transaction, in real time,
+ *        for the tests with threads [us], 0 after MockReset
+ */
+extern uint32_t MockBusyUs;
+
+/*!
+ * \brief Bytes clocked on the SPI bus, both ways
+ */
+extern uint32_t MockSpiBytes;
+
+/*!
+ * \brief Called on every pin and SPI access, a test raises its simulated
+ *        interrupts from there
+ */
+extern void ( *MockOnAccess )( void );
+
+/*!
+ * \brief Called when the current radio starts a transmission, with the payload
+ *        in its buffer at TxBase
+ */
+extern void ( *MockOnTx )( uint8_t *payload, uint8_t size );
+
+/*!
+ * \brief Registers of the current radio, read and written one byte at a
+ *        time, 0 is read when no function is set
+ */
+extern uint8_t ( *MockOnReadRegister )( uint16_t address );
+extern void ( *MockOnWriteRegister )( uint16_t address, uint8_t value );
+
+/*!
+ * \brief RSSI of the current radio given to GetRssiInst [dBm], 0 is read
+ *        when no function is set
+ */
+extern int16_t ( *MockOnRssi )( void );
+
+/*!
+ * \brief Slot timer armed by slot_timer_start, NULL if stopped
+ */
+extern void ( *MockSlotCallback )( void );
+extern uint32_t MockSlotTimestamp;
+
+/*!
+ * \brief Resets every radio and the mock state, MockRadio is the first radio
+ */
+void MockReset( void );
+
+/*!
+ * \brief Selects the radio the driver talks to
+ */
+void MockSelect( uint8_t radio );
+
+/*!
+ * \brief Puts a received packet in the buffer of the current radio at RxBase
+ *        and raises RX done
+ */
+void MockReceive( const uint8_t *payload, uint8_t size );
+
+/*!
+ * \brief A DIO1 edge at a time stamp, captured as TC0 CC0 does
+ */
+void MockCaptureDio1( uint32_t ticks );
+
+/*!
+ * \brief Runs a function as an interrupt: IN_INTERRUPT( ) is true and every
+ *        SPI access from it counts as a violation
+ */
+void MockRunIsr( void ( *isr )( void ) );
+
+/*!
+ * \brief SPI accesses made from MockRunIsr
+ */
+extern uint32_t MockIsrSpiAccesses;
+
+/*!
+ * \brief LoRa profile of the simulations: BW 125 kHz, CR 4/5, 8 symbols of
+ *        preamble, explicit header and CRC
+ *
+ * \param [out] modParams     Modulation
+ * \param [out] packetParams  Packet format
+ * \param [in]  sf            Spreading factor
+ * \param [in]  payload       Payload length
+ */
+void MockLoRaProfile( ModulationParams_t *modParams, PacketParams_t *packetParams, RadioLoRaSpreadingFactors_t sf, uint8_t payload );
+
+#endif // __MOCK_RADIO_H__
@@ -0,0 +1,11 @@
+// Host stub of the Atmel Start pin map, see tests/mock_radio.c
+#ifndef ATMEL_START_PINS_H_INCLUDED
+#define ATMEL_START_PINS_H_INCLUDED
+
+#define DIO1 64
+#define LED 33
+#define NSS 82
+#define RST 83
+#define BUSY 84
+
+#endif
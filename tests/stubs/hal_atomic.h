@@ -0,0 +1,16 @@
+// Host stub of the ASF4 header, see tests/mock_radio.c
+#ifndef HAL_ATOMIC_H_INCLUDED
+#define HAL_ATOMIC_H_INCLUDED
+
+#include <stdint.h>
+
+// A single host thread plays the interrupts, nothing to mask
+#define CRITICAL_SECTION_ENTER() {
+#define CRITICAL_SECTION_LEAVE() }
+
+#define __NOP()
+
+// Non zero while the mock runs a simulated interrupt
+uint32_t __get_IPSR(void);
+
+#endif
@@ -0,0 +1,2 @@
+// Host stub of the ASF4 header, see tests/mock_radio.c
+#include "hal_gpio.h"
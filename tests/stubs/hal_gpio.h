@@ -0,0 +1,20 @@
+// Host stub of the ASF4 header, see tests/mock_radio.c
+#ifndef HAL_GPIO_H_INCLUDED
+#define HAL_GPIO_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hal_atomic.h"
+
+#define ERR_NONE 0
+#define ERR_BUSY -4
+#define ERR_TIMEOUT -8
+#define ERR_INVALID_ARG -13
+#define ERR_NO_RESOURCE -28
+
+void delay_ms(const uint16_t ms);
+
+void delay_us(const uint16_t us);
+
+#endif
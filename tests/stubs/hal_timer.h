@@ -0,0 +1,21 @@
+// Host stub of the ASF4 header, see tests/mock_radio.c
+#ifndef HAL_TIMER_H_INCLUDED
+#define HAL_TIMER_H_INCLUDED
+
+#include "hal_gpio.h"
+
+struct list_element {
+	void *next;
+};
+
+enum timer_task_mode { TIMER_TASK_ONE_SHOT, TIMER_TASK_REPEAT };
+
+struct timer_task {
+	struct list_element elem;
+	uint32_t            time_label;
+	uint32_t            interval;
+	void (*cb)(const struct timer_task *const timer_task);
+	enum timer_task_mode mode;
+};
+
+#endif
@@ -0,0 +1,2 @@
+// Host stub of the Atmel Start configuration
+#define CONF_EIC_ASYNCH0 1
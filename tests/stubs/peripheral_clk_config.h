@@ -0,0 +1,8 @@
+// Host stub of the Atmel Start configuration, TC7 on the 48 MHz generator
+#ifndef PERIPHERAL_CLK_CONFIG_H_INCLUDED
+#define PERIPHERAL_CLK_CONFIG_H_INCLUDED
+
+#define CONF_GCLK_TC7_SRC 0
+#define CONF_GCLK_TC7_FREQUENCY 48000000
+
+#endif
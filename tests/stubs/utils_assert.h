@@ -0,0 +1,10 @@
+// Host stub of the ASF4 header, see tests/mock_radio.c
+#ifndef UTILS_ASSERT_H_INCLUDED
+#define UTILS_ASSERT_H_INCLUDED
+
+#include <assert.h>
+#include <stdbool.h>
+
+#define ASSERT(condition) assert(condition)
+
+#endif
@@ -0,0 +1,80 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/*!
+ * \brief Checks of the test program, a failed one is printed and the program
+ *        goes on
+ */
+static uint32_t TestChecks = 0;
+static uint32_t TestFailures = 0;
+
+#define CHECK( condition )                                                              \
+    do                                                                                  \
+    {                                                                                   \
+        TestChecks++;                                                                   \
+        if( !( condition ) )                                                            \
+        {                                                                               \
+            TestFailures++;                                                             \
+            printf( "%s:%d: CHECK( %s ) failed\n", __FILE__, __LINE__, #condition );    \
+        }                                                                               \
+    }while( 0 )
+
+/*!
+ * \brief Name of the build of a test made with other flags, see the Makefile
+ */
+#ifndef TEST_VARIANT
+#define TEST_VARIANT                                ""
+#endif
+
+/*!
+ * \brief Prints the summary, to be returned from main
+ */
+static inline int TestEnd( const char *name )
+{
+    printf( "%s%s%s: %u checks, %u failed\n", name, ( TEST_VARIANT[0] != '\0' ) ? "_" : "", TEST_VARIANT,
+            TestChecks, TestFailures );
+    return ( TestFailures == 0 ) ? 0 : 1;
+}
+
+/*!
+ * \brief Pseudo-random numbers, the same sequence on every run
+ */
+static uint32_t TestSeed = 12345;
+
+static inline uint32_t TestRandom( void )
+{
+    TestSeed = TestSeed * 1103515245 + 12345;
+    return TestSeed >> 16;
+}
+
+/*!
+ * \brief Monotonic time for the benchmarks, in ns
+ */
+static inline uint64_t TestNowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( uint64_t )now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#endif // __TEST_H__
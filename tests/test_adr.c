@@ -0,0 +1,310 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Adaptive data rate: a gateway and its nodes on links of every quality,
+ * both ends of each link running the engine and negotiating in-band over a
+ * fading channel. The rate each link settles on, the packets it delivers
+ * once settled, the airtime saved against SF12, and the fall back when a
+ * link degrades.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_adr.h"
+
+/*!
+ * \brief The node end of a link, the functions of a second instance
+ */
+void Peer_SX126x_AdrInit( uint8_t defaultRate );
+void Peer_SX126x_AdrOnPacket( uint8_t peer, PacketStatus_t *pktStatus );
+void Peer_SX126x_AdrOnMiss( uint8_t peer );
+uint8_t Peer_SX126x_AdrGetRate( uint8_t peer );
+uint8_t Peer_SX126x_AdrOnFrame( uint8_t peer, uint8_t *payload, uint8_t size, uint8_t *answer );
+void Peer_SX126x_AdrOnAnswerSent( uint8_t peer );
+
+#define TEST_GATEWAY                                0
+#define TEST_LINKS                                  6
+#define TEST_ROUNDS                                 600
+#define TEST_SETTLED                                300     // Rounds counted once the rates settled
+#define TEST_REQUEST_PERIOD                         16      // Rounds between two rate requests
+#define TEST_PAYLOAD                                20
+#define TEST_FADING_QDB                             8       // Largest fade or gain of a packet [0.25 dB]
+
+/*!
+ * \brief A node and the mean SNR of its link, at 125 kHz [dB]
+ */
+typedef struct
+{
+    uint8_t       Address;
+    int8_t        Snr;
+    uint8_t       Rate;                             //!< Settled on
+    uint32_t      Sent;
+    uint32_t      Delivered;
+    uint64_t      Airtime;                          //!< Of the settled rounds [us]
+}TestLink_t;
+
+static TestLink_t Links[TEST_LINKS] =
+{
+    { 1, -17, 0, 0, 0, 0 }, { 2, -12, 0, 0, 0, 0 }, { 3, -6, 0, 0, 0, 0 },
+    { 4, 0, 0, 0, 0, 0 },   { 5, 6, 0, 0, 0, 0 },   { 6, 12, 0, 0, 0, 0 },
+};
+
+/*!
+ * \brief Time on air of a packet at a rate
+ */
+static uint32_t TestAirtime( uint8_t rate )
+{
+    const AdrDataRate_t *dataRate = SX126x_AdrGetDataRate( rate );
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+
+    MockLoRaProfile( &modParams, &packetParams, dataRate->SpreadingFactor, TEST_PAYLOAD );
+    modParams.Params.LoRa.Bandwidth = dataRate->Bandwidth;
+    modParams.Params.LoRa.CodingRate = dataRate->CodingRate;
+    modParams.Params.LoRa.LowDatarateOptimize = ( dataRate->SpreadingFactor >= LORA_SF11 ) && ( dataRate->Bandwidth == LORA_BW_125 );
+    return SX126x_GetTimeOnAir( &modParams, &packetParams );
+}
+
+/*!
+ * \brief A packet over a link: both ends must use the same rate, and the
+ *        faded SNR in the bandwidth of the rate must clear its floor
+ *
+ * \param [out] status        What the receiver measured
+ *
+ * \retval      received      1 if the packet got through
+ */
+static uint8_t TestChannel( const TestLink_t *link, uint8_t txRate, uint8_t rxRate, PacketStatus_t *status )
+{
+    const AdrDataRate_t *dataRate = SX126x_AdrGetDataRate( txRate );
+    int16_t snr = 4 * link->Snr - dataRate->NoiseOffset + ( int16_t )( TestRandom( ) % ( 2 * TEST_FADING_QDB + 1 ) ) - TEST_FADING_QDB;
+
+    memset( status, 0, sizeof( PacketStatus_t ) );
+    status->packetType = PACKET_TYPE_LORA;
+    status->Params.LoRa.SnrPkt = ( int8_t )( snr / 4 );
+    status->Params.LoRa.RssiPkt = -120;
+    return ( txRate == rxRate ) && ( snr >= dataRate->RequiredSnr );
+}
+
+/*!
+ * \brief One round of a link: an uplink, a downlink, and now and then a rate
+ *        request of the gateway with the answer of the node
+ */
+static void TestRound( TestLink_t *link, uint32_t round, uint8_t settled )
+{
+    uint8_t gatewayRate = SX126x_AdrGetRate( link->Address );
+    uint8_t nodeRate = Peer_SX126x_AdrGetRate( TEST_GATEWAY );
+    PacketStatus_t status;
+    uint8_t request[ADR_REQUEST_SIZE];
+    uint8_t answer[ADR_ANSWER_SIZE];
+    uint8_t size;
+
+    if( TestChannel( link, nodeRate, gatewayRate, &status ) )
+    {
+        SX126x_AdrOnPacket( link->Address, &status );
+        link->Delivered += settled;
+    }
+    else
+    {
+        SX126x_AdrOnMiss( link->Address );
+    }
+    link->Sent += settled;
+    link->Airtime += settled ? TestAirtime( nodeRate ) : 0;
+
+    // The downlink of the gateway, at the rate it had for the uplink
+    if( TestChannel( link, gatewayRate, nodeRate, &status ) )
+    {
+        Peer_SX126x_AdrOnPacket( TEST_GATEWAY, &status );
+    }
+    else
+    {
+        Peer_SX126x_AdrOnMiss( TEST_GATEWAY );
+    }
+
+    if( ( round % TEST_REQUEST_PERIOD ) != 0 )
+    {
+        return;
+    }
+    size = SX126x_AdrBuildRequest( link->Address, request );
+    if( ( size == 0 ) || !TestChannel( link, gatewayRate, nodeRate, &status ) )
+    {
+        return;
+    }
+    size = Peer_SX126x_AdrOnFrame( TEST_GATEWAY, request, size, answer );
+    CHECK( size == ADR_ANSWER_SIZE );
+    // The answer goes out at the old rate, the node switches after it
+    if( TestChannel( link, nodeRate, gatewayRate, &status ) )
+    {
+        SX126x_AdrOnFrame( link->Address, answer, size, request );
+    }
+    Peer_SX126x_AdrOnAnswerSent( TEST_GATEWAY );
+}
+
+/*!
+ * \brief Runs a link alone: the node end only knows one gateway
+ */
+static void TestLink( TestLink_t *link, uint32_t rounds, uint32_t settle )
+{
+    for( uint32_t round = 1; round <= rounds; round++ )
+    {
+        TestRound( link, round, round > settle );
+    }
+}
+
+static void TestBasics( void )
+{
+    uint8_t request[ADR_REQUEST_SIZE];
+    uint8_t answer[ADR_ANSWER_SIZE];
+    PacketStatus_t status;
+
+    SX126x_AdrInit( 0 );
+    CHECK( SX126x_AdrGetDataRate( ADR_DATA_RATES ) == NULL );
+    CHECK( SX126x_AdrGetRate( 7 ) == 0 );
+    // Nothing heard, nothing to ask
+    CHECK( SX126x_AdrBuildRequest( 7, request ) == 0 );
+
+    // A strong peer: faster only once the history is full
+    memset( &status, 0, sizeof( status ) );
+    status.packetType = PACKET_TYPE_LORA;
+    status.Params.LoRa.SnrPkt = 10;
+    for( uint8_t i = 0; i < ADR_HISTORY - 1; i++ )
+    {
+        SX126x_AdrOnPacket( 7, &status );
+    }
+    CHECK( SX126x_AdrSelect( 7 ) == 0 );
+    SX126x_AdrOnPacket( 7, &status );
+    CHECK( SX126x_AdrSelect( 7 ) > 0 );
+    CHECK( SX126x_AdrBuildRequest( 7, request ) == ADR_REQUEST_SIZE );
+
+    // An answer with the wrong token or a refusal changes nothing
+    answer[0] = ADR_TYPE_ANSWER;
+    answer[1] = request[1];
+    answer[2] = request[2] + 1;
+    answer[3] = 0;
+    CHECK( SX126x_AdrOnFrame( 7, answer, ADR_ANSWER_SIZE, request ) == 0 );
+    CHECK( SX126x_AdrGetRate( 7 ) == 0 );
+    CHECK( SX126x_AdrBuildRequest( 7, request ) == ADR_REQUEST_SIZE );
+    answer[1] = request[1];
+    answer[2] = request[2];
+    answer[3] = 1;
+    SX126x_AdrOnFrame( 7, answer, ADR_ANSWER_SIZE, request );
+    CHECK( SX126x_AdrGetRate( 7 ) == 0 );
+    CHECK( SX126x_AdrBuildRequest( 7, request ) == ADR_REQUEST_SIZE );
+    answer[2] = request[2];
+    answer[3] = 0;
+    SX126x_AdrOnFrame( 7, answer, ADR_ANSWER_SIZE, request );
+    CHECK( SX126x_AdrGetRate( 7 ) == request[1] );
+
+    // Lost: back to the default rate
+    for( uint8_t i = 0; i < ADR_MAX_MISSES; i++ )
+    {
+        SX126x_AdrOnMiss( 7 );
+    }
+    CHECK( SX126x_AdrGetRate( 7 ) == 0 );
+
+    // A request out of the table is refused
+    request[0] = ADR_TYPE_REQUEST;
+    request[1] = ADR_DATA_RATES;
+    request[2] = 1;
+    CHECK( SX126x_AdrOnFrame( 7, request, ADR_REQUEST_SIZE, answer ) == ADR_ANSWER_SIZE );
+    CHECK( answer[3] == 1 );
+    SX126x_AdrOnAnswerSent( 7 );
+    CHECK( SX126x_AdrGetRate( 7 ) == 0 );
+
+    // The modulation of the rate goes to the radio
+    MockReset( );
+    SX126xHal_SpiInit( );
+    SX126x_AdrApply( 7 );
+    CHECK( ( MockRadio->LogSize > 0 ) && ( MockRadio->Log[MockRadio->LogSize - 1] == RADIO_SET_MODULATIONPARAMS ) );
+}
+
+static void TestConvergence( void )
+{
+    uint32_t slowest = TestAirtime( 0 );
+
+    for( uint8_t l = 0; l < TEST_LINKS; l++ )
+    {
+        TestLink_t *link = &Links[l];
+        uint8_t rate;
+        double airtime;
+
+        SX126x_AdrInit( 0 );
+        Peer_SX126x_AdrInit( 0 );
+        TestLink( link, TEST_ROUNDS, TEST_ROUNDS - TEST_SETTLED );
+        rate = SX126x_AdrGetRate( link->Address );
+        link->Rate = rate;
+        airtime = ( double )link->Airtime / link->Sent;
+
+        // Both ends agree, and the margin keeps the losses low
+        CHECK( rate == Peer_SX126x_AdrGetRate( TEST_GATEWAY ) );
+        CHECK( link->Delivered * 100 >= link->Sent * 95 );
+        // The link sits at the fastest rate of which the floor is
+        // ADR_MARGIN_DB under its SNR, give or take the fading
+        CHECK( 4 * link->Snr - SX126x_AdrGetDataRate( rate )->NoiseOffset >=
+               SX126x_AdrGetDataRate( rate )->RequiredSnr + 4 * ADR_MARGIN_DB - TEST_FADING_QDB );
+        if( rate < ADR_DATA_RATES - 1 )
+        {
+            CHECK( 4 * link->Snr - SX126x_AdrGetDataRate( rate + 1 )->NoiseOffset <
+                   SX126x_AdrGetDataRate( rate + 1 )->RequiredSnr + 4 * ( ADR_MARGIN_DB + ADR_HYSTERESIS_DB ) + TEST_FADING_QDB );
+        }
+
+        printf( "adr: SNR %+3d dB, settled on SF%u BW%u CR4/%u, %5.1f %% delivered, %6.0f us per packet, %5.1fx less airtime than SF12\n",
+                link->Snr, SX126x_AdrGetDataRate( rate )->SpreadingFactor,
+                ( SX126x_AdrGetDataRate( rate )->Bandwidth == LORA_BW_500 ) ? 500 : ( SX126x_AdrGetDataRate( rate )->Bandwidth == LORA_BW_250 ) ? 250 : 125,
+                4 + SX126x_AdrGetDataRate( rate )->CodingRate, 100.0 * link->Delivered / link->Sent, airtime, slowest / airtime );
+    }
+    // The weakest link stays at SF12, from 0 dB up SF7 and 20 times less
+    // airtime
+    CHECK( SX126x_AdrGetDataRate( Links[0].Rate )->SpreadingFactor == LORA_SF12 );
+    CHECK( SX126x_AdrGetDataRate( Links[3].Rate )->SpreadingFactor == LORA_SF7 );
+    CHECK( ( double )slowest * Links[3].Sent / Links[3].Airtime > 20 );
+}
+
+/*!
+ * \brief A good link losing 15 dB: the misses bring both ends back to the
+ *        default rate, and ADR climbs again to what the link still allows
+ */
+static void TestDegradation( void )
+{
+    TestLink_t link = { 9, 10, 0, 0, 0, 0 };
+    uint8_t before;
+    uint8_t after;
+
+    SX126x_AdrInit( 0 );
+    Peer_SX126x_AdrInit( 0 );
+    TestLink( &link, TEST_ROUNDS, TEST_ROUNDS );
+    before = SX126x_AdrGetRate( link.Address );
+
+    link.Snr -= 15;
+    link.Sent = 0;
+    link.Delivered = 0;
+    link.Airtime = 0;
+    TestLink( &link, TEST_ROUNDS, TEST_ROUNDS - TEST_SETTLED );
+    after = SX126x_AdrGetRate( link.Address );
+    CHECK( after < before );
+    CHECK( after == Peer_SX126x_AdrGetRate( TEST_GATEWAY ) );
+    CHECK( link.Delivered * 100 >= link.Sent * 95 );
+}
+
+int main( void )
+{
+    TestBasics( );
+    TestConvergence( );
+    TestDegradation( );
+
+    return TestEnd( "test_adr" );
+}
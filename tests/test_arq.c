@@ -0,0 +1,327 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * ARQ: a sender and a receiver, each with its own radio and its own instance
+ * of the module, on a half-duplex channel losing frames at random. Time goes
+ * on in steps of 1 ms, a frame is heard if the other radio listened for all
+ * of it. The payloads must come out intact and in order, with gaps only for
+ * the ones the sender gave up after ARQ_MAX_RETRIES. Malformed frames are
+ * dropped.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_arq.h"
+
+#define TEST_MESSAGES                               300
+#define TEST_STEP_US                                1000
+#define TEST_TIME_LIMIT_US                          3600000000UL
+
+#define TEST_SENDER                                 0
+#define TEST_RECEIVER                               1
+
+/*!
+ * \brief The receiver instance, see the Makefile
+ */
+void Peer_SX126x_ArqInit( ModulationParams_t *modParams, PacketParams_t *packetParams );
+uint8_t Peer_SX126x_ArqReceive( uint8_t *buffer, uint8_t maxSize );
+void Peer_SX126x_ArqProcess( void );
+void Peer_SX126x_ArqOnTxDone( void );
+void Peer_SX126x_ArqOnRxDone( uint8_t *payload, uint8_t size );
+void Peer_SX126x_ArqOnTimeout( void );
+void Peer_SX126x_ArqGetStats( ArqStats_t *stats );
+
+typedef struct
+{
+    void ( *Process )( void );
+    void ( *OnTxDone )( void );
+    void ( *OnRxDone )( uint8_t *payload, uint8_t size );
+    void ( *OnTimeout )( void );
+}TestNode_t;
+
+static const TestNode_t Nodes[2] =
+{
+    { SX126x_ArqProcess, SX126x_ArqOnTxDone, SX126x_ArqOnRxDone, SX126x_ArqOnTimeout },
+    { Peer_SX126x_ArqProcess, Peer_SX126x_ArqOnTxDone, Peer_SX126x_ArqOnRxDone, Peer_SX126x_ArqOnTimeout },
+};
+
+/*!
+ * \brief Frame on air from a node
+ */
+typedef struct
+{
+    uint8_t       Active;
+    uint8_t       Heard;                            //!< The other radio caught the preamble
+    uint8_t       Lost;                             //!< The other radio sent meanwhile
+    uint8_t       Size;
+    uint32_t      Start;                            //!< [us]
+    uint32_t      End;                              //!< [us]
+    uint8_t       Payload[256];
+}TestAir_t;
+
+static TestAir_t Air[2];
+static uint32_t RxStartedAt[2];
+static uint32_t RxCounts[2];
+
+static ModulationParams_t ModParams;
+static PacketParams_t PacketParams;
+static uint32_t PreambleDetection;                  // Latest start of a reception [us]
+
+static void TestOnTx( uint8_t *payload, uint8_t size )
+{
+    uint8_t node = MockRadio - MockRadios;
+    PacketParams_t params = PacketParams;
+
+    params.Params.LoRa.PayloadLength = size;
+    Air[node].Active = 1;
+    Air[node].Heard = ( MockRadios[1 - node].Mode == MODE_RX ) ? 1 : 0;
+    Air[node].Lost = 0;
+    Air[node].Size = size;
+    Air[node].Start = MockTimeUs;
+    Air[node].End = MockTimeUs + SX126x_GetTimeOnAir( &ModParams, &params );
+    memcpy( Air[node].Payload, payload, size );
+    // Half duplex: what the other one sends is lost
+    Air[1 - node].Lost = 1;
+}
+
+/*!
+ * \brief Payload number n: its number, then bytes derived from it
+ */
+static uint8_t TestMessage( uint32_t n, uint8_t *payload )
+{
+    uint8_t size = 4 + n % ( ARQ_MAX_PAYLOAD - 3 );
+
+    memcpy( payload, &n, 4 );
+    for( uint8_t i = 4; i < size; i++ )
+    {
+        payload[i] = ( uint8_t )( n * 31 + i );
+    }
+    return size;
+}
+
+/*!
+ * \brief Notes the start of every reception, for its timeout
+ */
+static void TestTrack( uint8_t node )
+{
+    if( MockRadios[node].RxCount != RxCounts[node] )
+    {
+        RxCounts[node] = MockRadios[node].RxCount;
+        RxStartedAt[node] = MockTimeUs;
+    }
+}
+
+static void TestCall( uint8_t node, void ( *function )( void ) )
+{
+    MockSelect( node );
+    function( );
+    TestTrack( node );
+}
+
+/*!
+ * \brief Frames at their end, RX timeouts, then both nodes run their main loop
+ */
+static void TestStep( uint8_t loss )
+{
+    for( uint8_t node = 0; node < 2; node++ )
+    {
+        uint8_t other = 1 - node;
+
+        if( ( Air[node].Active == 0 ) || ( ( int32_t )( MockTimeUs - Air[node].End ) < 0 ) )
+        {
+            continue;
+        }
+        Air[node].Active = 0;
+        MockRadios[node].Mode = MODE_STDBY_RC;
+        TestCall( node, Nodes[node].OnTxDone );
+        if( ( Air[node].Heard == 1 ) && ( Air[node].Lost == 0 ) && ( MockRadios[other].Mode == MODE_RX ) && ( TestRandom( ) % 100 >= loss ) )
+        {
+            if( MockRadios[other].RxTimeout != 0xFFFFFF )
+            {
+                MockRadios[other].Mode = MODE_STDBY_RC;
+            }
+            MockSelect( other );
+            Nodes[other].OnRxDone( Air[node].Payload, Air[node].Size );
+            TestTrack( other );
+        }
+    }
+    for( uint8_t node = 0; node < 2; node++ )
+    {
+        MockRadio_t *radio = &MockRadios[node];
+        uint32_t timeout = ( radio->RxTimeout * 1000 ) / 64;
+
+        // The timer stops on a header, while a frame is received
+        if( ( radio->Mode == MODE_RX ) && ( radio->RxTimeout != 0xFFFFFF ) && ( radio->RxTimeout != 0 ) &&
+            ( MockTimeUs - RxStartedAt[node] >= timeout ) && ( ( Air[1 - node].Active == 0 ) || ( Air[1 - node].Heard == 0 ) || ( Air[1 - node].Lost == 1 ) ) )
+        {
+            radio->Mode = MODE_STDBY_RC;
+            TestCall( node, Nodes[node].OnTimeout );
+        }
+    }
+    for( uint8_t node = 0; node < 2; node++ )
+    {
+        if( Air[node].Active == 0 )
+        {
+            TestCall( node, Nodes[node].Process );
+        }
+    }
+    // A receiver turned on during the first preamble symbols still gets the frame
+    for( uint8_t node = 0; node < 2; node++ )
+    {
+        if( ( Air[node].Active == 1 ) && ( MockTimeUs - Air[node].Start <= PreambleDetection ) &&
+            ( MockRadios[1 - node].Mode == MODE_RX ) )
+        {
+            Air[node].Heard = 1;
+        }
+    }
+}
+
+/*!
+ * \brief Sends TEST_MESSAGES payloads
+ *
+ * \retval      goodput       Payload bits per second
+ */
+static double TestLink( uint8_t loss )
+{
+    uint8_t payload[ARQ_MAX_PAYLOAD];
+    uint8_t expected[ARQ_MAX_PAYLOAD];
+    uint32_t queued = 0;
+    uint32_t next = 0;
+    uint32_t delivered = 0;
+    uint32_t skipped = 0;
+    uint32_t bytes = 0;
+    uint32_t wrong = 0;
+    ArqStats_t sender;
+    ArqStats_t receiver;
+
+    MockReset( );
+    MockOnTx = TestOnTx;
+    memset( Air, 0, sizeof( Air ) );
+    memset( RxCounts, 0, sizeof( RxCounts ) );
+    for( uint8_t node = 0; node < 2; node++ )
+    {
+        MockSelect( node );
+        SX126x_SetPacketType( PACKET_TYPE_LORA );
+    }
+    MockSelect( TEST_SENDER );
+    SX126x_ArqInit( &ModParams, &PacketParams );
+    MockSelect( TEST_RECEIVER );
+    Peer_SX126x_ArqInit( &ModParams, &PacketParams );
+    SX126x_ArqGetStats( &sender );
+
+    // Until the last payload is delivered or given up: a payload can be both,
+    // when the receiver got it and its SACKs were lost
+    while( ( next < TEST_MESSAGES ) && ( delivered + sender.Dropped < TEST_MESSAGES ) && ( MockTimeUs < TEST_TIME_LIMIT_US ) )
+    {
+        uint8_t size;
+
+        while( queued < TEST_MESSAGES )
+        {
+            size = TestMessage( queued, payload );
+            if( SX126x_ArqSend( payload, size ) != 0 )
+            {
+                break;
+            }
+            queued++;
+        }
+        TestStep( loss );
+        while( ( size = Peer_SX126x_ArqReceive( payload, sizeof( payload ) ) ) != 0 )
+        {
+            uint32_t n;
+
+            // In order, only the payloads given up by the sender are missing
+            memcpy( &n, payload, 4 );
+            if( ( size < 4 ) || ( n < next ) || ( n >= TEST_MESSAGES ) ||
+                ( size != TestMessage( n, expected ) ) || ( memcmp( payload, expected, size ) != 0 ) )
+            {
+                wrong++;
+                continue;
+            }
+            skipped += n - next;
+            next = n + 1;
+            bytes += size;
+            delivered++;
+        }
+        SX126x_ArqGetStats( &sender );
+        MockTimeUs += TEST_STEP_US;
+    }
+    MockOnTx = NULL;
+
+    Peer_SX126x_ArqGetStats( &receiver );
+    skipped += TEST_MESSAGES - next;
+    CHECK( delivered + skipped == TEST_MESSAGES );
+    CHECK( wrong == 0 );
+    CHECK( skipped <= sender.Dropped );
+    CHECK( receiver.Delivered == delivered );
+    CHECK( ( loss > 0 ) || ( ( sender.Dropped == 0 ) && ( sender.Retransmitted == 0 ) ) );
+    CHECK( MockNssViolations == 0 );
+
+    printf( "arq%s%s: window %u, %2u %% loss, %u payloads in %.1f s, %.0f bit/s, %u sent, %u retransmitted, %u given up\n",
+            ( TEST_VARIANT[0] != '\0' ) ? " " : "", TEST_VARIANT, ARQ_WINDOW, loss, delivered, MockTimeUs / 1e6,
+            bytes * 8 / ( MockTimeUs / 1e6 ), sender.Sent, sender.Retransmitted, sender.Dropped );
+    return bytes * 8 / ( MockTimeUs / 1e6 );
+}
+
+/*!
+ * \brief Empty and oversized data frames are dropped, the next valid one with
+ *        the same sequence number is delivered
+ */
+static void TestMalformed( void )
+{
+    uint8_t frame[255];
+    uint8_t payload[ARQ_MAX_PAYLOAD];
+
+    MockReset( );
+    MockSelect( TEST_RECEIVER );
+    SX126x_SetPacketType( PACKET_TYPE_LORA );
+    Peer_SX126x_ArqInit( &ModParams, &PacketParams );
+    memset( frame, 0x55, sizeof( frame ) );
+    frame[0] = ARQ_TYPE_DATA;
+    frame[1] = 0;
+    frame[2] = 0;
+    Peer_SX126x_ArqOnRxDone( frame, ARQ_HEADER_SIZE );
+    Peer_SX126x_ArqOnRxDone( frame, sizeof( frame ) );
+    Peer_SX126x_ArqOnRxDone( frame, ARQ_HEADER_SIZE + ARQ_MAX_PAYLOAD + 1 );
+    CHECK( Peer_SX126x_ArqReceive( payload, sizeof( payload ) ) == 0 );
+
+    Peer_SX126x_ArqOnRxDone( frame, ARQ_HEADER_SIZE + ARQ_MAX_PAYLOAD );
+    CHECK( Peer_SX126x_ArqReceive( payload, sizeof( payload ) ) == ARQ_MAX_PAYLOAD );
+    CHECK( ( payload[0] == 0x55 ) && ( payload[ARQ_MAX_PAYLOAD - 1] == 0x55 ) );
+}
+
+int main( void )
+{
+    static const uint8_t losses[] = { 0, 10, 30 };
+    double goodput = 0;
+
+    SX126xHal_SpiInit( );
+    MockLoRaProfile( &ModParams, &PacketParams, LORA_SF7, ARQ_MAX_PAYLOAD );
+    // 4 of the 8 preamble symbols left to the receiver
+    PreambleDetection = ( ( PacketParams.Params.LoRa.PreambleLength - 4 ) * ( 1000000UL << ModParams.Params.LoRa.SpreadingFactor ) ) / 125000;
+    for( uint8_t i = 0; i < sizeof( losses ); i++ )
+    {
+        double rate = TestLink( losses[i] );
+
+        // Losses only cost throughput
+        CHECK( ( i == 0 ) || ( rate < goodput ) );
+        goodput = rate;
+    }
+    TestMalformed( );
+
+    return TestEnd( "test_arq" );
+}
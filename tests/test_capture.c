@@ -0,0 +1,93 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * DIO1 time stamps: the edges are captured by a simulated TC0, the interrupt
+ * handling runs later and must report the time of the edge
+ */
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+
+#define TEST_EVENTS                                 10000
+
+/*!
+ * \brief Up to 2 ms of interrupt and main loop latency
+ */
+#define TEST_MAX_LATENCY_US                         2000
+
+static void TestRate( void )
+{
+    // 48 MHz generator of the host stubs, DIV8
+    CHECK( TIMESTAMP_TICKS_PER_US == 6 );
+}
+
+static void TestEdge( uint32_t edge, uint32_t latency, uint16_t irq )
+{
+    PacketStatus_t status;
+
+    MockTicks = edge;
+    MockCaptureDio1( edge );
+    MockRadio->Irq = irq;
+    MockTicks += latency;
+
+    SX126x_ProcessIrqs( );
+    CHECK( SX126x_GetIrqTimestamp( ) == edge );
+    CHECK( MockRadio->Irq == 0 );
+    SX126x_GetPacketStatus( &status );
+    CHECK( status.Timestamp == edge );
+}
+
+static void TestCapture( void )
+{
+    uint64_t softwareError = 0;
+
+    TestEdge( 1000, 600, IRQ_RX_DONE );
+    TestEdge( 5000, 0, IRQ_TX_DONE );
+
+    // Across the wrap of the 32 bit counter
+    TestEdge( 0xFFFFFF00, 0x200, IRQ_RX_DONE );
+    CHECK( ( uint32_t )( MockTicks - SX126x_GetIrqTimestamp( ) ) == 0x200 );
+
+    // The capture is given once, without an edge the time of the handling
+    MockTicks = 123456;
+    MockRadio->Irq = IRQ_RX_TX_TIMEOUT;
+    SX126x_ProcessIrqs( );
+    CHECK( SX126x_GetIrqTimestamp( ) == 123456 );
+
+    for( uint32_t i = 0; i < TEST_EVENTS; i++ )
+    {
+        uint32_t edge = MockTicks + TestRandom( ) * TIMESTAMP_TICKS_PER_US;
+        uint32_t latency = ( TestRandom( ) % TEST_MAX_LATENCY_US ) * TIMESTAMP_TICKS_PER_US + TestRandom( ) % TIMESTAMP_TICKS_PER_US;
+
+        TestEdge( edge, latency, ( i & 1 ) ? IRQ_RX_DONE : IRQ_TX_DONE );
+        // What a time stamp taken by the handling would have been off by
+        softwareError += latency;
+    }
+    printf( "capture: %u edges time stamped exactly, a software time stamp would be %.0f us late on average\n",
+            TEST_EVENTS, ( double )softwareError / TEST_EVENTS / TIMESTAMP_TICKS_PER_US );
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    DIO1_CaptureInit( );
+
+    TestRate( );
+    TestCapture( );
+
+    return TestEnd( "test_capture" );
+}
@@ -0,0 +1,225 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Channel monitor: the visits only in the idle gaps and what they leave
+ * behind, then channels with a jammer, a bursty interferer and a raised
+ * noise floor, the ranking of the channels, and a jammer showing up on the
+ * channel in use
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_chmon.h"
+
+#define TEST_CHANNELS                               8
+#define TEST_GAP_US                                 20000   // Between two idle gaps of the main loop
+#define TEST_ROUNDS                                 40      // Visits of every channel
+
+#define TEST_JAMMED                                 2
+#define TEST_BURSTY                                 5
+#define TEST_NOISY                                  6
+
+/*!
+ * \brief What the air of a channel holds
+ */
+typedef struct
+{
+    int16_t       Floor;                            //!< Noise floor [dBm]
+    int16_t       Interferer;                       //!< Level while on [dBm], 0 if none
+    uint32_t      Period;                           //!< On for half of it [us], 0 if always on
+}TestChannel_t;
+
+static const uint32_t Frequencies[TEST_CHANNELS] =
+{
+    868100000, 868300000, 868500000, 867100000, 867300000, 867500000, 867700000, 867900000,
+};
+
+static TestChannel_t Air[TEST_CHANNELS];
+static uint32_t Words[TEST_CHANNELS];
+
+static int16_t TestRssi( void )
+{
+    for( uint8_t c = 0; c < TEST_CHANNELS; c++ )
+    {
+        if( MockRadio->Frequency == Words[c] )
+        {
+            const TestChannel_t *air = &Air[c];
+            uint8_t on = ( air->Interferer != 0 ) && ( ( air->Period == 0 ) || ( ( MockTimeUs % air->Period ) < air->Period / 2 ) );
+
+            // A couple of dB of spread on every sample
+            return ( on ? air->Interferer : air->Floor ) + ( int16_t )( TestRandom( ) % 5 ) - 2;
+        }
+    }
+    return 0;
+}
+
+static void TestSetup( void )
+{
+    MockReset( );
+    MockTimeStepUs = 1;
+    MockOnRssi = TestRssi;
+    for( uint8_t c = 0; c < TEST_CHANNELS; c++ )
+    {
+        Words[c] = SX126x_GetFrequencyWord( Frequencies[c] );
+        Air[c].Floor = -118 + ( int16_t )( TestRandom( ) % 3 );
+        Air[c].Interferer = 0;
+        Air[c].Period = 0;
+    }
+    CHECK( SX126x_ChMonInit( Frequencies, TEST_CHANNELS ) == 0 );
+    SX126x_SetRfFrequency( 869525000 );
+    SX126x_SetStandby( STDBY_RC );
+}
+
+/*!
+ * \brief The main loop: an idle gap every TEST_GAP_US
+ */
+static void TestVisits( uint32_t visits )
+{
+    for( uint32_t n = 0; n < visits; n++ )
+    {
+        MockTimeUs += TEST_GAP_US;
+        CHECK( SX126x_ChMonProcess( ) == 0 );
+    }
+}
+
+static void TestIdleGaps( void )
+{
+    uint32_t frequency;
+    uint32_t start;
+    uint32_t bytes;
+    ChMonChannel_t stats;
+
+    TestSetup( );
+    frequency = MockRadio->Frequency;
+    CHECK( SX126x_ChMonInit( Frequencies, 0 ) == 1 );
+    CHECK( SX126x_ChMonInit( Frequencies, CHMON_MAX_CHANNELS + 1 ) == 1 );
+    CHECK( SX126x_ChMonInit( Frequencies, TEST_CHANNELS ) == 0 );
+    SX126x_ChMonGetChannel( 0, &stats );
+    CHECK( stats.Samples == 0 );
+
+    // A visit leaves the radio in its standby, on its frequency
+    start = MockTimeUs;
+    bytes = MockSpiBytes;
+    CHECK( SX126x_ChMonProcess( ) == 0 );
+    CHECK( ( MockRadio->Mode == MODE_STDBY_RC ) && ( MockRadio->Frequency == frequency ) );
+    SX126x_ChMonGetChannel( 0, &stats );
+    CHECK( ( stats.Samples == 1 ) && ( stats.NoiseFloor <= -114 ) && ( stats.NoiseFloor >= -122 ) && ( stats.Occupancy == 0 ) );
+    printf( "chmon: a visit takes %u us and %u SPI bytes\n", MockTimeUs - start, MockSpiBytes - bytes );
+    CHECK( MockTimeUs - start < CHMON_VISIT_US );
+
+    SX126x_SetStandby( STDBY_XOSC );
+    CHECK( SX126x_ChMonProcess( ) == 0 );
+    CHECK( MockRadio->Mode == MODE_STDBY_XOSC );
+
+    // Not while the radio works, nor right before a timer task
+    SX126x_SetRx( 0 );
+    CHECK( SX126x_ChMonProcess( ) == 1 );
+    CHECK( MockRadio->Mode == MODE_RX );
+    SX126x_SetStandby( STDBY_RC );
+    MockNextTimerTaskUs = CHMON_VISIT_US - 1;
+    CHECK( SX126x_ChMonProcess( ) == 1 );
+    MockNextTimerTaskUs = CHMON_VISIT_US;
+    CHECK( SX126x_ChMonProcess( ) == 0 );
+    SX126x_ChMonGetChannel( 2, &stats );
+    CHECK( stats.Samples == 1 );
+}
+
+static void TestInterferers( void )
+{
+    ChMonChannel_t stats;
+    uint8_t order[TEST_CHANNELS];
+    uint16_t allowed = ( 1U << TEST_CHANNELS ) - 1;
+    uint8_t best;
+
+    TestSetup( );
+    Air[TEST_JAMMED].Interferer = -80;
+    // A period the visits do not lock on to
+    Air[TEST_BURSTY].Interferer = -90;
+    Air[TEST_BURSTY].Period = 7 * TEST_GAP_US + 1234;
+    Air[TEST_NOISY].Floor = -107;
+    TestVisits( TEST_ROUNDS * TEST_CHANNELS );
+
+    SX126x_ChMonGetChannel( TEST_JAMMED, &stats );
+    CHECK( ( stats.Samples == CHMON_HISTORY ) && ( stats.Occupancy == 100 ) );
+    SX126x_ChMonGetChannel( TEST_BURSTY, &stats );
+    CHECK( ( stats.Occupancy >= 20 ) && ( stats.Occupancy <= 80 ) );
+    SX126x_ChMonGetChannel( TEST_NOISY, &stats );
+    CHECK( ( stats.Occupancy == 0 ) && ( stats.NoiseFloor >= -109 ) && ( stats.NoiseFloor <= -105 ) );
+
+    // The quiet channels, then the noisy one, then the interferers
+    CHECK( SX126x_ChMonRank( allowed, order, TEST_CHANNELS ) == TEST_CHANNELS );
+    CHECK( ( order[TEST_CHANNELS - 3] == TEST_NOISY ) && ( order[TEST_CHANNELS - 2] == TEST_BURSTY ) &&
+           ( order[TEST_CHANNELS - 1] == TEST_JAMMED ) );
+    for( uint8_t c = 0; c < TEST_CHANNELS; c++ )
+    {
+        SX126x_ChMonGetChannel( c, &stats );
+        printf( "chmon: channel %u %9u Hz, floor %4d dBm, %3u %% busy, rank %u\n", c, Frequencies[c], stats.NoiseFloor,
+                stats.Occupancy, ( uint8_t )( ( uint8_t * )memchr( order, c, TEST_CHANNELS ) - order ) );
+    }
+    // A short hop set, from the quiet ones
+    CHECK( SX126x_ChMonRank( allowed, order, 3 ) == 3 );
+    CHECK( ( order[0] != TEST_JAMMED ) && ( order[1] != TEST_BURSTY ) && ( order[2] != TEST_NOISY ) );
+
+    // Away from the jammer, nowhere between channels alike
+    best = SX126x_ChMonSelect( allowed, TEST_JAMMED );
+    CHECK( ( best != TEST_JAMMED ) && ( best != TEST_BURSTY ) && ( best != TEST_NOISY ) );
+    CHECK( SX126x_ChMonSelect( allowed, 0 ) == 0 );
+    CHECK( SX126x_ChMonSelect( allowed & ~( 1U << best ), best ) != best );
+    CHECK( SX126x_ChMonSelect( 0, TEST_JAMMED ) == TEST_JAMMED );
+    CHECK( SX126x_ChMonSelect( 1U << TEST_JAMMED, 0 ) == TEST_JAMMED );
+}
+
+/*!
+ * \brief A jammer starting on the channel in use: the visits of that
+ *        channel until the node moves
+ */
+static void TestNewJammer( void )
+{
+    uint16_t allowed = ( 1U << TEST_CHANNELS ) - 1;
+    uint8_t current;
+    uint32_t visits = 0;
+
+    TestSetup( );
+    TestVisits( CHMON_HISTORY * TEST_CHANNELS );
+    current = SX126x_ChMonSelect( allowed, 0 );
+    // Stable while nothing changes
+    TestVisits( 4 * TEST_CHANNELS );
+    CHECK( SX126x_ChMonSelect( allowed, current ) == current );
+
+    Air[current].Interferer = -85;
+    while( ( SX126x_ChMonSelect( allowed, current ) == current ) && ( visits < CHMON_HISTORY ) )
+    {
+        TestVisits( TEST_CHANNELS );
+        visits++;
+    }
+    CHECK( SX126x_ChMonSelect( allowed, current ) != current );
+    CHECK( visits <= 4 );
+    printf( "chmon: jammer on the channel in use, left after %u visits of it (%u ms of idle gaps)\n", visits,
+            visits * TEST_CHANNELS * TEST_GAP_US / 1000 );
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    TestIdleGaps( );
+    TestInterferers( );
+    TestNewJammer( );
+
+    return TestEnd( "test_chmon" );
+}
@@ -0,0 +1,220 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Compression: round trips of telemetry, packed structs and random data, the
+ * raw fallback, malformed input, and the ratio, speed and air time saved
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_compress.h"
+
+#define TEST_FUZZ                                   20000
+#define TEST_BENCHMARK_ROUNDS                       20000
+
+static const char *Telemetry[] =
+{
+    "{\"id\":\"node-17\",\"type\":\"env\",\"ts\":1718023311,\"seq\":4411,\"temp\":21.43,\"hum\":48.2,\"pressure\":1013.25,\"bat\":3.71}",
+    "{\"id\":\"node-17\",\"ts\":1718023371,\"seq\":4412,\"status\":\"ok\",\"rssi\":-97,\"snr\":7.25,\"battery\":88}",
+    "{\"id\":\"meter-3\",\"type\":\"power\",\"voltage\":229.8,\"current\":1.27,\"power\":291.8,\"energy\":18231.7}",
+    "{\"id\":\"gps-2\",\"lat\":45.46421,\"lon\":9.19035,\"alt\":122.0,\"speed\":0.00,\"status\":\"ok\"}",
+    "{\"id\":\"co2-9\",\"data\":{\"count\":60,\"min\":412,\"max\":655,\"avg\":501.3},\"error\":\"\"}",
+};
+
+#define TEST_TELEMETRY                              ( sizeof( Telemetry ) / sizeof( Telemetry[0] ) )
+
+static uint8_t RoundTrip( const uint8_t *input, uint8_t size )
+{
+    uint8_t compressed[COMPRESS_MAX_INPUT + 1];
+    uint8_t restored[COMPRESS_MAX_INPUT];
+    uint8_t length = SX126x_Compress( input, size, compressed, sizeof( compressed ) );
+
+    CHECK( ( length > 0 ) && ( length <= size + 1 ) );
+    CHECK( SX126x_Decompress( compressed, length, restored, sizeof( restored ) ) == size );
+    CHECK( memcmp( restored, input, size ) == 0 );
+    return length;
+}
+
+static void TestRoundTrips( void )
+{
+    uint8_t input[COMPRESS_MAX_INPUT];
+    uint8_t compressed[COMPRESS_MAX_INPUT + 1];
+    uint8_t restored[COMPRESS_MAX_INPUT];
+    uint8_t length;
+
+    for( uint8_t i = 0; i < TEST_TELEMETRY; i++ )
+    {
+        length = RoundTrip( ( const uint8_t * )Telemetry[i], strlen( Telemetry[i] ) );
+        CHECK( length < strlen( Telemetry[i] ) );
+    }
+
+    // Packed struct: mostly zeros, a counter and a few readings
+    memset( input, 0, 48 );
+    input[0] = 0x11;
+    input[4] = 0x2A;
+    input[20] = 0xFF;
+    input[21] = 0xFF;
+    CHECK( RoundTrip( input, 48 ) < 48 );
+
+    // Random data does not compress: raw, one header byte
+    for( uint8_t i = 0; i < 200; i++ )
+    {
+        input[i] = ( uint8_t )TestRandom( );
+    }
+    length = SX126x_Compress( input, 200, compressed, sizeof( compressed ) );
+    CHECK( ( length == 201 ) && ( ( compressed[0] & COMPRESS_HEADER_COMPRESSED ) == 0 ) );
+    CHECK( SX126x_Decompress( compressed, length, restored, sizeof( restored ) ) == 200 );
+    CHECK( memcmp( restored, input, 200 ) == 0 );
+
+    // Output too small
+    CHECK( SX126x_Compress( input, 200, compressed, 100 ) == 0 );
+
+    // Truncated or damaged payloads are rejected, never overrun the output
+    length = SX126x_Compress( ( const uint8_t * )Telemetry[0], strlen( Telemetry[0] ), compressed, sizeof( compressed ) );
+    CHECK( ( compressed[0] & COMPRESS_HEADER_COMPRESSED ) != 0 );
+    CHECK( SX126x_Decompress( compressed, length, restored, 10 ) == 0 );
+    for( uint32_t i = 0; i < TEST_FUZZ; i++ )
+    {
+        uint8_t damaged[COMPRESS_MAX_INPUT + 1];
+        uint8_t size = 1 + TestRandom( ) % length;
+
+        memcpy( damaged, compressed, size );
+        damaged[TestRandom( ) % size] ^= ( uint8_t )( 1 + TestRandom( ) % 255 );
+        CHECK( SX126x_Decompress( damaged, size, restored, sizeof( restored ) ) <= sizeof( restored ) );
+    }
+
+    // Mixes of telemetry pieces and random bytes
+    for( uint32_t i = 0; i < TEST_FUZZ; i++ )
+    {
+        uint8_t size = 0;
+
+        while( size < 150 )
+        {
+            const char *piece = Telemetry[TestRandom( ) % TEST_TELEMETRY];
+            uint8_t start = TestRandom( ) % 40;
+            uint8_t run = 1 + TestRandom( ) % 30;
+
+            if( TestRandom( ) % 4 == 0 )
+            {
+                input[size++] = ( uint8_t )TestRandom( );
+                continue;
+            }
+            memcpy( &input[size], piece + start, run );
+            size += run;
+        }
+        RoundTrip( input, size );
+    }
+}
+
+static void TestSend( void )
+{
+    uint8_t *payload = ( uint8_t * )Telemetry[1];
+    uint8_t size = strlen( Telemetry[1] );
+    uint8_t compressed[COMPRESS_MAX_INPUT + 1];
+    uint8_t length = SX126x_Compress( payload, size, compressed, sizeof( compressed ) );
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+
+    // The length of the profile is the raw one, the compressed one goes on air
+    MockLoRaProfile( &modParams, &packetParams, LORA_SF7, size );
+    SX126x_SetPacketType( PACKET_TYPE_LORA );
+    SX126x_SetBufferBaseAddresses( 0x00, 0x80 );
+    CHECK( SX126x_SendCompressed( &packetParams, payload, size, 0 ) == 0 );
+    CHECK( MockRadio->TxCount == 1 );
+    CHECK( MockRadio->PayloadLength == length );
+    CHECK( memcmp( MockRadio->Buffer, compressed, length ) == 0 );
+    CHECK( packetParams.Params.LoRa.PayloadLength == size );
+
+    // Nothing sent when it does not fit
+    memset( compressed, 0, sizeof( compressed ) );
+    CHECK( SX126x_SendCompressed( &packetParams, compressed, COMPRESS_MAX_INPUT + 1, 0 ) == 1 );
+    CHECK( MockRadio->TxCount == 1 );
+}
+
+static void TestBenchmark( void )
+{
+    static const RadioLoRaSpreadingFactors_t sfs[] = { LORA_SF7, LORA_SF9, LORA_SF12 };
+    uint8_t compressed[TEST_TELEMETRY][COMPRESS_MAX_INPUT + 1];
+    uint8_t lengths[TEST_TELEMETRY];
+    uint8_t restored[COMPRESS_MAX_INPUT];
+    uint32_t raw = 0;
+    uint32_t packed = 0;
+    uint64_t start;
+    double compress;
+    double decompress;
+
+    start = TestNowNs( );
+    for( uint32_t r = 0; r < TEST_BENCHMARK_ROUNDS; r++ )
+    {
+        for( uint8_t i = 0; i < TEST_TELEMETRY; i++ )
+        {
+            lengths[i] = SX126x_Compress( ( const uint8_t * )Telemetry[i], strlen( Telemetry[i] ), compressed[i], sizeof( compressed[i] ) );
+        }
+    }
+    compress = ( double )( TestNowNs( ) - start );
+    start = TestNowNs( );
+    for( uint32_t r = 0; r < TEST_BENCHMARK_ROUNDS; r++ )
+    {
+        for( uint8_t i = 0; i < TEST_TELEMETRY; i++ )
+        {
+            SX126x_Decompress( compressed[i], lengths[i], restored, sizeof( restored ) );
+        }
+    }
+    decompress = ( double )( TestNowNs( ) - start );
+    for( uint8_t i = 0; i < TEST_TELEMETRY; i++ )
+    {
+        raw += strlen( Telemetry[i] );
+        packed += lengths[i];
+    }
+    compress /= ( double )raw * TEST_BENCHMARK_ROUNDS;
+    decompress /= ( double )raw * TEST_BENCHMARK_ROUNDS;
+    printf( "compress: telemetry %u -> %u bytes, ratio %.2f, %.1f ns/byte to compress, %.1f ns/byte to restore on host\n",
+            raw, packed, ( double )raw / packed, compress, decompress );
+
+    for( uint8_t s = 0; s < sizeof( sfs ) / sizeof( sfs[0] ); s++ )
+    {
+        ModulationParams_t modParams;
+        PacketParams_t packetParams;
+        uint32_t before = 0;
+        uint32_t after = 0;
+
+        for( uint8_t i = 0; i < TEST_TELEMETRY; i++ )
+        {
+            MockLoRaProfile( &modParams, &packetParams, sfs[s], strlen( Telemetry[i] ) );
+            before += SX126x_GetTimeOnAir( &modParams, &packetParams );
+            MockLoRaProfile( &modParams, &packetParams, sfs[s], lengths[i] );
+            after += SX126x_GetTimeOnAir( &modParams, &packetParams );
+        }
+        printf( "compress: SF%u, %.0f ms on air per message instead of %.0f ms, %.0f %% saved\n", sfs[s],
+                after / 1000.0 / TEST_TELEMETRY, before / 1000.0 / TEST_TELEMETRY, 100.0 * ( before - after ) / before );
+        CHECK( after < before );
+    }
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+
+    TestRoundTrips( );
+    TestSend( );
+    TestBenchmark( );
+
+    return TestEnd( "test_compress" );
+}
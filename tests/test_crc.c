@@ -0,0 +1,272 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * GFSK CRC and whitening: the catalogue check values, a bitwise reference on
+ * random seeds and polynomials, the PN9 sequence, whole frames, and the speed
+ * of the kernel
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sx126x_crc.h"
+
+#define TEST_RANDOM_CASES                           20000
+#define TEST_BENCHMARK_BYTES                        ( 64UL * 1024 * 1024 )
+
+static const uint8_t Check[] = "123456789";
+
+/*!
+ * \brief CRC one bit at a time, MSB first, width 8 or 16
+ */
+static uint16_t TestCrc( uint8_t width, uint16_t seed, uint16_t polynomial, uint16_t xorOut, const uint8_t *data, uint16_t size )
+{
+    uint16_t top = 1 << ( width - 1 );
+    uint16_t mask = ( width == 16 ) ? 0xFFFF : 0xFF;
+    uint16_t state = seed & mask;
+
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        for( int8_t bit = 7; bit >= 0; bit-- )
+        {
+            uint8_t feedback = ( ( state & top ) != 0 ) ^ ( ( data[i] >> bit ) & 1 );
+
+            state = ( uint16_t )( state << 1 ) & mask;
+            if( feedback != 0 )
+            {
+                state ^= polynomial & mask;
+            }
+        }
+    }
+    return ( state ^ xorOut ) & mask;
+}
+
+/*!
+ * \brief PN9 one bit at a time: x^9 + x^5 + 1, a byte is the next 8 bits,
+ *        the oldest in bit 0
+ */
+static uint16_t TestPn9( uint16_t state, uint8_t *byte )
+{
+    *byte = ( uint8_t )state;
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        state = ( state >> 1 ) | ( ( ( state ^ ( state >> 5 ) ) & 1 ) << 8 );
+    }
+    return state;
+}
+
+static void TestCatalogue( void )
+{
+    static CrcEngine_t crc;
+
+    SX126x_CrcInit( &crc, RADIO_CRC_2_BYTES_CCIT, 0, 0 );
+    CHECK( SX126x_CrcCompute( &crc, Check, 9 ) == 0x1A33 );
+    SX126x_CrcInit( &crc, RADIO_CRC_2_BYTES_IBM, 0, 0 );
+    CHECK( SX126x_CrcCompute( &crc, Check, 9 ) == 0xAEE7 );
+    // CRC-8/AUTOSAR
+    SX126x_CrcInit( &crc, RADIO_CRC_1_BYTES_INV, 0xFF, 0x2F );
+    CHECK( SX126x_CrcCompute( &crc, Check, 9 ) == 0xDF );
+    // CRC-16/XMODEM
+    SX126x_CrcInit( &crc, RADIO_CRC_2_BYTES, 0x0000, 0x1021 );
+    CHECK( SX126x_CrcCompute( &crc, Check, 9 ) == 0x31C3 );
+    SX126x_CrcInit( &crc, RADIO_CRC_OFF, 0, 0 );
+    CHECK( ( crc.Bytes == 0 ) && ( SX126x_CrcCompute( &crc, Check, 9 ) == 0 ) );
+}
+
+static void TestRandomCrcs( void )
+{
+    static const RadioCrcTypes_t types[] = { RADIO_CRC_1_BYTES, RADIO_CRC_1_BYTES_INV, RADIO_CRC_2_BYTES, RADIO_CRC_2_BYTES_INV };
+    static CrcEngine_t crc;
+    uint8_t data[300];
+    uint32_t wrong = 0;
+
+    for( uint32_t n = 0; n < TEST_RANDOM_CASES; n++ )
+    {
+        RadioCrcTypes_t type = types[TestRandom( ) % 4];
+        uint8_t width = ( ( type == RADIO_CRC_1_BYTES ) || ( type == RADIO_CRC_1_BYTES_INV ) ) ? 8 : 16;
+        uint8_t invert = ( type == RADIO_CRC_1_BYTES_INV ) || ( type == RADIO_CRC_2_BYTES_INV );
+        uint16_t seed = ( uint16_t )TestRandom( );
+        uint16_t polynomial = ( uint16_t )TestRandom( ) | 1;
+        uint16_t size = TestRandom( ) % sizeof( data );
+        uint16_t split = ( size == 0 ) ? 0 : TestRandom( ) % size;
+        uint16_t expected;
+        uint16_t state;
+
+        for( uint16_t i = 0; i < size; i++ )
+        {
+            data[i] = ( uint8_t )TestRandom( );
+        }
+        if( width == 8 )
+        {
+            seed &= 0xFF;
+            polynomial &= 0xFF;
+        }
+        expected = TestCrc( width, seed, polynomial, invert ? 0xFFFF : 0, data, size );
+
+        SX126x_CrcInit( &crc, type, seed, polynomial );
+        wrong += ( SX126x_CrcCompute( &crc, data, size ) != expected ) ? 1 : 0;
+        // In two parts, the kernel restarts on any byte
+        state = SX126x_CrcUpdate( &crc, crc.Seed, data, split );
+        state = SX126x_CrcUpdate( &crc, state, data + split, size - split );
+        wrong += ( SX126x_CrcFinal( &crc, state ) != expected ) ? 1 : 0;
+    }
+    CHECK( wrong == 0 );
+}
+
+static void TestWhitening( void )
+{
+    uint8_t data[1100];
+    uint8_t copy[1100];
+    uint16_t state;
+    uint16_t period = 0;
+    uint32_t wrong = 0;
+
+    // Every state of the LFSR against the bitwise sequence
+    for( uint16_t seed = 1; seed < 512; seed++ )
+    {
+        uint16_t reference = seed;
+
+        state = seed;
+        memset( data, 0, 16 );
+        SX126x_Whiten( &state, data, 16 );
+        for( uint8_t i = 0; i < 16; i++ )
+        {
+            uint8_t byte;
+
+            reference = TestPn9( reference, &byte );
+            wrong += ( data[i] != byte ) ? 1 : 0;
+        }
+        wrong += ( state != reference ) ? 1 : 0;
+    }
+    CHECK( wrong == 0 );
+
+    // 8 and 511 are coprime: the bytes repeat after 511 of them, not before
+    memset( data, 0, sizeof( data ) );
+    state = WHITENING_SEED_DEFAULT;
+    SX126x_Whiten( &state, data, sizeof( data ) );
+    for( uint16_t p = 1; ( p < 600 ) && ( period == 0 ); p++ )
+    {
+        period = ( memcmp( data, data + p, sizeof( data ) - p ) == 0 ) ? p : 0;
+    }
+    CHECK( period == 511 );
+
+    // Whitening twice gives the data back, in any number of calls
+    for( uint16_t i = 0; i < sizeof( data ); i++ )
+    {
+        data[i] = ( uint8_t )TestRandom( );
+    }
+    memcpy( copy, data, sizeof( data ) );
+    state = 0x0123;
+    SX126x_Whiten( &state, data, sizeof( data ) );
+    CHECK( memcmp( copy, data, sizeof( data ) ) != 0 );
+    state = 0x0123;
+    SX126x_Whiten( &state, data, 100 );
+    SX126x_Whiten( &state, data + 100, sizeof( data ) - 100 );
+    CHECK( memcmp( copy, data, sizeof( data ) ) == 0 );
+}
+
+static void TestFrames( void )
+{
+    static CrcEngine_t crc;
+    uint8_t payload[255];
+    uint8_t frame[260];
+    uint8_t header[2];
+
+    for( uint32_t n = 0; n < 2000; n++ )
+    {
+        uint8_t whitening = n & 1;
+        uint8_t size = 1 + TestRandom( ) % 250;
+        uint16_t seed = TestRandom( ) & 0x01FF;
+        uint16_t length;
+        uint16_t corrupt;
+
+        SX126x_CrcInit( &crc, ( n & 2 ) ? RADIO_CRC_2_BYTES_CCIT : RADIO_CRC_2_BYTES_IBM, 0, 0 );
+        for( uint8_t i = 0; i < size; i++ )
+        {
+            payload[i] = ( uint8_t )TestRandom( );
+        }
+        header[0] = size;
+        header[1] = 0x42;
+        length = SX126x_GfskEncode( &crc, whitening, seed, header, 2, payload, size, frame );
+        CHECK( length == 2 + size + 2 );
+
+        corrupt = TestRandom( ) % length;
+        if( n & 4 )
+        {
+            frame[corrupt] ^= ( uint8_t )( 1 + TestRandom( ) % 255 );
+            CHECK( SX126x_GfskDecode( &crc, whitening, seed, frame, length ) == 1 );
+        }
+        else
+        {
+            CHECK( SX126x_GfskDecode( &crc, whitening, seed, frame, length ) == 0 );
+            CHECK( ( frame[0] == size ) && ( memcmp( frame + 2, payload, size ) == 0 ) );
+        }
+    }
+    CHECK( SX126x_GfskDecode( &crc, 0, 0, frame, 1 ) == 1 );
+}
+
+static void TestBenchmark( void )
+{
+    static CrcEngine_t crc;
+    static uint8_t data[255];
+    uint16_t state;
+    uint64_t start;
+    double crcRate;
+    double whitenRate;
+    double setup;
+
+    for( uint16_t i = 0; i < sizeof( data ); i++ )
+    {
+        data[i] = ( uint8_t )TestRandom( );
+    }
+    start = TestNowNs( );
+    for( uint16_t i = 0; i < 1000; i++ )
+    {
+        SX126x_CrcInit( &crc, RADIO_CRC_2_BYTES_CCIT, 0, 0 );
+    }
+    setup = ( TestNowNs( ) - start ) / 1000.0;
+
+    state = crc.Seed;
+    start = TestNowNs( );
+    for( uint32_t n = 0; n < TEST_BENCHMARK_BYTES / sizeof( data ); n++ )
+    {
+        state = SX126x_CrcUpdate( &crc, state, data, sizeof( data ) );
+    }
+    crcRate = TEST_BENCHMARK_BYTES / ( ( TestNowNs( ) - start ) / 1e9 ) / 1e6;
+
+    state = WHITENING_SEED_DEFAULT;
+    start = TestNowNs( );
+    for( uint32_t n = 0; n < TEST_BENCHMARK_BYTES / sizeof( data ) / 4; n++ )
+    {
+        SX126x_Whiten( &state, data, sizeof( data ) );
+    }
+    whitenRate = TEST_BENCHMARK_BYTES / 4 / ( ( TestNowNs( ) - start ) / 1e9 ) / 1e6;
+    // Keeps the results alive
+    CHECK( state != 0 || data[0] != 0 || crc.Seed != 0 );
+
+    printf( "crc%s%s: %u byte engine set up in %.0f ns, CRC %.0f MB/s, whitening %.0f MB/s on host\n",
+            ( TEST_VARIANT[0] != '\0' ) ? " " : "", TEST_VARIANT, ( unsigned )sizeof( crc ), setup, crcRate, whitenRate );
+}
+
+int main( void )
+{
+    TestCatalogue( );
+    TestRandomCrcs( );
+    TestWhitening( );
+    TestFrames( );
+    TestBenchmark( );
+
+    return TestEnd( "test_crc" );
+}
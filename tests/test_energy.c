@@ -0,0 +1,223 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Energy accounting: the TX current curves, then a node reporting for days
+ * through the driver commands, its totals against the time spent in each
+ * state, and power strategies compared on battery life
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_energy.h"
+
+#define TEST_DAYS                                   30
+#define TEST_BATTERY_MAH                            2400
+#define TEST_PAYLOAD                                20
+#define TEST_WAKE_US                                3000
+#define TEST_RX_WINDOW_US                           30000
+
+/*!
+ * \brief A way of running the node
+ */
+typedef struct
+{
+    const char                   *Name;
+    RadioLoRaSpreadingFactors_t   Sf;
+    int8_t                        Power;            //!< [dBm]
+    RadioRegulatorMode_t          Regulator;
+    uint8_t                       WarmStart;
+    uint32_t                      Period;           //!< Between two reports [s]
+}TestStrategy_t;
+
+enum
+{
+    TEST_BASELINE,
+    TEST_LDO,
+    TEST_HIGH_POWER,
+    TEST_LOW_POWER,
+    TEST_MIN_POWER,
+    TEST_SF7,
+    TEST_COLD_SLEEP,
+    TEST_HEAVY,
+    TEST_STRATEGIES,
+};
+
+static const TestStrategy_t Strategies[TEST_STRATEGIES] =
+{
+    [TEST_BASELINE]   = { "SF9 14 dBm DC-DC warm",        LORA_SF9,  14, USE_DCDC, 1, 600 },
+    [TEST_LDO]        = { "SF9 14 dBm LDO warm",          LORA_SF9,  14, USE_LDO,  1, 600 },
+    [TEST_HIGH_POWER] = { "SF9 22 dBm DC-DC warm",        LORA_SF9,  22, USE_DCDC, 1, 600 },
+    [TEST_LOW_POWER]  = { "SF9 0 dBm DC-DC warm",         LORA_SF9,  0,  USE_DCDC, 1, 600 },
+    [TEST_MIN_POWER]  = { "SF9 -9 dBm DC-DC warm",        LORA_SF9,  -9, USE_DCDC, 1, 600 },
+    [TEST_SF7]        = { "SF7 14 dBm DC-DC warm",        LORA_SF7,  14, USE_DCDC, 1, 600 },
+    [TEST_COLD_SLEEP] = { "SF9 14 dBm DC-DC cold",        LORA_SF9,  14, USE_DCDC, 0, 600 },
+    [TEST_HEAVY]      = { "SF12 22 dBm DC-DC every min",  LORA_SF12, 22, USE_DCDC, 1, 60 },
+};
+
+static uint64_t Elapsed;
+
+static void TestAdvance( uint32_t us )
+{
+    // The 32 bit time of the driver wraps every 71 minutes
+    MockTimeUs += us;
+    Elapsed += us;
+}
+
+static void TestCurves( void )
+{
+    static const EnergyChips_t chips[] = { ENERGY_CHIP_SX1262, ENERGY_CHIP_SX1268 };
+    EnergyModel_t model;
+    uint8_t wrong = 0;
+
+    memset( &model, 0, sizeof( model ) );
+    model.Regulator = USE_DCDC;
+    for( uint8_t c = 0; c < sizeof( chips ) / sizeof( chips[0] ); c++ )
+    {
+        uint32_t previous = 0;
+        uint32_t current14;
+
+        model.Chip = chips[c];
+        model.TxPower = 14;
+        SX126x_EnergySetModel( &model );
+        current14 = SX126x_EnergyGetCurrent( MODE_TX );
+        for( int8_t power = -9; power <= 22; power++ )
+        {
+            uint32_t current;
+
+            model.TxPower = power;
+            SX126x_EnergySetModel( &model );
+            current = SX126x_EnergyGetCurrent( MODE_TX );
+            wrong += ( current < previous ) ? 1 : 0;
+            previous = current;
+        }
+        CHECK( wrong == 0 );
+
+        // Not flat below 14 dBm: the backed off PA draws less
+        model.TxPower = -9;
+        SX126x_EnergySetModel( &model );
+        CHECK( SX126x_EnergyGetCurrent( MODE_TX ) < current14 / 2 );
+    }
+
+    model.Chip = ENERGY_CHIP_SX1262;
+    model.TxPower = 22;
+    SX126x_EnergySetModel( &model );
+    CHECK( SX126x_EnergyGetCurrent( MODE_TX ) == 118000000 );
+    model.TxPower = 14;
+    SX126x_EnergySetModel( &model );
+    CHECK( SX126x_EnergyGetCurrent( MODE_TX ) == 90000000 );
+}
+
+/*!
+ * \brief TEST_DAYS of reports: wake up, send, an RX window, then sleep
+ *
+ * \retval      energy        Energy drawn [uJ]
+ */
+static uint64_t TestDays( const TestStrategy_t *strategy )
+{
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+    SleepParams_t sleep;
+    EnergyReport_t report;
+    uint64_t expected[ENERGY_STATES];
+    uint64_t charge = 0;
+    uint64_t cycle = 0;
+    uint64_t energy;
+    uint32_t cycles = TEST_DAYS * 86400UL / strategy->Period;
+    uint32_t toa;
+    uint32_t rest;
+
+    MockReset( );
+    SX126xHal_SpiInit( );
+    Elapsed = 0;
+    MockLoRaProfile( &modParams, &packetParams, strategy->Sf, TEST_PAYLOAD );
+    toa = SX126x_GetTimeOnAir( &modParams, &packetParams );
+    rest = strategy->Period * 1000000UL - TEST_WAKE_US - toa - TEST_RX_WINDOW_US;
+
+    SX126x_EnergyInit( MockTimeUs );
+    SX126x_SetRegulatorMode( strategy->Regulator );
+    SX126x_SetTxParams( strategy->Power, RADIO_RAMP_200_US );
+    sleep.Value = 0;
+    sleep.Fields.WarmStart = strategy->WarmStart;
+    SX126x_SetSleep( sleep );
+
+    for( uint32_t n = 0; n < cycles; n++ )
+    {
+        SX126x_SetStandby( STDBY_RC );
+        TestAdvance( TEST_WAKE_US );
+        SX126x_SetTx( 0 );
+        TestAdvance( toa );
+        MockRadio->Irq = IRQ_TX_DONE;
+        SX126x_ProcessIrqs( );
+        SX126x_SetRx( ( TEST_RX_WINDOW_US * 64 ) / 1000 );
+        TestAdvance( TEST_RX_WINDOW_US );
+        MockRadio->Irq = IRQ_RX_TX_TIMEOUT;
+        SX126x_ProcessIrqs( );
+        SX126x_SetSleep( sleep );
+        TestAdvance( rest );
+    }
+    SX126x_EnergyGetReport( &report, MockTimeUs );
+
+    // Every state against the time the node spent in it
+    memset( expected, 0, sizeof( expected ) );
+    expected[MODE_STDBY_RC] = ( uint64_t )cycles * TEST_WAKE_US;
+    expected[MODE_TX] = ( uint64_t )cycles * toa;
+    expected[MODE_RX] = ( uint64_t )cycles * TEST_RX_WINDOW_US;
+    expected[MODE_SLEEP] = ( uint64_t )cycles * rest;
+    for( uint8_t s = 0; s < ENERGY_STATES; s++ )
+    {
+        CHECK( report.Time[s] == expected[s] );
+        CHECK( report.Charge[s] == report.Time[s] * SX126x_EnergyGetCurrent( s ) );
+        charge += report.Charge[s];
+        cycle += expected[s] / cycles * SX126x_EnergyGetCurrent( s );
+    }
+    CHECK( Elapsed == ( uint64_t )TEST_DAYS * 86400 * 1000000 );
+    CHECK( report.Packets == cycles );
+    // From one TX done to the next: one whole cycle
+    CHECK( report.LastPacketEnergy == SX126x_EnergyToMicroJoule( cycle ) );
+
+    energy = SX126x_EnergyToMicroJoule( charge );
+    CHECK( ( energy + 1 >= charge * ( ENERGY_SUPPLY_MV / 1000.0 ) / 1e9 ) && ( energy <= charge * ( ENERGY_SUPPLY_MV / 1000.0 ) / 1e9 + 1 ) );
+
+    printf( "energy: %-28s %8.1f J in %u days, %7.0f uJ per report, %6.0f days on %u mAh\n", strategy->Name,
+            energy / 1e6, TEST_DAYS, energy / ( double )cycles, TEST_BATTERY_MAH * 3.6 / ( charge / 1e15 / TEST_DAYS ), TEST_BATTERY_MAH );
+    return energy;
+}
+
+int main( void )
+{
+    uint64_t energy[TEST_STRATEGIES];
+
+    MockReset( );
+    SX126xHal_SpiInit( );
+    TestCurves( );
+
+    for( uint8_t i = 0; i < TEST_STRATEGIES; i++ )
+    {
+        energy[i] = TestDays( &Strategies[i] );
+    }
+    CHECK( energy[TEST_MIN_POWER] < energy[TEST_LOW_POWER] );
+    CHECK( energy[TEST_LOW_POWER] < energy[TEST_BASELINE] );
+    CHECK( energy[TEST_BASELINE] < energy[TEST_HIGH_POWER] );
+    CHECK( energy[TEST_BASELINE] < energy[TEST_LDO] );
+    CHECK( energy[TEST_SF7] < energy[TEST_BASELINE] );
+    CHECK( energy[TEST_COLD_SLEEP] < energy[TEST_BASELINE] );
+    // Past what 32 bits of uJ hold
+    CHECK( energy[TEST_HEAVY] > UINT32_MAX );
+
+    return TestEnd( "test_energy" );
+}
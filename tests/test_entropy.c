@@ -0,0 +1,362 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Entropy pool: a reference ChaCha20 checked on the RFC 8439 vector, the
+ * harvest only while the radio receives anyway, no output before the seed,
+ * the generator against the reference through reseeds and their rate limit,
+ * the balance of its output, and its throughput against SX126x_GetRandom
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_entropy.h"
+
+#define TEST_BALANCE_BYTES                          ( 1024 * 1024 )
+#define TEST_GET_RANDOM_CALLS                       32      // 1 ms of real sleep each
+#define TEST_SPI_HZ                                 8000000
+
+#define TEST_ROTL( x, n )                           ( ( ( x ) << ( n ) ) | ( ( x ) >> ( 32 - ( n ) ) ) )
+
+/*!
+ * \brief Generator of the reference, built the way the driver documents it
+ */
+typedef struct
+{
+    uint32_t      Key[8];
+    uint8_t       Output[32];
+    uint8_t       Left;
+    uint32_t      Pool[8];
+    uint8_t       Slot;
+}TestGenerator_t;
+
+/*!
+ * \brief Value of the RNG register the radio gives
+ */
+static uint32_t Sample;
+
+static uint8_t TestReadRegister( uint16_t address )
+{
+    if( ( address >= RANDOM_NUMBER_GENERATORBASEADDR ) && ( address < RANDOM_NUMBER_GENERATORBASEADDR + 4 ) )
+    {
+        return ( uint8_t )( Sample >> ( 8 * ( 3 - ( address - RANDOM_NUMBER_GENERATORBASEADDR ) ) ) );
+    }
+    return 0;
+}
+
+/*!
+ * \brief ChaCha20 block as RFC 8439 writes it, counter and nonce at 0
+ */
+static void TestChaCha( const uint32_t *key, uint32_t *block )
+{
+    uint32_t x[16] = { 0x61707865, 0x3320646E, 0x79622D32, 0x6B206574 };
+
+    memcpy( &x[4], key, 8 * sizeof( uint32_t ) );
+    memcpy( block, x, sizeof( x ) );
+    for( uint8_t round = 0; round < 20; round++ )
+    {
+        // Columns on the even rounds, diagonals on the odd ones
+        static const uint8_t lanes[2][4][4] =
+        {
+            { { 0, 4, 8, 12 }, { 1, 5, 9, 13 }, { 2, 6, 10, 14 }, { 3, 7, 11, 15 } },
+            { { 0, 5, 10, 15 }, { 1, 6, 11, 12 }, { 2, 7, 8, 13 }, { 3, 4, 9, 14 } },
+        };
+
+        for( uint8_t q = 0; q < 4; q++ )
+        {
+            const uint8_t *l = lanes[round % 2][q];
+
+            x[l[0]] += x[l[1]]; x[l[3]] ^= x[l[0]]; x[l[3]] = TEST_ROTL( x[l[3]], 16 );
+            x[l[2]] += x[l[3]]; x[l[1]] ^= x[l[2]]; x[l[1]] = TEST_ROTL( x[l[1]], 12 );
+            x[l[0]] += x[l[1]]; x[l[3]] ^= x[l[0]]; x[l[3]] = TEST_ROTL( x[l[3]], 8 );
+            x[l[2]] += x[l[3]]; x[l[1]] ^= x[l[2]]; x[l[1]] = TEST_ROTL( x[l[1]], 7 );
+        }
+    }
+    for( uint8_t i = 0; i < 16; i++ )
+    {
+        block[i] += x[i];
+    }
+}
+
+static void TestRefill( TestGenerator_t *generator )
+{
+    uint32_t block[16];
+
+    TestChaCha( generator->Key, block );
+    memcpy( generator->Key, &block[0], sizeof( generator->Key ) );
+    memcpy( generator->Output, &block[8], sizeof( generator->Output ) );
+    generator->Left = sizeof( generator->Output );
+}
+
+static void TestMix( TestGenerator_t *generator, uint32_t sample )
+{
+    generator->Pool[generator->Slot] = TEST_ROTL( generator->Pool[generator->Slot], 7 ) ^ sample;
+    generator->Slot = ( generator->Slot + 1 ) % 8;
+}
+
+static void TestReseed( TestGenerator_t *generator )
+{
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        generator->Key[i] ^= generator->Pool[i];
+    }
+    TestRefill( generator );
+    generator->Left = 0;
+    memset( generator->Pool, 0, sizeof( generator->Pool ) );
+}
+
+static void TestGet( TestGenerator_t *generator, uint8_t *buffer, uint16_t size )
+{
+    while( size-- > 0 )
+    {
+        if( generator->Left == 0 )
+        {
+            TestRefill( generator );
+        }
+        *buffer++ = generator->Output[sizeof( generator->Output ) - generator->Left--];
+    }
+}
+
+/*!
+ * \brief One harvest a period later with a new value in the register
+ */
+static uint8_t TestHarvest( uint32_t sample )
+{
+    Sample = sample;
+    MockTimeUs += ENTROPY_HARVEST_PERIOD_US;
+    return SX126x_EntropyHarvest( );
+}
+
+static void TestVector( void )
+{
+    // RFC 8439 A.1, test vector 1: key, counter and nonce at 0
+    static const uint8_t expected[64] =
+    {
+        0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+        0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+        0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+        0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86,
+    };
+    uint32_t key[8] = { 0 };
+    uint32_t block[16];
+    uint8_t bytes[64];
+
+    TestChaCha( key, block );
+    for( uint8_t i = 0; i < 64; i++ )
+    {
+        bytes[i] = ( uint8_t )( block[i / 4] >> ( 8 * ( i % 4 ) ) );
+    }
+    CHECK( memcmp( bytes, expected, sizeof( expected ) ) == 0 );
+}
+
+static void TestHarvestOnly( void )
+{
+    uint8_t byte;
+    uint16_t log;
+
+    MockReset( );
+    MockOnReadRegister = TestReadRegister;
+    SX126x_SetStandby( STDBY_RC );
+    SX126x_EntropyInit( 0 );
+    CHECK( SX126x_EntropyIsSeeded( ) == 0 );
+    CHECK( SX126x_EntropyGet( &byte, 1 ) == 1 );
+
+    // Nothing read outside RX, the radio stays where it is
+    log = MockRadio->LogSize;
+    CHECK( TestHarvest( 0x12345678 ) == 0 );
+    CHECK( ( MockRadio->LogSize == log ) && ( MockRadio->Mode == MODE_STDBY_RC ) );
+
+    SX126x_SetRx( 0 );
+    log = MockRadio->LogSize;
+    CHECK( TestHarvest( 0x12345678 ) == 1 );
+    CHECK( ( MockRadio->LogSize == log + 1 ) && ( MockRadio->Log[log] == RADIO_READ_REGISTER ) );
+    CHECK( MockRadio->Mode == MODE_RX );
+    // Too early, then the same value again: the radio left RX
+    Sample = 0x9ABCDEF0;
+    MockTimeUs += ENTROPY_HARVEST_PERIOD_US - 1;
+    CHECK( SX126x_EntropyHarvest( ) == 0 );
+    CHECK( TestHarvest( 0x12345678 ) == 0 );
+
+    for( uint8_t i = 2; i < ENTROPY_RESEED_SAMPLES; i++ )
+    {
+        CHECK( TestHarvest( TestRandom( ) << 16 | TestRandom( ) ) == 1 );
+        CHECK( SX126x_EntropyIsSeeded( ) == 0 );
+    }
+    CHECK( TestHarvest( 0xCAFEF00D ) == 1 );
+    CHECK( SX126x_EntropyIsSeeded( ) == 1 );
+    CHECK( SX126x_EntropyGet( &byte, 1 ) == 0 );
+    CHECK( MockRadio->Mode == MODE_RX );
+}
+
+/*!
+ * \brief The driver against the reference: output, reseeds and their rate
+ *        limit
+ */
+static void TestReference( void )
+{
+    TestGenerator_t reference;
+    uint8_t served[100];
+    uint8_t expected[100];
+    uint32_t samples[ENTROPY_RESEED_SAMPLES];
+
+    MockReset( );
+    MockOnReadRegister = TestReadRegister;
+    SX126x_EntropyInit( 0 );
+    SX126x_SetRx( 0 );
+    memset( &reference, 0, sizeof( reference ) );
+
+    // Samples that leave the pool at zero: the first key is the one of the
+    // RFC vector
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        samples[i] = 0x01000193 * ( i + 1 );
+        samples[i + 8] = TEST_ROTL( samples[i], 7 );
+    }
+    for( uint8_t i = 0; i < ENTROPY_RESEED_SAMPLES; i++ )
+    {
+        CHECK( TestHarvest( samples[i] ) == 1 );
+        TestMix( &reference, samples[i] );
+    }
+    TestReseed( &reference );
+    CHECK( SX126x_EntropyIsSeeded( ) == 1 );
+
+    // Odd sizes across the blocks
+    for( uint16_t size = 1; size <= sizeof( served ); size += 33 )
+    {
+        CHECK( SX126x_EntropyGet( served, size ) == 0 );
+        TestGet( &reference, expected, size );
+        CHECK( memcmp( served, expected, size ) == 0 );
+    }
+
+    // A pool full again before the period: no reseed until it ends
+    for( uint8_t i = 0; i < 2 * ENTROPY_RESEED_SAMPLES; i++ )
+    {
+        uint32_t sample = TestRandom( ) << 16 | TestRandom( );
+
+        CHECK( TestHarvest( sample ) == 1 );
+        TestMix( &reference, sample );
+    }
+    CHECK( SX126x_EntropyGet( served, 40 ) == 0 );
+    TestGet( &reference, expected, 40 );
+    CHECK( memcmp( served, expected, 40 ) == 0 );
+
+    MockTimeUs += ENTROPY_RESEED_PERIOD_US;
+    Sample = 0x5EED5EED;
+    CHECK( SX126x_EntropyHarvest( ) == 1 );
+    TestMix( &reference, Sample );
+    TestReseed( &reference );
+    CHECK( SX126x_EntropyGet( served, 40 ) == 0 );
+    TestGet( &reference, expected, 40 );
+    CHECK( memcmp( served, expected, 40 ) == 0 );
+}
+
+static void TestBalance( void )
+{
+    static uint8_t buffer[TEST_BALANCE_BYTES];
+    uint32_t histogram[256] = { 0 };
+    uint64_t ones = 0;
+    double chi2 = 0;
+    double expected = TEST_BALANCE_BYTES / 256.0;
+
+    CHECK( SX126x_EntropyGet( buffer, 0 ) == 0 );
+    for( uint32_t offset = 0; offset < TEST_BALANCE_BYTES; offset += 4096 )
+    {
+        CHECK( SX126x_EntropyGet( &buffer[offset], 4096 ) == 0 );
+    }
+    for( uint32_t i = 0; i < TEST_BALANCE_BYTES; i++ )
+    {
+        histogram[buffer[i]]++;
+        ones += __builtin_popcount( buffer[i] );
+    }
+    for( uint16_t b = 0; b < 256; b++ )
+    {
+        chi2 += ( histogram[b] - expected ) * ( histogram[b] - expected ) / expected;
+    }
+    // 255 degrees of freedom: 330 is passed once in 1000 runs
+    printf( "entropy: %u bytes, %.4f %% of ones, chi2 of the bytes %.1f\n", TEST_BALANCE_BYTES,
+            100.0 * ones / ( 8.0 * TEST_BALANCE_BYTES ), chi2 );
+    CHECK( chi2 < 330 );
+    CHECK( ( ones > 4 * ( uint64_t )TEST_BALANCE_BYTES - 8000 ) && ( ones < 4 * ( uint64_t )TEST_BALANCE_BYTES + 8000 ) );
+}
+
+/*!
+ * \brief Random 32 bits words from RAM against SX126x_GetRandom, which
+ *        waits 1 ms in RX for each and leaves the radio in STDBY_RC
+ */
+static void TestThroughput( void )
+{
+    static uint8_t buffer[TEST_BALANCE_BYTES];
+    uint64_t start;
+    uint32_t spiBytes;
+    uint32_t words = 0;
+    uint32_t value;
+    uint32_t refused = 0;
+    double poolRate;
+    double wordRate;
+    double radioRate;
+    double harvestUs;
+
+    start = TestNowNs( );
+    for( uint32_t offset = 0; offset < TEST_BALANCE_BYTES; offset += 4096 )
+    {
+        refused += SX126x_EntropyGet( &buffer[offset], 4096 );
+    }
+    poolRate = sizeof( buffer ) * 1e9 / ( TestNowNs( ) - start );
+    start = TestNowNs( );
+    for( uint32_t i = 0; i < TEST_BALANCE_BYTES / 4; i++ )
+    {
+        refused += SX126x_EntropyGetU32( &value );
+        words ^= value;
+    }
+    wordRate = TEST_BALANCE_BYTES * 1e9 / ( TestNowNs( ) - start );
+    CHECK( refused == 0 );
+
+    spiBytes = MockSpiBytes;
+    start = TestNowNs( );
+    for( uint8_t i = 0; i < TEST_GET_RANDOM_CALLS; i++ )
+    {
+        words ^= SX126x_GetRandom( );
+    }
+    radioRate = 4 * TEST_GET_RANDOM_CALLS * 1e9 / ( TestNowNs( ) - start );
+    CHECK( MockRadio->Mode == MODE_STDBY_RC );
+    spiBytes = MockSpiBytes - spiBytes;
+
+    // A harvest: the register read alone, on a radio already in RX
+    SX126x_SetRx( 0 );
+    MockSpiBytes = 0;
+    CHECK( TestHarvest( words + 1 ) == 1 );
+    harvestUs = MockSpiBytes * 8 * 1e6 / TEST_SPI_HZ;
+
+    printf( "entropy: pool %.1f MB/s in buffers, %.1f MB/s in 32 bits words; SX126x_GetRandom %.0f B/s with %u SPI bytes "
+            "and 1 ms of RX per word; a harvest %u SPI bytes, %.0f us at %u MHz\n", poolRate / 1e6, wordRate / 1e6,
+            radioRate, spiBytes / TEST_GET_RANDOM_CALLS, MockSpiBytes, harvestUs, TEST_SPI_HZ / 1000000 );
+    CHECK( radioRate <= 4000 );
+    CHECK( wordRate > 1000 * radioRate );
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    TestVector( );
+    TestHarvestOnly( );
+    TestReference( );
+    TestBalance( );
+    TestThroughput( );
+
+    return TestEnd( "test_entropy" );
+}
@@ -0,0 +1,242 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * FEC: the field arithmetic against a bitwise reference, groups rebuilt from
+ * any k of their k + m fragments, the messages recovered on a lossy channel
+ * and the encode and decode throughput
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sx126x_fec.h"
+
+#define TEST_GROUPS                                 5000
+#define TEST_CHANNEL_MESSAGES                       20000
+#define TEST_BENCHMARK_LENGTH                       240
+#define TEST_BENCHMARK_ROUNDS                       2000
+
+static uint8_t Fragments[FEC_MAX_DATA + FEC_MAX_PARITY][256];
+static uint8_t Original[FEC_MAX_DATA][256];
+static uint8_t *Pointers[FEC_MAX_DATA + FEC_MAX_PARITY];
+
+/*!
+ * \brief Multiplication modulo 0x11D, one bit at a time
+ */
+static uint8_t TestGfMul( uint8_t a, uint8_t b )
+{
+    uint8_t product = 0;
+
+    while( b != 0 )
+    {
+        if( ( b & 1 ) != 0 )
+        {
+            product ^= a;
+        }
+        a = ( uint8_t )( ( a << 1 ) ^ ( ( ( a & 0x80 ) != 0 ) ? 0x1D : 0 ) );
+        b >>= 1;
+    }
+    return product;
+}
+
+static void TestField( void )
+{
+    uint32_t wrong = 0;
+
+    for( uint16_t a = 0; a < 256; a++ )
+    {
+        for( uint16_t b = 0; b < 256; b++ )
+        {
+            wrong += ( SX126x_GfMul( a, b ) != TestGfMul( a, b ) ) ? 1 : 0;
+        }
+        if( a != 0 )
+        {
+            CHECK( SX126x_GfMul( a, SX126x_GfInv( a ) ) == 1 );
+        }
+    }
+    CHECK( wrong == 0 );
+    CHECK( SX126x_GfInv( 0 ) == 0 );
+}
+
+/*!
+ * \brief Fills k data fragments and computes m parity fragments
+ */
+static void TestEncode( uint8_t k, uint8_t m, uint16_t length )
+{
+    for( uint8_t i = 0; i < k + m; i++ )
+    {
+        Pointers[i] = Fragments[i];
+    }
+    for( uint8_t j = 0; j < k; j++ )
+    {
+        for( uint16_t n = 0; n < length; n++ )
+        {
+            Original[j][n] = ( uint8_t )TestRandom( );
+        }
+        memcpy( Fragments[j], Original[j], length );
+    }
+    SX126x_FecEncode( Pointers, k, &Pointers[k], m, length );
+}
+
+/*!
+ * \brief Erases lost fragments at random, the lost data is overwritten
+ */
+static void TestErase( uint8_t *received, uint8_t k, uint8_t m, uint8_t lost, uint16_t length )
+{
+    memset( received, 1, k + m );
+    while( lost > 0 )
+    {
+        uint8_t i = TestRandom( ) % ( k + m );
+
+        if( received[i] == 1 )
+        {
+            received[i] = 0;
+            memset( Fragments[i], 0xA5, length );
+            lost--;
+        }
+    }
+}
+
+static uint8_t TestIntact( uint8_t k, uint16_t length )
+{
+    for( uint8_t j = 0; j < k; j++ )
+    {
+        if( memcmp( Fragments[j], Original[j], length ) != 0 )
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void TestGroups( void )
+{
+    uint8_t received[FEC_MAX_DATA + FEC_MAX_PARITY];
+
+    for( uint32_t g = 0; g < TEST_GROUPS; g++ )
+    {
+        uint8_t k = 1 + TestRandom( ) % FEC_MAX_DATA;
+        uint8_t m = 1 + TestRandom( ) % FEC_MAX_PARITY;
+        // Odd lengths too, for the tail after the 16 byte steps
+        uint16_t length = 1 + TestRandom( ) % 255;
+        uint8_t lost = TestRandom( ) % ( m + 1 );
+
+        TestEncode( k, m, length );
+        TestErase( received, k, m, lost, length );
+        CHECK( SX126x_FecDecode( Pointers, received, k, m, length ) == 0 );
+        CHECK( TestIntact( k, length ) == 1 );
+        for( uint8_t j = 0; j < k; j++ )
+        {
+            CHECK( received[j] == 1 );
+        }
+
+        // One more than the parity can rebuild
+        TestEncode( k, m, length );
+        TestErase( received, k, m, m + 1, length );
+        CHECK( SX126x_FecDecode( Pointers, received, k, m, length ) == 1 );
+    }
+
+    // Out of range
+    memset( received, 1, sizeof( received ) );
+    CHECK( SX126x_FecDecode( Pointers, received, FEC_MAX_DATA + 1, 1, 16 ) == 1 );
+    CHECK( SX126x_FecDecode( Pointers, received, 1, FEC_MAX_PARITY + 1, 16 ) == 1 );
+}
+
+/*!
+ * \brief Every fragment is lost with the given probability: a message is
+ *        recovered when all its data can be rebuilt
+ */
+static void TestChannel( void )
+{
+    static const uint8_t losses[] = { 10, 20, 30 };
+    static const uint8_t parities[] = { 0, 4, 8 };
+    uint8_t received[FEC_MAX_DATA + FEC_MAX_PARITY];
+    uint8_t k = 16;
+    uint16_t length = 32;
+
+    for( uint8_t l = 0; l < sizeof( losses ); l++ )
+    {
+        printf( "fec: %2u %% loss, %u data fragments:", losses[l], k );
+        for( uint8_t p = 0; p < sizeof( parities ); p++ )
+        {
+            uint8_t m = parities[p];
+            uint32_t recovered = 0;
+
+            for( uint32_t n = 0; n < TEST_CHANNEL_MESSAGES / 10; n++ )
+            {
+                uint8_t lost = 0;
+
+                for( uint8_t i = 0; i < k + m; i++ )
+                {
+                    lost += ( TestRandom( ) % 100 < losses[l] ) ? 1 : 0;
+                }
+                TestEncode( k, m, length );
+                TestErase( received, k, m, lost, length );
+                if( ( SX126x_FecDecode( Pointers, received, k, m, length ) == 0 ) && ( TestIntact( k, length ) == 1 ) )
+                {
+                    recovered++;
+                }
+                CHECK( ( lost <= m ) == ( TestIntact( k, length ) == 1 ) );
+            }
+            printf( " %5.1f %% recovered with %u parity", 100.0 * recovered / ( TEST_CHANNEL_MESSAGES / 10 ), m );
+        }
+        printf( "\n" );
+    }
+}
+
+static void TestBenchmark( void )
+{
+    uint8_t received[FEC_MAX_DATA + FEC_MAX_PARITY];
+    uint8_t k = 16;
+    uint8_t m = 4;
+    uint64_t start;
+    uint64_t encode = 0;
+    uint64_t decode = 0;
+    uint8_t ok = 1;
+
+    for( uint32_t r = 0; r < TEST_BENCHMARK_ROUNDS; r++ )
+    {
+        TestEncode( k, m, 0 );
+        start = TestNowNs( );
+        SX126x_FecEncode( Pointers, k, &Pointers[k], m, TEST_BENCHMARK_LENGTH );
+        encode += TestNowNs( ) - start;
+
+        // The worst case, m data fragments lost
+        memset( received, 1, k + m );
+        for( uint8_t j = 0; j < m; j++ )
+        {
+            received[j * ( k / m )] = 0;
+        }
+        start = TestNowNs( );
+        ok &= ( SX126x_FecDecode( Pointers, received, k, m, TEST_BENCHMARK_LENGTH ) == 0 ) ? 1 : 0;
+        decode += TestNowNs( ) - start;
+    }
+    CHECK( ok == 1 );
+
+    printf( "fec%s%s: k %u m %u, %u byte fragments, encode %.1f MB/s, decode of %u lost %.1f MB/s of data on host\n",
+            ( TEST_VARIANT[0] != '\0' ) ? " " : "", TEST_VARIANT, k, m, TEST_BENCHMARK_LENGTH,
+            ( double )k * TEST_BENCHMARK_LENGTH * TEST_BENCHMARK_ROUNDS / ( encode / 1e9 ) / 1e6, m,
+            ( double )k * TEST_BENCHMARK_LENGTH * TEST_BENCHMARK_ROUNDS / ( decode / 1e9 ) / 1e6 );
+}
+
+int main( void )
+{
+    TestField( );
+    TestGroups( );
+    TestChannel( );
+    TestBenchmark( );
+
+    return TestEnd( "test_fec" );
+}
@@ -0,0 +1,219 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Fragmentation: the frames the radio sends are given back to the receiver
+ * out of order, with duplicates, losses and timeouts
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_frag.h"
+
+#define TEST_MESSAGE                                3000
+#define TEST_BENCHMARK_MESSAGES                     2000
+
+static uint8_t Frames[FRAG_MAX_FRAGMENTS][256];
+static uint8_t FrameSizes[FRAG_MAX_FRAGMENTS];
+static uint8_t FrameCount = 0;
+
+static uint8_t Message[FRAG_MAX_MESSAGE];
+
+static void TestOnTx( uint8_t *payload, uint8_t size )
+{
+    if( FrameCount < FRAG_MAX_FRAGMENTS )
+    {
+        memcpy( Frames[FrameCount], payload, size );
+        FrameSizes[FrameCount++] = size;
+    }
+}
+
+/*!
+ * \brief Sends a message, the frames are kept in Frames
+ */
+static void TestSend( uint8_t source, uint16_t size )
+{
+    FrameCount = 0;
+    CHECK( SX126x_FragSend( source, Message, size ) == 0 );
+    // One message at a time
+    CHECK( SX126x_FragSend( source, Message, size ) == 1 );
+    while( SX126x_FragOnTxDone( ) == 0 )
+    {
+    }
+}
+
+static FragStatus_t TestReceive( uint8_t frame, FragMessage_t *message )
+{
+    MockReceive( Frames[frame], FrameSizes[frame] );
+    return SX126x_FragReceive( message );
+}
+
+static void TestShuffle( uint8_t *order, uint8_t count )
+{
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        order[i] = i;
+    }
+    for( uint8_t i = count - 1; i > 0; i-- )
+    {
+        uint8_t j = TestRandom( ) % ( i + 1 );
+        uint8_t swap = order[i];
+
+        order[i] = order[j];
+        order[j] = swap;
+    }
+}
+
+static void TestReassembly( void )
+{
+    uint8_t order[FRAG_MAX_FRAGMENTS];
+    FragMessage_t message;
+    uint32_t sent = 0;
+    uint8_t blocks = ( TEST_MESSAGE + FRAG_BLOCK_SIZE - 1 ) / FRAG_BLOCK_SIZE;
+
+    TestSend( 7, TEST_MESSAGE );
+    CHECK( FrameCount == ( TEST_MESSAGE + 255 - FRAG_HEADER_SIZE - 1 ) / ( 255 - FRAG_HEADER_SIZE ) );
+    for( uint8_t i = 0; i < FrameCount; i++ )
+    {
+        CHECK( ( Frames[i][0] == 7 ) && ( Frames[i][2] == i ) && ( Frames[i][3] == FrameCount ) );
+        CHECK( ( Frames[i][4] | ( Frames[i][5] << 8 ) ) == TEST_MESSAGE );
+        // Straight from the message
+        CHECK( memcmp( &Frames[i][FRAG_HEADER_SIZE], &Message[sent], FrameSizes[i] - FRAG_HEADER_SIZE ) == 0 );
+        sent += FrameSizes[i] - FRAG_HEADER_SIZE;
+    }
+    CHECK( sent == TEST_MESSAGE );
+
+    TestShuffle( order, FrameCount );
+    for( uint8_t i = 0; i < FrameCount - 1; i++ )
+    {
+        CHECK( TestReceive( order[i], &message ) == FRAG_INCOMPLETE );
+    }
+    CHECK( TestReceive( order[0], &message ) == FRAG_DUPLICATE );
+    CHECK( SX126x_FragGetFreeBlocks( ) == FRAG_POOL_BLOCKS - blocks );
+    CHECK( TestReceive( order[FrameCount - 1], &message ) == FRAG_COMPLETE );
+    CHECK( ( message.Source == 7 ) && ( message.Size == TEST_MESSAGE ) );
+    CHECK( memcmp( message.Data, Message, TEST_MESSAGE ) == 0 );
+    CHECK( TestReceive( order[1], &message ) == FRAG_DUPLICATE );
+    SX126x_FragRelease( &message );
+    CHECK( SX126x_FragGetFreeBlocks( ) == FRAG_POOL_BLOCKS );
+
+    // Not a fragment
+    MockReceive( Frames[0], FRAG_HEADER_SIZE );
+    CHECK( SX126x_FragReceive( &message ) == FRAG_INVALID );
+}
+
+static void TestLimits( void )
+{
+    FragMessage_t message;
+
+    // A lost fragment: the message is dropped after FRAG_TIMEOUT_MS
+    TestSend( 1, TEST_MESSAGE );
+    for( uint8_t i = 1; i < FrameCount; i++ )
+    {
+        CHECK( TestReceive( i, &message ) == FRAG_INCOMPLETE );
+    }
+
+    // Not enough blocks left for a second one
+    TestSend( 2, TEST_MESSAGE );
+    CHECK( TestReceive( 0, &message ) == FRAG_NO_MEMORY );
+
+    MockTimeUs += FRAG_TIMEOUT_MS * 1000 - 1000;
+    SX126x_FragExpire( );
+    CHECK( SX126x_FragGetFreeBlocks( ) < FRAG_POOL_BLOCKS );
+    MockTimeUs += 2000;
+    SX126x_FragExpire( );
+    CHECK( SX126x_FragGetFreeBlocks( ) == FRAG_POOL_BLOCKS );
+
+    // Every context held by an incomplete message: a new one waits for them to
+    // expire, then takes the place of a stale one
+    for( uint8_t i = 0; i <= FRAG_CONTEXTS; i++ )
+    {
+        TestSend( 10 + i, 300 );
+        CHECK( TestReceive( 0, &message ) == ( ( i < FRAG_CONTEXTS ) ? FRAG_INCOMPLETE : FRAG_NO_MEMORY ) );
+    }
+    MockTimeUs += FRAG_TIMEOUT_MS * 1000 + 1000;
+    CHECK( TestReceive( 0, &message ) == FRAG_INCOMPLETE );
+    MockTimeUs += FRAG_TIMEOUT_MS * 1000 + 1000;
+    SX126x_FragExpire( );
+    CHECK( SX126x_FragGetFreeBlocks( ) == FRAG_POOL_BLOCKS );
+
+    // Too large
+    CHECK( SX126x_FragSend( 1, Message, FRAG_MAX_MESSAGE + 1 ) == 1 );
+}
+
+static void TestBenchmark( ModulationParams_t *modParams, PacketParams_t *packetParams )
+{
+    FragMessage_t message;
+    uint64_t start;
+    double seconds;
+    uint32_t air = 0;
+    uint8_t ok = 1;
+
+    TestSend( 3, TEST_MESSAGE );
+    for( uint8_t i = 0; i < FrameCount; i++ )
+    {
+        packetParams->Params.LoRa.PayloadLength = FrameSizes[i];
+        air += SX126x_GetTimeOnAir( modParams, packetParams );
+    }
+
+    start = TestNowNs( );
+    for( uint32_t m = 0; m < TEST_BENCHMARK_MESSAGES; m++ )
+    {
+        for( uint8_t i = 0; i < FrameCount; i++ )
+        {
+            // A new message id every time
+            Frames[i][1] = ( uint8_t )m;
+            if( TestReceive( i, &message ) == ( ( i == FrameCount - 1 ) ? FRAG_COMPLETE : FRAG_INCOMPLETE ) )
+            {
+                continue;
+            }
+            ok = 0;
+        }
+        SX126x_FragRelease( &message );
+    }
+    seconds = ( TestNowNs( ) - start ) / 1e9;
+    CHECK( ok == 1 );
+
+    printf( "frag: %u byte message in %u frames, reassembled at %.1f MB/s on host through the mock SPI\n",
+            TEST_MESSAGE, FrameCount, ( double )TEST_MESSAGE * TEST_BENCHMARK_MESSAGES / seconds / 1e6 );
+    printf( "frag: %.2f s on air at SF7, %.0f B/s, %u bytes of reassembly pool\n",
+            air / 1e6, TEST_MESSAGE / ( air / 1e6 ), FRAG_POOL_BLOCKS * FRAG_BLOCK_SIZE );
+}
+
+int main( void )
+{
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+
+    MockReset( );
+    SX126xHal_SpiInit( );
+    MockLoRaProfile( &modParams, &packetParams, LORA_SF7, 255 );
+    SX126x_SetPacketType( PACKET_TYPE_LORA );
+    SX126x_FragInit( &packetParams );
+    MockOnTx = TestOnTx;
+
+    for( uint16_t i = 0; i < sizeof( Message ); i++ )
+    {
+        Message[i] = ( uint8_t )TestRandom( );
+    }
+
+    TestReassembly( );
+    TestLimits( );
+    TestBenchmark( &modParams, &packetParams );
+
+    return TestEnd( "test_frag" );
+}
@@ -0,0 +1,162 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Interrupts defer their radio work to the HAL: randomized interleaving of the
+ * main context and of an interrupt raised on any pin or SPI access
+ */
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+
+#define TEST_REQUEST                                0
+#define TEST_ITERATIONS                             200000
+
+static uint8_t InSequence = 0;
+static uint32_t HandlerInSequence = 0;
+static uint32_t Raised = 0;
+static uint32_t Served = 0;
+static uint8_t Waiting = 0;
+static uint32_t Transactions = 0;                   // Since the oldest request not served
+static uint32_t WorstTransactions = 0;
+
+/*!
+ * \brief Does what DIO1 used to do from the interrupt: radio commands
+ */
+static void TestHandler( void )
+{
+    uint8_t buffer[3] = { 0x00, 0x00, 0x00 };
+
+    if( InSequence == 1 )
+    {
+        HandlerInSequence++;
+    }
+    SX126xHal_WriteCommand( RADIO_SET_RX, buffer, 3 );
+    Served++;
+    Waiting = 0;
+    if( Transactions > WorstTransactions )
+    {
+        WorstTransactions = Transactions;
+    }
+    Transactions = 0;
+}
+
+static void TestIsr( void )
+{
+    Raised++;
+    if( Waiting == 0 )
+    {
+        Waiting = 1;
+        Transactions = 0;
+    }
+    SX126xHal_DeferFromIsr( TEST_REQUEST );
+}
+
+/*!
+ * \brief One interrupt every 7 accesses on average
+ */
+static void TestOnAccess( void )
+{
+    static uint8_t inIsr = 0;
+
+    if( ( inIsr == 0 ) && ( TestRandom( ) % 7 == 0 ) )
+    {
+        inIsr = 1;
+        MockRunIsr( TestIsr );
+        inIsr = 0;
+    }
+}
+
+static void TestDeferredAfterUnlock( void )
+{
+    uint8_t buffer[8] = { 0 };
+
+    Served = 0;
+    SX126xHal_Lock( );
+    InSequence = 1;
+    SX126xHal_WriteBuffer( 0, buffer, 8 );
+    MockRunIsr( TestIsr );
+    // Not served between the steps of a locked sequence
+    SX126xHal_WriteCommand( RADIO_SET_TX, buffer, 3 );
+    CHECK( Served == 0 );
+    InSequence = 0;
+    SX126xHal_Unlock( );
+    CHECK( Served == 1 );
+    CHECK( SX126xHal_HasPending( ) == 0 );
+
+    // Raised while the bus is free: served by the main loop
+    MockRunIsr( TestIsr );
+    CHECK( SX126xHal_HasPending( ) == 1 );
+    CHECK( Served == 1 );
+    SX126xHal_ProcessPending( );
+    CHECK( Served == 2 );
+    CHECK( HandlerInSequence == 0 );
+}
+
+static void TestRandomInterleaving( void )
+{
+    uint8_t buffer[8] = { 0 };
+
+    Raised = Served = 0;
+    Waiting = 0;
+    MockOnAccess = TestOnAccess;
+    for( uint32_t i = 0; i < TEST_ITERATIONS; i++ )
+    {
+        switch( TestRandom( ) % 3 )
+        {
+            case 0:
+                // SendPayload: the payload and the TX command
+                SX126xHal_Lock( );
+                InSequence = 1;
+                SX126xHal_WriteBuffer( 0, buffer, 8 );
+                SX126xHal_WriteCommand( RADIO_SET_TX, buffer, 3 );
+                InSequence = 0;
+                SX126xHal_Unlock( );
+                break;
+
+            case 1:
+                SX126xHal_ReadRegister( 0x0740, buffer, 2 );
+                break;
+
+            default:
+                SX126xHal_ProcessPending( );
+                break;
+        }
+        Transactions++;
+    }
+    MockOnAccess = NULL;
+    SX126xHal_ProcessPending( );
+
+    printf( "interleaving: %u interrupts, %u handler runs, worst %u driver calls before service\n", Raised, Served, WorstTransactions );
+    CHECK( Raised > 0 );
+    CHECK( Waiting == 0 );
+    CHECK( HandlerInSequence == 0 );
+    CHECK( MockNssViolations == 0 );
+    CHECK( MockIsrSpiAccesses == 0 );
+    // A request waits at most for the driver call it interrupted
+    CHECK( WorstTransactions <= 1 );
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    SX126xHal_SetDeferredHandler( TEST_REQUEST, TestHandler );
+
+    TestDeferredAfterUnlock( );
+    TestRandomInterleaving( );
+
+    return TestEnd( "test_isr" );
+}
@@ -0,0 +1,313 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * GFSK long packets against a byte level model of the packet handler: the
+ * data buffer used as a ring, the buffer pointer register and the payload
+ * length register compared with the 8 bit byte count. The handler moves one
+ * byte per byte time while the SPI transfers of the driver take their time
+ * on the bus. Packets of every size, in TX and RX, served at random periods
+ * up to SX126x_LongPktGetPeriod, and the throughput against packets of 255
+ * bytes.
+ *
+ * The register behaviour is the one the driver assumes, the datasheet does
+ * not describe it: this checks the driver against that model, not the chip.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_longpkt.h"
+
+#define TEST_MAX_SIZE                               65000
+#define TEST_RANDOM_SIZES                           30
+#define TEST_START_BYTES                            8       // Preamble and sync word before the first data byte
+#define TEST_FRAME_OVERHEAD_BYTES                   11      // Preamble, sync word, length and CRC of a short packet
+#define TEST_FRAME_GAP_US                           300     // From TX done to the next TX, assumed
+
+/*!
+ * \brief The packet handler of the model
+ */
+typedef struct
+{
+    uint8_t       Active;
+    uint8_t       Tx;
+    uint8_t       Pointer;                          //!< REG_BUFFER_POINTER
+    uint8_t       Length;                           //!< REG_GFSK_PAYLOADLENGTH
+    uint32_t      Count;                            //!< Bytes sent or received
+    double        Next;                             //!< Time of the next byte [ns]
+    double        ByteNs;
+    double        Start;
+    double        End;
+}TestHandler_t;
+
+/*!
+ * \brief What a transfer did
+ */
+typedef struct
+{
+    uint8_t       Intact;                           //!< 1 if every byte arrived, in place, and no more
+    uint32_t      Count;                            //!< Returned by SX126x_LongPktOnDone
+    double        AirNs;
+    double        SpiNs;                            //!< Time the bus was busy
+    uint32_t      Services;
+}TestResult_t;
+
+static TestHandler_t Handler;
+static uint8_t Air[TEST_MAX_SIZE + 512];            //!< The bytes on the air
+static uint8_t Data[TEST_MAX_SIZE + 512];           //!< Given to the driver
+static double Now;                                  //!< Simulated time [ns]
+static double SpiNs;
+static uint32_t SpiBytes;
+static uint32_t SpiHz;
+
+static void TestRun( double until )
+{
+    while( ( Handler.Active == 1 ) && ( Handler.Next <= until ) )
+    {
+        if( Handler.Tx == 1 )
+        {
+            Air[Handler.Count] = MockRadio->Buffer[Handler.Pointer];
+        }
+        else
+        {
+            MockRadio->Buffer[Handler.Pointer] = Air[Handler.Count];
+        }
+        Handler.Pointer++;
+        Handler.Count++;
+        Handler.Next += Handler.ByteNs;
+        if( ( ( uint8_t )Handler.Count == Handler.Length ) || ( Handler.Count == sizeof( Air ) ) )
+        {
+            Handler.Active = 0;
+            Handler.End = Handler.Next;
+        }
+    }
+}
+
+/*!
+ * \brief Every pin and SPI access: the bytes clocked since the last one took
+ *        their time, the handler went on meanwhile
+ */
+static void TestOnAccess( void )
+{
+    double elapsed = ( MockSpiBytes - SpiBytes ) * 8e9 / SpiHz;
+
+    SpiBytes = MockSpiBytes;
+    Now += elapsed;
+    SpiNs += elapsed;
+    TestRun( Now );
+}
+
+static uint8_t TestReadRegister( uint16_t address )
+{
+    return ( address == REG_BUFFER_POINTER ) ? Handler.Pointer : 0;
+}
+
+static void TestWriteRegister( uint16_t address, uint8_t value )
+{
+    if( address == REG_GFSK_PAYLOADLENGTH )
+    {
+        Handler.Length = value;
+    }
+}
+
+static void TestGfsk( PacketParams_t *packetParams )
+{
+    memset( packetParams, 0, sizeof( PacketParams_t ) );
+    packetParams->PacketType = PACKET_TYPE_GFSK;
+    packetParams->Params.Gfsk.PreambleLength = 4;
+    packetParams->Params.Gfsk.PreambleMinDetect = RADIO_PREAMBLE_DETECTOR_16_BITS;
+    packetParams->Params.Gfsk.SyncWordLength = 4;
+    packetParams->Params.Gfsk.AddrComp = RADIO_ADDRESSCOMP_FILT_OFF;
+    packetParams->Params.Gfsk.HeaderType = RADIO_PACKET_FIXED_LENGTH;
+    packetParams->Params.Gfsk.CrcLength = RADIO_CRC_OFF;
+    packetParams->Params.Gfsk.DcFree = RADIO_DC_FREE_OFF;
+}
+
+/*!
+ * \brief One packet, SX126x_LongPktProcess called at random periods up to
+ *        scale times SX126x_LongPktGetPeriod
+ *
+ * \param [in]  rxLength      In RX, size of the packet, carried in its first
+ *                            two bytes when smaller than size
+ */
+static TestResult_t TestTransfer( uint8_t tx, uint32_t size, uint32_t rxLength, uint32_t bitRate, uint32_t spiHz, double scale )
+{
+    PacketParams_t packetParams;
+    TestResult_t result;
+    double period = SX126x_LongPktGetPeriod( bitRate ) * 1e3;
+    uint32_t expected = tx ? size : rxLength;
+    uint8_t lengthSet = 0;
+
+    memset( &result, 0, sizeof( result ) );
+    MockReset( );
+    SX126x_SetPacketType( PACKET_TYPE_GFSK );
+    TestGfsk( &packetParams );
+
+    for( uint32_t i = 0; i < size; i++ )
+    {
+        Data[i] = ( uint8_t )TestRandom( );
+    }
+    if( tx == 0 )
+    {
+        Data[0] = ( uint8_t )( rxLength >> 8 );
+        Data[1] = ( uint8_t )rxLength;
+        // The air carries the packet and then whatever comes after it
+        memcpy( Air, Data, size );
+        for( uint32_t i = size; i < sizeof( Air ); i++ )
+        {
+            Air[i] = ( uint8_t )TestRandom( );
+        }
+        memset( Data, 0, size );
+    }
+    else
+    {
+        memset( Air, 0, sizeof( Air ) );
+    }
+
+    memset( &Handler, 0, sizeof( Handler ) );
+    Handler.Tx = tx;
+    Handler.ByteNs = 8e9 / bitRate;
+    Now = 0;
+    SpiNs = 0;
+    SpiBytes = 0;
+    SpiHz = spiHz;
+    MockOnAccess = TestOnAccess;
+    MockOnReadRegister = TestReadRegister;
+    MockOnWriteRegister = TestWriteRegister;
+
+    if( tx == 1 )
+    {
+        CHECK( SX126x_LongPktSend( &packetParams, Data, size ) == 0 );
+    }
+    else
+    {
+        CHECK( SX126x_LongPktReceive( &packetParams, Data, size, 0 ) == 0 );
+    }
+    Handler.Active = 1;
+    Handler.Start = Now + TEST_START_BYTES * Handler.ByteNs;
+    Handler.Next = Handler.Start;
+
+    while( Handler.Active == 1 )
+    {
+        uint32_t progress;
+
+        Now += period * scale * ( 0.25 + 0.75 * ( TestRandom( ) % 1000 ) / 1000.0 );
+        TestRun( Now );
+        if( Handler.Active == 0 )
+        {
+            break;
+        }
+        progress = SX126x_LongPktProcess( );
+        result.Services++;
+        if( ( tx == 0 ) && ( lengthSet == 0 ) && ( progress >= 2 ) && ( rxLength < size ) )
+        {
+            SX126x_LongPktSetRxLength( ( ( uint32_t )Data[0] << 8 ) | Data[1] );
+            lengthSet = 1;
+        }
+    }
+    // TX or RX done raised at the end of the last byte
+    Now = ( Now > Handler.End ) ? Now : Handler.End;
+    result.Count = SX126x_LongPktOnDone( );
+    MockOnAccess = NULL;
+
+    result.Intact = ( Handler.Count == expected ) && ( result.Count == expected ) && ( memcmp( Air, Data, expected ) == 0 );
+    result.AirNs = Handler.End - Handler.Start;
+    result.SpiNs = SpiNs;
+    return result;
+}
+
+static void TestSizes( void )
+{
+    static const uint32_t sizes[] = { 1, 2, 200, 254, 255, 256, 257, 300, 510, 511, 512, 513, 767, 768, 769, 1000, 4096, TEST_MAX_SIZE };
+    static const uint32_t rates[][2] = { { 50000, 8000000 }, { 250000, 8000000 }, { 300000, 1000000 } };
+    uint32_t wrong = 0;
+
+    for( uint8_t r = 0; r < sizeof( rates ) / sizeof( rates[0] ); r++ )
+    {
+        for( uint8_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ) + TEST_RANDOM_SIZES; i++ )
+        {
+            uint32_t size = ( i < sizeof( sizes ) / sizeof( sizes[0] ) ) ? sizes[i] : 1 + TestRandom( ) % 20000;
+
+            wrong += TestTransfer( 1, size, size, rates[r][0], rates[r][1], 1.0 ).Intact ? 0 : 1;
+            wrong += TestTransfer( 0, size, size, rates[r][0], rates[r][1], 1.0 ).Intact ? 0 : 1;
+        }
+    }
+    CHECK( wrong == 0 );
+
+    // The length field of the packet known after its first bytes
+    CHECK( TestTransfer( 0, 60000, 3000, 250000, 8000000, 1.0 ).Intact == 1 );
+    CHECK( TestTransfer( 0, 60000, 256, 250000, 8000000, 1.0 ).Intact == 1 );
+
+    // Out of the supported formats, or while a transfer runs
+    {
+        PacketParams_t packetParams;
+
+        TestGfsk( &packetParams );
+        packetParams.Params.Gfsk.HeaderType = RADIO_PACKET_VARIABLE_LENGTH;
+        CHECK( SX126x_LongPktSend( &packetParams, Data, 1000 ) == 1 );
+        TestGfsk( &packetParams );
+        CHECK( SX126x_LongPktSend( &packetParams, Data, 0 ) == 1 );
+        CHECK( SX126x_LongPktSend( &packetParams, Data, 1000 ) == 0 );
+        CHECK( SX126x_LongPktReceive( &packetParams, Data, 1000, 0 ) == 1 );
+        SX126x_LongPktOnDone( );
+    }
+}
+
+/*!
+ * \brief Served too slowly the ring runs over: the model must see it
+ */
+static void TestTooSlow( void )
+{
+    CHECK( TestTransfer( 1, 20000, 20000, 250000, 8000000, 3.0 ).Intact == 0 );
+    CHECK( TestTransfer( 0, 20000, 20000, 250000, 8000000, 3.0 ).Intact == 0 );
+}
+
+static void TestThroughput( void )
+{
+    static const uint32_t rates[] = { 50000, 100000, 250000 };
+    uint32_t size = 16384;
+
+    for( uint8_t r = 0; r < sizeof( rates ) / sizeof( rates[0] ); r++ )
+    {
+        TestResult_t result = TestTransfer( 1, size, size, rates[r], 8000000, 1.0 );
+        double longRate = size * 8 / ( ( result.AirNs + TEST_START_BYTES * 8e9 / rates[r] ) / 1e9 );
+        // Short packets: their overhead on the air, then the buffer written
+        // for the next one and the turnaround
+        uint32_t frames = ( size + 254 ) / 255;
+        double frameNs = ( 255 + TEST_FRAME_OVERHEAD_BYTES ) * 8e9 / rates[r] + 257 * 8e9 / 8000000 + TEST_FRAME_GAP_US * 1e3;
+        double shortRate = size * 8 / ( frames * frameNs / 1e9 );
+
+        CHECK( result.Intact == 1 );
+        // The data streams at the full bit rate
+        CHECK( ( result.AirNs - size * 8e9 / rates[r] ) < 1 );
+        CHECK( longRate > shortRate );
+        printf( "longpkt: %6u b/s, %u bytes in one packet at %6.0f b/s, %3u services, SPI busy %4.1f %% of the packet; "
+                "in packets of 255 bytes %6.0f b/s\n", rates[r], size, longRate, result.Services,
+                100.0 * result.SpiNs / result.AirNs, shortRate );
+    }
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    TestSizes( );
+    TestTooSlow( );
+    TestThroughput( );
+
+    return TestEnd( "test_longpkt" );
+}
@@ -0,0 +1,311 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Neighbor table: averages, PER and LRU replacement, then random updates and
+ * removals against a plain array searched linearly, and the cost of an update
+ * in a full table
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sx126x_neighbor.h"
+
+#define TEST_OPERATIONS                             20000
+#define TEST_BENCHMARK_UPDATES                      1000000
+
+/*!
+ * \brief The reference: the same table as a plain array
+ */
+typedef struct
+{
+    uint16_t      Address;
+    int16_t       Rssi;
+    uint16_t      Received;
+    uint16_t      Lost;
+    uint8_t       LastSequence;
+    uint32_t      LastUse;
+}TestEntry_t;
+
+static TestEntry_t Model[NEIGHBOR_MAX];
+static uint16_t ModelCount = 0;
+static uint32_t ModelClock = 0;
+
+static PacketStatus_t TestStatus( int8_t rssi, int8_t snr )
+{
+    PacketStatus_t status;
+
+    memset( &status, 0, sizeof( status ) );
+    status.packetType = PACKET_TYPE_LORA;
+    status.Params.LoRa.RssiPkt = rssi;
+    status.Params.LoRa.SnrPkt = snr;
+    status.Timestamp = ModelClock;
+    return status;
+}
+
+static TestEntry_t *ModelFind( uint16_t address )
+{
+    for( uint16_t i = 0; i < ModelCount; i++ )
+    {
+        if( Model[i].Address == address )
+        {
+            return &Model[i];
+        }
+    }
+    return NULL;
+}
+
+static void ModelUpdate( uint16_t address, uint8_t sequence, int8_t rssi )
+{
+    TestEntry_t *entry = ModelFind( address );
+
+    if( entry == NULL )
+    {
+        if( ModelCount == NEIGHBOR_MAX )
+        {
+            uint16_t oldest = 0;
+
+            for( uint16_t i = 1; i < ModelCount; i++ )
+            {
+                oldest = ( Model[i].LastUse < Model[oldest].LastUse ) ? i : oldest;
+            }
+            Model[oldest] = Model[--ModelCount];
+        }
+        entry = &Model[ModelCount++];
+        entry->Address = address;
+        entry->Rssi = 16 * rssi;
+        entry->Received = 1;
+        entry->Lost = 0;
+    }
+    else
+    {
+        uint8_t gap = sequence - entry->LastSequence;
+
+        entry->Rssi += ( 16 * rssi - entry->Rssi ) / 8;
+        entry->Lost += ( ( gap > 1 ) && ( gap < 128 ) ) ? gap - 1 : 0;
+        entry->Received++;
+        if( entry->Received + entry->Lost > NEIGHBOR_PER_WINDOW )
+        {
+            entry->Received /= 2;
+            entry->Lost /= 2;
+        }
+    }
+    entry->LastSequence = sequence;
+    entry->LastUse = ++ModelClock;
+}
+
+static void ModelRemove( uint16_t address )
+{
+    TestEntry_t *entry = ModelFind( address );
+
+    if( entry != NULL )
+    {
+        *entry = Model[--ModelCount];
+    }
+}
+
+static void TestUpdate( uint16_t address, uint8_t sequence, int8_t rssi )
+{
+    PacketStatus_t status = TestStatus( rssi, 0 );
+
+    SX126x_NeighborUpdate( address, sequence, &status );
+    ModelUpdate( address, sequence, rssi );
+}
+
+static void TestBasics( void )
+{
+    NeighborInfo_t info;
+    PacketStatus_t status = TestStatus( -80, 7 );
+
+    SX126x_NeighborInit( );
+    CHECK( SX126x_NeighborGet( 0x1234, &info ) == 1 );
+    SX126x_NeighborUpdate( 0x1234, 10, &status );
+    CHECK( SX126x_NeighborGet( 0x1234, &info ) == 0 );
+    CHECK( ( info.Address == 0x1234 ) && ( info.Rssi == -80 * 16 ) && ( info.Snr == 7 * 16 ) && ( info.Per == 0 ) );
+
+    // A step of the RSSI: 1/8 of it at every packet
+    status = TestStatus( -72, 7 );
+    SX126x_NeighborUpdate( 0x1234, 11, &status );
+    SX126x_NeighborGet( 0x1234, &info );
+    CHECK( info.Rssi == -80 * 16 + 16 );
+    for( uint8_t i = 0; i < 100; i++ )
+    {
+        SX126x_NeighborUpdate( 0x1234, 12 + i, &status );
+    }
+    SX126x_NeighborGet( 0x1234, &info );
+    CHECK( ( info.Rssi > -72 * 16 - 8 ) && ( info.Rssi <= -72 * 16 ) );
+    CHECK( info.Per == 0 );
+
+    // Sequence 111 then 115: 3 lost, 104 received with a duplicate that loses
+    // nothing
+    SX126x_NeighborUpdate( 0x1234, 115, &status );
+    SX126x_NeighborUpdate( 0x1234, 115, &status );
+    SX126x_NeighborGet( 0x1234, &info );
+    CHECK( info.Per == 3 * 1000 / ( 3 + 104 ) );
+    CHECK( info.LastSequence == 115 );
+
+    // Half the packets lost for a long time: the PER follows
+    for( uint16_t i = 0; i < 2000; i++ )
+    {
+        SX126x_NeighborUpdate( 0x1234, ( uint8_t )( 117 + 2 * i ), &status );
+    }
+    SX126x_NeighborGet( 0x1234, &info );
+    CHECK( ( info.Per > 450 ) && ( info.Per < 550 ) );
+
+    SX126x_NeighborRemove( 0x1234 );
+    CHECK( SX126x_NeighborGet( 0x1234, &info ) == 1 );
+    CHECK( SX126x_NeighborCount( ) == 0 );
+}
+
+static void TestLru( void )
+{
+    NeighborInfo_t info;
+
+    SX126x_NeighborInit( );
+    ModelCount = 0;
+    for( uint16_t i = 0; i < NEIGHBOR_MAX; i++ )
+    {
+        TestUpdate( 100 + i, 0, -90 );
+    }
+    CHECK( SX126x_NeighborCount( ) == NEIGHBOR_MAX );
+
+    // The first one heard again, the second one is now the oldest
+    TestUpdate( 100, 1, -90 );
+    TestUpdate( 50, 0, -90 );
+    CHECK( SX126x_NeighborCount( ) == NEIGHBOR_MAX );
+    CHECK( SX126x_NeighborGet( 100, &info ) == 0 );
+    CHECK( SX126x_NeighborGet( 101, &info ) == 1 );
+    CHECK( SX126x_NeighborGet( 50, &info ) == 0 );
+    CHECK( SX126x_NeighborGet( 102, &info ) == 0 );
+}
+
+/*!
+ * \brief Random updates and removals over more addresses than entries
+ */
+static void TestModel( void )
+{
+    uint16_t population = NEIGHBOR_MAX + NEIGHBOR_MAX / 2;
+    uint32_t wrong = 0;
+
+    SX126x_NeighborInit( );
+    ModelCount = 0;
+    for( uint32_t n = 0; n < TEST_OPERATIONS; n++ )
+    {
+        // Clustered addresses, for long probes in the index
+        uint16_t address = ( uint16_t )( ( TestRandom( ) % population ) * ( ( n & 1 ) ? 1 : 64 ) );
+        NeighborInfo_t info;
+        TestEntry_t *entry;
+
+        if( TestRandom( ) % 8 == 0 )
+        {
+            SX126x_NeighborRemove( address );
+            ModelRemove( address );
+        }
+        else
+        {
+            TestUpdate( address, ( uint8_t )TestRandom( ), ( int8_t )( -40 - TestRandom( ) % 90 ) );
+        }
+
+        entry = ModelFind( address );
+        if( entry == NULL )
+        {
+            wrong += ( SX126x_NeighborGet( address, &info ) == 1 ) ? 0 : 1;
+        }
+        else
+        {
+            uint32_t total = entry->Received + entry->Lost;
+
+            wrong += ( ( SX126x_NeighborGet( address, &info ) == 0 ) && ( info.Rssi == entry->Rssi ) &&
+                       ( info.LastSequence == entry->LastSequence ) && ( info.Per == entry->Lost * 1000 / total ) ) ? 0 : 1;
+        }
+        wrong += ( SX126x_NeighborCount( ) == ModelCount ) ? 0 : 1;
+    }
+    CHECK( wrong == 0 );
+
+    // Every entry of the table is in the model
+    for( uint16_t i = 0; i < SX126x_NeighborCount( ); i++ )
+    {
+        NeighborInfo_t info;
+
+        CHECK( ( SX126x_NeighborGetAt( i, &info ) == 0 ) && ( ModelFind( info.Address ) != NULL ) );
+    }
+}
+
+/*!
+ * \brief Updates in a full table: the neighbors heard again, new ones
+ *        replacing the oldest, and the same on the linear array
+ */
+static void TestBenchmark( void )
+{
+    static uint16_t addresses[4096];
+    PacketStatus_t status = TestStatus( -90, 5 );
+    uint64_t start;
+    double hit;
+    double miss;
+    double linear;
+    uint32_t updates = TEST_BENCHMARK_UPDATES;
+
+    SX126x_NeighborInit( );
+    for( uint16_t i = 0; i < NEIGHBOR_MAX; i++ )
+    {
+        SX126x_NeighborUpdate( i * 7, 0, &status );
+    }
+    for( uint16_t i = 0; i < sizeof( addresses ) / sizeof( addresses[0] ); i++ )
+    {
+        addresses[i] = ( TestRandom( ) % NEIGHBOR_MAX ) * 7;
+    }
+
+    start = TestNowNs( );
+    for( uint32_t n = 0; n < updates; n++ )
+    {
+        SX126x_NeighborUpdate( addresses[n & 4095], ( uint8_t )n, &status );
+    }
+    hit = ( double )( TestNowNs( ) - start ) / updates;
+
+    // Addresses never seen: one eviction each
+    start = TestNowNs( );
+    for( uint32_t n = 0; n < updates; n++ )
+    {
+        SX126x_NeighborUpdate( ( uint16_t )( 1 + n * 7 ), ( uint8_t )n, &status );
+    }
+    miss = ( double )( TestNowNs( ) - start ) / updates;
+    CHECK( SX126x_NeighborCount( ) == NEIGHBOR_MAX );
+
+    ModelCount = 0;
+    for( uint16_t i = 0; i < NEIGHBOR_MAX; i++ )
+    {
+        ModelUpdate( i * 7, 0, -90 );
+    }
+    updates = ( NEIGHBOR_MAX > 1000 ) ? TEST_BENCHMARK_UPDATES / 100 : TEST_BENCHMARK_UPDATES;
+    start = TestNowNs( );
+    for( uint32_t n = 0; n < updates; n++ )
+    {
+        ModelUpdate( addresses[n & 4095], ( uint8_t )n, -90 );
+    }
+    linear = ( double )( TestNowNs( ) - start ) / updates;
+
+    printf( "neighbor: %5u entries, update %5.1f ns heard again, %5.1f ns new, linear search %7.1f ns on host\n",
+            NEIGHBOR_MAX, hit, miss, linear );
+}
+
+int main( void )
+{
+    TestBasics( );
+    TestLru( );
+    TestModel( );
+    TestBenchmark( );
+
+    return TestEnd( "test_neighbor" );
+}
@@ -0,0 +1,341 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * OS abstraction on the POSIX backend: the primitives, then threads sharing
+ * the radio with a BUSY period after every transaction (the bus ownership,
+ * sequences under the lock that must not be split, throughput and latency),
+ * the other threads during a reset, and the DIO1 wake up latency
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_os.h"
+
+#define TEST_MAX_THREADS                            8
+#define TEST_SEQUENCES                              2400    // Split between the threads
+#define TEST_SEQUENCE_SIZE                          16
+#define TEST_BUSY_US                                20
+#define TEST_WAKEUPS                                200
+
+static OsSemaphore_t Semaphore;
+static volatile uint8_t Flag;
+
+static uint32_t TestElapsedMs( uint64_t start )
+{
+    return ( uint32_t )( ( TestNowNs( ) - start ) / 1000000 );
+}
+
+static int TestCompare( const void *a, const void *b )
+{
+    uint32_t x = *( const uint32_t * )a;
+    uint32_t y = *( const uint32_t * )b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/*!
+ * \brief Percentile of sorted values
+ */
+static uint32_t TestPercentile( const uint32_t *values, uint32_t count, uint8_t percent )
+{
+    return values[( ( uint64_t )count * percent ) / 100 - ( ( percent == 100 ) ? 1 : 0 )];
+}
+
+static void *TestTakeMutex( void *mutex )
+{
+    SX126x_OsMutexLock( ( OsMutex_t * )mutex );
+    Flag = 1;
+    SX126x_OsMutexUnlock( ( OsMutex_t * )mutex );
+    return NULL;
+}
+
+static void TestTimerCallback( void *context )
+{
+    SX126x_OsSemaphoreGive( ( OsSemaphore_t * )context );
+}
+
+static void TestPrimitives( void )
+{
+    OsMutex_t mutex;
+    OsEventFlags_t events;
+    OsTimer_t timer;
+    pthread_t thread;
+    uint64_t start;
+
+    // Recursive: free again after as many unlocks as locks only
+    SX126x_OsMutexInit( &mutex );
+    SX126x_OsMutexLock( &mutex );
+    SX126x_OsMutexLock( &mutex );
+    Flag = 0;
+    pthread_create( &thread, NULL, TestTakeMutex, &mutex );
+    SX126x_OsDelayMs( 20 );
+    SX126x_OsMutexUnlock( &mutex );
+    SX126x_OsDelayMs( 20 );
+    CHECK( Flag == 0 );
+    SX126x_OsMutexUnlock( &mutex );
+    pthread_join( thread, NULL );
+    CHECK( Flag == 1 );
+
+    SX126x_OsSemaphoreInit( &Semaphore );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 0 ) == false );
+    start = TestNowNs( );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 20 ) == false );
+    CHECK( TestElapsedMs( start ) >= 20 );
+    SX126x_OsSemaphoreGive( &Semaphore );
+    SX126x_OsSemaphoreGiveFromIsr( &Semaphore );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 0 ) == true );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, OS_WAIT_FOREVER ) == true );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 0 ) == false );
+
+    // Only the flags returned are cleared
+    SX126x_OsEventInit( &events );
+    SX126x_OsEventSet( &events, 0x03 );
+    CHECK( SX126x_OsEventWait( &events, 0x05, 0 ) == 0x01 );
+    CHECK( SX126x_OsEventWait( &events, 0x07, OS_WAIT_FOREVER ) == 0x02 );
+    start = TestNowNs( );
+    CHECK( SX126x_OsEventWait( &events, 0x07, 10 ) == 0 );
+    CHECK( TestElapsedMs( start ) >= 10 );
+
+    // One shot, and stopped before it expires
+    SX126x_OsTimerInit( &timer, TestTimerCallback, &Semaphore );
+    start = TestNowNs( );
+    SX126x_OsTimerStart( &timer, 10 );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 1000 ) == true );
+    CHECK( TestElapsedMs( start ) >= 10 );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 30 ) == false );
+    SX126x_OsTimerStart( &timer, 50 );
+    SX126x_OsTimerStop( &timer );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 100 ) == false );
+    SX126x_OsTimerStart( &timer, 0 );
+    CHECK( SX126x_OsSemaphoreTake( &Semaphore, 1000 ) == true );
+}
+
+/*!
+ * \brief A thread on the radio: its sequences and what they cost
+ */
+typedef struct
+{
+    pthread_t     Thread;
+    uint8_t       Id;
+    uint8_t       Locked;                           //!< 0: each transaction alone, for comparison
+    uint32_t      Sequences;
+    uint32_t      *Latencies;                       //!< Of every sequence [us]
+    uint32_t      Split;                            //!< Sequences read back wrong
+}TestWorker_t;
+
+/*!
+ * \brief Writes a pattern of its own and reads it back under the lock, then
+ *        a transaction alone: 3 transactions
+ */
+static void *TestWorker( void *context )
+{
+    TestWorker_t *worker = ( TestWorker_t * )context;
+    uint8_t pattern[TEST_SEQUENCE_SIZE];
+    uint8_t read[TEST_SEQUENCE_SIZE];
+
+    for( uint32_t n = 0; n < worker->Sequences; n++ )
+    {
+        uint64_t start = TestNowNs( );
+
+        for( uint8_t i = 0; i < TEST_SEQUENCE_SIZE; i++ )
+        {
+            pattern[i] = ( uint8_t )( worker->Id * 31 + n + i );
+        }
+        if( worker->Locked == 1 )
+        {
+            SX126xHal_Lock( );
+        }
+        SX126xHal_WriteBuffer( 0x00, pattern, TEST_SEQUENCE_SIZE );
+        SX126xHal_ReadBuffer( 0x00, read, TEST_SEQUENCE_SIZE );
+        if( worker->Locked == 1 )
+        {
+            SX126xHal_Unlock( );
+        }
+        SX126x_GetIrqStatus( );
+        worker->Latencies[n] = ( uint32_t )( ( TestNowNs( ) - start ) / 1000 );
+        worker->Split += ( memcmp( pattern, read, TEST_SEQUENCE_SIZE ) != 0 ) ? 1 : 0;
+    }
+    return NULL;
+}
+
+/*!
+ * \brief Runs the workers
+ *
+ * \retval      split         Sequences read back wrong
+ */
+static uint32_t TestRun( uint8_t threads, uint8_t locked )
+{
+    static uint32_t latencies[TEST_SEQUENCES];
+    TestWorker_t workers[TEST_MAX_THREADS];
+    uint32_t split = 0;
+    uint64_t start;
+    double seconds;
+
+    MockReset( );
+    MockBusyUs = TEST_BUSY_US;
+    start = TestNowNs( );
+    for( uint8_t t = 0; t < threads; t++ )
+    {
+        workers[t].Id = t;
+        workers[t].Locked = locked;
+        workers[t].Sequences = TEST_SEQUENCES / threads;
+        workers[t].Latencies = &latencies[t * ( TEST_SEQUENCES / threads )];
+        workers[t].Split = 0;
+        pthread_create( &workers[t].Thread, NULL, TestWorker, &workers[t] );
+    }
+    for( uint8_t t = 0; t < threads; t++ )
+    {
+        pthread_join( workers[t].Thread, NULL );
+        split += workers[t].Split;
+    }
+    seconds = ( TestNowNs( ) - start ) / 1e9;
+    qsort( latencies, TEST_SEQUENCES, sizeof( latencies[0] ), TestCompare );
+
+    // Every transaction holds the bus, with or without the lock of the sequence
+    CHECK( MockNssViolations == 0 );
+    printf( "os: %u threads%s, %6.0f transactions/s, sequence of 3 p50 %5u us p99 %6u us max %6u us, %u NSS violations, "
+            "%u sequences split\n", threads, ( locked == 1 ) ? "" : " without the lock", 3 * TEST_SEQUENCES / seconds,
+            TestPercentile( latencies, TEST_SEQUENCES, 50 ), TestPercentile( latencies, TEST_SEQUENCES, 99 ),
+            TestPercentile( latencies, TEST_SEQUENCES, 100 ), MockNssViolations, split );
+    return split;
+}
+
+static void TestBus( void )
+{
+    static const uint8_t counts[] = { 1, 2, 4, 8 };
+
+    for( uint8_t c = 0; c < sizeof( counts ); c++ )
+    {
+        CHECK( TestRun( counts[c], 1 ) == 0 );
+    }
+    // The same sequences without SX126xHal_Lock: the other threads get in
+    // between the write and the read back
+    CHECK( TestRun( 4, 0 ) > 0 );
+}
+
+static volatile uint8_t ResetDone;
+
+static void *TestResetThread( void *context )
+{
+    SX126xHal_Reset( );
+    ResetDone = 1;
+    return NULL;
+}
+
+static void *TestIrqThread( void *context )
+{
+    SX126x_OsDelayMs( 10 );
+    *( uint64_t * )context = TestNowNs( );
+    SX126xHal_OnDio1Irq( );
+    return NULL;
+}
+
+/*!
+ * \brief 90 ms of reset: the bus waits, the other threads and the DIO1
+ *        wake ups don't
+ */
+static void TestReset( void )
+{
+    pthread_t reset;
+    pthread_t irq;
+    uint64_t start;
+    uint64_t raised;
+    uint32_t wakeMs;
+    uint32_t busMs;
+    uint32_t ticks = 0;
+
+    MockReset( );
+    ResetDone = 0;
+    start = TestNowNs( );
+    pthread_create( &reset, NULL, TestResetThread, NULL );
+    SX126x_OsDelayMs( 5 );
+
+    // A task waiting for DIO1 is woken while the reset holds the bus
+    pthread_create( &irq, NULL, TestIrqThread, &raised );
+    CHECK( SX126xHal_WaitDio1( 1000 ) == 1 );
+    wakeMs = TestElapsedMs( raised );
+    CHECK( ResetDone == 0 );
+    pthread_join( irq, NULL );
+
+    // A task off the bus keeps running
+    while( ( ResetDone == 0 ) && ( ticks < 1000 ) )
+    {
+        SX126x_OsDelayMs( 1 );
+        ticks++;
+    }
+    CHECK( ticks >= 20 );
+
+    // A task on the bus waits for the end of the reset
+    pthread_join( reset, NULL );
+    SX126x_GetIrqStatus( );
+    busMs = TestElapsedMs( start );
+    CHECK( busMs >= 90 );
+    printf( "os: during a reset of %u ms, DIO1 woke its task in %u ms, another task ran %u times\n", busMs, wakeMs, ticks );
+}
+
+static volatile uint64_t Raised;
+
+static void *TestWaiter( void *context )
+{
+    uint32_t *latencies = ( uint32_t * )context;
+
+    for( uint32_t n = 0; n < TEST_WAKEUPS; n++ )
+    {
+        SX126x_OsSemaphoreGive( &Semaphore );
+        latencies[n] = ( SX126xHal_WaitDio1( 1000 ) == 1 ) ? ( uint32_t )( ( TestNowNs( ) - Raised ) / 1000 ) : UINT32_MAX;
+    }
+    return NULL;
+}
+
+static void TestDio1( void )
+{
+    static uint32_t latencies[TEST_WAKEUPS];
+    pthread_t waiter;
+
+    // Nothing left from before
+    SX126xHal_WaitDio1( 0 );
+    SX126x_OsSemaphoreInit( &Semaphore );
+    pthread_create( &waiter, NULL, TestWaiter, latencies );
+    for( uint32_t n = 0; n < TEST_WAKEUPS; n++ )
+    {
+        CHECK( SX126x_OsSemaphoreTake( &Semaphore, 1000 ) == true );
+        SX126x_OsDelayMs( 1 );
+        Raised = TestNowNs( );
+        SX126xHal_OnDio1Irq( );
+    }
+    pthread_join( waiter, NULL );
+    qsort( latencies, TEST_WAKEUPS, sizeof( latencies[0] ), TestCompare );
+
+    CHECK( latencies[TEST_WAKEUPS - 1] != UINT32_MAX );
+    printf( "os: DIO1 to the waiting task p50 %u us p99 %u us max %u us\n", TestPercentile( latencies, TEST_WAKEUPS, 50 ),
+            TestPercentile( latencies, TEST_WAKEUPS, 99 ), TestPercentile( latencies, TEST_WAKEUPS, 100 ) );
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    TestPrimitives( );
+    TestBus( );
+    TestReset( );
+    TestDio1( );
+
+    return TestEnd( "test_os" );
+}
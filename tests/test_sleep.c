@@ -0,0 +1,239 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Sleep manager: what a warm and a cold start replay before the first TX,
+ * in which order, the radio state it gives back, and the wake to TX latency
+ * and energy of both modes
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_sleep.h"
+#include "sx126x_energy.h"
+
+#define TEST_PAYLOAD                                20
+
+/*
+ * Timings of the model, typical values of the datasheet or assumed where it
+ * gives none: they are not measured here
+ */
+#define TEST_WAKE_WARM_US                           340
+#define TEST_WAKE_COLD_US                           3500
+#define TEST_CALIBRATE_US                           3500
+#define TEST_CALIBRATE_IMAGE_US                     1000    // Assumed
+#define TEST_COMMAND_US                             10      // BUSY after a command and NSS framing, assumed
+
+/*!
+ * \brief What a wake up followed by a TX cost
+ */
+typedef struct
+{
+    uint16_t      Replayed;                         //!< Transactions between the wake up and the payload
+    uint16_t      Calibrations;
+    uint16_t      ImageCalibrations;
+    uint32_t      SpiBytes;                         //!< Of the whole wake up to TX sequence
+}TestWake_t;
+
+static ModulationParams_t ModParams;
+static PacketParams_t PacketParams;
+static uint8_t Payload[TEST_PAYLOAD];
+
+/*!
+ * \brief The configuration of a node: everything the shadow keeps
+ */
+static void TestConfigure( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    SX126x_Init( );
+    SX126x_SetDio3AsTcxoCtrl( TCXO_CTRL_1_7V, 320 );
+    SX126x_SetRegulatorMode( USE_DCDC );
+    SX126x_SetRfFrequency( 868000000 );
+    SX126x_SetTxParams( 14, RADIO_RAMP_200_US );
+    MockLoRaProfile( &ModParams, &PacketParams, LORA_SF9, TEST_PAYLOAD );
+    SX126x_SetModulationParams( &ModParams );
+    SX126x_SetPacketParams( &PacketParams );
+    SX126x_SetBufferBaseAddresses( 0x40, 0x00 );
+    SX126x_SetDioIrqParams( IRQ_TX_DONE | IRQ_RX_DONE, IRQ_TX_DONE | IRQ_RX_DONE, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
+    SX126x_SetStopRxTimerOnPreambleDetect( 1 );
+    SX126x_SetLoRaSymbNumTimeout( 8 );
+    SX126x_SetRxBoosted( 0 );
+    SX126x_SetStandby( STDBY_RC );
+    for( uint8_t i = 0; i < TEST_PAYLOAD; i++ )
+    {
+        Payload[i] = ( uint8_t )TestRandom( );
+    }
+}
+
+/*!
+ * \brief Sleeps, wakes up with a TX and counts the sequence on the bus
+ */
+static TestWake_t TestWake( uint8_t warmStart )
+{
+    TestWake_t wake;
+    SleepParams_t sleep;
+    uint16_t first;
+    uint16_t status;
+    uint16_t payload;
+    uint32_t txCount;
+
+    memset( &wake, 0, sizeof( wake ) );
+    sleep.Value = 0;
+    sleep.Fields.WarmStart = warmStart;
+    SX126x_SetSleep( sleep );
+    CHECK( MockRadio->Asleep == 1 );
+    CHECK( SX126x_SleepGetLostMask( ) != 0 );
+    if( warmStart == 0 )
+    {
+        // What the radio forgets in a cold start, in the state of the mock
+        MockRadio->PacketType = 0;
+        MockRadio->PayloadLength = 0;
+        MockRadio->TxBase = 0;
+    }
+
+    first = MockRadio->LogSize;
+    txCount = MockRadio->TxCount;
+    MockSpiBytes = 0;
+    SX126x_SendPayload( Payload, TEST_PAYLOAD, 0 );
+    wake.SpiBytes = MockSpiBytes;
+
+    // GET_STATUS wakes the radio up, the replay runs until the payload
+    status = first;
+    while( ( status < MockRadio->LogSize ) && ( MockRadio->Log[status] != RADIO_GET_STATUS ) )
+    {
+        status++;
+    }
+    payload = status;
+    while( ( payload < MockRadio->LogSize ) && ( MockRadio->Log[payload] != RADIO_WRITE_BUFFER ) )
+    {
+        payload++;
+    }
+    CHECK( ( status < payload ) && ( payload < MockRadio->LogSize ) );
+    wake.Replayed = payload - status - 1;
+    for( uint16_t i = status + 1; i < payload; i++ )
+    {
+        wake.Calibrations += ( MockRadio->Log[i] == RADIO_CALIBRATE ) ? 1 : 0;
+        wake.ImageCalibrations += ( MockRadio->Log[i] == RADIO_CALIBRATEIMAGE ) ? 1 : 0;
+    }
+
+    CHECK( MockRadio->TxCount == txCount + 1 );
+    CHECK( MockRadio->Asleep == 0 );
+    CHECK( SX126x_SleepGetLostMask( ) == 0 );
+    // The packet went out with the configuration of before the sleep
+    CHECK( MockRadio->PacketType == PACKET_TYPE_LORA );
+    CHECK( MockRadio->PayloadLength == TEST_PAYLOAD );
+    CHECK( MockRadio->TxBase == 0x40 );
+    CHECK( memcmp( &MockRadio->Buffer[0x40], Payload, TEST_PAYLOAD ) == 0 );
+
+    MockRadio->Irq = IRQ_TX_DONE;
+    SX126x_ProcessIrqs( );
+    SX126x_SetStandby( STDBY_RC );
+    return wake;
+}
+
+/*!
+ * \brief Index of the first transaction with an opcode after a position
+ */
+static uint16_t TestFind( uint16_t from, uint8_t opcode )
+{
+    while( ( from < MockRadio->LogSize ) && ( MockRadio->Log[from] != opcode ) )
+    {
+        from++;
+    }
+    return from;
+}
+
+static void TestOrder( void )
+{
+    SleepParams_t sleep;
+    uint16_t wake;
+
+    TestConfigure( );
+    sleep.Value = 0;
+    SX126x_SetSleep( sleep );
+    wake = MockRadio->LogSize;
+    SX126x_SendPayload( Payload, TEST_PAYLOAD, 0 );
+
+    // Packet type before the parameters that depend on it, PA before TX
+    // power, the calibration right after the TCXO
+    CHECK( TestFind( wake, RADIO_SET_TCXOMODE ) + 1 == TestFind( wake, RADIO_CALIBRATE ) );
+    CHECK( TestFind( wake, RADIO_SET_PACKETTYPE ) < TestFind( wake, RADIO_SET_MODULATIONPARAMS ) );
+    CHECK( TestFind( wake, RADIO_SET_MODULATIONPARAMS ) < TestFind( wake, RADIO_SET_PACKETPARAMS ) );
+    CHECK( TestFind( wake, RADIO_SET_PACONFIG ) < TestFind( wake, RADIO_SET_TXPARAMS ) );
+    CHECK( TestFind( wake, RADIO_SET_PACKETPARAMS ) < TestFind( wake, RADIO_WRITE_BUFFER ) );
+    CHECK( TestFind( wake, RADIO_WRITE_BUFFER ) < TestFind( wake, RADIO_SET_TX ) );
+}
+
+/*!
+ * \brief Wake to TX latency of the model at an SPI clock
+ */
+static double TestLatency( uint8_t warmStart, const TestWake_t *wake, uint32_t spiHz )
+{
+    return ( warmStart ? TEST_WAKE_WARM_US : TEST_WAKE_COLD_US ) + wake->Calibrations * TEST_CALIBRATE_US +
+           wake->ImageCalibrations * TEST_CALIBRATE_IMAGE_US + ( wake->Replayed + 2 ) * TEST_COMMAND_US +
+           wake->SpiBytes * 8 * 1e6 / spiHz;
+}
+
+static void TestBenchmark( void )
+{
+    static const uint32_t clocks[] = { 50000, 8000000 };
+    TestWake_t warm;
+    TestWake_t cold;
+    EnergyModel_t model;
+    uint32_t sleepWarm;
+    uint32_t sleepCold;
+
+    TestConfigure( );
+    warm = TestWake( 1 );
+    cold = TestWake( 0 );
+    // Warm: only the RX gain, cold: the whole configuration and a calibration
+    CHECK( ( warm.Replayed == 1 ) && ( warm.Calibrations == 0 ) );
+    CHECK( ( cold.Replayed > 10 ) && ( cold.Calibrations == 1 ) && ( cold.ImageCalibrations == 1 ) );
+    CHECK( cold.SpiBytes > warm.SpiBytes );
+
+    SX126x_EnergyGetModel( &model );
+    model.WarmStart = 1;
+    SX126x_EnergySetModel( &model );
+    sleepWarm = SX126x_EnergyGetCurrent( MODE_SLEEP );
+    model.WarmStart = 0;
+    SX126x_EnergySetModel( &model );
+    sleepCold = SX126x_EnergyGetCurrent( MODE_SLEEP );
+    CHECK( sleepCold < sleepWarm );
+
+    for( uint8_t c = 0; c < sizeof( clocks ) / sizeof( clocks[0] ); c++ )
+    {
+        double warmUs = TestLatency( 1, &warm, clocks[c] );
+        double coldUs = TestLatency( 0, &cold, clocks[c] );
+        // In STDBY_RC while waking up and replaying
+        double warmNc = warmUs * SX126x_EnergyGetCurrent( MODE_STDBY_RC ) / 1e6;
+        double coldNc = coldUs * SX126x_EnergyGetCurrent( MODE_STDBY_RC ) / 1e6;
+
+        CHECK( warmUs < coldUs );
+        printf( "sleep: SPI %7u Hz, warm %2u commands %3u bytes %7.0f us %6.0f nC, cold %2u commands %3u bytes %7.0f us %6.0f nC, "
+                "cold pays off after %.1f s asleep\n", clocks[c], warm.Replayed, warm.SpiBytes, warmUs, warmNc, cold.Replayed,
+                cold.SpiBytes, coldUs, coldNc, ( coldNc - warmNc ) / ( sleepWarm - sleepCold ) );
+    }
+}
+
+int main( void )
+{
+    TestOrder( );
+    TestBenchmark( );
+
+    return TestEnd( "test_sleep" );
+}
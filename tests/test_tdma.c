@@ -0,0 +1,222 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * TDMA: a coordinator runs two superframes on the simulated slot timer, the
+ * slot operations are checked against the schedule, then the goodput of a
+ * superframe with one dedicated slot per node is compared with pure ALOHA
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_tdma.h"
+
+#define TEST_CONTENTION                             2
+#define TEST_DEDICATED                              4
+#define TEST_SLOTS                                  ( 1 + TEST_CONTENTION + TEST_DEDICATED )
+#define TEST_TX_SLOT                                3
+#define TEST_RX_SLOT                                4
+
+static uint8_t Sent[256];
+static uint8_t SentSize = 0;
+
+static void TestOnTx( uint8_t *payload, uint8_t size )
+{
+    memcpy( Sent, payload, size );
+    SentSize = size;
+}
+
+/*!
+ * \brief The slot timer interrupt: one shot, then the deferred work is run
+ *        by the main loop
+ */
+static void TestFire( void )
+{
+    void ( *callback )( void ) = MockSlotCallback;
+
+    MockSlotCallback = NULL;
+    MockTicks = MockSlotTimestamp;
+    MockRunIsr( callback );
+    CHECK( SX126xHal_HasPending( ) == 1 );
+    SX126xHal_ProcessPending( );
+}
+
+static TdmaOperations_t TestExpected( uint8_t slot, uint8_t superframe )
+{
+    if( slot == 0 )
+    {
+        return TDMA_OP_TX;
+    }
+    if( ( slot <= TEST_CONTENTION ) || ( slot == TEST_RX_SLOT ) )
+    {
+        return TDMA_OP_RX;
+    }
+    // The packet is queued for the first superframe only
+    return ( ( slot == TEST_TX_SLOT ) && ( superframe == 0 ) ) ? TDMA_OP_TX : TDMA_OP_SLEEP;
+}
+
+static void TestSchedule( void )
+{
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+    uint8_t packet[32];
+    uint32_t slotLength;
+    uint32_t guard = TDMA_GUARD_US * TIMESTAMP_TICKS_PER_US;
+    uint32_t wakeup = TDMA_WAKEUP_US * TIMESTAMP_TICKS_PER_US;
+    uint32_t events = 0;
+    uint32_t wakeups = 0;
+    uint32_t packets = 0;
+    uint32_t beacons = 0;
+
+    MockLoRaProfile( &modParams, &packetParams, LORA_SF7, 64 );
+    SX126x_SetPacketType( PACKET_TYPE_LORA );
+    SX126x_TdmaInit( TIMESYNC_COORDINATOR, &modParams, &packetParams, TEST_CONTENTION, TEST_DEDICATED );
+
+    slotLength = SX126x_TdmaGetSlotLength( );
+    CHECK( slotLength == ( SX126x_GetTimeOnAir( &modParams, &packetParams ) + 2 * TDMA_GUARD_US ) * TIMESTAMP_TICKS_PER_US );
+    CHECK( SX126x_TdmaGetSlotType( 0 ) == TDMA_SLOT_BEACON );
+    CHECK( SX126x_TdmaGetSlotType( TEST_CONTENTION ) == TDMA_SLOT_CONTENTION );
+    CHECK( SX126x_TdmaGetSlotType( TEST_CONTENTION + 1 ) == TDMA_SLOT_DEDICATED );
+
+    SX126x_TdmaSetSlot( TEST_TX_SLOT, TDMA_OP_TX );
+    SX126x_TdmaSetSlot( TEST_RX_SLOT, TDMA_OP_RX );
+    for( uint8_t i = 0; i < sizeof( packet ); i++ )
+    {
+        packet[i] = i;
+    }
+    CHECK( SX126x_TdmaQueue( TEST_TX_SLOT, packet, sizeof( packet ) ) == 0 );
+    CHECK( SX126x_TdmaQueue( TEST_TX_SLOT, packet, sizeof( packet ) ) == 1 );
+
+    MockOnTx = TestOnTx;
+    MockTicks = 0;
+    SX126x_TdmaStart( );
+
+    // From slot 1 of superframe 0 to slot 0 of superframe 2
+    while( events < 2 * TEST_SLOTS )
+    {
+        uint32_t txCount = MockRadio->TxCount;
+        uint32_t rxCount = MockRadio->RxCount;
+        uint32_t at;
+        uint8_t slot;
+        uint8_t superframe;
+        TdmaOperations_t op;
+
+        CHECK( MockSlotCallback != NULL );
+        if( MockSlotCallback == NULL )
+        {
+            return;
+        }
+        TestFire( );
+        at = MockTicks;
+
+        // A TX starts one guard after the boundary, for the receivers
+        op = ( MockRadio->TxCount != txCount ) ? TDMA_OP_TX : ( ( MockRadio->RxCount != rxCount ) ? TDMA_OP_RX : TDMA_OP_SLEEP );
+        if( ( at % slotLength == slotLength - wakeup ) || ( at % slotLength == slotLength - wakeup + guard ) )
+        {
+            // Woken up ahead of a slot following a sleeping one
+            CHECK( MockRadio->Mode != MODE_SLEEP );
+            CHECK( op == TDMA_OP_SLEEP );
+            wakeups++;
+            continue;
+        }
+        if( op == TDMA_OP_TX )
+        {
+            CHECK( at % slotLength == guard );
+            at -= guard;
+        }
+        CHECK( at % slotLength == 0 );
+        slot = ( at / slotLength ) % TEST_SLOTS;
+        superframe = ( at / slotLength ) / TEST_SLOTS;
+        CHECK( op == TestExpected( slot, superframe ) );
+        if( op == TDMA_OP_SLEEP )
+        {
+            CHECK( MockRadio->Mode == MODE_SLEEP );
+        }
+        if( ( op == TDMA_OP_TX ) && ( slot == 0 ) )
+        {
+            CHECK( ( SentSize == TIMESYNC_BEACON_SIZE ) && ( Sent[0] == TIMESYNC_BEACON_TYPE ) );
+            beacons++;
+        }
+        else if( op == TDMA_OP_TX )
+        {
+            CHECK( ( SentSize == sizeof( packet ) ) && ( memcmp( Sent, packet, sizeof( packet ) ) == 0 ) );
+            packets++;
+        }
+        if( op == TDMA_OP_TX )
+        {
+            MockRadio->Mode = MODE_STDBY_RC;
+            SX126x_TdmaOnTxDone( MockTicks );
+        }
+        events++;
+    }
+    MockOnTx = NULL;
+    SX126x_TdmaStop( );
+    CHECK( MockSlotCallback == NULL );
+
+    // No SPI access from the slot timer interrupt
+    CHECK( MockIsrSpiAccesses == 0 );
+    CHECK( MockNssViolations == 0 );
+    CHECK( beacons == 2 );
+    CHECK( packets == 1 );
+    CHECK( wakeups > 0 );
+    // Sent, the queue is free again
+    CHECK( SX126x_TdmaQueue( TEST_TX_SLOT, packet, sizeof( packet ) ) == 0 );
+}
+
+/*!
+ * \brief Every node sends one packet of the largest size per superframe, with
+ *        one dedicated slot each, or at random times at the same rate
+ */
+static void TestGoodput( void )
+{
+    static const uint8_t nodes[] = { 1, 8, 16, 32, 48, 62 };
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+    uint8_t payload = 64;
+    double timeOnAir;
+
+    MockLoRaProfile( &modParams, &packetParams, LORA_SF7, payload );
+    timeOnAir = SX126x_GetTimeOnAir( &modParams, &packetParams ) / 1e6;
+    for( uint8_t i = 0; i < sizeof( nodes ); i++ )
+    {
+        double superframe;
+        double load;
+        double tdma;
+        double aloha;
+
+        SX126x_TdmaInit( TIMESYNC_COORDINATOR, &modParams, &packetParams, 1, nodes[i] );
+        superframe = ( 2.0 + nodes[i] ) * SX126x_TdmaGetSlotLength( ) / TIMESTAMP_TICKS_PER_US / 1e6;
+        tdma = nodes[i] * payload * 8 / superframe;
+        // Pure ALOHA at the same offered load: S = G e^-2G
+        load = nodes[i] * timeOnAir / superframe;
+        aloha = load * exp( -2 * load ) * payload * 8 / timeOnAir;
+        printf( "tdma: %2u nodes, superframe %6.1f ms, goodput %6.0f bit/s, pure ALOHA %6.0f bit/s\n", nodes[i], superframe * 1000, tdma, aloha );
+        CHECK( tdma >= aloha );
+    }
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+
+    TestSchedule( );
+    TestGoodput( );
+
+    return TestEnd( "test_tdma" );
+}
@@ -0,0 +1,159 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * Network time: a coordinator sends beacons, nodes with drifting crystals
+ * follow them. The true time is in us, the coordinator clock is the network
+ * time, every node counts its own ticks from its own boot.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_timesync.h"
+
+#define TEST_BEACONS                                100
+#define TEST_BEACON_PERIOD_US                       10000000ULL
+
+/*!
+ * \brief Actual delay from SendBeacon to the preamble on air, the coordinator
+ *        starts from TIMESYNC_TX_LATENCY_US and learns it
+ */
+#define TEST_TX_LATENCY_US                          180
+
+/*!
+ * \brief Crystal errors of the nodes, in ppm
+ */
+static const double NodeDrifts[] = { -40.0, -10.0, 0.0, 3.5, 25.0, 50.0 };
+
+#define TEST_NODES                                  ( sizeof( NodeDrifts ) / sizeof( NodeDrifts[0] ) )
+
+typedef struct
+{
+    uint8_t       Payload[TIMESYNC_BEACON_SIZE];
+    uint64_t      Start;                            //!< True time of the first preamble symbol [us]
+}TestBeacon_t;
+
+static TestBeacon_t Beacons[TEST_BEACONS];
+static uint8_t Sent[TIMESYNC_BEACON_SIZE];
+static uint32_t TimeOnAir = 0;
+
+static void TestOnTx( uint8_t *payload, uint8_t size )
+{
+    memcpy( Sent, payload, TIMESYNC_BEACON_SIZE );
+}
+
+/*!
+ * \brief Ticks of a clock running ppm fast, booted at the true time boot
+ */
+static uint32_t TestTicks( uint64_t trueUs, double ppm, uint64_t bootUs )
+{
+    return ( uint32_t )( uint64_t )( ( double )( trueUs - bootUs ) * ( 1.0 + ppm / 1e6 ) * TIMESTAMP_TICKS_PER_US );
+}
+
+/*!
+ * \brief The coordinator sends every beacon, its clock is the true time
+ */
+static void TestCoordinator( PacketParams_t *packetParams )
+{
+    SX126x_SetPacketParams( packetParams );
+    MockOnTx = TestOnTx;
+    MockTicks = 0;
+    SX126x_TimeSyncInit( TIMESYNC_COORDINATOR, TimeOnAir );
+    CHECK( SX126x_TimeSyncGetState( ) == TIMESYNC_SYNCED );
+
+    for( uint32_t b = 0; b < TEST_BEACONS; b++ )
+    {
+        uint64_t now = 1000000 + b * TEST_BEACON_PERIOD_US;
+
+        MockTicks = TestTicks( now, 0, 0 );
+        SX126x_TimeSyncSendBeacon( );
+        CHECK( Sent[0] == TIMESYNC_BEACON_TYPE );
+        memcpy( Beacons[b].Payload, Sent, TIMESYNC_BEACON_SIZE );
+        Beacons[b].Start = now + TEST_TX_LATENCY_US;
+
+        MockTicks = TestTicks( Beacons[b].Start + TimeOnAir, 0, 0 );
+        SX126x_TimeSyncOnTxDone( MockTicks );
+    }
+    MockOnTx = NULL;
+}
+
+/*!
+ * \brief A node receives every beacon, the network time is checked halfway
+ *        to the next beacon, where the drift error is the largest
+ */
+static void TestNode( double ppm, uint64_t bootUs )
+{
+    uint64_t evaluation = Beacons[TEST_BEACONS - 1].Start + TEST_BEACON_PERIOD_US / 2;
+    double error;
+    int64_t drift;
+    uint64_t network;
+    uint64_t local;
+
+    MockTicks = TestTicks( bootUs, ppm, bootUs );
+    SX126x_TimeSyncInit( TIMESYNC_NODE, TimeOnAir );
+    CHECK( SX126x_TimeSyncGetState( ) == TIMESYNC_UNSYNCED );
+
+    for( uint32_t b = 0; b < TEST_BEACONS; b++ )
+    {
+        // RX done one time on air after the start, up to a tick of jitter
+        MockTicks = TestTicks( Beacons[b].Start + TimeOnAir, ppm, bootUs ) + TestRandom( ) % 2;
+        CHECK( SX126x_TimeSyncOnBeacon( Beacons[b].Payload, TIMESYNC_BEACON_SIZE, MockTicks ) == 1 );
+        if( b == 0 )
+        {
+            CHECK( SX126x_TimeSyncGetState( ) == TIMESYNC_OFFSET_ONLY );
+        }
+    }
+    CHECK( SX126x_TimeSyncGetState( ) == TIMESYNC_SYNCED );
+
+    MockTicks = TestTicks( evaluation, ppm, bootUs );
+    network = SX126x_TimeSyncGetNetworkTime( );
+    error = ( ( double )network - ( double )evaluation * TIMESTAMP_TICKS_PER_US ) / TIMESTAMP_TICKS_PER_US;
+    drift = SX126x_TimeSyncGetDriftPpb( );
+    local = SX126x_TimeSyncNetworkToLocal( network );
+
+    printf( "timesync: node %+6.1f ppm, drift estimated %+9.3f ppm, network time error %+6.2f us\n", ppm, -drift / 1000.0, error );
+    CHECK( fabs( error ) < 2.0 );
+    // Network minus local rate
+    CHECK( llabs( drift + ( int64_t )( ppm * 1000.0 / ( 1.0 + ppm / 1e6 ) ) ) < 50 );
+    CHECK( llabs( ( int64_t )( local - SX126x_TimeSyncGetLocalTime( ) ) ) <= 1 );
+
+    // Not a beacon
+    CHECK( SX126x_TimeSyncOnBeacon( Beacons[0].Payload, TIMESYNC_BEACON_SIZE - 1, MockTicks ) == 0 );
+}
+
+int main( void )
+{
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+
+    MockReset( );
+    SX126xHal_SpiInit( );
+    MockLoRaProfile( &modParams, &packetParams, LORA_SF9, TIMESYNC_BEACON_SIZE );
+    SX126x_SetPacketType( PACKET_TYPE_LORA );
+    TimeOnAir = SX126x_GetTimeOnAir( &modParams, &packetParams );
+
+    TestCoordinator( &packetParams );
+    for( uint32_t i = 0; i < TEST_NODES; i++ )
+    {
+        // The nodes boot after the coordinator, their 32 bit counters wrap
+        TestNode( NodeDrifts[i], 400000 + TestRandom( ) % 500000 );
+    }
+
+    return TestEnd( "test_timesync" );
+}
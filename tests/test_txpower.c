@@ -0,0 +1,240 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * TX power control: the commands a change of power costs on the bus, then a
+ * node sending to neighbors near and far with the SNR of its frames coming
+ * back in the acknowledgements, and the energy of its transmissions against
+ * a fixed power
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+#include "sx126x_energy.h"
+#include "sx126x_txpower.h"
+
+#define TEST_PEERS                                  6
+#define TEST_FRAMES                                 3000    // Per peer
+#define TEST_SETTLE                                 50      // Frames not counted, per peer
+#define TEST_PAYLOAD                                20
+#define TEST_SF                                     LORA_SF9
+#define TEST_FLOOR_DB                               -12.5
+#define TEST_FADING_DB                              2       // Largest fade or gain of a frame
+#define TEST_ACK_LOSS                               2       // Acknowledgements lost [%]
+#define TEST_MIN_POWER                              -3
+#define TEST_MAX_POWER                              22
+
+/*!
+ * \brief A neighbor: the SNR of a frame is the power minus the loss
+ */
+typedef struct
+{
+    uint8_t       Address;
+    int8_t        Loss;                             //!< Path loss and noise floor [dB]
+}TestPeer_t;
+
+static const TestPeer_t Peers[TEST_PEERS] =
+{
+    { 1, -5 }, { 2, 0 }, { 3, 5 }, { 4, 12 }, { 5, 20 }, { 6, 28 },
+};
+
+/*!
+ * \brief What the node sent
+ */
+typedef struct
+{
+    uint32_t      Frames;
+    uint32_t      Delivered;
+    uint64_t      Charge;                           //!< Of the transmissions [nA * us]
+    uint32_t      TxParams;                         //!< SetTxParams issued
+    uint32_t      PaConfigs;                        //!< SetPaConfig issued
+}TestResult_t;
+
+static uint32_t TimeOnAir;
+
+/*!
+ * \brief Counts an opcode in the log since the last reset of it
+ */
+static uint32_t TestCount( uint8_t opcode )
+{
+    uint32_t count = 0;
+
+    for( uint16_t i = 0; i < MockRadio->LogSize; i++ )
+    {
+        count += ( MockRadio->Log[i] == opcode ) ? 1 : 0;
+    }
+    return count;
+}
+
+/*!
+ * \brief Sends frames round robin to every peer, with the power of the
+ *        controller or a fixed one
+ */
+static TestResult_t TestRun( int8_t fixedPower )
+{
+    TestResult_t result;
+
+    memset( &result, 0, sizeof( result ) );
+    SX126x_TxPowerInit( TEST_MIN_POWER, TEST_MAX_POWER );
+    for( uint32_t n = 0; n < TEST_FRAMES; n++ )
+    {
+        for( uint8_t p = 0; p < TEST_PEERS; p++ )
+        {
+            uint8_t counted = ( n >= TEST_SETTLE ) ? 1 : 0;
+            int8_t power;
+            double snr;
+
+            MockRadio->LogSize = 0;
+            if( fixedPower == INT8_MIN )
+            {
+                SX126x_TxPowerApply( Peers[p].Address, RADIO_RAMP_200_US );
+            }
+            else
+            {
+                SX126x_SetTxParams( fixedPower, RADIO_RAMP_200_US );
+            }
+            power = ( fixedPower == INT8_MIN ) ? SX126x_TxPowerGet( Peers[p].Address ) : fixedPower;
+            result.TxParams += TestCount( RADIO_SET_TXPARAMS );
+            result.PaConfigs += TestCount( RADIO_SET_PACONFIG );
+
+            result.Frames += counted;
+            result.Charge += counted * ( uint64_t )TimeOnAir * SX126x_EnergyGetCurrent( MODE_TX );
+            snr = power - Peers[p].Loss + ( double )( TestRandom( ) % ( 8 * TEST_FADING_DB + 1 ) ) / 4 - TEST_FADING_DB;
+            if( snr < TEST_FLOOR_DB )
+            {
+                SX126x_TxPowerOnMiss( Peers[p].Address );
+                continue;
+            }
+            result.Delivered += counted;
+            if( TestRandom( ) % 100 < TEST_ACK_LOSS )
+            {
+                SX126x_TxPowerOnMiss( Peers[p].Address );
+            }
+            else
+            {
+                // The peer reports the SNR it measured, in whole dB
+                SX126x_TxPowerOnAck( Peers[p].Address, ( int8_t )( snr >= 0 ? snr : snr - 1 ), TEST_SF );
+            }
+        }
+    }
+    return result;
+}
+
+static void TestCommands( void )
+{
+    SX126x_TxPowerInit( TEST_MIN_POWER, TEST_MAX_POWER );
+    CHECK( SX126x_TxPowerGet( 1 ) == TEST_MAX_POWER );
+
+    // The same power again costs nothing on the bus
+    MockRadio->LogSize = 0;
+    SX126x_TxPowerApply( 1, RADIO_RAMP_200_US );
+    CHECK( TestCount( RADIO_SET_TXPARAMS ) == 1 );
+    MockRadio->LogSize = 0;
+    SX126x_TxPowerApply( 1, RADIO_RAMP_200_US );
+    SX126x_TxPowerApply( 2, RADIO_RAMP_200_US );
+    CHECK( MockRadio->LogSize == 0 );
+
+    // A high margin: down by at most the step, a new PA setting at 19 dBm
+    // (the one of 20 dBm) then at 16 dBm (17 dBm)
+    SX126x_TxPowerOnAck( 1, 20, TEST_SF );
+    CHECK( SX126x_TxPowerGet( 1 ) == TEST_MAX_POWER - TXPOWER_MAX_STEP_DOWN_DB );
+    MockRadio->LogSize = 0;
+    SX126x_TxPowerApply( 1, RADIO_RAMP_200_US );
+    CHECK( ( TestCount( RADIO_SET_TXPARAMS ) == 1 ) && ( TestCount( RADIO_SET_PACONFIG ) == 1 ) );
+    SX126x_TxPowerOnAck( 1, 20, TEST_SF );
+    MockRadio->LogSize = 0;
+    SX126x_TxPowerApply( 1, RADIO_RAMP_200_US );
+    CHECK( ( TestCount( RADIO_SET_TXPARAMS ) == 1 ) && ( TestCount( RADIO_SET_PACONFIG ) == 1 ) );
+    // 13 then 10 dBm, both on the PA setting of 14 dBm: -3 dB of SNR is
+    // 3 dB over the target at SF9
+    SX126x_TxPowerOnAck( 1, -3, TEST_SF );
+    SX126x_TxPowerApply( 1, RADIO_RAMP_200_US );
+    SX126x_TxPowerOnAck( 1, -3, TEST_SF );
+    CHECK( SX126x_TxPowerGet( 1 ) == 10 );
+    MockRadio->LogSize = 0;
+    SX126x_TxPowerApply( 1, RADIO_RAMP_200_US );
+    CHECK( ( TestCount( RADIO_SET_TXPARAMS ) == 1 ) && ( TestCount( RADIO_SET_PACONFIG ) == 0 ) );
+
+    // Under the target: straight back up by the missing margin
+    SX126x_TxPowerOnAck( 1, -12, TEST_SF );
+    CHECK( SX126x_TxPowerGet( 1 ) == 10 + 6 );
+    SX126x_TxPowerOnMiss( 1 );
+    CHECK( SX126x_TxPowerGet( 1 ) == 16 + TXPOWER_MISS_STEP_DB );
+    for( uint8_t i = 0; i < 20; i++ )
+    {
+        SX126x_TxPowerOnAck( 1, 30, TEST_SF );
+    }
+    CHECK( SX126x_TxPowerGet( 1 ) == TEST_MIN_POWER );
+    CHECK( SX126x_TxPowerGet( 2 ) == TEST_MAX_POWER );
+}
+
+static void TestSimulation( void )
+{
+    static const int8_t fixed[] = { 22, 14 };
+    TestResult_t loop;
+
+    loop = TestRun( INT8_MIN );
+    // The node still gets its frames through, with much less energy
+    CHECK( loop.Delivered * 100 >= loop.Frames * 97 );
+    // Round robin over peers at different powers: SetTxParams on a change
+    // only, and the PA only when its setting changes too
+    CHECK( loop.TxParams < TEST_PEERS * TEST_FRAMES );
+    CHECK( loop.PaConfigs < loop.TxParams );
+    for( uint8_t p = 0; p < TEST_PEERS; p++ )
+    {
+        int8_t power = SX126x_TxPowerGet( Peers[p].Address );
+        double margin = power - Peers[p].Loss - TEST_FLOOR_DB;
+
+        CHECK( ( power == TEST_MIN_POWER ) || ( power == TEST_MAX_POWER ) ||
+               ( ( margin >= TXPOWER_TARGET_MARGIN_DB - TXPOWER_HYSTERESIS_DB - TEST_FADING_DB - 1 ) &&
+                 ( margin <= TXPOWER_TARGET_MARGIN_DB + TXPOWER_HYSTERESIS_DB + TEST_FADING_DB + 1 ) ) );
+        printf( "txpower: path %+3d dB, settled at %+3d dBm, %4.1f dB over the SF9 floor\n", Peers[p].Loss, power, margin );
+    }
+
+    for( uint8_t f = 0; f < sizeof( fixed ); f++ )
+    {
+        TestResult_t reference = TestRun( fixed[f] );
+
+        CHECK( loop.Charge < reference.Charge );
+        printf( "txpower: closed loop %5.1f mJ per frame, %5.1f %% delivered, %u SetTxParams, %u SetPaConfig; fixed %2d dBm %5.1f mJ per frame, %5.1f %% delivered: %4.1f %% saved\n",
+                SX126x_EnergyToMicroJoule( loop.Charge ) / 1e3 / loop.Frames, 100.0 * loop.Delivered / loop.Frames, loop.TxParams, loop.PaConfigs,
+                fixed[f], SX126x_EnergyToMicroJoule( reference.Charge ) / 1e3 / reference.Frames, 100.0 * reference.Delivered / reference.Frames,
+                100.0 * ( 1.0 - ( double )loop.Charge / reference.Charge ) );
+        if( fixed[f] == TEST_MAX_POWER )
+        {
+            // At least 40 % saved
+            CHECK( loop.Charge * 10 < reference.Charge * 6 );
+        }
+    }
+}
+
+int main( void )
+{
+    ModulationParams_t modParams;
+    PacketParams_t packetParams;
+
+    MockReset( );
+    SX126xHal_SpiInit( );
+    SX126x_EnergyInit( MockTimeUs );
+    MockLoRaProfile( &modParams, &packetParams, TEST_SF, TEST_PAYLOAD );
+    TimeOnAir = SX126x_GetTimeOnAir( &modParams, &packetParams );
+
+    TestCommands( );
+    TestSimulation( );
+
+    return TestEnd( "test_txpower" );
+}
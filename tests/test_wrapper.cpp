@@ -0,0 +1,216 @@
+/*
+__/\\\\____________/\\\\_____/\\\\\\\\\\\\_
+ _\/\\\\\\________/\\\\\\___/\\\//////////__
+  _\/\\\//\\\____/\\\//\\\__/\\\_____________
+   _\/\\\\///\\\/\\\/_\/\\\_\/\\\____/\\\\\\\_
+    _\/\\\__\///\\\/___\/\\\_\/\\\___\/////\\\_
+     _\/\\\____\///_____\/\\\_\/\\\_______\/\\\_
+      _\/\\\_____________\/\\\_\/\\\_______\/\\\_
+       _\/\\\_____________\/\\\_\//\\\\\\\\\\\\/__
+        _\///______________\///___\////////////____
+
+Author: Marco Giordano
+*/
+
+/*
+ * C++ wrapper: the same frames and radio state as the C driver for the same
+ * commands, two radios on their own policies, and the time of the same
+ * commands through the C driver and through the wrapper on the same mocked
+ * bus
+ */
+
+#include <cstring>
+#include <type_traits>
+
+extern "C"
+{
+#include "test.h"
+#include "mock_radio.h"
+#include "sx126x_hal.h"
+}
+
+#define SX126X_DEVICE_POLICIES
+#include "sx126x.hpp"
+
+#define TEST_ITERATIONS                             200000
+#define TEST_RUNS                                   5       // The best one is kept
+
+using namespace sx126x;
+
+/*!
+ * \brief The bus of the device functions, on a radio of the mock: NSS of
+ *        each radio on its own pin, in the test the radio it selects
+ */
+template< uint8_t Index >
+struct TestBus
+{
+    static void Select( )
+    {
+        MockSelect( Index );
+        DeviceBus< NSS >::Select( );
+    }
+    static void Deselect( ) { DeviceBus< NSS >::Deselect( ); }
+    static void Transfer( const uint8_t *tx, uint8_t *rx, std::size_t size ) { DeviceBus< NSS >::Transfer( tx, rx, size ); }
+};
+
+using TestPins = DevicePins< BUSY, RST >;
+using TestRadio0 = Radio< TestBus< 0 >, TestPins >;
+using TestRadio1 = Radio< TestBus< 1 >, TestPins >;
+
+// Two radios are two types: no shared code path chosen at run time
+static_assert( !std::is_same< TestRadio0, TestRadio1 >::value, "one type per radio" );
+static_assert( !std::is_polymorphic< TestRadio0 >::value, "no virtual call" );
+static_assert( sizeof( TestRadio0 ) <= 2, "the status and its freshness only" );
+
+/*!
+ * \brief What a radio of the mock ended with
+ */
+static bool TestSameRadio( const MockRadio_t &a, const MockRadio_t &b )
+{
+    return ( a.LogSize == b.LogSize ) && ( std::memcmp( a.Log, b.Log, a.LogSize ) == 0 ) &&
+           ( std::memcmp( a.Buffer, b.Buffer, sizeof( a.Buffer ) ) == 0 ) && ( a.TxBase == b.TxBase ) &&
+           ( a.RxBase == b.RxBase ) && ( a.PacketType == b.PacketType ) && ( a.PayloadLength == b.PayloadLength ) &&
+           ( a.Mode == b.Mode ) && ( a.RxTimeout == b.RxTimeout ) && ( a.Frequency == b.Frequency ) && ( a.Irq == b.Irq );
+}
+
+/*!
+ * \brief The same commands through the C driver on radio 0 and through the
+ *        wrapper on radio 1
+ */
+static void TestFrames( void )
+{
+    static const uint8_t payload[] = { 'P', 'I', 'N', 'G', 0x00, 0xFF };
+    TestRadio1 radio;
+    uint8_t readC[sizeof( payload )];
+    uint8_t readCpp[sizeof( payload )];
+    uint32_t bytesC;
+    uint32_t bytesCpp;
+    uint16_t irqC;
+    Irq irqCpp;
+
+    MockReset( );
+    MockSelect( 0 );
+    MockSpiBytes = 0;
+    SX126x_SetStandby( STDBY_XOSC );
+    SX126x_SetPacketType( PACKET_TYPE_LORA );
+    SX126x_SetRfFrequencyWord( SX126x_GetFrequencyWord( 868100000 ) );
+    SX126x_SetBufferBaseAddresses( 0x80, 0x00 );
+    SX126x_SetDioIrqParams( IRQ_TX_DONE | IRQ_RX_DONE, IRQ_TX_DONE | IRQ_RX_DONE, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
+    SX126xHal_WriteBuffer( 0x80, ( uint8_t * )payload, sizeof( payload ) );
+    SX126xHal_ReadBuffer( 0x80, readC, sizeof( readC ) );
+    SX126x_SetTx( 0 );
+    MockRadios[0].Irq = IRQ_TX_DONE;
+    irqC = SX126x_GetIrqStatus( );
+    SX126x_ClearIrqStatus( IRQ_RADIO_ALL );
+    SX126x_SetRx( 0xFFFFFF );
+    bytesC = MockSpiBytes;
+
+    MockSpiBytes = 0;
+    radio.SetStandby( StandbyMode::Xosc );
+    radio.SetPacketType( PacketType::LoRa );
+    radio.SetRfFrequency< 868100000 >( );
+    radio.SetBufferBaseAddress( 0x80, 0x00 );
+    radio.SetDioIrqParams( Irq::TxDone | Irq::RxDone, Irq::TxDone | Irq::RxDone );
+    radio.WriteBuffer( 0x80, payload );
+    radio.ReadBuffer( 0x80, readCpp );
+    radio.SetTx( 0 );
+    MockRadios[1].Irq = IRQ_TX_DONE;
+    irqCpp = radio.GetIrqStatus( );
+    radio.ClearIrqStatus( Irq::All );
+    radio.SetRx( 0xFFFFFF );
+    bytesCpp = MockSpiBytes;
+
+    CHECK( TestSameRadio( MockRadios[0], MockRadios[1] ) );
+    CHECK( MockRadios[1].Mode == MODE_RX );
+    CHECK( bytesC == bytesCpp );
+    CHECK( ( std::memcmp( readC, payload, sizeof( payload ) ) == 0 ) && ( std::memcmp( readCpp, payload, sizeof( payload ) ) == 0 ) );
+    CHECK( ( irqC == IRQ_TX_DONE ) && ( irqCpp & Irq::TxDone ) && !( irqCpp & Irq::RxDone ) );
+    // The status of the last transaction: SetRx changed the mode, a new one is read
+    CHECK( radio.GetStatus( ).Mode( ) == ChipMode::Rx );
+    CHECK( MockNssViolations == 0 );
+    printf( "wrapper: %u transactions and %u SPI bytes, the same as the C driver\n", MockRadios[1].LogSize, bytesCpp );
+}
+
+/*!
+ * \brief Two radios on their own policies keep their own state
+ */
+static void TestRadios( void )
+{
+    TestRadio0 radio0;
+    TestRadio1 radio1;
+    uint8_t value = 0x5A;
+
+    MockReset( );
+    radio0.SetRfFrequency< 868300000 >( );
+    radio1.SetRfFrequency( 915000000 );
+    radio0.SetRx( 0 );
+    radio1.SetStandby( StandbyMode::Rc );
+    radio1.WriteRegister( 0x0740, Span< const uint8_t >( &value, 1 ) );
+
+    CHECK( MockRadios[0].Frequency == FrequencyWord( 868300000 ) );
+    CHECK( MockRadios[1].Frequency == FrequencyWord( 915000000 ) );
+    CHECK( ( MockRadios[0].Mode == MODE_RX ) && ( MockRadios[1].Mode == MODE_STDBY_RC ) );
+    CHECK( ( MockRadios[0].LogSize == 2 ) && ( MockRadios[1].LogSize == 3 ) );
+    CHECK( ( radio0.LastStatus( ).Mode( ) == ChipMode::StandbyRc ) && ( radio1.LastStatus( ).Mode( ) == ChipMode::StandbyRc ) );
+}
+
+/*!
+ * \brief Best time of a run of three commands, in ns per command
+ */
+template< typename Commands >
+static double TestTime( Commands commands )
+{
+    double best = 1e9;
+
+    for( uint8_t run = 0; run < TEST_RUNS; run++ )
+    {
+        uint64_t start = TestNowNs( );
+
+        for( uint32_t i = 0; i < TEST_ITERATIONS; i++ )
+        {
+            commands( );
+        }
+        double ns = ( double )( TestNowNs( ) - start ) / ( 3.0 * TEST_ITERATIONS );
+        best = ( ns < best ) ? ns : best;
+        // The log of the mock would saturate
+        MockRadio->LogSize = 0;
+    }
+    return best;
+}
+
+static void TestBenchmark( void )
+{
+    TestRadio0 radio;
+    double c;
+    double cpp;
+
+    MockReset( );
+    SX126x_SetRfFrequency( 868000000 );
+    c = TestTime( [ ]( )
+    {
+        SX126x_SetStandby( STDBY_RC );
+        SX126x_SetBufferBaseAddresses( 0x00, 0x80 );
+        SX126x_SetRfFrequency( 868000000 );
+    } );
+    cpp = TestTime( [ &radio ]( )
+    {
+        radio.SetStandby( StandbyMode::Rc );
+        radio.SetBufferBaseAddress( 0x00, 0x80 );
+        radio.SetRfFrequency< 868000000 >( );
+    } );
+
+    // The mock answers both the same way: the difference is the layer
+    printf( "wrapper: C driver %.1f ns per command, C++ wrapper %.1f ns per command on the same mocked bus\n", c, cpp );
+    CHECK( cpp <= c * 1.1 );
+}
+
+int main( void )
+{
+    MockReset( );
+    SX126xHal_SpiInit( );
+    TestFrames( );
+    TestRadios( );
+    TestBenchmark( );
+
+    return TestEnd( "test_wrapper" );
+}